@@ -0,0 +1,251 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "BindlessHeap.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+    constexpr std::array<VkDescriptorType, BindlessHeap::k_type_count> k_descriptor_types{
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_SAMPLER,
+    };
+
+    constexpr std::array<const char*, BindlessHeap::k_type_count> k_type_names{
+        "sampled images", "storage images", "storage buffers", "samplers"
+    };
+}
+
+void BindlessHeap::init(VkDevice device, VkPhysicalDevice physical_device, DeletionQueue& deletion_queue,
+                        const Capacity& capacity)
+{
+    device_ = device;
+    deletion_queue_ = &deletion_queue;
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexing{};
+    indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexing;
+    vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+    // 整个集合和单个着色器阶段的 update-after-bind 上限都要满足 (所有 binding 对全部阶段可见)
+    std::array<uint32_t, k_type_count> counts{
+        std::min({
+            capacity.sampled_images, indexing.maxDescriptorSetUpdateAfterBindSampledImages,
+            indexing.maxPerStageDescriptorUpdateAfterBindSampledImages
+        }),
+        std::min({
+            capacity.storage_images, indexing.maxDescriptorSetUpdateAfterBindStorageImages,
+            indexing.maxPerStageDescriptorUpdateAfterBindStorageImages
+        }),
+        std::min({
+            capacity.storage_buffers, indexing.maxDescriptorSetUpdateAfterBindStorageBuffers,
+            indexing.maxPerStageDescriptorUpdateAfterBindStorageBuffers
+        }),
+        std::min({
+            capacity.samplers, indexing.maxDescriptorSetUpdateAfterBindSamplers,
+            indexing.maxPerStageDescriptorUpdateAfterBindSamplers
+        }),
+    };
+    // 总数超过单阶段资源上限时把最大的数组减半, 直到满足
+    while (std::accumulate(counts.begin(), counts.end(), uint64_t{0}) > indexing.maxPerStageUpdateAfterBindResources)
+    {
+        auto& largest = *std::ranges::max_element(counts);
+        if (largest <= 1)
+            break;
+        largest /= 2;
+    }
+
+    std::array<VkDescriptorSetLayoutBinding, k_type_count> bindings{};
+    std::array<VkDescriptorBindingFlags, k_type_count> binding_flags{};
+    std::array<VkDescriptorPoolSize, k_type_count> pool_sizes{};
+    for (uint32_t type = 0; type < k_type_count; ++type)
+    {
+        bindings[type].binding = type;
+        bindings[type].descriptorType = k_descriptor_types[type];
+        bindings[type].descriptorCount = counts[type];
+        bindings[type].stageFlags = VK_SHADER_STAGE_ALL;
+        // 未被着色器访问的元素可以保持未写入, 写入时不影响已经提交的命令缓冲
+        binding_flags[type] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+            | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+            | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        pool_sizes[type] = {k_descriptor_types[type], counts[type]};
+
+        free_lists_[type] = {};
+        free_lists_[type].capacity = counts[type];
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info{};
+    flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flags_info.bindingCount = k_type_count;
+    flags_info.pBindingFlags = binding_flags.data();
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = &flags_info;
+    layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout_info.bindingCount = k_type_count;
+    layout_info.pBindings = bindings.data();
+    details::err_check(vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &set_layout_),
+                       "failed to create bindless descriptor set layout!");
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = k_type_count;
+    pool_info.pPoolSizes = pool_sizes.data();
+    details::err_check(vkCreateDescriptorPool(device_, &pool_info, nullptr, &pool_),
+                       "failed to create bindless descriptor pool!");
+
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = pool_;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &set_layout_;
+    details::err_check(vkAllocateDescriptorSets(device_, &allocate_info, &set_),
+                       "failed to allocate bindless descriptor set!");
+
+    fmt::println("[bindless] {} sampled images, {} storage images, {} storage buffers, {} samplers",
+                 counts[0], counts[1], counts[2], counts[3]);
+}
+
+void BindlessHeap::destroy()
+{
+    // 描述符集随池一起释放
+    if (pool_ != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(device_, pool_, nullptr);
+    if (set_layout_ != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(device_, set_layout_, nullptr);
+    pool_ = VK_NULL_HANDLE;
+    set_layout_ = VK_NULL_HANDLE;
+    set_ = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessHeap::allocate(Type type)
+{
+    auto& list = free_lists_[static_cast<uint32_t>(type)];
+    uint32_t index;
+    if (!list.free.empty())
+    {
+        index = list.free.back();
+        list.free.pop_back();
+    }
+    else if (list.next < list.capacity)
+    {
+        index = list.next++;
+    }
+    else
+    {
+        ++allocation_failures_;
+        return UINT32_MAX;
+    }
+    list.peak = std::max(list.peak, ++list.used);
+    return index;
+}
+
+BindlessHeap::Handle BindlessHeap::add(Type type, const VkDescriptorImageInfo* image,
+                                       const VkDescriptorBufferInfo* buffer)
+{
+    std::lock_guard lock(mutex_);
+    const auto index = allocate(type);
+    if (index == UINT32_MAX)
+        return {};
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set_;
+    write.dstBinding = static_cast<uint32_t>(type);
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = k_descriptor_types[static_cast<uint32_t>(type)];
+    write.pImageInfo = image;
+    write.pBufferInfo = buffer;
+    vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+    ++descriptor_writes_;
+    return {type, index};
+}
+
+BindlessHeap::Handle BindlessHeap::add_sampled_image(VkImageView view, VkImageLayout layout)
+{
+    const VkDescriptorImageInfo info{VK_NULL_HANDLE, view, layout};
+    return add(Type::SampledImage, &info, nullptr);
+}
+
+BindlessHeap::Handle BindlessHeap::add_storage_image(VkImageView view)
+{
+    const VkDescriptorImageInfo info{VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL};
+    return add(Type::StorageImage, &info, nullptr);
+}
+
+BindlessHeap::Handle BindlessHeap::add_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    const VkDescriptorBufferInfo info{buffer, offset, range};
+    return add(Type::StorageBuffer, nullptr, &info);
+}
+
+BindlessHeap::Handle BindlessHeap::add_sampler(VkSampler sampler)
+{
+    const VkDescriptorImageInfo info{sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED};
+    return add(Type::Sampler, &info, nullptr);
+}
+
+void BindlessHeap::remove(Handle handle, uint64_t retire_serial)
+{
+    if (!handle)
+        return;
+    // 描述符内容保持不变, 之前录制的命令缓冲执行完之前下标都不会被重新写入
+    deletion_queue_->push(retire_serial, [this, handle]
+    {
+        std::lock_guard lock(mutex_);
+        auto& list = free_lists_[static_cast<uint32_t>(handle.type)];
+        list.free.push_back(handle.index);
+        --list.used;
+    });
+}
+
+VkPushConstantRange BindlessHeap::push_constant_range()
+{
+    return {VK_SHADER_STAGE_ALL, 0, k_push_constant_size};
+}
+
+void BindlessHeap::bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point,
+                        VkPipelineLayout layout) const
+{
+    vkCmdBindDescriptorSets(command_buffer, bind_point, layout, k_set, 1, &set_, 0, nullptr);
+}
+
+BindlessHeap::Stats BindlessHeap::stats() const
+{
+    std::lock_guard lock(mutex_);
+    Stats stats;
+    for (uint32_t type = 0; type < k_type_count; ++type)
+    {
+        stats.capacity[type] = free_lists_[type].capacity;
+        stats.used[type] = free_lists_[type].used;
+        stats.peak[type] = free_lists_[type].peak;
+    }
+    stats.descriptor_writes = descriptor_writes_;
+    stats.allocation_failures = allocation_failures_;
+    return stats;
+}
+
+void BindlessHeap::print_stats() const
+{
+    const auto stats = this->stats();
+    for (uint32_t type = 0; type < k_type_count; ++type)
+    {
+        fmt::println("[bindless] {}: {} used, peak {} of {}", k_type_names[type], stats.used[type],
+                     stats.peak[type], stats.capacity[type]);
+    }
+    fmt::println("[bindless] {} descriptor writes, {} allocation failures", stats.descriptor_writes,
+                 stats.allocation_failures);
+}
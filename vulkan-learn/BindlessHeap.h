@@ -0,0 +1,144 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_BINDLESSHEAP_H
+#define VULKAN_LEARN_BINDLESSHEAP_H
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+#include "DeletionQueue.h"
+
+/**
+ * @brief 全局 bindless 描述符堆
+ *
+ * 一个描述符集 (管线布局的 set k_set) 里每种资源一个大数组, 着色器用 push constant 传入的下标直接索引
+ * (见 shader/bindless.glsl):
+ *  - binding 0: sampled image, binding 1: storage image, binding 2: storage buffer, binding 3: sampler
+ *
+ * 各 binding 都带 UPDATE_AFTER_BIND | PARTIALLY_BOUND | UPDATE_UNUSED_WHILE_PENDING, 描述符集创建后只绑定一次,
+ * 之后添加资源直接写入描述符, 不影响已经录制或正在执行的命令缓冲; 绘制之间不再需要绑定任何描述符集,
+ * 每个命令缓冲开头 bind 一次即可 (次级命令缓冲不继承绑定, 各自 bind).
+ *
+ * 每种资源的下标由空闲链表分配. remove 的下标在 retire_serial 对应的提交完成后才回到空闲链表,
+ * 在此之前仍可能被 GPU 读取. add / remove 可以在任意线程调用.
+ */
+class BindlessHeap
+{
+public:
+    enum class Type : uint32_t
+    {
+        SampledImage,
+        StorageImage,
+        StorageBuffer,
+        Sampler,
+    };
+
+    static constexpr uint32_t k_type_count = 4;
+
+    // 在管线布局中的位置, set 0 留给每帧数据的 dynamic uniform buffer
+    static constexpr uint32_t k_set = 1;
+
+    struct Handle
+    {
+        Type type = Type::SampledImage;
+        uint32_t index = UINT32_MAX;
+
+        explicit operator bool() const { return index != UINT32_MAX; }
+    };
+
+    // 各数组的容量, 超过设备 update-after-bind 上限时按上限截断
+    struct Capacity
+    {
+        uint32_t sampled_images = 16384;
+        uint32_t storage_images = 4096;
+        uint32_t storage_buffers = 16384;
+        uint32_t samplers = 256;
+    };
+
+    // 所有管线共用的 push constant 大小, 128 字节是规范保证的最小 maxPushConstantsSize
+    static constexpr uint32_t k_push_constant_size = 128;
+
+    struct Stats
+    {
+        std::array<uint32_t, k_type_count> capacity{};
+        std::array<uint32_t, k_type_count> used{};
+        std::array<uint32_t, k_type_count> peak{};
+        uint64_t descriptor_writes = 0;
+        uint32_t allocation_failures = 0; // 数组已满
+    };
+
+    BindlessHeap() = default;
+    BindlessHeap(const BindlessHeap&) = delete;
+    BindlessHeap& operator=(const BindlessHeap&) = delete;
+
+    // 设备需要启用 descriptorIndexing 中 runtimeDescriptorArray, descriptorBindingPartiallyBound,
+    // descriptorBindingUpdateUnusedWhilePending 以及四种资源的 UpdateAfterBind 特性
+    void init(VkDevice device, VkPhysicalDevice physical_device, DeletionQueue& deletion_queue,
+              const Capacity& capacity = {});
+
+    void destroy();
+
+    bool initialized() const { return set_ != VK_NULL_HANDLE; }
+
+    // 数组已满时返回空句柄
+    Handle add_sampled_image(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    Handle add_storage_image(VkImageView view);
+
+    Handle add_storage_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    Handle add_sampler(VkSampler sampler);
+
+    // 下标在 retire_serial 完成后才能被重新分配
+    void remove(Handle handle, uint64_t retire_serial);
+
+    VkDescriptorSetLayout set_layout() const { return set_layout_; }
+
+    VkDescriptorSet set() const { return set_; }
+
+    // 所有管线布局使用的 push constant 范围
+    static VkPushConstantRange push_constant_range();
+
+    // 在命令缓冲开头绑定一次, layout 的 set k_set 必须是 set_layout()
+    void bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout layout) const;
+
+    Stats stats() const;
+
+    void print_stats() const;
+
+private:
+    struct FreeList
+    {
+        uint32_t capacity = 0;
+        // 从未分配过的最小下标
+        uint32_t next = 0;
+        std::vector<uint32_t> free;
+        uint32_t used = 0;
+        uint32_t peak = 0;
+    };
+
+    uint32_t allocate(Type type);
+
+    // 分配下标并写入描述符, 数组已满时返回空句柄
+    Handle add(Type type, const VkDescriptorImageInfo* image, const VkDescriptorBufferInfo* buffer);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    DeletionQueue* deletion_queue_ = nullptr;
+    VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+    VkDescriptorPool pool_ = VK_NULL_HANDLE;
+    VkDescriptorSet set_ = VK_NULL_HANDLE;
+
+    // 同时保护空闲链表和描述符集的写入 (vkUpdateDescriptorSets 需要对 dstSet 外部同步)
+    mutable std::mutex mutex_;
+    std::array<FreeList, k_type_count> free_lists_;
+    uint64_t descriptor_writes_ = 0;
+    uint32_t allocation_failures_ = 0;
+};
+
+
+#endif //VULKAN_LEARN_BINDLESSHEAP_H
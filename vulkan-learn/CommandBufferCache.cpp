@@ -0,0 +1,155 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "CommandBufferCache.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ranges>
+
+void CommandBufferCache::init(VkDevice device, uint32_t queue_family, DeletionQueue& deletion_queue)
+{
+    device_ = device;
+    deletion_queue_ = &deletion_queue;
+
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // vkBeginCommandBuffer 隐式重置单个命令缓冲
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = queue_family;
+    details::err_check(vkCreateCommandPool(device_, &pool_info, nullptr, &command_pool_),
+                       "failed to create command buffer cache pool!");
+}
+
+void CommandBufferCache::destroy()
+{
+    // 销毁命令池时一并释放其中的所有命令缓冲
+    vkDestroyCommandPool(device_, command_pool_, nullptr);
+    command_pool_ = VK_NULL_HANDLE;
+    secondaries_.clear();
+    primaries_.clear();
+}
+
+VkCommandBuffer CommandBufferCache::allocate(VkCommandBufferLevel level)
+{
+    VkCommandBufferAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool = command_pool_;
+    allocate_info.level = level;
+    allocate_info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    details::err_check(vkAllocateCommandBuffers(device_, &allocate_info, &command_buffer),
+                       "failed to allocate cached command buffer!");
+    return command_buffer;
+}
+
+VkCommandBuffer CommandBufferCache::secondary(uint32_t id, uint64_t version,
+                                              const VkCommandBufferInheritanceInfo& inheritance,
+                                              const Recorder& record, uint64_t retire_serial)
+{
+    auto& entry = secondaries_[id];
+    if (entry.command_buffer != VK_NULL_HANDLE && entry.version == version)
+    {
+        ++stats_.secondary_hits;
+        return entry.command_buffer;
+    }
+
+    // 旧缓冲可能还在被执行中的主命令缓冲引用, 不能原地重置
+    if (entry.command_buffer != VK_NULL_HANDLE)
+    {
+        deletion_queue_->push(retire_serial, [device = device_, pool = command_pool_,
+                                  command_buffer = entry.command_buffer]
+                              {
+                                  vkFreeCommandBuffers(device, pool, 1, &command_buffer);
+                              });
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+
+    entry.command_buffer = allocate(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT
+        | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    begin_info.pInheritanceInfo = &inheritance;
+    details::err_check(vkBeginCommandBuffer(entry.command_buffer, &begin_info),
+                       "failed to begin secondary command buffer!");
+    record(entry.command_buffer);
+    details::err_check(vkEndCommandBuffer(entry.command_buffer), "failed to record secondary command buffer!");
+
+    entry.version = version;
+    entry.record_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    frame_secondary_ms_ += entry.record_ms;
+    stats_.record_ms += entry.record_ms;
+    ++stats_.secondary_records;
+    // 引用它的主命令缓冲都要重新录制
+    ++version_;
+    return entry.command_buffer;
+}
+
+VkCommandBuffer CommandBufferCache::primary(uint32_t frame, uint32_t image, const Recorder& record)
+{
+    ++stats_.frames;
+    auto& entry = primaries_[static_cast<uint64_t>(frame) << 32 | image];
+    if (entry.command_buffer != VK_NULL_HANDLE && entry.version == version_)
+    {
+        ++stats_.primary_hits;
+        stats_.saved_ms += std::max(full_record_ms() - frame_secondary_ms_, 0.0);
+        frame_secondary_ms_ = 0;
+        return entry.command_buffer;
+    }
+
+    if (entry.command_buffer == VK_NULL_HANDLE)
+    {
+        entry.command_buffer = allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    details::err_check(vkBeginCommandBuffer(entry.command_buffer, &begin_info),
+                       "Failed to begin record command buffer!");
+    record(entry.command_buffer);
+    details::err_check(vkEndCommandBuffer(entry.command_buffer), "failed to record command buffer!");
+
+    const double record_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    // 平滑一下, 主命令缓冲很短, 单次测量波动大
+    primary_record_ms_ = primary_record_ms_ == 0 ? record_ms : primary_record_ms_ * 0.9 + record_ms * 0.1;
+    stats_.record_ms += record_ms;
+    stats_.saved_ms += std::max(full_record_ms() - primary_record_ms_ - frame_secondary_ms_, 0.0);
+    frame_secondary_ms_ = 0;
+    ++stats_.primary_records;
+
+    entry.version = version_;
+    return entry.command_buffer;
+}
+
+void CommandBufferCache::invalidate()
+{
+    ++version_;
+}
+
+double CommandBufferCache::full_record_ms() const
+{
+    double total = primary_record_ms_;
+    for (const auto& entry : secondaries_ | std::views::values)
+    {
+        total += entry.record_ms;
+    }
+    return total;
+}
+
+void CommandBufferCache::print_stats() const
+{
+    fmt::println("[command buffer cache] {} frames, primary {} hits / {} records, secondary {} hits / {} records",
+                 stats_.frames, stats_.primary_hits, stats_.primary_records, stats_.secondary_hits,
+                 stats_.secondary_records);
+    fmt::println("[command buffer cache] recorded {:.3f}ms, saved ~{:.3f}ms ({:.4f}ms per frame)",
+                 stats_.record_ms, stats_.saved_ms, stats_.frames ? stats_.saved_ms / stats_.frames : 0.0);
+}
@@ -0,0 +1,106 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_COMMANDBUFFERCACHE_H
+#define VULKAN_LEARN_COMMANDBUFFERCACHE_H
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <unordered_map>
+
+#include "DeletionQueue.h"
+
+/**
+ * @brief 按帧状态版本缓存已录制的命令缓冲
+ *
+ * 画面内容由若干次级命令缓冲组成, 每个部分带一个内容版本, 版本不变时直接复用, 变化时只重新录制这一部分.
+ * 次级命令缓冲以 SIMULTANEOUS_USE 录制, 可以同时被多个尚未执行完的主命令缓冲引用; 被替换下来的旧缓冲交给
+ * DeletionQueue, 在最后一次可能引用它的提交完成后释放.
+ *
+ * 主命令缓冲只负责开始渲染流程并执行次级命令缓冲, 按 (飞行帧, 交换链图像) 缓存. 同一个飞行帧上一次的
+ * 提交完成后它的槽位才会再次使用, 复用时命令缓冲不会处于 pending 状态. 任一部分重新录制或 invalidate 之后
+ * 状态版本加一, 所有主命令缓冲在下次使用时重新录制.
+ *
+ * 不加锁, 只能在提交线程上使用.
+ */
+class CommandBufferCache
+{
+public:
+    using Recorder = std::function<void(VkCommandBuffer)>;
+
+    struct Stats
+    {
+        uint32_t frames = 0;
+        uint32_t primary_hits = 0;
+        uint32_t primary_records = 0;
+        uint32_t secondary_hits = 0;
+        uint32_t secondary_records = 0;
+        double record_ms = 0; // 实际花在录制上的时间
+        double saved_ms = 0; // 按各部分最近一次录制耗时估算的节省时间
+    };
+
+    CommandBufferCache() = default;
+    CommandBufferCache(const CommandBufferCache&) = delete;
+    CommandBufferCache& operator=(const CommandBufferCache&) = delete;
+
+    void init(VkDevice device, uint32_t queue_family, DeletionQueue& deletion_queue);
+
+    // 所有引用缓存命令缓冲的提交都已完成, 并且 deletion_queue 已经 flush
+    void destroy();
+
+    // 返回部分 id 的次级命令缓冲, version 与上次不同时用 record 重新录制 (不需要调用 begin/end).
+    // retire_serial 为最近一次提交的 serial, 旧缓冲在它完成后释放
+    VkCommandBuffer secondary(uint32_t id, uint64_t version, const VkCommandBufferInheritanceInfo& inheritance,
+                              const Recorder& record, uint64_t retire_serial);
+
+    // 返回 (frame, image) 的主命令缓冲, 状态版本变化后用 record 重新录制 (不需要调用 begin/end).
+    // 调用前 frame 上一次的提交必须已经完成
+    VkCommandBuffer primary(uint32_t frame, uint32_t image, const Recorder& record);
+
+    // 主命令缓冲引用的对象(帧缓冲, 渲染流程)失效时调用, 例如交换链重建
+    void invalidate();
+
+    uint64_t version() const { return version_; }
+
+    Stats stats() const { return stats_; }
+
+    void print_stats() const;
+
+private:
+    struct Secondary
+    {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        uint64_t version = 0;
+        double record_ms = 0;
+    };
+
+    struct Primary
+    {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        uint64_t version = 0;
+    };
+
+    VkCommandBuffer allocate(VkCommandBufferLevel level);
+
+    // 不使用缓存时这一帧需要的录制时间
+    double full_record_ms() const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    DeletionQueue* deletion_queue_ = nullptr;
+    VkCommandPool command_pool_ = VK_NULL_HANDLE;
+
+    std::unordered_map<uint32_t, Secondary> secondaries_;
+    // key 为 frame << 32 | image
+    std::unordered_map<uint64_t, Primary> primaries_;
+    uint64_t version_ = 1;
+
+    double primary_record_ms_ = 0;
+    // 本帧在 primary 之前重新录制次级命令缓冲花的时间
+    double frame_secondary_ms_ = 0;
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_COMMANDBUFFERCACHE_H
@@ -0,0 +1,104 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "DeletionQueue.h"
+
+#include <algorithm>
+#include <vector>
+
+void DeletionQueue::init(VkDevice device, GpuAllocator& allocator)
+{
+    device_ = device;
+    allocator_ = &allocator;
+}
+
+void DeletionQueue::push(uint64_t serial, std::function<void()> destroy)
+{
+    std::lock_guard lock(mutex_);
+    // 绝大多数情况下 serial 单调递增, 直接追加到末尾
+    const auto position = std::upper_bound(entries_.begin(), entries_.end(), serial,
+                                           [](uint64_t value, const Entry& entry) { return value < entry.serial; });
+    entries_.insert(position, Entry{serial, std::move(destroy)});
+}
+
+void DeletionQueue::push(uint64_t serial, VkBuffer buffer, GpuAllocation allocation)
+{
+    push(serial, [this, buffer, allocation]() mutable { allocator_->destroy_buffer(buffer, allocation); });
+}
+
+void DeletionQueue::push(uint64_t serial, VkImage image, GpuAllocation allocation)
+{
+    push(serial, [this, image, allocation]() mutable
+    {
+        vkDestroyImage(device_, image, nullptr);
+        allocator_->free(allocation);
+    });
+}
+
+void DeletionQueue::push(uint64_t serial, VkImageView image_view)
+{
+    push(serial, [this, image_view] { vkDestroyImageView(device_, image_view, nullptr); });
+}
+
+void DeletionQueue::push(uint64_t serial, VkFramebuffer framebuffer)
+{
+    push(serial, [this, framebuffer] { vkDestroyFramebuffer(device_, framebuffer, nullptr); });
+}
+
+void DeletionQueue::push(uint64_t serial, VkPipeline pipeline)
+{
+    push(serial, [this, pipeline] { vkDestroyPipeline(device_, pipeline, nullptr); });
+}
+
+void DeletionQueue::push(uint64_t serial, VkPipelineLayout pipeline_layout)
+{
+    push(serial, [this, pipeline_layout] { vkDestroyPipelineLayout(device_, pipeline_layout, nullptr); });
+}
+
+void DeletionQueue::push(uint64_t serial, VkRenderPass render_pass)
+{
+    push(serial, [this, render_pass] { vkDestroyRenderPass(device_, render_pass, nullptr); });
+}
+
+void DeletionQueue::push(uint64_t serial, VkShaderModule shader_module)
+{
+    push(serial, [this, shader_module] { vkDestroyShaderModule(device_, shader_module, nullptr); });
+}
+
+void DeletionQueue::push(uint64_t serial, GpuAllocation allocation)
+{
+    push(serial, [this, allocation]() mutable { allocator_->free(allocation); });
+}
+
+void DeletionQueue::collect(uint64_t completed_serial)
+{
+    // 先取出再在锁外销毁, 销毁回调里可以继续 push
+    std::vector<Entry> ready;
+    {
+        std::lock_guard lock(mutex_);
+        while (!entries_.empty() && entries_.front().serial <= completed_serial)
+        {
+            ready.push_back(std::move(entries_.front()));
+            entries_.pop_front();
+        }
+    }
+    for (auto& entry : ready)
+    {
+        entry.destroy();
+    }
+}
+
+void DeletionQueue::flush()
+{
+    while (pending() > 0)
+    {
+        collect(UINT64_MAX);
+    }
+}
+
+size_t DeletionQueue::pending() const
+{
+    std::lock_guard lock(mutex_);
+    return entries_.size();
+}
@@ -0,0 +1,77 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_DELETIONQUEUE_H
+#define VULKAN_LEARN_DELETIONQUEUE_H
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "GpuAllocator.h"
+
+/**
+ * @brief 延迟销毁队列
+ *
+ * 每个被替换下来的对象都带上最后一次使用它的提交序号(serial), 只有当该序号对应的提交完成后
+ * (collect 传入的 completed_serial 不小于它) 才真正销毁. 替换资源时因此不需要 vkDeviceWaitIdle.
+ *
+ * serial 由调用方维护: 每次向图形队列提交一帧加一, 即帧时间线信号量在这次提交完成后的值.
+ */
+class DeletionQueue
+{
+public:
+    DeletionQueue() = default;
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    void init(VkDevice device, GpuAllocator& allocator);
+
+    void push(uint64_t serial, std::function<void()> destroy);
+
+    void push(uint64_t serial, VkBuffer buffer, GpuAllocation allocation);
+
+    void push(uint64_t serial, VkImage image, GpuAllocation allocation);
+
+    void push(uint64_t serial, VkImageView image_view);
+
+    void push(uint64_t serial, VkFramebuffer framebuffer);
+
+    void push(uint64_t serial, VkPipeline pipeline);
+
+    void push(uint64_t serial, VkPipelineLayout pipeline_layout);
+
+    void push(uint64_t serial, VkRenderPass render_pass);
+
+    void push(uint64_t serial, VkShaderModule shader_module);
+
+    void push(uint64_t serial, GpuAllocation allocation);
+
+    // 销毁所有 serial <= completed_serial 的对象
+    void collect(uint64_t completed_serial);
+
+    // 设备空闲后销毁全部对象
+    void flush();
+
+    size_t pending() const;
+
+private:
+    struct Entry
+    {
+        uint64_t serial;
+        std::function<void()> destroy;
+    };
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    GpuAllocator* allocator_ = nullptr;
+
+    mutable std::mutex mutex_;
+    // 按 serial 升序
+    std::deque<Entry> entries_;
+};
+
+
+#endif //VULKAN_LEARN_DELETIONQUEUE_H
@@ -0,0 +1,139 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "FrameAllocator.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+
+namespace
+{
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void FrameAllocator::init(VkDevice device, GpuAllocator& allocator, const VkPhysicalDeviceLimits& limits,
+                          uint32_t frame_count, VkDeviceSize frame_size)
+{
+    device_ = device;
+    allocator_ = &allocator;
+    atom_size_ = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+    default_alignment_ = std::max({
+        limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, VkDeviceSize{16}
+    });
+    // 每帧区域的起点同时满足 dynamic offset 和 flush 的对齐
+    frame_size_ = align_up(frame_size, std::max(atom_size_, default_alignment_));
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = frame_size_ * frame_count;
+    buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+        | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+        | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    GpuAllocator::MemoryUsage usage{
+        .required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        .preferred = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    };
+    if (allocator.has_rebar())
+    {
+        // GPU 直接从显存读取, 省掉 PCIe 上的每次访问
+        usage.preferred |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    }
+    allocation_ = allocator.create_buffer(buffer_info, buffer_, usage, atom_size_);
+    if (!allocation_ || !allocation_.mapped)
+    {
+        throw std::runtime_error("failed to create frame ring buffer!");
+    }
+
+    coherent_ = allocator.memory_type_flags(allocation_.memory_type) & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+void FrameAllocator::destroy()
+{
+    allocator_->destroy_buffer(buffer_, allocation_);
+}
+
+void FrameAllocator::begin_frame(uint32_t frame_index)
+{
+    const VkDeviceSize used = head_.load(std::memory_order_relaxed);
+    last_frame_bytes_ = used;
+    peak_frame_bytes_ = std::max(peak_frame_bytes_, used);
+
+    frame_begin_ = frame_size_ * frame_index;
+    head_.store(0, std::memory_order_relaxed);
+    flushed_ = 0;
+}
+
+FrameAllocator::Allocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (alignment == 0)
+        alignment = default_alignment_;
+
+    VkDeviceSize head = head_.load(std::memory_order_relaxed);
+    VkDeviceSize offset;
+    do
+    {
+        offset = align_up(head, alignment);
+        if (offset + size > frame_size_)
+        {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+    }
+    while (!head_.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+    const VkDeviceSize buffer_offset = frame_begin_ + offset;
+    return Allocation{
+        .buffer = buffer_,
+        .offset = buffer_offset,
+        .data = static_cast<char*>(allocation_.mapped) + buffer_offset,
+    };
+}
+
+void FrameAllocator::flush()
+{
+    const VkDeviceSize head = head_.load(std::memory_order_acquire);
+    if (coherent_ || head <= flushed_)
+        return;
+
+    // 区域起点和大小都按 nonCoherentAtomSize 对齐, 向上取整不会越过本帧区域
+    const VkDeviceSize begin = flushed_ / atom_size_ * atom_size_;
+    const VkDeviceSize end = std::min(align_up(head, atom_size_), frame_size_);
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation_.memory;
+    range.offset = allocation_.offset + frame_begin_ + begin;
+    range.size = end - begin;
+    details::err_check(vkFlushMappedMemoryRanges(device_, 1, &range), "failed to flush frame ring!");
+
+    flushed_ = head;
+    ++flushes_;
+}
+
+FrameAllocator::Stats FrameAllocator::stats() const
+{
+    return Stats{
+        .frame_size = frame_size_,
+        .last_frame_bytes = last_frame_bytes_,
+        .peak_frame_bytes = peak_frame_bytes_,
+        .overflows = overflows_.load(std::memory_order_relaxed),
+        .flushes = flushes_,
+    };
+}
+
+void FrameAllocator::print_stats() const
+{
+    constexpr double kib = 1024.0;
+    const auto stats = this->stats();
+    fmt::println("[frame allocator] {:.1f}KiB per frame, last {:.1f}KiB, peak {:.1f}KiB, overflows {}, "
+                 "flushes {} ({})",
+                 stats.frame_size / kib, stats.last_frame_bytes / kib, stats.peak_frame_bytes / kib,
+                 stats.overflows, stats.flushes, coherent_ ? "coherent" : "non-coherent");
+}
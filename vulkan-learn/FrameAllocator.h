@@ -0,0 +1,109 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_FRAMEALLOCATOR_H
+#define VULKAN_LEARN_FRAMEALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstring>
+#include <span>
+
+#include "GpuAllocator.h"
+
+/**
+ * @brief 每帧数据(uniform, 实例变换, 动态顶点)的线性环形分配器
+ *
+ * 一个持久映射的 HOST_VISIBLE buffer 按飞行帧数等分, 每一帧只在自己的区域里顺序分配, 返回的偏移可以直接作为
+ * dynamic offset 使用. begin_frame 必须在该帧上一次的提交完成之后调用, 此时 GPU 已经读完
+ * 上一轮写入的数据, 整段区域一次性回收; 整个过程没有 map/unmap, 也没有任何内存申请.
+ *
+ * allocate 用原子操作实现, 多个录制线程可以同时分配. 非一致内存的写入在 flush 中合并成一次
+ * vkFlushMappedMemoryRanges, 需要在提交前调用. 有 ReBAR 时优先放在 DEVICE_LOCAL | HOST_VISIBLE 内存中.
+ */
+class FrameAllocator
+{
+public:
+    struct Allocation
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0; // 相对 buffer 起点
+        void* data = nullptr;
+
+        uint32_t dynamic_offset() const { return static_cast<uint32_t>(offset); }
+
+        explicit operator bool() const { return data != nullptr; }
+    };
+
+    struct Stats
+    {
+        VkDeviceSize frame_size = 0;
+        VkDeviceSize last_frame_bytes = 0;
+        VkDeviceSize peak_frame_bytes = 0;
+        uint32_t overflows = 0; // 当前帧区域用尽导致分配失败的次数
+        uint32_t flushes = 0;
+    };
+
+    FrameAllocator() = default;
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+    void init(VkDevice device, GpuAllocator& allocator, const VkPhysicalDeviceLimits& limits, uint32_t frame_count,
+              VkDeviceSize frame_size = 4ull << 20);
+
+    void destroy();
+
+    // 切换到 frame_index 对应的区域并清空, 调用前该帧上一次的提交必须已经完成
+    void begin_frame(uint32_t frame_index);
+
+    // alignment 为 0 时使用 uniform/storage buffer 的最小偏移对齐; 区域用尽时返回空分配
+    Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+    template <typename T>
+    Allocation push(std::span<const T> values, VkDeviceSize alignment = 0)
+    {
+        auto allocation = allocate(values.size_bytes(), alignment);
+        if (allocation)
+            std::memcpy(allocation.data, values.data(), values.size_bytes());
+        return allocation;
+    }
+
+    template <typename T>
+    Allocation push(const T& value, VkDeviceSize alignment = 0)
+    {
+        return push(std::span<const T>(&value, 1), alignment);
+    }
+
+    // 把本帧自上次 flush 以来写入的范围刷新给设备, 一致内存上什么也不做
+    void flush();
+
+    VkBuffer buffer() const { return buffer_; }
+
+    Stats stats() const;
+
+    void print_stats() const;
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    GpuAllocator* allocator_ = nullptr;
+    VkBuffer buffer_ = VK_NULL_HANDLE;
+    GpuAllocation allocation_;
+    bool coherent_ = true;
+    VkDeviceSize atom_size_ = 1;
+    VkDeviceSize default_alignment_ = 1;
+    VkDeviceSize frame_size_ = 0;
+
+    VkDeviceSize frame_begin_ = 0;
+    std::atomic<VkDeviceSize> head_ = 0; // 相对 frame_begin_
+    VkDeviceSize flushed_ = 0;
+
+    VkDeviceSize last_frame_bytes_ = 0;
+    VkDeviceSize peak_frame_bytes_ = 0;
+    std::atomic<uint32_t> overflows_ = 0;
+    uint32_t flushes_ = 0;
+};
+
+
+#endif //VULKAN_LEARN_FRAMEALLOCATOR_H
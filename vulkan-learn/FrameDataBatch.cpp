@@ -0,0 +1,70 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "FrameDataBatch.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+
+namespace
+{
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void FrameDataBatch::init(const VkPhysicalDeviceLimits& limits, VkDeviceSize max_range, VkDeviceSize min_alignment)
+{
+    // 不小于 FrameAllocator 的默认对齐, 批次起点和每条记录都满足 uniform / storage 的 dynamic offset 对齐
+    alignment_ = std::max({
+        limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, min_alignment
+    });
+    max_range_ = max_range;
+    staging_.clear();
+    stats_ = {};
+}
+
+void FrameDataBatch::begin()
+{
+    staging_.clear();
+    records_ = 0;
+}
+
+void* FrameDataBatch::reserve(VkDeviceSize size, Ref& ref)
+{
+    const VkDeviceSize offset = align_up(staging_.size(), alignment_);
+    staging_.resize(offset + size);
+    ++records_;
+    ref.offset = static_cast<uint32_t>(offset);
+    return staging_.data() + offset;
+}
+
+bool FrameDataBatch::upload(FrameAllocator& frame_allocator)
+{
+    const VkDeviceSize size = staging_.size();
+    const auto allocation = frame_allocator.allocate(size + max_range_, alignment_);
+    if (!allocation)
+    {
+        ++stats_.overflows;
+        return false;
+    }
+    std::memcpy(allocation.data, staging_.data(), size);
+    base_ = allocation.offset;
+
+    ++stats_.batches;
+    stats_.records += records_;
+    stats_.last_bytes = size;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, size);
+    return true;
+}
+
+void FrameDataBatch::print_stats() const
+{
+    constexpr double kib = 1024.0;
+    fmt::println("[frame data] {} batches, {:.1f} records per batch, last {:.1f}KiB, peak {:.1f}KiB, overflows {}",
+                 stats_.batches, stats_.batches ? static_cast<double>(stats_.records) / stats_.batches : 0.0,
+                 stats_.last_bytes / kib, stats_.peak_bytes / kib, stats_.overflows);
+}
@@ -0,0 +1,104 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_FRAMEDATABATCH_H
+#define VULKAN_LEARN_FRAMEDATABATCH_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "FrameAllocator.h"
+
+/**
+ * @brief 每帧 uniform 数据的 CPU 端打包
+ *
+ * 一帧内的每帧数据, 材质参数和每个物体的动画数据先写进 CPU 端的连续暂存区, 每条记录按 dynamic offset 的对齐
+ * 排列; upload 从 FrameAllocator 申请一次空间并一次 memcpy 过去, 非一致内存上 flush 也只有一段.
+ * 成千上万个物体每帧只有一次分配和一次拷贝, 暂存区的容量在几帧之后稳定, 之后不再申请内存.
+ *
+ * add / emplace 返回的 Ref 是记录在批次内的偏移, upload 之后由 dynamic_offset 换算成绑定描述符集时的
+ * dynamic offset. 上传的空间末尾多留 max_range 字节, 任何记录的 dynamic offset 加上描述符的 range 都不会越过
+ * 环形缓冲的末尾.
+ *
+ * 只在一个线程上构建; upload 之后, 下一次 begin 之前, dynamic_offset 可以在多个录制线程上同时调用.
+ */
+class FrameDataBatch
+{
+public:
+    struct Ref
+    {
+        uint32_t offset = UINT32_MAX;
+
+        explicit operator bool() const { return offset != UINT32_MAX; }
+    };
+
+    struct Stats
+    {
+        uint64_t batches = 0;
+        uint64_t records = 0;
+        VkDeviceSize last_bytes = 0;
+        VkDeviceSize peak_bytes = 0;
+        uint32_t overflows = 0; // FrameAllocator 的本帧区域不足
+    };
+
+    FrameDataBatch() = default;
+    FrameDataBatch(const FrameDataBatch&) = delete;
+    FrameDataBatch& operator=(const FrameDataBatch&) = delete;
+
+    // max_range: 绑定这些数据的描述符中最大的 range; min_alignment: 批次起点和每条记录至少对齐到的字节数,
+    // 着色器按数组下标而不是字节偏移定位记录时传入元素大小
+    void init(const VkPhysicalDeviceLimits& limits, VkDeviceSize max_range, VkDeviceSize min_alignment = 16);
+
+    // 清空暂存区, 之前的 Ref 全部失效
+    void begin();
+
+    template <typename T>
+    Ref add(std::span<const T> values)
+    {
+        Ref ref;
+        std::memcpy(reserve(values.size_bytes(), ref), values.data(), values.size_bytes());
+        return ref;
+    }
+
+    template <typename T>
+    Ref add(const T& value)
+    {
+        return add(std::span<const T>(&value, 1));
+    }
+
+    // 预留 count 个元素由调用方就地填写, 省掉一次拷贝; 返回的 span 在下一次 add / emplace 之前有效
+    template <typename T>
+    std::span<T> emplace(size_t count, Ref& ref)
+    {
+        return {static_cast<T*>(reserve(count * sizeof(T), ref)), count};
+    }
+
+    // 一次分配, 一次拷贝; 本帧区域不足时返回 false, 这一帧的 dynamic offset 不可用
+    bool upload(FrameAllocator& frame_allocator);
+
+    uint32_t dynamic_offset(Ref ref) const { return static_cast<uint32_t>(base_ + ref.offset); }
+
+    // 最近一次 upload 在环形缓冲中的起点
+    VkDeviceSize base() const { return base_; }
+
+    Stats stats() const { return stats_; }
+
+    void print_stats() const;
+
+private:
+    void* reserve(VkDeviceSize size, Ref& ref);
+
+    VkDeviceSize alignment_ = 256;
+    VkDeviceSize max_range_ = 0;
+    std::vector<std::byte> staging_;
+    uint32_t records_ = 0;
+    VkDeviceSize base_ = 0;
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_FRAMEDATABATCH_H
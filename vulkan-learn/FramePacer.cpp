@@ -0,0 +1,167 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "FramePacer.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <numeric>
+#include <span>
+#include <thread>
+
+namespace
+{
+    // 交换链失效时 vkWaitForPresentKHR 可能一直等不到, 超时后照常开始下一帧
+    constexpr uint64_t k_present_wait_timeout_ns = 100'000'000;
+    // 长时间没有完成的呈现(例如窗口被遮挡)不再跟踪
+    constexpr size_t k_max_pending = 64;
+
+    double to_ms(FramePacer::clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+}
+
+FramePacer::PacingProfile FramePacer::profile_for(VkPresentModeKHR present_mode)
+{
+    switch (present_mode)
+    {
+    case VK_PRESENT_MODE_FIFO_KHR:
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        // 垂直同步下多排队一帧就多一个刷新周期的延迟, CPU 最多领先一帧
+        return {.frames_in_flight = 2, .max_queued_presents = 1};
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        // 新帧直接替换排队的帧, 多一个飞行帧让 GPU 保持忙碌
+        return {.frames_in_flight = 3, .max_queued_presents = 0};
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    default:
+        return {.frames_in_flight = 2, .max_queued_presents = 0};
+    }
+}
+
+void FramePacer::init(VkDevice device, bool present_wait)
+{
+    device_ = device;
+    if (present_wait)
+    {
+        wait_for_present_ = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+            vkGetDeviceProcAddr(device_, "vkWaitForPresentKHR"));
+    }
+}
+
+void FramePacer::set_frame_cap(double fps)
+{
+    frame_cap_ = std::max(fps, 0.0);
+    frame_period_ = frame_cap_ > 0
+                        ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / frame_cap_))
+                        : clock::duration{};
+    next_frame_ = {};
+}
+
+void FramePacer::set_swap_chain(VkSwapchainKHR swap_chain, VkPresentModeKHR present_mode)
+{
+    swap_chain_ = swap_chain;
+    profile_ = profile_for(present_mode);
+    first_present_id_ = last_present_id_ + 1;
+    pending_.clear();
+}
+
+VkResult FramePacer::wait_for_present(uint64_t id, uint64_t timeout_ns) const
+{
+    return wait_for_present_(device_, swap_chain_, id, timeout_ns);
+}
+
+void FramePacer::wait_for_frame()
+{
+    if (frame_period_ > clock::duration{})
+    {
+        const auto begin = clock::now();
+        if (begin < next_frame_)
+        {
+            // sleep 的唤醒误差通常在毫秒级, 最后一小段自旋
+            if (next_frame_ - begin > k_spin_threshold)
+                std::this_thread::sleep_for(next_frame_ - begin - k_spin_threshold);
+            while (clock::now() < next_frame_)
+                std::this_thread::yield();
+            ++stats_.limiter_waits;
+            stats_.limiter_wait_ms += to_ms(clock::now() - begin);
+        }
+        // 落后超过一帧时重新对齐, 不连续追赶
+        const auto now = clock::now();
+        next_frame_ = now - next_frame_ > frame_period_ ? now + frame_period_ : next_frame_ + frame_period_;
+    }
+
+    if (wait_for_present_ && profile_.max_queued_presents > 0
+        && last_present_id_ + 1 >= first_present_id_ + profile_.max_queued_presents)
+    {
+        // 等到排队中的呈现不超过 max_queued_presents - 1 次, 加上这一帧正好 max_queued_presents 次
+        const uint64_t target = last_present_id_ + 1 - profile_.max_queued_presents;
+        const auto begin = clock::now();
+        wait_for_present(target, k_present_wait_timeout_ns);
+        ++stats_.present_waits;
+        stats_.present_wait_ms += to_ms(clock::now() - begin);
+    }
+}
+
+uint64_t FramePacer::next_present_id()
+{
+    if (!wait_for_present_)
+        return 0;
+
+    const uint64_t id = ++last_present_id_;
+    if (pending_.size() >= k_max_pending)
+        pending_.pop_front();
+    pending_.push_back({id, input_time_});
+    return id;
+}
+
+void FramePacer::poll()
+{
+    while (!pending_.empty())
+    {
+        const auto [id, input_time] = pending_.front();
+        const VkResult result = wait_for_present(id, 0);
+        if (result == VK_TIMEOUT)
+            break;
+        pending_.pop_front();
+        // 交换链失效等错误, 这次呈现不计入
+        if (result != VK_SUCCESS)
+            continue;
+
+        const double latency = to_ms(clock::now() - input_time);
+        latency_window_[stats_.presents_measured % k_latency_window] = latency;
+        ++stats_.presents_measured;
+        stats_.latency_last_ms = latency;
+    }
+}
+
+FramePacer::Stats FramePacer::stats() const
+{
+    auto stats = stats_;
+    if (stats.presents_measured > 0)
+    {
+        const auto count = static_cast<size_t>(std::min<uint64_t>(stats.presents_measured, k_latency_window));
+        const auto window = std::span(latency_window_).first(count);
+        stats.latency_avg_ms = std::accumulate(window.begin(), window.end(), 0.0) / static_cast<double>(count);
+        stats.latency_max_ms = std::ranges::max(window);
+    }
+    return stats;
+}
+
+void FramePacer::print_stats() const
+{
+    const auto stats = this->stats();
+    fmt::println("[frame pacer] {} frames in flight, {} queued presents, cap {}",
+                 profile_.frames_in_flight, profile_.max_queued_presents,
+                 frame_cap_ > 0 ? fmt::format("{:.0f}fps", frame_cap_) : std::string("off"));
+    fmt::println("[frame pacer] limiter {} waits ({:.1f}ms), present wait {} waits ({:.1f}ms)",
+                 stats.limiter_waits, stats.limiter_wait_ms, stats.present_waits, stats.present_wait_ms);
+    if (stats.presents_measured > 0)
+    {
+        fmt::println("[frame pacer] input -> present latency last {:.2f}ms, avg {:.2f}ms, max {:.2f}ms "
+                     "({} presents)", stats.latency_last_ms, stats.latency_avg_ms, stats.latency_max_ms,
+                     stats.presents_measured);
+    }
+}
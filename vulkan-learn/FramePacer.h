@@ -0,0 +1,111 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_FRAMEPACER_H
+#define VULKAN_LEARN_FRAMEPACER_H
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <chrono>
+#include <deque>
+
+/**
+ * @brief 帧节奏与延迟控制
+ *
+ * 每种呈现模式对应一组固定的取舍(PacingProfile): 飞行帧数, 以及开始新的一帧之前最多允许多少次呈现还在排队.
+ * FIFO 类模式只保留一次排队中的呈现, 用吞吐换取输入延迟; MAILBOX 和 IMMEDIATE 不会在呈现队列里堆积,
+ * 只靠飞行帧数限制 CPU 超前 GPU 的距离.
+ *
+ * wait_for_frame 在采样输入之前调用: 先按帧率上限等待(先 sleep 到目标时刻前 k_spin_threshold, 再自旋到目标
+ * 时刻, 兼顾精度和 CPU 占用), 再在 VK_KHR_present_wait 可用时等到排队的呈现数不超过上限.
+ * 每次呈现带一个 VK_KHR_present_id, poll 用零超时的 vkWaitForPresentKHR 检查哪些呈现已经完成, 得到
+ * "输入采样 -> 呈现" 的延迟. 完成时刻在下一次 poll 时才被观察到, 测得的是延迟的上界.
+ */
+class FramePacer
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct PacingProfile
+    {
+        uint32_t frames_in_flight;
+        // 开始新的一帧时允许仍未呈现的帧数, 0 表示不限制
+        uint32_t max_queued_presents;
+    };
+
+    struct Stats
+    {
+        uint64_t presents_measured = 0;
+        double latency_last_ms = 0;
+        double latency_avg_ms = 0; // 最近 k_latency_window 次
+        double latency_max_ms = 0; // 最近 k_latency_window 次
+        uint64_t limiter_waits = 0;
+        double limiter_wait_ms = 0;
+        uint64_t present_waits = 0;
+        double present_wait_ms = 0;
+    };
+
+    static constexpr auto k_spin_threshold = std::chrono::microseconds(1500);
+    static constexpr uint32_t k_latency_window = 128;
+
+    static PacingProfile profile_for(VkPresentModeKHR present_mode);
+
+    // present_id / present_wait 都启用时才测量和限制延迟
+    void init(VkDevice device, bool present_wait);
+
+    // 0 表示不限制帧率
+    void set_frame_cap(double fps);
+
+    double frame_cap() const { return frame_cap_; }
+
+    // 交换链(重新)创建后调用, 之前交换链上的 present id 不再等待
+    void set_swap_chain(VkSwapchainKHR swap_chain, VkPresentModeKHR present_mode);
+
+    const PacingProfile& profile() const { return profile_; }
+
+    void wait_for_frame();
+
+    // 输入已经采样(glfwPollEvents 之后)
+    void input_sampled() { input_time_ = clock::now(); }
+
+    // 为这次呈现分配 present id, 不支持 present_id 时返回 0
+    uint64_t next_present_id();
+
+    void poll();
+
+    Stats stats() const;
+
+    void print_stats() const;
+
+private:
+    struct PendingPresent
+    {
+        uint64_t id;
+        clock::time_point input_time;
+    };
+
+    VkResult wait_for_present(uint64_t id, uint64_t timeout_ns) const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    PFN_vkWaitForPresentKHR wait_for_present_ = nullptr;
+    VkSwapchainKHR swap_chain_ = VK_NULL_HANDLE;
+    PacingProfile profile_{2, 0};
+
+    double frame_cap_ = 0;
+    clock::duration frame_period_{};
+    clock::time_point next_frame_{};
+
+    clock::time_point input_time_{};
+    uint64_t last_present_id_ = 0;
+    // 当前交换链上第一次呈现的 id, 更早的属于旧交换链
+    uint64_t first_present_id_ = 1;
+    std::deque<PendingPresent> pending_;
+
+    std::array<double, k_latency_window> latency_window_{};
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_FRAMEPACER_H
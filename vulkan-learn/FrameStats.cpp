@@ -0,0 +1,186 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "FrameStats.h"
+
+#include "StartupProfiler.h"
+
+#include <fmt/printf.h>
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+
+namespace
+{
+    // 前几十帧包含着色器编译和交换链建立, 不参与卡顿判断
+    constexpr uint32_t k_warmup_frames = 30;
+    constexpr double k_smoothing = 0.05;
+}
+
+void FrameStats::record(const Sample& sample)
+{
+    const uint64_t index = head_.load(std::memory_order_relaxed);
+    auto& slot = slots_[index % k_capacity];
+
+    const uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.frame.store(sample.frame, std::memory_order_relaxed);
+    for (size_t i = 0; i < k_timing_count; ++i)
+    {
+        slot.ms[i].store(sample.ms[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    head_.store(index + 1, std::memory_order_release);
+
+    const double frame_ms = sample[Timing::Frame];
+    if (frame_ms <= 0)
+        return;
+    if (warmup_ < k_warmup_frames)
+    {
+        ++warmup_;
+        smoothed_frame_ms_ = smoothed_frame_ms_ == 0 ? frame_ms : std::min(smoothed_frame_ms_, frame_ms);
+        return;
+    }
+    if (frame_ms > smoothed_frame_ms_ * k_hitch_ratio && frame_ms > smoothed_frame_ms_ + k_hitch_min_ms)
+    {
+        // 卡顿帧不计入平滑值, 否则连续卡顿会抬高基线
+        hitches_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    smoothed_frame_ms_ += (frame_ms - smoothed_frame_ms_) * k_smoothing;
+}
+
+std::vector<FrameStats::Sample> FrameStats::snapshot() const
+{
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    const uint64_t count = std::min<uint64_t>(head, k_capacity);
+
+    std::vector<Sample> samples;
+    samples.reserve(count);
+    for (uint64_t index = head - count; index < head; ++index)
+    {
+        const auto& slot = slots_[index % k_capacity];
+        const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        Sample sample;
+        sample.frame = slot.frame.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < k_timing_count; ++i)
+        {
+            sample.ms[i] = slot.ms[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // 读取期间被覆盖
+        if (slot.sequence.load(std::memory_order_relaxed) != before)
+            continue;
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+FrameStats::Report FrameStats::report() const
+{
+    const auto samples = snapshot();
+
+    Report report;
+    report.frames = frames();
+    report.hitches = hitches();
+    report.window = samples.size();
+    if (samples.empty())
+        return report;
+
+    std::vector<double> values(samples.size());
+    for (size_t timing = 0; timing < k_timing_count; ++timing)
+    {
+        std::ranges::transform(samples, values.begin(), [&](const Sample& sample) { return sample.ms[timing]; });
+        auto& summary = report.timings[timing];
+        summary.avg = std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+        summary.max = std::ranges::max(values);
+        summary.p50 = StartupProfiler::percentile(values, 50);
+        summary.p95 = StartupProfiler::percentile(values, 95);
+        summary.p99 = StartupProfiler::percentile(values, 99);
+    }
+
+    for (const auto& sample : samples)
+    {
+        const auto bucket = std::ranges::lower_bound(k_histogram_edges, sample[Timing::Frame]);
+        ++report.histogram[bucket - k_histogram_edges.begin()];
+    }
+    return report;
+}
+
+void FrameStats::print_report() const
+{
+    const auto report = this->report();
+    fmt::println("[frame stats] {} frames ({} in window), {} hitches", report.frames, report.window, report.hitches);
+    fmt::println("{:<10}{:>10}{:>10}{:>10}{:>10}{:>10}", "timing", "avg(ms)", "p50(ms)", "p95(ms)", "p99(ms)",
+                 "max(ms)");
+    for (size_t timing = 0; timing < k_timing_count; ++timing)
+    {
+        const auto& summary = report.timings[timing];
+        fmt::println("{:<10}{:>10.3f}{:>10.3f}{:>10.3f}{:>10.3f}{:>10.3f}", name(static_cast<Timing>(timing)),
+                     summary.avg, summary.p50, summary.p95, summary.p99, summary.max);
+    }
+
+    for (size_t bucket = 0; bucket < report.histogram.size(); ++bucket)
+    {
+        if (report.histogram[bucket] == 0)
+            continue;
+        const double lower = bucket == 0 ? 0 : k_histogram_edges[bucket - 1];
+        if (bucket < k_histogram_edges.size())
+            fmt::println("[frame stats] {:>6.1f} - {:<6.1f}ms {}", lower, k_histogram_edges[bucket],
+                         report.histogram[bucket]);
+        else
+            fmt::println("[frame stats] {:>6.1f}+        ms {}", lower, report.histogram[bucket]);
+    }
+}
+
+bool FrameStats::write_csv(const std::filesystem::path& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        fmt::println(stderr, "[frame stats] failed to open {}", path.string());
+        return false;
+    }
+
+    file << "frame";
+    for (size_t timing = 0; timing < k_timing_count; ++timing)
+    {
+        file << ',' << name(static_cast<Timing>(timing)) << "_ms";
+    }
+    file << '\n';
+
+    const auto samples = snapshot();
+    for (const auto& sample : samples)
+    {
+        file << sample.frame;
+        for (const float ms : sample.ms)
+        {
+            file << ',' << ms;
+        }
+        file << '\n';
+    }
+
+    fmt::println("[frame stats] wrote {} frames to {}", samples.size(), path.string());
+    return static_cast<bool>(file);
+}
+
+std::string_view FrameStats::name(Timing timing)
+{
+    switch (timing)
+    {
+    case Timing::Frame: return "frame";
+    case Timing::Cpu: return "cpu";
+    case Timing::Wait: return "wait";
+    case Timing::Acquire: return "acquire";
+    case Timing::Record: return "record";
+    case Timing::Submit: return "submit";
+    case Timing::Present: return "present";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,115 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_FRAMESTATS_H
+#define VULKAN_LEARN_FRAMESTATS_H
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief 每帧耗时的无锁统计
+ *
+ * 渲染线程每帧调用一次 record, 写入固定大小环形缓冲中的一个槽位, 只有几次 relaxed 原子写, 不加锁也不分配内存.
+ * 每个槽位带一个序列号(seqlock), 其他线程随时可以 snapshot, 正在被覆盖的槽位会被跳过.
+ *
+ * 卡顿(hitch)在 record 中检测: 帧间隔超过平滑后帧间隔的 k_hitch_ratio 倍, 并且至少多出 k_hitch_min_ms.
+ * 百分位和直方图在 report 中按环里的最近 k_capacity 帧计算, 只在需要时付出排序的开销.
+ */
+class FrameStats
+{
+public:
+    enum class Timing : uint32_t
+    {
+        Frame, // 相邻两帧开始的间隔
+        Cpu, // draw_frame 中除去等待的部分
+        Wait, // 等待飞行帧的上一次提交完成
+        Acquire,
+        Record,
+        Submit,
+        Present,
+        Count,
+    };
+
+    static constexpr size_t k_timing_count = static_cast<size_t>(Timing::Count);
+    static constexpr uint32_t k_capacity = 4096;
+    static constexpr double k_hitch_ratio = 2.0;
+    static constexpr double k_hitch_min_ms = 4.0;
+    // 直方图桶的上界(ms), 最后一个桶收集其余所有帧
+    static constexpr std::array<double, 10> k_histogram_edges{1, 2, 4, 8, 12, 16.7, 20, 33.3, 50, 100};
+
+    struct Sample
+    {
+        uint64_t frame = 0;
+        std::array<float, k_timing_count> ms{};
+
+        float& operator[](Timing timing) { return ms[static_cast<size_t>(timing)]; }
+        float operator[](Timing timing) const { return ms[static_cast<size_t>(timing)]; }
+    };
+
+    struct Summary
+    {
+        double avg = 0;
+        double p50 = 0;
+        double p95 = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    struct Report
+    {
+        uint64_t frames = 0; // 自开始以来记录的帧数
+        uint64_t hitches = 0;
+        size_t window = 0; // 参与统计的最近帧数
+        std::array<Summary, k_timing_count> timings{};
+        std::array<uint32_t, k_histogram_edges.size() + 1> histogram{}; // 帧间隔
+    };
+
+    FrameStats() = default;
+    FrameStats(const FrameStats&) = delete;
+    FrameStats& operator=(const FrameStats&) = delete;
+
+    // 只能由一个线程调用
+    void record(const Sample& sample);
+
+    // 最近最多 k_capacity 帧, 按帧序排列
+    std::vector<Sample> snapshot() const;
+
+    Report report() const;
+
+    void print_report() const;
+
+    bool write_csv(const std::filesystem::path& path) const;
+
+    uint64_t frames() const { return head_.load(std::memory_order_relaxed); }
+
+    uint64_t hitches() const { return hitches_.load(std::memory_order_relaxed); }
+
+    static std::string_view name(Timing timing);
+
+private:
+    struct Slot
+    {
+        // 奇数表示正在写入
+        std::atomic<uint64_t> sequence = 0;
+        std::atomic<uint64_t> frame = 0;
+        std::array<std::atomic<float>, k_timing_count> ms{};
+    };
+
+    // 放在堆上, 避免整个环占用所属对象的栈空间
+    std::unique_ptr<Slot[]> slots_ = std::make_unique<Slot[]>(k_capacity);
+    std::atomic<uint64_t> head_ = 0;
+    std::atomic<uint64_t> hitches_ = 0;
+
+    // 以下只由 record 的调用线程访问
+    double smoothed_frame_ms_ = 0;
+    uint32_t warmup_ = 0;
+};
+
+
+#endif //VULKAN_LEARN_FRAMESTATS_H
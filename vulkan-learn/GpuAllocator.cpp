@@ -0,0 +1,439 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "GpuAllocator.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <bit>
+#include <ranges>
+#include <tuple>
+
+void GpuAllocator::init(VkPhysicalDevice physical_device, VkDevice device, bool memory_budget,
+                        VkDeviceSize block_size)
+{
+    physical_device_ = physical_device;
+    device_ = device;
+    memory_budget_ = memory_budget;
+    block_size_ = block_size;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties_);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    buffer_image_granularity_ = properties.limits.bufferImageGranularity;
+    max_allocation_count_ = properties.limits.maxMemoryAllocationCount;
+
+    constexpr VkMemoryPropertyFlags bar_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; ++i)
+    {
+        const auto& type = memory_properties_.memoryTypes[i];
+        if ((type.propertyFlags & bar_flags) == bar_flags
+            && memory_properties_.memoryHeaps[type.heapIndex].size > (256ull << 20))
+        {
+            rebar_ = true;
+        }
+    }
+
+    // 没有 VK_EXT_memory_budget 时保守地只用堆的 80%
+    for (uint32_t i = 0; i < memory_properties_.memoryHeapCount; ++i)
+    {
+        heap_budget_[i] = memory_properties_.memoryHeaps[i].size / 10 * 8;
+    }
+    update_budget();
+
+    fmt::println("[gpu allocator] memory budget {}, resizable BAR {}", memory_budget_ ? "ext" : "estimated",
+                 rebar_ ? "yes" : "no");
+}
+
+void GpuAllocator::destroy()
+{
+    std::lock_guard lock(mutex_);
+    for (auto& block : blocks_)
+    {
+        if (!block)
+            continue;
+        if (!block->tlsf.empty())
+        {
+            fmt::println(stderr, "[gpu allocator] block of memory type {} still has {} live allocations",
+                         block->memory_type, block->tlsf.stats().allocation_count);
+        }
+        free_device_memory(block->memory, block->tlsf.capacity(), block->memory_type);
+    }
+    blocks_.clear();
+    if (dedicated_count_ > 0)
+    {
+        fmt::println(stderr, "[gpu allocator] {} dedicated allocations leaked", dedicated_count_);
+    }
+}
+
+std::vector<uint32_t> GpuAllocator::find_memory_types(uint32_t type_bits, const MemoryUsage& usage,
+                                                     VkDeviceSize size) const
+{
+    struct Candidate
+    {
+        uint32_t type;
+        bool fits;
+        int cost;
+    };
+
+    std::vector<Candidate> candidates;
+    for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; ++i)
+    {
+        const VkMemoryPropertyFlags flags = memory_properties_.memoryTypes[i].propertyFlags;
+        if (!(type_bits & (1u << i)) || (flags & usage.required) != usage.required)
+            continue;
+        // 每缺一个 preferred 位或者多一个 avoid 位扣一分
+        const int cost = std::popcount(usage.preferred & ~flags) + std::popcount(usage.avoid & flags);
+        const bool fits = heap_headroom(memory_properties_.memoryTypes[i].heapIndex) >= size;
+        candidates.push_back({i, fits, cost});
+    }
+
+    std::ranges::stable_sort(candidates, [](const Candidate& a, const Candidate& b)
+    {
+        return std::tie(b.fits, a.cost) < std::tie(a.fits, b.cost);
+    });
+    return candidates | std::views::transform(&Candidate::type) | std::ranges::to<std::vector<uint32_t>>();
+}
+
+uint32_t GpuAllocator::find_memory_type(uint32_t type_bits, const MemoryUsage& usage, VkDeviceSize size) const
+{
+    const auto types = find_memory_types(type_bits, usage, size);
+    if (types.empty())
+    {
+        throw std::runtime_error("Memory type does not match memory type");
+    }
+    return types.front();
+}
+
+GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements& requirements, const MemoryUsage& usage, bool linear)
+{
+    // 首选类型申请失败(堆满或者超出预算)时依次尝试后面的候选
+    for (const uint32_t memory_type : find_memory_types(requirements.memoryTypeBits, usage, requirements.size))
+    {
+        if (auto allocation = allocate_in_type(requirements, memory_type, linear))
+            return allocation;
+    }
+    return {};
+}
+
+GpuAllocation GpuAllocator::allocate_in_type(const VkMemoryRequirements& requirements, uint32_t memory_type,
+                                             bool linear)
+{
+    const VkDeviceSize block_size = block_size_for(memory_type);
+    if (requirements.size > block_size / 2)
+        return allocate_dedicated(requirements.size, memory_type);
+
+    // 粒度为 1 时线性和非线性资源可以紧挨着放
+    const bool pool_linear = buffer_image_granularity_ > 1 ? linear : true;
+
+    std::unique_lock lock(mutex_);
+    auto make_allocation = [&](uint32_t index, const TlsfAllocator::Allocation& sub)
+    {
+        const Block& block = *blocks_[index];
+        return GpuAllocation{
+            .memory = block.memory,
+            .offset = sub.offset,
+            .size = sub.size,
+            .mapped = block.mapped ? static_cast<char*>(block.mapped) + sub.offset : nullptr,
+            .memory_type = memory_type,
+            .block = index,
+            .handle = sub.handle,
+        };
+    };
+
+    for (uint32_t i = 0; i < blocks_.size(); ++i)
+    {
+        const auto& block = blocks_[i];
+        if (!block || block->memory_type != memory_type || block->linear != pool_linear)
+            continue;
+        if (const auto sub = block->tlsf.allocate(requirements.size, requirements.alignment))
+            return make_allocation(i, *sub);
+    }
+
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = block_size;
+    alloc_info.memoryTypeIndex = memory_type;
+
+    // 预算里放不下一整块时不再预留, 按实际大小独立分配
+    const bool within_budget = heap_headroom(memory_properties_.memoryTypes[memory_type].heapIndex) >= block_size;
+    auto block = std::make_unique<Block>();
+    block->memory = within_budget ? allocate_device_memory(alloc_info, &block->mapped) : VK_NULL_HANDLE;
+    if (block->memory == VK_NULL_HANDLE)
+    {
+        // 整块申请失败(例如堆快满了), 退回按实际大小独立分配
+        lock.unlock();
+        return allocate_dedicated(requirements.size, memory_type);
+    }
+    block->memory_type = memory_type;
+    block->linear = pool_linear;
+    block->tlsf = TlsfAllocator(block_size);
+
+    const auto sub = block->tlsf.allocate(requirements.size, requirements.alignment);
+    auto slot = std::ranges::find(blocks_, nullptr);
+    if (slot == blocks_.end())
+        slot = blocks_.insert(blocks_.end(), nullptr);
+    *slot = std::move(block);
+    return make_allocation(static_cast<uint32_t>(slot - blocks_.begin()), *sub);
+}
+
+void GpuAllocator::free(GpuAllocation& allocation)
+{
+    if (!allocation)
+        return;
+
+    std::lock_guard lock(mutex_);
+    if (allocation.block == GpuAllocation::k_dedicated)
+    {
+        free_device_memory(allocation.memory, allocation.size, allocation.memory_type);
+        --dedicated_count_;
+        dedicated_bytes_ -= allocation.size;
+        allocation = {};
+        return;
+    }
+
+    auto& block = blocks_[allocation.block];
+    block->tlsf.free(allocation.handle);
+
+    // 同类型还有其他 block 时把空 block 还给驱动, 否则留一个避免反复申请
+    if (block->tlsf.empty())
+    {
+        const bool has_sibling = std::ranges::any_of(blocks_, [&](const auto& other)
+        {
+            return other && other != block && other->memory_type == block->memory_type
+                && other->linear == block->linear;
+        });
+        if (has_sibling)
+        {
+            free_device_memory(block->memory, block->tlsf.capacity(), block->memory_type);
+            block.reset();
+        }
+    }
+    allocation = {};
+}
+
+GpuAllocation GpuAllocator::create_buffer(const VkBufferCreateInfo& create_info, VkBuffer& buffer,
+                                          const MemoryUsage& usage, VkDeviceSize min_alignment)
+{
+    if (const VkResult result = vkCreateBuffer(device_, &create_info, nullptr, &buffer); result != VK_SUCCESS)
+        return {};
+
+    GpuAllocation allocation;
+    try
+    {
+        VkMemoryRequirements requirements;
+        bool dedicated = false;
+        get_buffer_requirements(buffer, requirements, dedicated);
+        requirements.alignment = std::max(requirements.alignment, min_alignment);
+
+        for (const uint32_t memory_type : find_memory_types(requirements.memoryTypeBits, usage, requirements.size))
+        {
+            allocation = dedicated
+                             ? allocate_dedicated(requirements.size, memory_type, buffer)
+                             : allocate_in_type(requirements, memory_type, true);
+            if (allocation)
+                break;
+        }
+    }
+    catch (...)
+    {
+        vkDestroyBuffer(device_, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        throw;
+    }
+
+    if (!allocation || vkBindBufferMemory(device_, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+    {
+        free(allocation);
+        vkDestroyBuffer(device_, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        return {};
+    }
+    return allocation;
+}
+
+void GpuAllocator::destroy_buffer(VkBuffer& buffer, GpuAllocation& allocation)
+{
+    vkDestroyBuffer(device_, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+    free(allocation);
+}
+
+void GpuAllocator::update_budget()
+{
+    if (!memory_budget_)
+        return;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget;
+    vkGetPhysicalDeviceMemoryProperties2(physical_device_, &properties);
+
+    std::lock_guard lock(budget_mutex_);
+    for (uint32_t i = 0; i < memory_properties_.memoryHeapCount; ++i)
+    {
+        heap_budget_[i] = budget.heapBudget[i];
+        heap_usage_[i] = budget.heapUsage[i];
+        allocated_at_query_[i] = heap_allocated_[i].load();
+    }
+}
+
+std::vector<GpuAllocator::HeapBudget> GpuAllocator::heap_budgets() const
+{
+    std::lock_guard lock(budget_mutex_);
+    std::vector<HeapBudget> heaps;
+    for (uint32_t i = 0; i < memory_properties_.memoryHeapCount; ++i)
+    {
+        const VkDeviceSize allocated = heap_allocated_[i].load();
+        VkDeviceSize usage = allocated;
+        if (memory_budget_)
+        {
+            // 快照之后本分配器的增减直接累加到驱动报告的用量上
+            const auto delta = static_cast<int64_t>(allocated) - static_cast<int64_t>(allocated_at_query_[i]);
+            usage = static_cast<VkDeviceSize>(std::max<int64_t>(0, static_cast<int64_t>(heap_usage_[i]) + delta));
+        }
+        heaps.push_back({
+            .heap = i,
+            .device_local = (memory_properties_.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+            .size = memory_properties_.memoryHeaps[i].size,
+            .budget = heap_budget_[i],
+            .usage = usage,
+            .allocated = allocated,
+        });
+    }
+    return heaps;
+}
+
+GpuAllocator::Stats GpuAllocator::stats() const
+{
+    std::lock_guard lock(mutex_);
+    Stats stats;
+    VkDeviceSize free_bytes = 0;
+    for (const auto& block : blocks_)
+    {
+        if (!block)
+            continue;
+        const auto tlsf = block->tlsf.stats();
+        ++stats.block_count;
+        stats.allocation_count += tlsf.allocation_count;
+        stats.bytes_reserved += tlsf.capacity;
+        stats.bytes_in_use += tlsf.used;
+        stats.largest_free = std::max(stats.largest_free, tlsf.largest_free);
+        free_bytes += tlsf.free;
+    }
+    stats.dedicated_count = dedicated_count_;
+    stats.allocation_count += dedicated_count_;
+    stats.bytes_reserved += dedicated_bytes_;
+    stats.bytes_in_use += dedicated_bytes_;
+    stats.device_memory_count = stats.block_count + dedicated_count_;
+    stats.fragmentation = free_bytes > 0 ? 1.0 - static_cast<double>(stats.largest_free) / free_bytes : 0.0;
+    return stats;
+}
+
+void GpuAllocator::print_stats() const
+{
+    constexpr double mib = 1024.0 * 1024.0;
+    const auto stats = this->stats();
+    fmt::println("[gpu allocator] {} blocks + {} dedicated ({}/{} vkAllocateMemory), {} allocations, "
+                 "in use {:.2f}/{:.2f}MiB, largest free {:.2f}MiB, fragmentation {:.1f}%",
+                 stats.block_count, stats.dedicated_count, stats.device_memory_count, max_allocation_count_,
+                 stats.allocation_count, stats.bytes_in_use / mib, stats.bytes_reserved / mib,
+                 stats.largest_free / mib, stats.fragmentation * 100.0);
+    for (const auto& heap : heap_budgets())
+    {
+        fmt::println("[gpu allocator] heap {}{}: usage {:.2f}/{:.2f}MiB budget, {:.2f}MiB ours, size {:.2f}MiB",
+                     heap.heap, heap.device_local ? " (device local)" : "", heap.usage / mib, heap.budget / mib,
+                     heap.allocated / mib, heap.size / mib);
+    }
+}
+
+void GpuAllocator::get_buffer_requirements(VkBuffer buffer, VkMemoryRequirements& requirements,
+                                           bool& dedicated) const
+{
+    VkBufferMemoryRequirementsInfo2 info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    info.buffer = buffer;
+
+    VkMemoryDedicatedRequirements dedicated_requirements{};
+    dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 requirements2{};
+    requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements2.pNext = &dedicated_requirements;
+
+    vkGetBufferMemoryRequirements2(device_, &info, &requirements2);
+    requirements = requirements2.memoryRequirements;
+    dedicated = dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation;
+}
+
+VkDeviceMemory GpuAllocator::allocate_device_memory(const VkMemoryAllocateInfo& alloc_info, void** mapped)
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(device_, &alloc_info, nullptr, &memory) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    heap_allocated_[memory_properties_.memoryTypes[alloc_info.memoryTypeIndex].heapIndex] += alloc_info.allocationSize;
+
+    *mapped = nullptr;
+    const auto flags = memory_properties_.memoryTypes[alloc_info.memoryTypeIndex].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        // 持久映射, vkFreeMemory 时隐式解除
+        details::err_check(vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, mapped),
+                           "failed to map device memory!");
+    }
+    return memory;
+}
+
+void GpuAllocator::free_device_memory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type)
+{
+    vkFreeMemory(device_, memory, nullptr);
+    heap_allocated_[memory_properties_.memoryTypes[memory_type].heapIndex] -= size;
+}
+
+GpuAllocation GpuAllocator::allocate_dedicated(VkDeviceSize size, uint32_t memory_type, VkBuffer buffer)
+{
+    VkMemoryDedicatedAllocateInfo dedicated_info{};
+    dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicated_info.buffer = buffer;
+
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.pNext = buffer != VK_NULL_HANDLE ? &dedicated_info : nullptr;
+    alloc_info.allocationSize = size;
+    alloc_info.memoryTypeIndex = memory_type;
+
+    void* mapped = nullptr;
+    const VkDeviceMemory memory = allocate_device_memory(alloc_info, &mapped);
+    if (memory == VK_NULL_HANDLE)
+        return {};
+
+    std::lock_guard lock(mutex_);
+    ++dedicated_count_;
+    dedicated_bytes_ += size;
+    return GpuAllocation{
+        .memory = memory,
+        .offset = 0,
+        .size = size,
+        .mapped = mapped,
+        .memory_type = memory_type,
+        .block = GpuAllocation::k_dedicated,
+        .handle = 0,
+    };
+}
+
+VkDeviceSize GpuAllocator::block_size_for(uint32_t memory_type) const
+{
+    // 小堆(例如 256MiB 的 BAR)按堆大小的 1/8 切块
+    const auto heap_index = memory_properties_.memoryTypes[memory_type].heapIndex;
+    return std::min(block_size_, memory_properties_.memoryHeaps[heap_index].size / 8);
+}
+
+VkDeviceSize GpuAllocator::heap_headroom(uint32_t heap) const
+{
+    const auto heaps = heap_budgets();
+    return heaps[heap].budget > heaps[heap].usage ? heaps[heap].budget - heaps[heap].usage : 0;
+}
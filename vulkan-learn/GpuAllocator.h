@@ -0,0 +1,171 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_GPUALLOCATOR_H
+#define VULKAN_LEARN_GPUALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "TlsfAllocator.h"
+
+struct GpuAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // HOST_VISIBLE 内存在 block 创建时整体映射, 这里已经加上了 offset
+    void* mapped = nullptr;
+    uint32_t memory_type = 0;
+    // k_dedicated 表示独立的 vkAllocateMemory
+    uint32_t block = 0;
+    uint32_t handle = 0;
+
+    static constexpr uint32_t k_dedicated = UINT32_MAX;
+
+    explicit operator bool() const { return memory != VK_NULL_HANDLE; }
+};
+
+/**
+ * @brief 按内存类型划分大块 VkDeviceMemory, 再用 TLSF 切分给各个资源
+ *
+ * 线性资源(buffer)和非线性资源(optimal image)放在不同的 block 中, 因此不需要在相邻分配之间
+ * 按 bufferImageGranularity 留空; bufferImageGranularity 为 1 时两者共用 block.
+ * 驱动要求或建议独立分配(VkMemoryDedicatedRequirements), 或者请求超过半个 block 时走独立分配.
+ *
+ * 内存类型按 MemoryUsage 的 required / preferred / avoid 打分选择. 每个堆的预算来自 VK_EXT_memory_budget,
+ * 扩展不可用时按堆大小的 80% 估算并只统计本分配器的用量. 预算不足的堆排到候选列表末尾, 新 block 放不下时
+ * 改为按实际大小独立分配, vkAllocateMemory 失败时换下一个候选类型, 而不是直接 OOM.
+ */
+class GpuAllocator
+{
+public:
+    struct MemoryUsage
+    {
+        VkMemoryPropertyFlags required = 0;
+        VkMemoryPropertyFlags preferred = 0;
+        VkMemoryPropertyFlags avoid = 0;
+    };
+
+    struct HeapBudget
+    {
+        uint32_t heap = 0;
+        bool device_local = false;
+        VkDeviceSize size = 0;
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage = 0;     // 整个进程的用量(没有扩展时等于 allocated)
+        VkDeviceSize allocated = 0; // 本分配器申请的 VkDeviceMemory 总量
+    };
+
+    struct Stats
+    {
+        uint32_t block_count = 0;
+        uint32_t dedicated_count = 0;
+        uint32_t allocation_count = 0;
+        uint32_t device_memory_count = 0; // 对比 maxMemoryAllocationCount
+        VkDeviceSize bytes_reserved = 0;  // 向驱动申请的总量
+        VkDeviceSize bytes_in_use = 0;
+        VkDeviceSize largest_free = 0;
+        // 1 - 最大空闲块 / 空闲总量, 0 表示空闲空间完全连续
+        double fragmentation = 0;
+    };
+
+    // memory_budget: 设备是否启用了 VK_EXT_memory_budget
+    void init(VkPhysicalDevice physical_device, VkDevice device, bool memory_budget,
+              VkDeviceSize block_size = 64ull << 20);
+
+    // 释放所有 block, 调用前所有分配都应已归还
+    void destroy();
+
+    // 按偏好从高到低排列的候选内存类型, 放不下 size 的堆排在最后
+    std::vector<uint32_t> find_memory_types(uint32_t type_bits, const MemoryUsage& usage, VkDeviceSize size = 0) const;
+
+    // 最优的候选类型, 没有满足 required 的类型时抛出异常
+    uint32_t find_memory_type(uint32_t type_bits, const MemoryUsage& usage, VkDeviceSize size = 0) const;
+
+    // linear: buffer / linear image 为 true, optimal image 为 false; 所有候选类型都失败时返回空分配
+    GpuAllocation allocate(const VkMemoryRequirements& requirements, const MemoryUsage& usage, bool linear);
+
+    void free(GpuAllocation& allocation);
+
+    // 创建 buffer 并绑定到子分配的内存上, 会查询 VkMemoryDedicatedRequirements;
+    // min_alignment 用于非一致内存按 nonCoherentAtomSize 对齐, 以便 flush 的范围不越过分配边界
+    GpuAllocation create_buffer(const VkBufferCreateInfo& create_info, VkBuffer& buffer, const MemoryUsage& usage,
+                                VkDeviceSize min_alignment = 1);
+
+    void destroy_buffer(VkBuffer& buffer, GpuAllocation& allocation);
+
+    // 重新查询 VK_EXT_memory_budget, 建议每帧调用一次; 没有扩展时什么也不做
+    void update_budget();
+
+    std::vector<HeapBudget> heap_budgets() const;
+
+    VkMemoryPropertyFlags memory_type_flags(uint32_t memory_type) const
+    {
+        return memory_properties_.memoryTypes[memory_type].propertyFlags;
+    }
+
+    // 存在大于 256MiB 的 DEVICE_LOCAL | HOST_VISIBLE 内存(Resizable BAR / SAM)
+    bool has_rebar() const { return rebar_; }
+
+    Stats stats() const;
+
+    void print_stats() const;
+
+private:
+    struct Block
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        uint32_t memory_type = 0;
+        bool linear = true;
+        void* mapped = nullptr;
+        TlsfAllocator tlsf;
+    };
+
+    GpuAllocation allocate_in_type(const VkMemoryRequirements& requirements, uint32_t memory_type, bool linear);
+
+    void get_buffer_requirements(VkBuffer buffer, VkMemoryRequirements& requirements, bool& dedicated) const;
+
+    // 失败时返回 VK_NULL_HANDLE; HOST_VISIBLE 的内存会整体映射到 *mapped
+    VkDeviceMemory allocate_device_memory(const VkMemoryAllocateInfo& alloc_info, void** mapped);
+
+    void free_device_memory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type);
+
+    // buffer 非空时附带 VkMemoryDedicatedAllocateInfo
+    GpuAllocation allocate_dedicated(VkDeviceSize size, uint32_t memory_type, VkBuffer buffer = VK_NULL_HANDLE);
+
+    VkDeviceSize block_size_for(uint32_t memory_type) const;
+
+    // 该堆在预算内还能申请的字节数
+    VkDeviceSize heap_headroom(uint32_t heap) const;
+
+    VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memory_properties_{};
+    VkDeviceSize buffer_image_granularity_ = 1;
+    VkDeviceSize block_size_ = 0;
+    uint32_t max_allocation_count_ = 0;
+    bool memory_budget_ = false;
+    bool rebar_ = false;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    uint32_t dedicated_count_ = 0;
+    VkDeviceSize dedicated_bytes_ = 0;
+
+    // 预算快照, 两次查询之间的用量用 allocated 的增量补上
+    mutable std::mutex budget_mutex_;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_budget_{};
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_usage_{};
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> allocated_at_query_{};
+    std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> heap_allocated_{};
+};
+
+
+#endif //VULKAN_LEARN_GPUALLOCATOR_H
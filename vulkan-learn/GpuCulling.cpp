@@ -0,0 +1,625 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "GpuCulling.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // count 缓冲: Early / All 阶段每个桶的计数, Late 阶段每个桶的计数, 然后是 FrameCounts
+    constexpr uint32_t k_late_counts = GpuCulling::k_max_buckets;
+    constexpr uint32_t k_frame_counts = 2 * GpuCulling::k_max_buckets;
+
+    // 与 shader/hiz.comp 中的 push constant 一致
+    struct PyramidConstants
+    {
+        std::array<uint32_t, 2> src_size;
+        std::array<uint32_t, 2> dst_size;
+    };
+
+    VkPipeline create_compute_pipeline(VkDevice device, PipelineCache& pipeline_cache, std::span<const char> code,
+                                       VkPipelineLayout layout)
+    {
+        VkShaderModuleCreateInfo module_info{};
+        module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        module_info.codeSize = code.size();
+        module_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        VkShaderModule shader_module = VK_NULL_HANDLE;
+        details::err_check(vkCreateShaderModule(device, &module_info, nullptr, &shader_module),
+                           "failed to create culling shader module!");
+
+        VkComputePipelineCreateInfo pipeline_info{};
+        pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipeline_info.stage.module = shader_module;
+        pipeline_info.stage.pName = "main";
+        pipeline_info.layout = layout;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        const auto result = pipeline_cache.create_compute_pipelines(1, &pipeline_info, &pipeline);
+        vkDestroyShaderModule(device, shader_module, nullptr);
+        details::err_check(result, "failed to create culling pipeline!");
+        return pipeline;
+    }
+
+    VkDescriptorSetLayout create_set_layout(VkDevice device, std::span<const VkDescriptorSetLayoutBinding> bindings)
+    {
+        VkDescriptorSetLayoutCreateInfo layout_info{};
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+        layout_info.pBindings = bindings.data();
+        VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+        details::err_check(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &set_layout),
+                           "failed to create culling descriptor set layout!");
+        return set_layout;
+    }
+
+    VkBufferMemoryBarrier buffer_barrier(VkBuffer buffer, VkAccessFlags src_access, VkAccessFlags dst_access)
+    {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = src_access;
+        barrier.dstAccessMask = dst_access;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        return barrier;
+    }
+}
+
+void GpuCulling::init(VkDevice device, GpuAllocator& allocator, PipelineCache& pipeline_cache,
+                      DeletionQueue& deletion_queue, std::span<const char> cull_code,
+                      std::span<const char> pyramid_code, VkBuffer objects, uint32_t capacity, uint32_t frame_count)
+{
+    device_ = device;
+    allocator_ = &allocator;
+    deletion_queue_ = &deletion_queue;
+    capacity_ = capacity;
+    frame_count_ = frame_count;
+    stats_ = {};
+    stats_.capacity = capacity;
+
+    // 计数每帧先用 vkCmdFillBuffer 清零; 以下 buffer 都只由 GPU 访问.
+    // draw 缓冲前后两半分别给 Early (或 All) 和 Late 阶段
+    constexpr GpuAllocator::MemoryUsage gpu_only{
+        .preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        .avoid = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    };
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.size = 2 * VkDeviceSize{capacity} * sizeof(VkDrawIndexedIndirectCommand);
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    draw_allocation_ = allocator.create_buffer(buffer_info, draw_buffer_, gpu_only);
+    buffer_info.size = k_frame_counts * sizeof(uint32_t) + sizeof(FrameCounts);
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+        | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    count_allocation_ = allocator.create_buffer(buffer_info, count_buffer_, gpu_only);
+    // 初始内容未定义: 非零的物体在第一帧的 Early 阶段多画一次, Late 阶段之后就是正确的
+    buffer_info.size = VkDeviceSize{capacity} * sizeof(uint32_t);
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    visibility_allocation_ = allocator.create_buffer(buffer_info, visibility_buffer_, gpu_only);
+    buffer_info.size = VkDeviceSize{frame_count} * sizeof(FrameCounts);
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    readback_allocation_ = allocator.create_buffer(buffer_info, readback_buffer_, {
+                                                       .required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                                       | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                       .preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                                   });
+    if (!draw_allocation_ || !count_allocation_ || !visibility_allocation_ || !readback_allocation_)
+        throw std::runtime_error("failed to create indirect draw buffers!");
+    std::memset(readback_allocation_.mapped, 0, buffer_info.size);
+
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+    for (uint32_t binding = 0; binding < bindings.size(); ++binding)
+    {
+        bindings[binding].binding = binding;
+        bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[binding].descriptorCount = 1;
+        bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+    set_layout_ = create_set_layout(device_, bindings);
+
+    // 剔除采样整个金字塔; 构建时每级读上一级 (第 0 级读深度附件), 写这一级
+    const VkDescriptorSetLayoutBinding pyramid_binding{
+        0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr
+    };
+    pyramid_set_layout_ = create_set_layout(device_, std::span(&pyramid_binding, 1));
+    const std::array build_bindings{
+        pyramid_binding,
+        VkDescriptorSetLayoutBinding{1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+    };
+    build_set_layout_ = create_set_layout(device_, build_bindings);
+
+    const VkDescriptorPoolSize pool_size{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(bindings.size())};
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    details::err_check(vkCreateDescriptorPool(device_, &pool_info, nullptr, &pool_),
+                       "failed to create culling descriptor pool!");
+
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = pool_;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &set_layout_;
+    details::err_check(vkAllocateDescriptorSets(device_, &allocate_info, &set_),
+                       "failed to allocate culling descriptor set!");
+
+    // 描述符只写一次, 每帧变化的只有 push constant, 缓存的命令缓冲不会因此失效
+    const std::array<VkDescriptorBufferInfo, 4> buffer_infos{
+        VkDescriptorBufferInfo{objects, 0, VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{draw_buffer_, 0, VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{count_buffer_, 0, VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{visibility_buffer_, 0, VK_WHOLE_SIZE},
+    };
+    std::array<VkWriteDescriptorSet, 4> writes{};
+    for (uint32_t binding = 0; binding < writes.size(); ++binding)
+    {
+        writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[binding].dstSet = set_;
+        writes[binding].dstBinding = binding;
+        writes[binding].descriptorCount = 1;
+        writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[binding].pBufferInfo = &buffer_infos[binding];
+    }
+    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    const std::array cull_set_layouts{set_layout_, pyramid_set_layout_};
+    const VkPushConstantRange push_constant_range{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants)};
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(cull_set_layouts.size());
+    pipeline_layout_info.pSetLayouts = cull_set_layouts.data();
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+    details::err_check(vkCreatePipelineLayout(device_, &pipeline_layout_info, nullptr, &pipeline_layout_),
+                       "failed to create culling pipeline layout!");
+
+    const VkPushConstantRange build_push_constant_range{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidConstants)};
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &build_set_layout_;
+    pipeline_layout_info.pPushConstantRanges = &build_push_constant_range;
+    details::err_check(vkCreatePipelineLayout(device_, &pipeline_layout_info, nullptr, &build_pipeline_layout_),
+                       "failed to create depth pyramid pipeline layout!");
+
+    pipeline_ = create_compute_pipeline(device_, pipeline_cache, cull_code, pipeline_layout_);
+    build_pipeline_ = create_compute_pipeline(device_, pipeline_cache, pyramid_code, build_pipeline_layout_);
+
+    // 只用 texelFetch 读取, 采样器状态不影响结果
+    VkSamplerCreateInfo sampler_info{};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    details::err_check(vkCreateSampler(device_, &sampler_info, nullptr, &sampler_),
+                       "failed to create depth pyramid sampler!");
+
+    fmt::println("[gpu culling] up to {} objects, {:.1f}KiB of indirect commands", capacity,
+                 draw_allocation_.size / 1024.0);
+}
+
+void GpuCulling::destroy()
+{
+    // 调用时删除队列已经清空, 当前的金字塔直接销毁
+    for (const auto view : pyramid_.views)
+    {
+        vkDestroyImageView(device_, view, nullptr);
+    }
+    if (pyramid_.image != VK_NULL_HANDLE)
+    {
+        vkDestroyImage(device_, pyramid_.image, nullptr);
+        allocator_->free(pyramid_.allocation);
+    }
+    if (pyramid_.pool != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(device_, pyramid_.pool, nullptr);
+    pyramid_ = {};
+
+    if (sampler_ != VK_NULL_HANDLE)
+        vkDestroySampler(device_, sampler_, nullptr);
+    for (const auto pipeline : {pipeline_, build_pipeline_})
+    {
+        if (pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(device_, pipeline, nullptr);
+    }
+    for (const auto layout : {pipeline_layout_, build_pipeline_layout_})
+    {
+        if (layout != VK_NULL_HANDLE)
+            vkDestroyPipelineLayout(device_, layout, nullptr);
+    }
+    if (pool_ != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(device_, pool_, nullptr);
+    for (const auto set_layout : {set_layout_, pyramid_set_layout_, build_set_layout_})
+    {
+        if (set_layout != VK_NULL_HANDLE)
+            vkDestroyDescriptorSetLayout(device_, set_layout, nullptr);
+    }
+    if (draw_buffer_ != VK_NULL_HANDLE)
+        allocator_->destroy_buffer(draw_buffer_, draw_allocation_);
+    if (count_buffer_ != VK_NULL_HANDLE)
+        allocator_->destroy_buffer(count_buffer_, count_allocation_);
+    if (visibility_buffer_ != VK_NULL_HANDLE)
+        allocator_->destroy_buffer(visibility_buffer_, visibility_allocation_);
+    if (readback_buffer_ != VK_NULL_HANDLE)
+        allocator_->destroy_buffer(readback_buffer_, readback_allocation_);
+    sampler_ = VK_NULL_HANDLE;
+    pipeline_ = VK_NULL_HANDLE;
+    build_pipeline_ = VK_NULL_HANDLE;
+    pipeline_layout_ = VK_NULL_HANDLE;
+    build_pipeline_layout_ = VK_NULL_HANDLE;
+    pool_ = VK_NULL_HANDLE;
+    set_layout_ = VK_NULL_HANDLE;
+    pyramid_set_layout_ = VK_NULL_HANDLE;
+    build_set_layout_ = VK_NULL_HANDLE;
+    set_ = VK_NULL_HANDLE;
+}
+
+void GpuCulling::release(Pyramid& pyramid, uint64_t retire_serial)
+{
+    if (pyramid.image != VK_NULL_HANDLE)
+        deletion_queue_->push(retire_serial, pyramid.image, pyramid.allocation);
+    for (const auto view : pyramid.views)
+    {
+        deletion_queue_->push(retire_serial, view);
+    }
+    // 描述符集随池一起释放
+    if (pyramid.pool != VK_NULL_HANDLE)
+    {
+        deletion_queue_->push(retire_serial, [device = device_, pool = pyramid.pool]
+        {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+        });
+    }
+    pyramid = {};
+}
+
+void GpuCulling::resize(VkImageView depth_view, VkExtent2D extent, uint64_t retire_serial)
+{
+    release(pyramid_, retire_serial);
+    stats_.pyramid_levels = 0;
+    if (extent.width == 0 || extent.height == 0)
+        return;
+
+    // 第 0 级是深度附件的一半 (向上取整), 之后逐级减半直到 1x1; 每个纹素覆盖上一级的 2x2, 奇数边缘的纹素少一行或一列
+    Pyramid pyramid;
+    pyramid.depth_extent = extent;
+    VkExtent2D level_extent{(extent.width + 1) / 2, (extent.height + 1) / 2};
+    while (true)
+    {
+        pyramid.extents.push_back(level_extent);
+        if (level_extent.width == 1 && level_extent.height == 1)
+            break;
+        level_extent = {(level_extent.width + 1) / 2, (level_extent.height + 1) / 2};
+    }
+    const auto levels = static_cast<uint32_t>(pyramid.extents.size());
+
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = VK_FORMAT_R32_SFLOAT;
+    image_info.extent = {pyramid.extents[0].width, pyramid.extents[0].height, 1};
+    image_info.mipLevels = levels;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    details::err_check(vkCreateImage(device_, &image_info, nullptr, &pyramid.image),
+                       "failed to create depth pyramid!");
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device_, pyramid.image, &requirements);
+    pyramid.allocation = allocator_->allocate(requirements, {
+                                                  .preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                  .avoid = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                              }, false);
+    if (!pyramid.allocation)
+    {
+        vkDestroyImage(device_, pyramid.image, nullptr);
+        throw std::runtime_error("failed to allocate depth pyramid memory!");
+    }
+    details::err_check(vkBindImageMemory(device_, pyramid.image, pyramid.allocation.memory,
+                                         pyramid.allocation.offset),
+                       "failed to bind depth pyramid memory!");
+
+    for (uint32_t view = 0; view <= levels; ++view)
+    {
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = pyramid.image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = VK_FORMAT_R32_SFLOAT;
+        view_info.subresourceRange = view == 0
+                                         ? VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1}
+                                         : VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, view - 1, 1, 0, 1};
+        details::err_check(vkCreateImageView(device_, &view_info, nullptr, &pyramid.views.emplace_back()),
+                           "failed to create depth pyramid view!");
+    }
+
+    // 没有深度视图 (只做视锥剔除) 时不会构建金字塔, 只创建剔除管线 set 1 需要的描述符集
+    const uint32_t build_sets = depth_view != VK_NULL_HANDLE ? levels : 0;
+    const std::array pool_sizes{
+        VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, build_sets + 1},
+        VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, std::max(build_sets, 1u)},
+    };
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = build_sets + 1;
+    pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+    pool_info.pPoolSizes = pool_sizes.data();
+    details::err_check(vkCreateDescriptorPool(device_, &pool_info, nullptr, &pyramid.pool),
+                       "failed to create depth pyramid descriptor pool!");
+
+    std::vector<VkDescriptorSetLayout> set_layouts(build_sets, build_set_layout_);
+    set_layouts.push_back(pyramid_set_layout_);
+    std::vector<VkDescriptorSet> sets(set_layouts.size());
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = pyramid.pool;
+    allocate_info.descriptorSetCount = static_cast<uint32_t>(set_layouts.size());
+    allocate_info.pSetLayouts = set_layouts.data();
+    details::err_check(vkAllocateDescriptorSets(device_, &allocate_info, sets.data()),
+                       "failed to allocate depth pyramid descriptor sets!");
+    pyramid.cull_set = sets.back();
+    sets.pop_back();
+    pyramid.build_sets = std::move(sets);
+
+    // 写入的一级在 GENERAL 布局, 读取的上一级也保持 GENERAL, 深度附件由渲染图转换到 SHADER_READ_ONLY_OPTIMAL
+    std::vector<VkDescriptorImageInfo> image_infos;
+    image_infos.reserve(2 * build_sets + 1);
+    std::vector<VkWriteDescriptorSet> writes;
+    auto write = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkDescriptorImageInfo info)
+    {
+        VkWriteDescriptorSet& descriptor_write = writes.emplace_back();
+        descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_write.dstSet = set;
+        descriptor_write.dstBinding = binding;
+        descriptor_write.descriptorCount = 1;
+        descriptor_write.descriptorType = type;
+        descriptor_write.pImageInfo = &image_infos.emplace_back(info);
+    };
+    for (uint32_t level = 0; level < build_sets; ++level)
+    {
+        write(pyramid.build_sets[level], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+              level == 0
+                  ? VkDescriptorImageInfo{sampler_, depth_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}
+                  : VkDescriptorImageInfo{sampler_, pyramid.views[level], VK_IMAGE_LAYOUT_GENERAL});
+        write(pyramid.build_sets[level], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+              {VK_NULL_HANDLE, pyramid.views[level + 1], VK_IMAGE_LAYOUT_GENERAL});
+    }
+    write(pyramid.cull_set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          {sampler_, pyramid.views[0], VK_IMAGE_LAYOUT_GENERAL});
+    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    pyramid_ = std::move(pyramid);
+    stats_.pyramid_levels = levels;
+}
+
+std::array<std::array<float, 4>, 4> GpuCulling::clip_planes()
+{
+    return {{
+        {1.0f, 0.0f, 0.0f, 1.0f}, // x >= -1
+        {-1.0f, 0.0f, 0.0f, 1.0f}, // x <= 1
+        {0.0f, 1.0f, 0.0f, 1.0f}, // y >= -1
+        {0.0f, -1.0f, 0.0f, 1.0f}, // y <= 1
+    }};
+}
+
+uint32_t GpuCulling::bucket_begin(uint32_t object_count, uint32_t bucket_count, uint32_t bucket)
+{
+    // 物体 i 属于桶 i * bucket_count / object_count, 桶 b 的第一个物体是 ceil(b * object_count / bucket_count)
+    return static_cast<uint32_t>((uint64_t{bucket} * object_count + bucket_count - 1) / bucket_count);
+}
+
+uint32_t GpuCulling::record_cull(VkCommandBuffer command_buffer, Constants constants, Phase phase, uint32_t frame)
+{
+    if (constants.object_count > capacity_)
+    {
+        constants.object_count = capacity_;
+        ++stats_.clamped;
+    }
+    constants.bucket_count = std::clamp(constants.bucket_count, 1u, k_max_buckets);
+    constants.phase = phase;
+    constants.depth_size = {pyramid_.depth_extent.width, pyramid_.depth_extent.height};
+    // resize 之后的第一帧 Early 阶段时金字塔还没有构建过, 内容无效, 和只做视锥剔除一样不做遮挡测试
+    constants.pyramid_levels = pyramid_.built ? static_cast<uint32_t>(pyramid_.extents.size()) : 0;
+    constants.late_offset = capacity_;
+
+    // cull_set 总是被绑定, 只做视锥剔除时 record_pyramid 从不录制, 金字塔的布局要在这里先和描述符一致
+    if (!pyramid_.transitioned && pyramid_.image != VK_NULL_HANDLE)
+    {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = pyramid_.image;
+        barrier.subresourceRange = {
+            VK_IMAGE_ASPECT_COLOR_BIT, 0, static_cast<uint32_t>(pyramid_.extents.size()), 0, 1
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+        pyramid_.transitioned = true;
+    }
+
+    // 清零之后着色器才能累加计数; Early 阶段读取上一帧 Late 阶段写入的 visibility
+    std::array<VkBufferMemoryBarrier, 2> barriers{};
+    uint32_t barrier_count = 0;
+    VkPipelineStageFlags src_stages = 0;
+    if (phase != Phase::Late)
+    {
+        vkCmdFillBuffer(command_buffer, count_buffer_, 0, VK_WHOLE_SIZE, 0);
+        barriers[barrier_count++] = buffer_barrier(count_buffer_, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                   VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        src_stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    if (phase == Phase::Early)
+    {
+        barriers[barrier_count++] = buffer_barrier(visibility_buffer_, VK_ACCESS_SHADER_WRITE_BIT,
+                                                   VK_ACCESS_SHADER_READ_BIT);
+        src_stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
+    if (barrier_count > 0)
+    {
+        vkCmdPipelineBarrier(command_buffer, src_stages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                             barrier_count, barriers.data(), 0, nullptr);
+    }
+
+    // set 1 在着色器中被静态使用, 只做视锥剔除时也要绑定
+    const std::array sets{set_, pyramid_.cull_set};
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0,
+                            static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+    vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants),
+                       &constants);
+    if (constants.object_count > 0)
+        vkCmdDispatch(command_buffer, (constants.object_count + k_group_size - 1) / k_group_size, 1, 1);
+
+    // 这一帧的统计在最后一个阶段之后复制出来, 提交完成后主机可见
+    if (phase != Phase::Early)
+    {
+        const auto read_barrier = buffer_barrier(count_buffer_, VK_ACCESS_SHADER_WRITE_BIT,
+                                                 VK_ACCESS_TRANSFER_READ_BIT);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 1, &read_barrier, 0, nullptr);
+        const VkBufferCopy region{
+            k_frame_counts * sizeof(uint32_t), VkDeviceSize{frame % frame_count_} * sizeof(FrameCounts),
+            sizeof(FrameCounts)
+        };
+        vkCmdCopyBuffer(command_buffer, count_buffer_, readback_buffer_, 1, &region);
+        const auto host_barrier = buffer_barrier(readback_buffer_, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                 VK_ACCESS_HOST_READ_BIT);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             0, nullptr, 1, &host_barrier, 0, nullptr);
+    }
+
+    ++stats_.dispatches;
+    stats_.objects += constants.object_count;
+    return constants.object_count;
+}
+
+void GpuCulling::record_pyramid(VkCommandBuffer command_buffer)
+{
+    if (pyramid_.build_sets.empty())
+        return;
+
+    // 上一帧的剔除读完之后整个金字塔重写, 旧内容不需要保留, 所以仍从 UNDEFINED 转换
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = pyramid_.image;
+    barrier.subresourceRange = {
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, static_cast<uint32_t>(pyramid_.extents.size()), 0, 1
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, build_pipeline_);
+    auto src_extent = pyramid_.depth_extent;
+    for (uint32_t level = 0; level < pyramid_.build_sets.size(); ++level)
+    {
+        const auto dst_extent = pyramid_.extents[level];
+        const PyramidConstants constants{
+            {src_extent.width, src_extent.height}, {dst_extent.width, dst_extent.height}
+        };
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, build_pipeline_layout_, 0, 1,
+                                &pyramid_.build_sets[level], 0, nullptr);
+        vkCmdPushConstants(command_buffer, build_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(constants), &constants);
+        vkCmdDispatch(command_buffer, (dst_extent.width + k_pyramid_group_size - 1) / k_pyramid_group_size,
+                      (dst_extent.height + k_pyramid_group_size - 1) / k_pyramid_group_size, 1);
+
+        // 这一级写完后才能被下一级和 Late 阶段的剔除读取
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        src_extent = dst_extent;
+    }
+    pyramid_.built = true;
+    ++stats_.pyramids;
+}
+
+void GpuCulling::bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout layout,
+                      uint32_t set) const
+{
+    vkCmdBindDescriptorSets(command_buffer, bind_point, layout, set, 1, &set_, 0, nullptr);
+}
+
+void GpuCulling::record_draw(VkCommandBuffer command_buffer, const Constants& constants, uint32_t bucket,
+                             Phase phase)
+{
+    const uint32_t object_count = std::min(constants.object_count, capacity_);
+    const uint32_t bucket_count = std::clamp(constants.bucket_count, 1u, k_max_buckets);
+    if (bucket >= bucket_count)
+        return;
+
+    const uint32_t begin = bucket_begin(object_count, bucket_count, bucket);
+    const uint32_t end = bucket_begin(object_count, bucket_count, bucket + 1);
+    if (begin == end)
+        return;
+    // Late 阶段使用 draw 缓冲的后一半和各自的计数
+    const uint32_t draw_base = phase == Phase::Late ? capacity_ : 0;
+    const uint32_t count_base = phase == Phase::Late ? k_late_counts : 0;
+    // 绘制数由剔除写入的计数决定, maxDrawCount 只是这个桶区域的大小
+    vkCmdDrawIndexedIndirectCount(command_buffer, draw_buffer_,
+                                  VkDeviceSize{draw_base + begin} * sizeof(VkDrawIndexedIndirectCommand),
+                                  count_buffer_, (count_base + bucket) * sizeof(uint32_t), end - begin,
+                                  sizeof(VkDrawIndexedIndirectCommand));
+    ++stats_.indirect_draws;
+}
+
+void GpuCulling::collect(uint32_t frame)
+{
+    FrameCounts counts;
+    std::memcpy(&counts, static_cast<const std::byte*>(readback_allocation_.mapped)
+                + (frame % frame_count_) * sizeof(FrameCounts), sizeof(FrameCounts));
+    ++stats_.frames;
+    stats_.last = counts;
+    stats_.frustum_culled += counts.frustum_culled;
+    stats_.occlusion_culled += counts.occlusion_culled;
+    stats_.drawn_early += counts.drawn_early;
+    stats_.drawn_late += counts.drawn_late;
+}
+
+void GpuCulling::print_stats() const
+{
+    fmt::println("[gpu culling] {} dispatches, {:.1f} objects per dispatch, {} indirect draws recorded, "
+                 "capacity {}, clamped {} times",
+                 stats_.dispatches,
+                 stats_.dispatches ? static_cast<double>(stats_.objects) / stats_.dispatches : 0.0,
+                 stats_.indirect_draws, stats_.capacity, stats_.clamped);
+    if (stats_.frames == 0)
+        return;
+    const auto frames = static_cast<double>(stats_.frames);
+    fmt::println("[gpu culling] per frame over {} frames: {:.1f} frustum culled, {:.1f} occlusion culled, "
+                 "{:.1f} drawn early, {:.1f} drawn late; {} pyramids of {} levels",
+                 stats_.frames, stats_.frustum_culled / frames, stats_.occlusion_culled / frames,
+                 stats_.drawn_early / frames, stats_.drawn_late / frames, stats_.pyramids, stats_.pyramid_levels);
+}
@@ -0,0 +1,211 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_GPUCULLING_H
+#define VULKAN_LEARN_GPUCULLING_H
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <span>
+#include <vector>
+
+#include "DeletionQueue.h"
+#include "GpuAllocator.h"
+#include "PipelineCache.h"
+
+/**
+ * @brief GPU 驱动的绘制: 计算着色器做视锥和遮挡剔除, 生成 vkCmdDrawIndexedIndirectCount 的绘制命令
+ *
+ * 物体的变换 (ObjectData) 每帧由 CPU 写进 FrameAllocator 的环形缓冲, 整个环形缓冲作为 storage buffer 绑定,
+ * 这一帧的数据由 push constant 中的 object_base 定位; 包围圆由网格的局部包围半径和物体的世界矩阵得出.
+ * record_cull 每个线程处理一个物体, 可见的物体通过原子计数压缩进 draw 缓冲. 物体按下标连续均分成若干桶
+ * (与逐个绘制时的材质划分相同), 每个桶在 draw 缓冲中占一段连续区域并有自己的计数,
+ * record_draw 每个桶一次间接绘制, CPU 录制的命令数只取决于桶数, 与物体数无关.
+ *
+ * 遮挡剔除分两个阶段, 依据是每个物体上一帧是否可见 (visibility 缓冲):
+ *  - Early: 视锥内且上一帧可见的物体, 画完后由 record_pyramid 把深度缩减成 Hi-Z 金字塔 (每级取最大深度)
+ *  - Late: 所有视锥内的物体和金字塔比较, 没有被挡住并且 Early 没有画过的物体补画, 同时更新 visibility
+ * 金字塔只来自上一帧可见的物体, 被它挡住的物体一定不可见; 新出现的物体在同一帧的 Late 阶段补上, 不会闪烁.
+ * All 阶段只做视锥剔除, 不使用金字塔.
+ *
+ * draw / count 缓冲每帧整体重写, 由渲染图导入: 剔除 pass 写入, 场景 pass 在 DRAW_INDIRECT 阶段读取.
+ * 导入时的初始阶段为 DRAW_INDIRECT, 同一队列上的屏障也覆盖之前的提交, 下一帧的剔除会等上一帧的间接绘制读完.
+ * 金字塔和 visibility 只在这里使用, 屏障由 record_cull / record_pyramid 自己录制.
+ * 每帧的剔除统计从 count 缓冲复制到可映射的回读缓冲, 该帧的提交完成后由 collect 读取.
+ */
+class GpuCulling
+{
+public:
+    static constexpr uint32_t k_group_size = 64;
+    static constexpr uint32_t k_max_buckets = 16;
+    // hiz.comp 的工作组是 k_pyramid_group_size x k_pyramid_group_size
+    static constexpr uint32_t k_pyramid_group_size = 8;
+
+    enum class Phase : uint32_t
+    {
+        All,
+        Early,
+        Late,
+    };
+
+    // 与 shader/cull.comp 中的 push constant 一致
+    struct Constants
+    {
+        // 裁剪空间中的平面 (nx, ny, 0, d), 可见一侧 dot(n, p) + d >= 0
+        std::array<std::array<float, 4>, 4> planes{};
+        // 局部半径换算成裁剪空间两个半轴的比例, x 包含 1 / aspect
+        std::array<float, 2> extent_scale{1.0f, 1.0f};
+        float bounding_radius = 0;
+        // 这一帧第一个 ObjectData 在环形缓冲中的下标
+        uint32_t object_base = 0;
+        uint32_t object_count = 0;
+        uint32_t bucket_count = 1;
+        uint32_t index_count = 0;
+        // 以下由 record_cull 填写
+        Phase phase = Phase::All;
+        std::array<uint32_t, 2> depth_size{};
+        uint32_t pyramid_levels = 0;
+        // Late 阶段的绘制命令在 draw 缓冲中的起点
+        uint32_t late_offset = 0;
+    };
+
+    // 一帧的剔除结果, 四项之和是物体数; 与 count 缓冲末尾的统计计数一致
+    struct FrameCounts
+    {
+        uint32_t frustum_culled = 0;
+        uint32_t occlusion_culled = 0; // 在视锥内但被金字塔挡住, 两个阶段都没有画
+        uint32_t drawn_early = 0; // All 阶段画的物体也算在这里
+        uint32_t drawn_late = 0;
+    };
+
+    struct Stats
+    {
+        uint64_t dispatches = 0;
+        uint64_t objects = 0; // 提交剔除的物体总数
+        uint64_t indirect_draws = 0; // 录制的 vkCmdDrawIndexedIndirectCount 次数
+        uint64_t pyramids = 0; // 录制的 Hi-Z 金字塔构建次数
+        uint32_t capacity = 0;
+        uint32_t clamped = 0; // 物体数超过 capacity 被截断的次数
+        uint32_t pyramid_levels = 0;
+        // 以下来自已完成的帧
+        uint64_t frames = 0;
+        FrameCounts last;
+        uint64_t frustum_culled = 0;
+        uint64_t occlusion_culled = 0;
+        uint64_t drawn_early = 0;
+        uint64_t drawn_late = 0;
+    };
+
+    GpuCulling() = default;
+    GpuCulling(const GpuCulling&) = delete;
+    GpuCulling& operator=(const GpuCulling&) = delete;
+
+    // objects: 存放 ObjectData 的 buffer, 整体绑定为 storage buffer; capacity: 一次最多剔除的物体数;
+    // frame_count: 飞行帧数, 每帧一份回读缓冲
+    void init(VkDevice device, GpuAllocator& allocator, PipelineCache& pipeline_cache, DeletionQueue& deletion_queue,
+              std::span<const char> cull_code, std::span<const char> pyramid_code, VkBuffer objects,
+              uint32_t capacity, uint32_t frame_count);
+
+    // 所有使用它的提交都已完成
+    void destroy();
+
+    bool initialized() const { return pipeline_ != VK_NULL_HANDLE; }
+
+    uint32_t capacity() const { return capacity_; }
+
+    // binding 0: ObjectData (计算和顶点着色器可见), binding 1: 绘制命令, binding 2: 每个桶的计数,
+    // binding 3: 每个物体上一帧是否可见
+    VkDescriptorSetLayout set_layout() const { return set_layout_; }
+
+    VkBuffer draw_buffer() const { return draw_buffer_; }
+
+    VkBuffer count_buffer() const { return count_buffer_; }
+
+    // 按深度附件重建金字塔和引用它的描述符集, 深度视图变化 (交换链重建, 渲染图重新编译) 后调用;
+    // 旧对象在 retire_serial 完成后销毁. depth_view 的布局为 SHADER_READ_ONLY_OPTIMAL
+    void resize(VkImageView depth_view, VkExtent2D extent, uint64_t retire_serial);
+
+    // 裁剪空间 [-1, 1] 的四个侧面, 深度方向由遮挡剔除处理
+    static std::array<std::array<float, 4>, 4> clip_planes();
+
+    // 桶在 draw 缓冲中的起点, 即属于它的第一个物体的下标
+    static uint32_t bucket_begin(uint32_t object_count, uint32_t bucket_count, uint32_t bucket);
+
+    // 在渲染流程之外录制. All / Early 先把计数清零; Late 需要这一帧的金字塔已经由 record_pyramid 构建,
+    // resize 之后还没有构建过金字塔时所有阶段都不做遮挡测试.
+    // All / Late 之后把统计复制到 frame 的回读缓冲. 之后读取 draw / count 缓冲的屏障由调用方负责;
+    // object_count 超过 capacity 时截断, 返回实际剔除的物体数
+    uint32_t record_cull(VkCommandBuffer command_buffer, Constants constants, Phase phase, uint32_t frame);
+
+    // 在渲染流程之外录制, 深度附件已经转换到 SHADER_READ_ONLY_OPTIMAL 并且写入可见
+    void record_pyramid(VkCommandBuffer command_buffer);
+
+    // 绑定 set_layout() 的描述符集, 图形管线通过它读取 ObjectData
+    void bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout layout,
+              uint32_t set) const;
+
+    // 在渲染流程内录制一个桶的间接绘制, 管线, 顶点和索引缓冲由调用方绑定; constants 与 record_cull 相同
+    void record_draw(VkCommandBuffer command_buffer, const Constants& constants, uint32_t bucket,
+                     Phase phase = Phase::All);
+
+    // frame 上一次的提交已经完成后调用, 累计它的剔除统计
+    void collect(uint32_t frame);
+
+    Stats stats() const { return stats_; }
+
+    void print_stats() const;
+
+private:
+    // 金字塔和引用它的描述符集, resize 时整体替换
+    struct Pyramid
+    {
+        VkImage image = VK_NULL_HANDLE;
+        GpuAllocation allocation;
+        // views[0] 覆盖所有 mip, 供剔除采样; views[1 + level] 是单个 mip, 供构建时写入
+        std::vector<VkImageView> views;
+        std::vector<VkExtent2D> extents;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        // 每级一个: 上一级 (第 0 级为深度附件) 和这一级
+        std::vector<VkDescriptorSet> build_sets;
+        VkDescriptorSet cull_set = VK_NULL_HANDLE;
+        VkExtent2D depth_extent{};
+        // 创建时是 UNDEFINED, 之后第一次 record_cull 把整个金字塔转换到 cull_set 声明的 GENERAL
+        bool transitioned = false;
+        // resize 之后 record_pyramid 录制过才有有效内容, 在此之前的剔除不做遮挡测试
+        bool built = false;
+    };
+
+    void release(Pyramid& pyramid, uint64_t retire_serial);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    GpuAllocator* allocator_ = nullptr;
+    DeletionQueue* deletion_queue_ = nullptr;
+    uint32_t capacity_ = 0;
+    VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+    VkDescriptorPool pool_ = VK_NULL_HANDLE;
+    VkDescriptorSet set_ = VK_NULL_HANDLE;
+    // 剔除管线的 set 1: 整个金字塔
+    VkDescriptorSetLayout pyramid_set_layout_ = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline pipeline_ = VK_NULL_HANDLE;
+    VkDescriptorSetLayout build_set_layout_ = VK_NULL_HANDLE;
+    VkPipelineLayout build_pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline build_pipeline_ = VK_NULL_HANDLE;
+    VkSampler sampler_ = VK_NULL_HANDLE;
+    Pyramid pyramid_;
+    VkBuffer draw_buffer_ = VK_NULL_HANDLE;
+    GpuAllocation draw_allocation_;
+    VkBuffer count_buffer_ = VK_NULL_HANDLE;
+    GpuAllocation count_allocation_;
+    VkBuffer visibility_buffer_ = VK_NULL_HANDLE;
+    GpuAllocation visibility_allocation_;
+    VkBuffer readback_buffer_ = VK_NULL_HANDLE;
+    GpuAllocation readback_allocation_;
+    uint32_t frame_count_ = 0;
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_GPUCULLING_H
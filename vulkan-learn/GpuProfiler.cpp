@@ -0,0 +1,237 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "GpuProfiler.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+
+namespace
+{
+    constexpr VkQueryPipelineStatisticFlags k_statistics_flags =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    // 结果按标志位从低到高排列, 最后一个值是可用性
+    constexpr uint32_t k_statistics_values = 4;
+}
+
+void GpuProfiler::init(VkDevice device, const VkPhysicalDeviceLimits& limits, uint32_t timestamp_valid_bits,
+                       uint32_t frame_count, bool pipeline_statistics, uint32_t max_scopes)
+{
+    device_ = device;
+    max_scopes_ = max_scopes;
+    pending_.assign(frame_count, false);
+    if (timestamp_valid_bits == 0 || limits.timestampPeriod == 0)
+    {
+        fmt::println("[gpu profiler] timestamps are not supported on the graphics queue, disabled");
+        return;
+    }
+
+    period_ns_ = limits.timestampPeriod;
+    timestamp_mask_ = timestamp_valid_bits >= 64 ? ~0ull : (1ull << timestamp_valid_bits) - 1;
+
+    VkQueryPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = frame_count * max_scopes_ * 2;
+    details::err_check(vkCreateQueryPool(device_, &pool_info, nullptr, &timestamp_pool_),
+                       "failed to create timestamp query pool!");
+
+    if (pipeline_statistics)
+    {
+        pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        pool_info.queryCount = frame_count * max_scopes_;
+        pool_info.pipelineStatistics = k_statistics_flags;
+        details::err_check(vkCreateQueryPool(device_, &pool_info, nullptr, &statistics_pool_),
+                           "failed to create pipeline statistics query pool!");
+    }
+}
+
+void GpuProfiler::destroy()
+{
+    if (statistics_pool_ != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device_, statistics_pool_, nullptr);
+    if (timestamp_pool_ != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device_, timestamp_pool_, nullptr);
+    statistics_pool_ = VK_NULL_HANDLE;
+    timestamp_pool_ = VK_NULL_HANDLE;
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::statistics_flags() const
+{
+    return statistics_pool_ != VK_NULL_HANDLE ? k_statistics_flags : 0;
+}
+
+GpuProfiler::ScopeId GpuProfiler::scope_id(std::string_view name)
+{
+    std::lock_guard lock(mutex_);
+    if (const auto it = scope_ids_.find(std::string(name)); it != scope_ids_.end())
+        return it->second;
+
+    if (scopes_.size() >= max_scopes_)
+        throw std::runtime_error("too many gpu profiler scopes!");
+    const auto id = static_cast<ScopeId>(scopes_.size());
+    scopes_.push_back(ScopeState{.name = std::string(name)});
+    scope_ids_.emplace(name, id);
+    return id;
+}
+
+void GpuProfiler::begin_frame(uint32_t frame)
+{
+    if (enabled() && pending_[frame])
+    {
+        collect(frame);
+        pending_[frame] = false;
+    }
+    frame_ = frame;
+}
+
+void GpuProfiler::reset(VkCommandBuffer command_buffer)
+{
+    if (!enabled())
+        return;
+    vkCmdResetQueryPool(command_buffer, timestamp_pool_, timestamp_base(frame_), max_scopes_ * 2);
+    if (statistics_pool_ != VK_NULL_HANDLE)
+        vkCmdResetQueryPool(command_buffer, statistics_pool_, frame_ * max_scopes_, max_scopes_);
+}
+
+void GpuProfiler::begin(VkCommandBuffer command_buffer, ScopeId id, bool statistics)
+{
+    if (!enabled())
+        return;
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_pool_,
+                        timestamp_base(frame_) + id * 2);
+    if (statistics && statistics_pool_ != VK_NULL_HANDLE)
+    {
+        if (active_statistics_)
+            throw std::logic_error("pipeline statistics scopes cannot be nested!");
+        active_statistics_ = id;
+        {
+            std::lock_guard lock(mutex_);
+            scopes_[id].statistics = true;
+        }
+        vkCmdBeginQuery(command_buffer, statistics_pool_, frame_ * max_scopes_ + id, 0);
+    }
+}
+
+void GpuProfiler::end(VkCommandBuffer command_buffer, ScopeId id)
+{
+    if (!enabled())
+        return;
+    if (active_statistics_ == id)
+    {
+        vkCmdEndQuery(command_buffer, statistics_pool_, frame_ * max_scopes_ + id);
+        active_statistics_.reset();
+    }
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_pool_,
+                        timestamp_base(frame_) + id * 2 + 1);
+}
+
+void GpuProfiler::submitted()
+{
+    if (enabled())
+        pending_[frame_] = true;
+}
+
+void GpuProfiler::collect(uint32_t frame)
+{
+    std::lock_guard lock(mutex_);
+    const auto scope_count = static_cast<uint32_t>(scopes_.size());
+    if (scope_count == 0)
+        return;
+
+    // 每个查询两个值: 结果和可用性. 没有写入过的区间(这一帧没有录制)不可用, 直接跳过
+    std::vector<uint64_t> timestamps(scope_count * 2 * 2);
+    const VkResult result = vkGetQueryPoolResults(device_, timestamp_pool_, timestamp_base(frame), scope_count * 2,
+                                                  timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                                                  2 * sizeof(uint64_t),
+                                                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY)
+        details::err_check(result, "failed to read timestamp queries!");
+
+    std::vector<uint64_t> statistics;
+    if (statistics_pool_ != VK_NULL_HANDLE)
+    {
+        statistics.resize(scope_count * (k_statistics_values + 1));
+        const VkResult statistics_result = vkGetQueryPoolResults(
+            device_, statistics_pool_, frame * max_scopes_, scope_count, statistics.size() * sizeof(uint64_t),
+            statistics.data(), (k_statistics_values + 1) * sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (statistics_result != VK_SUCCESS && statistics_result != VK_NOT_READY)
+            details::err_check(statistics_result, "failed to read pipeline statistics queries!");
+    }
+
+    for (uint32_t id = 0; id < scope_count; ++id)
+    {
+        const uint64_t* begin = &timestamps[id * 4];
+        const uint64_t* end = &timestamps[id * 4 + 2];
+        if (!begin[1] || !end[1])
+            continue;
+
+        auto& scope = scopes_[id];
+        const uint64_t ticks = (end[0] - begin[0]) & timestamp_mask_;
+        scope.window[scope.samples % k_window] = static_cast<double>(ticks) * period_ns_ / 1e6;
+        ++scope.samples;
+
+        if (scope.statistics && !statistics.empty())
+        {
+            const uint64_t* values = &statistics[id * (k_statistics_values + 1)];
+            if (values[k_statistics_values])
+            {
+                scope.last_statistics = PipelineStatistics{
+                    .input_vertices = values[0],
+                    .vertex_invocations = values[1],
+                    .clipping_primitives = values[2],
+                    .fragment_invocations = values[3],
+                };
+            }
+        }
+    }
+}
+
+std::vector<GpuProfiler::ScopeTiming> GpuProfiler::timings() const
+{
+    std::lock_guard lock(mutex_);
+    std::vector<ScopeTiming> timings;
+    timings.reserve(scopes_.size());
+    for (const auto& scope : scopes_)
+    {
+        ScopeTiming timing{.name = scope.name, .samples = scope.samples, .statistics = scope.last_statistics};
+        if (scope.samples > 0)
+        {
+            const auto count = static_cast<size_t>(std::min<uint64_t>(scope.samples, k_window));
+            const auto window = std::span(scope.window).first(count);
+            timing.last_ms = scope.window[(scope.samples - 1) % k_window];
+            timing.avg_ms = std::accumulate(window.begin(), window.end(), 0.0) / static_cast<double>(count);
+            timing.max_ms = std::ranges::max(window);
+        }
+        timings.push_back(std::move(timing));
+    }
+    return timings;
+}
+
+void GpuProfiler::print_stats() const
+{
+    if (!enabled())
+        return;
+    for (const auto& timing : timings())
+    {
+        fmt::println("[gpu profiler] {:<16} last {:.4f}ms, avg {:.4f}ms, max {:.4f}ms ({} samples)", timing.name,
+                     timing.last_ms, timing.avg_ms, timing.max_ms, timing.samples);
+        if (timing.statistics)
+        {
+            const auto& statistics = *timing.statistics;
+            fmt::println("[gpu profiler] {:<16} vertices {}, vs invocations {}, clipped primitives {}, "
+                         "fs invocations {}", "", statistics.input_vertices, statistics.vertex_invocations,
+                         statistics.clipping_primitives, statistics.fragment_invocations);
+        }
+    }
+}
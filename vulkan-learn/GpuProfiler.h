@@ -0,0 +1,152 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_GPUPROFILER_H
+#define VULKAN_LEARN_GPUPROFILER_H
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 基于 query pool 的 GPU 计时
+ *
+ * 每个具名区间占两个时间戳查询, 需要时再占一个管线统计查询. 查询池按飞行帧分区, 每个帧的主命令缓冲开头
+ * 用 reset 重置自己的分区. begin_frame 在该帧上一次的提交完成之后读取结果, 不带 WAIT 标志, 不会阻塞;
+ * 读到的是 MAX_FRAMES_IN_FLIGHT 帧之前的数据. 时间戳按 timestampPeriod 换算为毫秒, 每个区间保留最近
+ * k_window 个样本的平均值和最大值.
+ *
+ * 管线统计查询在执行次级命令缓冲期间保持激活, 因此同时需要 pipelineStatisticsQuery 和 inheritedQueries,
+ * 次级命令缓冲的 inheritance.pipelineStatistics 需要设置为 statistics_flags(). 同类查询不能嵌套,
+ * 同一时刻只能有一个带统计的区间.
+ *
+ * 区间只能在提交线程录制的主命令缓冲中使用.
+ */
+class GpuProfiler
+{
+public:
+    using ScopeId = uint32_t;
+
+    static constexpr uint32_t k_window = 64;
+
+    struct PipelineStatistics
+    {
+        uint64_t input_vertices = 0;
+        uint64_t vertex_invocations = 0;
+        uint64_t clipping_primitives = 0;
+        uint64_t fragment_invocations = 0;
+    };
+
+    struct ScopeTiming
+    {
+        std::string name;
+        double last_ms = 0;
+        double avg_ms = 0; // 最近 k_window 个样本
+        double max_ms = 0; // 最近 k_window 个样本
+        uint64_t samples = 0;
+        std::optional<PipelineStatistics> statistics;
+    };
+
+    class Scope
+    {
+    public:
+        Scope(GpuProfiler& profiler, VkCommandBuffer command_buffer, ScopeId id, bool statistics)
+            : profiler_(&profiler), command_buffer_(command_buffer), id_(id)
+        {
+            profiler_->begin(command_buffer_, id_, statistics);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope()
+        {
+            profiler_->end(command_buffer_, id_);
+        }
+
+    private:
+        GpuProfiler* profiler_;
+        VkCommandBuffer command_buffer_;
+        ScopeId id_;
+    };
+
+    GpuProfiler() = default;
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // timestamp_valid_bits 为 0 (队列不支持时间戳) 时所有操作都是空操作
+    void init(VkDevice device, const VkPhysicalDeviceLimits& limits, uint32_t timestamp_valid_bits,
+              uint32_t frame_count, bool pipeline_statistics, uint32_t max_scopes = 32);
+
+    void destroy();
+
+    bool enabled() const { return timestamp_pool_ != VK_NULL_HANDLE; }
+
+    // 不支持管线统计时为 0
+    VkQueryPipelineStatisticFlags statistics_flags() const;
+
+    // 按名字注册区间, 同名返回同一个 id
+    ScopeId scope_id(std::string_view name);
+
+    // 读取 frame 上一次提交的结果并切换到该帧的查询分区, 调用前该帧上一次的提交必须已经完成
+    void begin_frame(uint32_t frame);
+
+    // 在使用该帧任何查询之前录制, 必须在渲染流程之外
+    void reset(VkCommandBuffer command_buffer);
+
+    void begin(VkCommandBuffer command_buffer, ScopeId id, bool statistics = false);
+
+    void end(VkCommandBuffer command_buffer, ScopeId id);
+
+    [[nodiscard]] Scope scope(VkCommandBuffer command_buffer, std::string_view name, bool statistics = false)
+    {
+        return {*this, command_buffer, scope_id(name), statistics};
+    }
+
+    // 这一帧的命令缓冲已经提交, 下次 begin_frame 该帧时读取结果
+    void submitted();
+
+    std::vector<ScopeTiming> timings() const;
+
+    void print_stats() const;
+
+private:
+    struct ScopeState
+    {
+        std::string name;
+        std::array<double, k_window> window{};
+        uint64_t samples = 0;
+        bool statistics = false;
+        std::optional<PipelineStatistics> last_statistics;
+    };
+
+    void collect(uint32_t frame);
+
+    uint32_t timestamp_base(uint32_t frame) const { return frame * max_scopes_ * 2; }
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkQueryPool timestamp_pool_ = VK_NULL_HANDLE;
+    VkQueryPool statistics_pool_ = VK_NULL_HANDLE;
+    uint32_t max_scopes_ = 0;
+    double period_ns_ = 1;
+    uint64_t timestamp_mask_ = ~0ull;
+
+    uint32_t frame_ = 0;
+    std::optional<ScopeId> active_statistics_;
+    // 该帧是否有已提交但尚未读取的结果
+    std::vector<bool> pending_;
+
+    mutable std::mutex mutex_;
+    std::vector<ScopeState> scopes_;
+    std::unordered_map<std::string, ScopeId> scope_ids_;
+};
+
+
+#endif //VULKAN_LEARN_GPUPROFILER_H
@@ -4,8 +4,13 @@
 
 #include "HelloTriangleApplication.h"
 
+#include "InitScheduler.h"
+
+#include <cmath>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <numbers>
 #include <range/v3/range.hpp>
 #include <queue>
 #include <random>
@@ -372,7 +377,8 @@ bool HelloTriangleApplication::check_device_extensions_support(const VkPhysicalD
 
 void HelloTriangleApplication::create_logical_device()
 {
-    const auto [graphic_index, present_index] = find_queue_families_index(physical_device_);
+    queue_family_indices_ = find_queue_families_index(physical_device_);
+    const auto& [graphic_index, present_index, transfer_index] = queue_family_indices_;
 
     if (!graphic_index.has_value() || !present_index.has_value())
         throw std::runtime_error("failed to find graphics/present families!");
@@ -380,22 +386,29 @@ void HelloTriangleApplication::create_logical_device()
     const auto graphicQueueFamilyIndex = graphic_index.value();
     const auto presentQueueFamilyIndex = present_index.value();
 
-    std::set<uint32_t> uniqueQueueFamilies = {graphicQueueFamilyIndex, presentQueueFamilyIndex};
+    std::set<uint32_t> uniqueQueueFamilies = {graphicQueueFamilyIndex, presentQueueFamilyIndex, transfer_index.value()};
 
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
+    float queuePriority = 1.0f;
     for (auto queueFamilies : uniqueQueueFamilies)
     {
         VkDeviceQueueCreateInfo queueCreateInfo{};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamilies;
         queueCreateInfo.queueCount = 1;
-        float queuePriority = 1.0f;
         queueCreateInfo.pQueuePriorities = &queuePriority;
         queue_create_infos.push_back(queueCreateInfo);
     }
 
 
+    // 管线统计区间包住 vkCmdExecuteCommands, 需要同时支持 inheritedQueries
+    VkPhysicalDeviceFeatures supportedFeatures{};
+    vkGetPhysicalDeviceFeatures(physical_device_, &supportedFeatures);
+    pipeline_statistics_ = supportedFeatures.pipelineStatisticsQuery && supportedFeatures.inheritedQueries;
+
     VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.pipelineStatisticsQuery = pipeline_statistics_;
+    deviceFeatures.inheritedQueries = pipeline_statistics_;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -405,16 +418,151 @@ void HelloTriangleApplication::create_logical_device()
 
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = k_device_extensions.size();
-    createInfo.ppEnabledExtensionNames = k_device_extensions.data();
+    const auto supports = [this](const char* extension)
+    {
+        return check_device_extensions_support(physical_device_, std::array{extension});
+    };
+    // 把特性结构接到 next 指向的链尾
+    void** next = nullptr;
+    const auto chain = [&next](auto& feature)
+    {
+        feature.pNext = nullptr;
+        *next = &feature;
+        next = &feature.pNext;
+    };
+
+    // 可选扩展的特性结构只在设备支持该扩展时参与查询
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchain_maintenance1{};
+    swapchain_maintenance1.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+    VkPhysicalDevicePresentIdFeaturesKHR present_id{};
+    present_id.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait{};
+    present_wait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2{};
+    synchronization2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering{};
+    dynamic_rendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+    VkPhysicalDeviceVulkan12Features supported12{};
+    supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    next = &features2.pNext;
+    chain(supported12);
+    // 呈现 fence 还需要实例上的 surface_maintenance1
+    if (enabled_instance_extensions_.contains(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME)
+        && supports(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME))
+    {
+        chain(swapchain_maintenance1);
+    }
+    if (supports(VK_KHR_PRESENT_ID_EXTENSION_NAME) && supports(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        chain(present_id);
+        chain(present_wait);
+    }
+    if (supports(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME))
+    {
+        chain(synchronization2);
+    }
+    if (supports(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+    {
+        chain(dynamic_rendering);
+    }
+    vkGetPhysicalDeviceFeatures2(physical_device_, &features2);
+
+    // 这些扩展只在对应特性可用时启用
+    const std::unordered_map<std::string_view, bool> extension_features{
+        {VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME, swapchain_maintenance1.swapchainMaintenance1},
+        {VK_KHR_PRESENT_ID_EXTENSION_NAME, present_id.presentId && present_wait.presentWait},
+        {VK_KHR_PRESENT_WAIT_EXTENSION_NAME, present_id.presentId && present_wait.presentWait},
+        {VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME, synchronization2.synchronization2},
+        {VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, dynamic_rendering.dynamicRendering && prefer_dynamic_rendering_},
+    };
+
+    std::vector<const char*> extensions = k_device_extensions;
+    for (const auto extension : k_optional_device_extensions)
+    {
+        if (const auto it = extension_features.find(extension); it != extension_features.end() && !it->second)
+            continue;
+        if (supports(extension))
+        {
+            extensions.push_back(extension);
+        }
+    }
+    enabled_device_extensions_ = {extensions.begin(), extensions.end()};
+    swapchain_maintenance1_ = is_device_extension_enabled(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+    present_wait_ = is_device_extension_enabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    synchronization2_ = is_device_extension_enabled(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    dynamic_rendering_ = is_device_extension_enabled(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    // bindless 堆: 运行时大小的数组, 部分绑定, 绑定后更新, 着色器中非统一下标访问
+    descriptor_indexing_ = supported12.descriptorIndexing
+        && supported12.runtimeDescriptorArray
+        && supported12.descriptorBindingPartiallyBound
+        && supported12.descriptorBindingUpdateUnusedWhilePending
+        && supported12.descriptorBindingSampledImageUpdateAfterBind
+        && supported12.descriptorBindingStorageImageUpdateAfterBind
+        && supported12.descriptorBindingStorageBufferUpdateAfterBind
+        && supported12.shaderSampledImageArrayNonUniformIndexing;
+    // GPU 剔除生成的绘制命令: 绘制数量来自 buffer, maxDrawCount 大于 1 还需要 multiDrawIndirect;
+    // 命令的 firstInstance 是物体下标, 顶点着色器从 gl_InstanceIndex 取回, 非零时需要 drawIndirectFirstInstance
+    draw_indirect_count_ = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance
+        && supported12.drawIndirectCount;
+    deviceFeatures.multiDrawIndirect = draw_indirect_count_;
+    deviceFeatures.drawIndirectFirstInstance = draw_indirect_count_;
+
+    // 要启用的特性链
+    VkPhysicalDeviceVulkan12Features vulkan12_features{};
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12_features.timelineSemaphore = VK_TRUE;
+    if (descriptor_indexing_)
+    {
+        vulkan12_features.descriptorIndexing = VK_TRUE;
+        vulkan12_features.runtimeDescriptorArray = VK_TRUE;
+        vulkan12_features.descriptorBindingPartiallyBound = VK_TRUE;
+        vulkan12_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        vulkan12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        vulkan12_features.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+        vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        vulkan12_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    }
+    vulkan12_features.drawIndirectCount = draw_indirect_count_;
+    createInfo.pNext = &vulkan12_features;
+    next = &vulkan12_features.pNext;
+    if (swapchain_maintenance1_)
+    {
+        chain(swapchain_maintenance1);
+    }
+    if (present_wait_)
+    {
+        chain(present_id);
+        chain(present_wait);
+    }
+    if (synchronization2_)
+    {
+        chain(synchronization2);
+    }
+    if (dynamic_rendering_)
+    {
+        chain(dynamic_rendering);
+    }
+
+    createInfo.enabledExtensionCount = extensions.size();
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     details::err_check(vkCreateDevice(physical_device_, &createInfo, nullptr, &device_),
                        "failed to create logical device!");
 
     fmt::println("{}", "create logicalDevice");
 
-    vkGetDeviceQueue(device_, graphicQueueFamilyIndex, 0, &present_queue_);
-    vkGetDeviceQueue(device_, presentQueueFamilyIndex, 0, &graphics_queue_);
+    frame_pacer_.init(device_, present_wait_);
+
+    vkGetDeviceQueue(device_, graphicQueueFamilyIndex, 0, &graphics_queue_);
+    vkGetDeviceQueue(device_, presentQueueFamilyIndex, 0, &present_queue_);
+    vkGetDeviceQueue(device_, transfer_index.value(), 0, &transfer_queue_);
+
+    fmt::println("queue families: graphics {} present {} transfer {}", graphicQueueFamilyIndex,
+                 presentQueueFamilyIndex, transfer_index.value());
 }
 
 
@@ -482,25 +630,21 @@ HelloTriangleApplication::QueueFamilyIndices HelloTriangleApplication::find_queu
                                                                      this, std::placeholders::_1,
                                                                      std::placeholders::_2));
 
-    return QueueFamilyIndices{
+    // 优先选只做传输的族, 其次是任意非图形族(如异步计算族), 都没有时和图形共用一个族
+    const auto transfer_only = find_queue_families_index(physical_device_, vk_pred::is_vk_queue_transfer_only);
+    const auto transfer_non_graphics = find_queue_families_index(physical_device_,
+                                                                 vk_pred::is_vk_queue_transfer_non_graphics);
+
+    QueueFamilyIndices indices{
         !graphic_indices.empty() ? graphic_indices.front() : std::optional<uint32_t>{},
         !present_indices.empty() ? present_indices.front() : std::optional<uint32_t>{}
     };
-}
-
-uint32_t HelloTriangleApplication::find_memory_type(uint32_t typeFilter,
-                                                    VkMemoryPropertyFlags properties)
-{
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(physical_device_, &memoryProperties);
-    for (int i = 0; i < memoryProperties.memoryTypeCount; i++)
-    {
-        if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-        {
-            return i;
-        }
-    }
-    throw std::runtime_error("Memory type does not match memory type");
+    indices.transferFamily = !transfer_only.empty()
+                                 ? transfer_only.front()
+                                 : !transfer_non_graphics.empty()
+                                 ? transfer_non_graphics.front()
+                                 : indices.graphicsFamily;
+    return indices;
 }
 
 int HelloTriangleApplication::rate_device_suitability(VkPhysicalDevice device)
@@ -549,6 +693,11 @@ void HelloTriangleApplication::pick_physical_device()
         // 是否支持拓展
         const bool is_extension_support = check_device_extensions_support(device, k_device_extensions);
 
+        // 帧同步使用时间线信号量
+        const bool is_timeline_semaphore_support = deviceProperties.apiVersion >= VK_API_VERSION_1_2
+            && device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>()
+                     .get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore;
+
         const auto SwapChainSupportDetails = query_swap_chain_support(device);
 
         // 至少有一个受支持的图像格式和一个受支持的演示模式, 交换链支持就足够了
@@ -559,6 +708,7 @@ void HelloTriangleApplication::pick_physical_device()
             && is_has_geometry_shader
             && is_have_graphics_queue
             && is_extension_support
+            && is_timeline_semaphore_support
             && swapChainAdequate;
     };
 
@@ -585,8 +735,8 @@ void HelloTriangleApplication::pick_physical_device()
         throw std::runtime_error("failed to find suited physical device");
     }
 
-    VkPhysicalDeviceProperties deviceProperties;
-    vkGetPhysicalDeviceProperties(physical_device_, &deviceProperties);
+    vkGetPhysicalDeviceProperties(physical_device_, &physical_device_properties_);
+    const VkPhysicalDeviceProperties& deviceProperties = physical_device_properties_;
 
 
     auto number_to_string = [](auto& c, int base = 10)
@@ -757,6 +907,21 @@ std::vector<const char*> HelloTriangleApplication::get_required_extensions()
         extensions.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
 
+    uint32_t extension_count = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> available(extension_count);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, available.data());
+    for (const auto extension : k_optional_instance_extensions)
+    {
+        if (std::ranges::any_of(available, [&](const auto& property)
+        {
+            return std::string_view(property.extensionName) == extension;
+        }))
+        {
+            extensions.push_back(extension);
+        }
+    }
+
     return extensions;
 }
 
@@ -786,10 +951,12 @@ void HelloTriangleApplication::create_instance()
         VK_MAKE_VERSION(1, 0, 0),
         "No Engine",
         VK_MAKE_VERSION(1, 0, 0),
-        VK_API_VERSION_1_0,
+        // vkGetBufferMemoryRequirements2 / VkMemoryDedicatedRequirements 需要 1.1, 时间线信号量需要 1.2
+        VK_API_VERSION_1_2,
     };
 
     const auto extensions = get_required_extensions();
+    enabled_instance_extensions_ = {extensions.begin(), extensions.end()};
 
     vk::InstanceCreateInfo instance_create_info;
     instance_create_info.setPApplicationInfo(&info)
@@ -806,6 +973,178 @@ void HelloTriangleApplication::create_instance()
     vk_instance_ = vk::createInstance(instance_create_info);
 }
 
+void HelloTriangleApplication::create_pipeline_cache()
+{
+    // 缓存文件头用 pick_physical_device 打印的 vendorID / deviceID / driverVersion / pipelineCacheUUID 校验
+    pipeline_cache_.init(device_, physical_device_properties_,
+                         std::filesystem::current_path() / "pipeline_cache.bin",
+                         is_device_extension_enabled(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME));
+}
+
+void HelloTriangleApplication::create_allocator()
+{
+    allocator_.init(physical_device_, device_,
+                    is_device_extension_enabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+    deletion_queue_.init(device_, allocator_);
+}
+
+void HelloTriangleApplication::create_upload_manager()
+{
+    // 拷贝走专用传输队列, 再把 buffer 的所有权转交给图形队列族
+    upload_manager_.init(device_, allocator_,
+                         {transfer_queue_, queue_family_indices_.transferFamily.value()},
+                         {graphics_queue_, queue_family_indices_.graphicsFamily.value()});
+}
+
+void HelloTriangleApplication::create_frame_allocator()
+{
+    frame_allocator_.init(device_, allocator_, physical_device_properties_.limits, MAX_FRAMES_IN_FLIGHT);
+
+    objects_per_bind_ = std::min<uint32_t>(k_max_objects_per_bind,
+                                           physical_device_properties_.limits.maxUniformBufferRange
+                                           / sizeof(ObjectData));
+    // GPU 剔除按 ObjectData 的下标定位这一帧的物体, 记录的起点要对齐到它的大小
+    frame_data_.init(physical_device_properties_.limits, VkDeviceSize{objects_per_bind_} * sizeof(ObjectData),
+                     sizeof(ObjectData));
+}
+
+void HelloTriangleApplication::create_task_pool()
+{
+    // 线程数包括每帧调用 update 的主线程
+    task_pool_.init(std::max(std::thread::hardware_concurrency(), 1u));
+}
+
+void HelloTriangleApplication::create_frame_data_set()
+{
+    // range 固定, 每帧只通过 dynamic offset 指向 frame_allocator_ 中这一帧的数据
+    const std::array<VkDeviceSize, 3> ranges{
+        sizeof(FrameUniforms), sizeof(MaterialUniforms), VkDeviceSize{objects_per_bind_} * sizeof(ObjectData)
+    };
+
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    std::array<VkDescriptorBufferInfo, 3> buffer_infos{};
+    std::array<VkWriteDescriptorSet, 3> writes{};
+    for (uint32_t binding = 0; binding < bindings.size(); ++binding)
+    {
+        bindings[binding].binding = binding;
+        bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        bindings[binding].descriptorCount = 1;
+        bindings[binding].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    layout_info.pBindings = bindings.data();
+    details::err_check(vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &frame_data_layout_),
+                       "failed to create frame data descriptor set layout!");
+
+    const VkDescriptorPoolSize pool_size{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 3};
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    details::err_check(vkCreateDescriptorPool(device_, &pool_info, nullptr, &frame_data_pool_),
+                       "failed to create frame data descriptor pool!");
+
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = frame_data_pool_;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &frame_data_layout_;
+    details::err_check(vkAllocateDescriptorSets(device_, &allocate_info, &frame_data_set_),
+                       "failed to allocate frame data descriptor set!");
+
+    for (uint32_t binding = 0; binding < writes.size(); ++binding)
+    {
+        buffer_infos[binding] = {frame_allocator_.buffer(), 0, ranges[binding]};
+        writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[binding].dstSet = frame_data_set_;
+        writes[binding].dstBinding = binding;
+        writes[binding].descriptorCount = 1;
+        writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        writes[binding].pBufferInfo = &buffer_infos[binding];
+    }
+    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void HelloTriangleApplication::create_bindless_heap()
+{
+    if (!descriptor_indexing_)
+    {
+        fmt::println("[bindless] descriptor indexing is not supported, pipelines use push constants only");
+        return;
+    }
+    bindless_.init(device_, physical_device_, deletion_queue_);
+}
+
+void HelloTriangleApplication::create_gpu_culling()
+{
+    if (!prefer_gpu_driven_)
+        return;
+    if (!draw_indirect_count_)
+    {
+        fmt::println("[gpu culling] drawIndirectCount, multiDrawIndirect or drawIndirectFirstInstance "
+                     "is not supported, objects are drawn one by one");
+        return;
+    }
+    if (cull_spv_.empty() || hiz_spv_.empty() || indirect_vert_spv_.empty())
+    {
+        fmt::println("[gpu culling] shader/cull.comp.spv, shader/hiz.comp.spv or "
+                     "shader/sample_triangle_indirect.vert.spv is missing (build the vulkan_learn_shaders target), "
+                     "objects are drawn one by one");
+        return;
+    }
+    gpu_culling_.init(device_, allocator_, pipeline_cache_, deletion_queue_, cull_spv_, hiz_spv_,
+                      frame_allocator_.buffer(), k_max_gpu_objects, MAX_FRAMES_IN_FLIGHT);
+    cull_spv_.clear();
+    hiz_spv_.clear();
+    gpu_driven_ = true;
+    occlusion_culling_ = prefer_occlusion_culling_;
+}
+
+void HelloTriangleApplication::create_gpu_profiler()
+{
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &family_count, families.data());
+    const auto& graphics_family = families[queue_family_indices_.graphicsFamily.value()];
+
+    gpu_profiler_.init(device_, physical_device_properties_.limits, graphics_family.timestampValidBits,
+                       MAX_FRAMES_IN_FLIGHT, pipeline_statistics_);
+}
+
+void HelloTriangleApplication::flush_uploads()
+{
+    upload_manager_.flush();
+}
+
+void HelloTriangleApplication::choose_surface_format()
+{
+    // 渲染流程只依赖表面格式, 提前选定后就不必等交换链创建完成
+    surface_format_ = choose_swap_surface_format(query_swap_chain_support(physical_device_).formats);
+}
+
+void HelloTriangleApplication::choose_depth_format()
+{
+    // D16_UNORM 一定支持这两种用途
+    constexpr VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+        | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    for (const auto format : {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM})
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device_, format, &properties);
+        if ((properties.optimalTilingFeatures & required) == required)
+        {
+            depth_format_ = format;
+            return;
+        }
+    }
+    throw std::runtime_error("no supported depth format");
+}
+
 VkSurfaceFormatKHR HelloTriangleApplication::choose_swap_surface_format(
     const std::vector<VkSurfaceFormatKHR>& availableFormats)
 {
@@ -819,13 +1158,14 @@ VkSurfaceFormatKHR HelloTriangleApplication::choose_swap_surface_format(
 }
 
 VkPresentModeKHR HelloTriangleApplication::choose_swap_present_mode(
-    const std::vector<VkPresentModeKHR>& availablePresentModes)
+    const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferred)
 {
-    for (const auto& presentMode : availablePresentModes)
+    // 优先使用指定的模式, 其次 MAILBOX, FIFO 总是可用
+    for (const auto candidate : {preferred, VK_PRESENT_MODE_MAILBOX_KHR})
     {
-        if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+        if (std::ranges::contains(availablePresentModes, candidate))
         {
-            return presentMode;
+            return candidate;
         }
     }
     return VK_PRESENT_MODE_FIFO_KHR;
@@ -856,61 +1196,115 @@ VkExtent2D HelloTriangleApplication::choose_swap_extent(const VkSurfaceCapabilit
     }
 }
 
+namespace
+{
+    // 显存不足时可以退到系统内存; 避开 HOST_VISIBLE 以免占用 ReBAR 堆
+    constexpr GpuAllocator::MemoryUsage k_gpu_only_usage{
+        .preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        .avoid = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    };
+}
+
 void HelloTriangleApplication::create_vertex_buffer()
 {
     auto buffer_size = sizeof(decltype(vertices)::value_type) * vertices.size();
 
-    VkBuffer staging_buffer{};
-    VkDeviceMemory staging_buffer_memory{};
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                  staging_buffer, staging_buffer_memory);
-
-    // 第五步：填充顶点数据（CPU -> GPU）
-    void* data;
-    vkMapMemory(device_, staging_buffer_memory, 0, buffer_size, 0, &data);
-    memcpy(data, vertices.data(), buffer_size);
-    vkUnmapMemory(device_, staging_buffer_memory);
-
     create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                  vertex_buffer_, vertex_buffer_memory_);
+                  k_gpu_only_usage,
+                  vertex_buffer_, vertex_buffer_allocation_);
 
-    copy_buffer(staging_buffer, vertex_buffer_, buffer_size);
-
-    vkDestroyBuffer(device_, staging_buffer, nullptr);
-    vkFreeMemory(device_, staging_buffer_memory, nullptr);
+    // 第五步：填充数据（CPU -> GPU）, 写入暂存环, 在 flush_uploads 时随同一批次提交
+    upload_manager_.upload_buffer(vertex_buffer_, 0, vertices.data(), buffer_size);
 }
 
 void HelloTriangleApplication::create_index_buffer()
 {
     auto buffer_size = sizeof(decltype(indices)::value_type) * indices.size();
 
-    VkBuffer staging_buffer{};
-    VkDeviceMemory staging_buffer_memory{};
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                  staging_buffer, staging_buffer_memory);
-
-    // 第五步：填充顶点数据（CPU -> GPU）
-    void* data;
-    vkMapMemory(device_, staging_buffer_memory, 0, buffer_size, 0, &data);
-    memcpy(data, indices.data(), buffer_size);
-    vkUnmapMemory(device_, staging_buffer_memory);
+    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                  k_gpu_only_usage,
+                  index_buffer_, index_buffer_allocation_);
 
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                  index_buffer_, index_buffer_memory_);
+    // 第五步：填充数据（CPU -> GPU）, 写入暂存环, 在 flush_uploads 时随同一批次提交
+    upload_manager_.upload_buffer(index_buffer_, 0, indices.data(), buffer_size);
+}
 
-    copy_buffer(staging_buffer, index_buffer_, buffer_size);
+void HelloTriangleApplication::create_texture()
+{
+    if (!bindless_.initialized())
+        return;
+
+    // 8x8 个格子的棋盘格, 亮暗两种灰度和顶点颜色相乘
+    constexpr uint32_t k_texture_size = 64;
+    constexpr uint32_t k_cell_size = 8;
+    std::vector<uint32_t> pixels(k_texture_size * k_texture_size);
+    for (uint32_t y = 0; y < k_texture_size; ++y)
+    {
+        for (uint32_t x = 0; x < k_texture_size; ++x)
+        {
+            const bool light = (x / k_cell_size + y / k_cell_size) % 2 == 0;
+            pixels[y * k_texture_size + x] = light ? 0xffffffff : 0xff808080;
+        }
+    }
 
-    vkDestroyBuffer(device_, staging_buffer, nullptr);
-    vkFreeMemory(device_, staging_buffer_memory, nullptr);
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    image_info.extent = {k_texture_size, k_texture_size, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    details::err_check(vkCreateImage(device_, &image_info, nullptr, &texture_image_), "failed to create texture!");
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device_, texture_image_, &requirements);
+    texture_allocation_ = allocator_.allocate(requirements, k_gpu_only_usage, false);
+    if (!texture_allocation_)
+    {
+        vkDestroyImage(device_, std::exchange(texture_image_, VK_NULL_HANDLE), nullptr);
+        throw std::runtime_error("failed to allocate texture memory!");
+    }
+    details::err_check(vkBindImageMemory(device_, texture_image_, texture_allocation_.memory,
+                                         texture_allocation_.offset),
+                       "failed to bind texture memory!");
+
+    VkImageViewCreateInfo view_info{};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = texture_image_;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = image_info.format;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    details::err_check(vkCreateImageView(device_, &view_info, nullptr, &texture_view_),
+                       "failed to create texture view!");
+
+    VkSamplerCreateInfo sampler_info{};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    details::err_check(vkCreateSampler(device_, &sampler_info, nullptr, &texture_sampler_),
+                       "failed to create texture sampler!");
+
+    // 批次完成后图像处于 SHADER_READ_ONLY_OPTIMAL, 与登记的布局一致
+    upload_manager_.upload_image(texture_image_, {k_texture_size, k_texture_size}, pixels.data(),
+                                 pixels.size() * sizeof(uint32_t));
+    texture_handle_ = bindless_.add_sampled_image(texture_view_);
+    sampler_handle_ = bindless_.add_sampler(texture_sampler_);
+    if (!texture_handle_ || !sampler_handle_)
+        throw std::runtime_error("failed to add texture to bindless heap!");
 }
 
 void HelloTriangleApplication::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
-                                             VkMemoryPropertyFlags properties, VkBuffer& buffer,
-                                             VkDeviceMemory& buffer_memory)
+                                             const GpuAllocator::MemoryUsage& memory_usage, VkBuffer& buffer,
+                                             GpuAllocation& allocation)
 {
     // 第一步：创建缓冲区对象 (VkBuffer)
     VkBufferCreateInfo bufferInfo{};
@@ -919,59 +1313,19 @@ void HelloTriangleApplication::create_buffer(VkDeviceSize size, VkBufferUsageFla
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     bufferInfo.size = size;
 
-    details::err_check(vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer), "failed to create vertex buffer!");
-
-    // 第二步：查询内存需求
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
-
-    // 第三步：选择并分配设备内存
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = find_memory_type(memRequirements.memoryTypeBits, properties);
-
-    details::err_check(vkAllocateMemory(device_, &allocInfo, nullptr, &buffer_memory),
-                       "failed to allocate vertex buffer memory!");
-
-    // 第四步：将内存绑定到缓冲区
-    vkBindBufferMemory(device_, buffer, buffer_memory, 0);
-}
-
-void HelloTriangleApplication::copy_buffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size)
-{
-    VkCommandBufferAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    alloc_info.commandPool = command_pool_;
-    alloc_info.commandBufferCount = 1;
-    VkCommandBuffer command_buffer;
-    vkAllocateCommandBuffers(device_, &alloc_info, &command_buffer);
-
-    VkCommandBufferBeginInfo begin_info{};
-    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(command_buffer, &begin_info);
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = size;
-    vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copyRegion);
-    vkEndCommandBuffer(command_buffer);
-    VkSubmitInfo submit_info{};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer;
-
-    vkQueueSubmit(graphics_queue_, 1, &submit_info, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphics_queue_);
+    // 第二步到第四步：查询内存需求, 按偏好和各堆预算选择内存类型, 从分配器的大块内存中切出一段并绑定
+    allocation = allocator_.create_buffer(bufferInfo, buffer, memory_usage);
+    if (!allocation)
+    {
+        throw std::runtime_error("failed to create buffer!");
+    }
 }
 
 void HelloTriangleApplication::create_swap_chain()
 {
     const auto [capabilities, formats, present_modes] = query_swap_chain_support(physical_device_);
-    auto [format, color_space] = choose_swap_surface_format(formats);
-    const VkPresentModeKHR presentMode = choose_swap_present_mode(present_modes);
+    auto [format, color_space] = surface_format_;
+    const VkPresentModeKHR presentMode = choose_swap_present_mode(present_modes, requested_present_mode_);
     const VkExtent2D extent = choose_swap_extent(capabilities);
 
     uint32_t image_count = capabilities.minImageCount + 1;
@@ -992,10 +1346,12 @@ void HelloTriangleApplication::create_swap_chain()
     create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
 
-    if (const auto& [graphic_index, present_index] = find_queue_families_index(physical_device_); graphic_index !=
-        present_index)
+    // 必须在 vkCreateSwapchainKHR 之前一直有效
+    std::array<uint32_t, 2> queueFamilies{};
+    if (const auto& [graphic_index, present_index, transfer_index] = queue_family_indices_;
+        graphic_index != present_index)
     {
-        std::array<uint32_t, 2> queueFamilies{graphic_index.value(), present_index.value()};
+        queueFamilies = {graphic_index.value(), present_index.value()};
         create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
         create_info.queueFamilyIndexCount = 2;
         create_info.pQueueFamilyIndices = queueFamilies.data();
@@ -1011,10 +1367,13 @@ void HelloTriangleApplication::create_swap_chain()
 
     create_info.presentMode = presentMode;
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    // 重建时把旧交换链交给驱动, 它可以复用资源, 旧交换链上已经排队的呈现照常完成
+    create_info.oldSwapchain = swap_chain_;
 
-    details::err_check(vkCreateSwapchainKHR(device_, &create_info, nullptr, &swap_chain_),
+    VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
+    details::err_check(vkCreateSwapchainKHR(device_, &create_info, nullptr, &swap_chain),
                        "Failed to create a swapchain");
+    swap_chain_ = swap_chain;
 
     vkGetSwapchainImagesKHR(device_, swap_chain_, &image_count, nullptr);
     swap_chain_images_.resize(image_count);
@@ -1023,6 +1382,11 @@ void HelloTriangleApplication::create_swap_chain()
 
     swap_chain_image_format_ = format;
     swap_chain_extent_ = extent;
+
+    // 飞行帧数和呈现排队上限随呈现模式变化, 已有的飞行帧槽位各自等待自己的 serial, 可以直接切换
+    present_mode_ = presentMode;
+    frame_pacer_.set_swap_chain(swap_chain_, presentMode);
+    frames_in_flight_ = std::min<uint32_t>(frame_pacer_.profile().frames_in_flight, MAX_FRAMES_IN_FLIGHT);
 }
 
 void HelloTriangleApplication::create_image_view()
@@ -1057,16 +1421,39 @@ void HelloTriangleApplication::create_image_view()
     }
 }
 
-void HelloTriangleApplication::create_graphics_pipeline()
+void HelloTriangleApplication::load_shader_code()
 {
-    auto frag_spv = details::read_file(details::get_project_dir() + "/shader/sample_triangle.frag.spv");
-    auto vert_spv = details::read_file(details::get_project_dir() + "/shader/sample_triangle.vert.spv");
+    frag_spv_ = details::read_file(details::get_project_dir() + "/shader/sample_triangle.frag.spv");
+    vert_spv_ = details::read_file(details::get_project_dir() + "/shader/sample_triangle.vert.spv");
 
-    if (frag_spv.empty() || vert_spv.empty())
+    if (frag_spv_.empty() || vert_spv_.empty())
         throw std::runtime_error("Could not load shaders");
+    // 设备不支持 descriptor indexing 时代替 frag_spv_
+    untextured_frag_spv_ = details::read_file(details::get_project_dir()
+        + "/shader/sample_triangle_untextured.frag.spv");
+
+    // 可选: 缺少时退回逐个物体绘制
+    cull_spv_ = details::read_file(details::get_project_dir() + "/shader/cull.comp.spv");
+    hiz_spv_ = details::read_file(details::get_project_dir() + "/shader/hiz.comp.spv");
+    indirect_vert_spv_ = details::read_file(details::get_project_dir() + "/shader/sample_triangle_indirect.vert.spv");
+}
 
-    VkShaderModule vertShaderModule = create_shader_module(vert_spv);
-    VkShaderModule fragShaderModule = create_shader_module(frag_spv);
+void HelloTriangleApplication::create_shader_modules()
+{
+    vert_shader_module_ = create_shader_module(vert_spv_);
+    // sample_triangle.frag 从 bindless 堆采样纹理, 没有 bindless 堆 (见 create_bindless_heap) 时只用顶点颜色
+    if (!descriptor_indexing_ && untextured_frag_spv_.empty())
+        throw std::runtime_error("Could not load shader/sample_triangle_untextured.frag.spv");
+    frag_shader_module_ = create_shader_module(descriptor_indexing_ ? frag_spv_ : untextured_frag_spv_);
+    vert_spv_.clear();
+    frag_spv_.clear();
+    untextured_frag_spv_.clear();
+}
+
+void HelloTriangleApplication::create_graphics_pipeline()
+{
+    VkShaderModule vertShaderModule = std::exchange(vert_shader_module_, VK_NULL_HANDLE);
+    VkShaderModule fragShaderModule = std::exchange(frag_shader_module_, VK_NULL_HANDLE);
 
     VkPipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
     vertShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -1116,17 +1503,7 @@ void HelloTriangleApplication::create_graphics_pipeline()
     // `minDepth` 和 `maxDepth` 值指定用于帧缓冲区的深度值的范围。这些值必须在 `[0.0f, 1.0f]` 范围内，但是 `minDepth` 可能高于 `maxDepth`。
     // 如果您没有做任何特殊的事情，则应坚持使用 `0.0f` 和 `1.0f` 的标准值。
     // 视口定义从图像到帧缓冲区的转换，而剪裁矩形定义了实际存储像素的区域。任何超出剪裁矩形范围的像素都将被光栅化器丢弃。它们的作用类似于过滤器而不是转换。
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = swap_chain_extent_.width;
-    viewport.height = swap_chain_extent_.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = {swap_chain_extent_.width, swap_chain_extent_.height};
+    // 这里使用动态视口和剪裁矩形(见 record_scene), 管线因此不依赖交换链尺寸, 可以和交换链并行创建。
 
     // 视口和剪裁矩形可以指定为管线的静态部分，也可以指定为命令缓冲区中设置的动态状态。
     // 尽管前者更符合其他状态，但将视口和剪裁状态设置为动态通常很方便，因为它为您提供了更大的灵活性。
@@ -1232,18 +1609,31 @@ void HelloTriangleApplication::create_graphics_pipeline()
     colorBlending.blendConstants[3] = 0; // Optional
 
 
+    // 深度测试: 物体的深度来自 ObjectData, 靠前的先画时被挡住的片段在片段着色器之前就被丢弃
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
     // 管线布局
     // 您可以在着色器中使用 uniform 值，它们是类似于动态状态变量的全局变量，可以在绘制时更改以改变着色器的行为，而无需重新创建它们。
     // 它们通常用于将变换矩阵传递给顶点着色器，或在片段着色器中创建纹理采样器。
     // 这些 uniform 值需要在创建管线期间通过创建 VkPipelineLayout 对象来指定。
     // 即使我们要在未来的章节中使用它们，我们仍然需要创建一个空的管线布局。
 
+    // 所有管线共用同一个布局: set 0 是每帧数据的 dynamic uniform buffer, set 1 是 bindless 堆,
+    // 每次绘制的参数和 bindless 下标通过 push constant 传入
+    const std::array setLayouts{frame_data_layout_, bindless_.set_layout()};
+    const VkPushConstantRange pushConstantRange = BindlessHeap::push_constant_range();
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
     pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutCreateInfo.setLayoutCount = 0;
-    pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+    pipelineLayoutCreateInfo.setLayoutCount = bindless_.initialized() ? 2 : 1;
+    pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
     details::err_check(vkCreatePipelineLayout(device_, &pipelineLayoutCreateInfo, nullptr, &pipeline_layout_),
                        "failed to create pipeline layout");
@@ -1259,12 +1649,21 @@ void HelloTriangleApplication::create_graphics_pipeline()
     pipelineCreateInfo.pViewportState = &viewportState;
     pipelineCreateInfo.pRasterizationState = &rasterizer;
     pipelineCreateInfo.pMultisampleState = &multisampling;
-    pipelineCreateInfo.pDepthStencilState = nullptr;
+    pipelineCreateInfo.pDepthStencilState = &depthStencil;
     pipelineCreateInfo.pColorBlendState = &colorBlending;
     pipelineCreateInfo.pDynamicState = &dynamicState;
 
     pipelineCreateInfo.layout = pipeline_layout_;
 
+    // 动态渲染时管线只需要知道附件格式
+    VkPipelineRenderingCreateInfoKHR renderingCreateInfo{};
+    renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingCreateInfo.colorAttachmentCount = 1;
+    renderingCreateInfo.pColorAttachmentFormats = &surface_format_.format;
+    renderingCreateInfo.depthAttachmentFormat = depth_format_;
+    if (dynamic_rendering_)
+        pipelineCreateInfo.pNext = &renderingCreateInfo;
+
     pipelineCreateInfo.renderPass = render_pass_;
     pipelineCreateInfo.subpass = 0;
 
@@ -1272,9 +1671,43 @@ void HelloTriangleApplication::create_graphics_pipeline()
     pipelineCreateInfo.basePipelineIndex = -1; // Optional
 
     details::err_check(
-        vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphics_pipeline_),
+        pipeline_cache_.create_graphics_pipelines(1, &pipelineCreateInfo, &graphics_pipeline_),
         "failed to create pipeline");
 
+    // GPU 驱动路径: 顶点着色器从 gpu_culling_ 的 storage buffer (set 2) 读取物体数据, 按索引缓冲绘制三角形列表,
+    // 其余状态相同; 片段着色器和 set 1 的 bindless 堆共用, 没有 bindless 堆时 set 1 用空布局占位
+    if (gpu_driven_)
+    {
+        VkDescriptorSetLayout emptySetLayout = VK_NULL_HANDLE;
+        if (!bindless_.initialized())
+        {
+            VkDescriptorSetLayoutCreateInfo emptyLayoutInfo{};
+            emptyLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            details::err_check(vkCreateDescriptorSetLayout(device_, &emptyLayoutInfo, nullptr, &emptySetLayout),
+                               "failed to create empty descriptor set layout");
+        }
+        const std::array indirectSetLayouts{
+            frame_data_layout_, bindless_.initialized() ? bindless_.set_layout() : emptySetLayout,
+            gpu_culling_.set_layout()
+        };
+        pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(indirectSetLayouts.size());
+        pipelineLayoutCreateInfo.pSetLayouts = indirectSetLayouts.data();
+        const auto layoutResult = vkCreatePipelineLayout(device_, &pipelineLayoutCreateInfo, nullptr,
+                                                         &indirect_pipeline_layout_);
+        // 创建之后管线布局不再引用描述符集布局
+        vkDestroyDescriptorSetLayout(device_, emptySetLayout, nullptr);
+        details::err_check(layoutResult, "failed to create indirect pipeline layout");
+
+        VkShaderModule indirectVertShaderModule = create_shader_module(indirect_vert_spv_);
+        indirect_vert_spv_.clear();
+        shaderStageCreateInfo[0].module = indirectVertShaderModule;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        pipelineCreateInfo.layout = indirect_pipeline_layout_;
+        const auto result = pipeline_cache_.create_graphics_pipelines(1, &pipelineCreateInfo, &indirect_pipeline_);
+        vkDestroyShaderModule(device_, indirectVertShaderModule, nullptr);
+        details::err_check(result, "failed to create indirect pipeline");
+    }
+
     vkDestroyShaderModule(device_, vertShaderModule, nullptr);
     vkDestroyShaderModule(device_, fragShaderModule, nullptr);
 }
@@ -1295,8 +1728,11 @@ VkShaderModule HelloTriangleApplication::create_shader_module(std::span<char> co
 
 void HelloTriangleApplication::create_render_pass()
 {
+    if (dynamic_rendering_)
+        return;
+
     VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = swap_chain_image_format_;
+    colorAttachment.format = surface_format_.format;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 
     // loadOp 和 storeOp 决定在渲染之前和渲染之后如何处理附件中的数据。loadOp 有以下选择
@@ -1316,30 +1752,48 @@ void HelloTriangleApplication::create_render_pass()
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+    // 深度附件排在颜色之后, 与渲染图按声明顺序创建的渲染流程兼容 (兼容性只比较格式和采样数)
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = depth_format_;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     // 子过程和附件引用
     VkAttachmentReference colorAttachmentReference{};
     colorAttachmentReference.attachment = 0;
     colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkAttachmentReference depthAttachmentReference{};
+    depthAttachmentReference.attachment = 1;
+    depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentReference;
+    subpass.pDepthStencilAttachment = &depthAttachmentReference;
 
     VkSubpassDependency subpassDependency{};
     subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     subpassDependency.dstSubpass = 0;
-    subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+        | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
     subpassDependency.srcAccessMask = 0;
 
-    subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
+    subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+        | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+        | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+    const std::array attachments{colorAttachment, depthAttachment};
     VkRenderPassCreateInfo renderPassCreateInfo{};
     renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount = 1;
-    renderPassCreateInfo.pAttachments = &colorAttachment;
+    renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassCreateInfo.pAttachments = attachments.data();
     renderPassCreateInfo.subpassCount = 1;
     renderPassCreateInfo.pSubpasses = &subpass;
     renderPassCreateInfo.dependencyCount = 1;
@@ -1349,64 +1803,171 @@ void HelloTriangleApplication::create_render_pass()
                        "Failed to create render pass !");
 }
 
-void HelloTriangleApplication::create_framebuffers()
+void HelloTriangleApplication::create_render_graph()
 {
-    swapChainFramebuffers.resize(swap_chain_image_views_.size(), nullptr);
+    render_graph_.init(device_, allocator_, deletion_queue_, synchronization2_, dynamic_rendering_);
+}
 
-    for (auto i = 0; i < swap_chain_image_views_.size(); i++)
+void HelloTriangleApplication::build_render_graph()
+{
+    using PassType = RenderGraph::PassType;
+
+    // 旧图的渲染流程和帧缓冲可能仍被最近提交的帧使用
+    render_graph_.reset(submit_serial_);
+
+    // 交换链图像: acquire 信号量在颜色输出阶段等待, 之前的内容不需要保留, 结束时转换为呈现布局
+    backbuffer_ = render_graph_.import_image("backbuffer", {
+                                                 .desc = {surface_format_.format, swap_chain_extent_},
+                                                 .initial_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                                                 .initial_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                 .final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                             });
+
+    // 每帧清除的深度附件, 只在图内使用
+    depth_ = render_graph_.create_image("depth", {depth_format_, swap_chain_extent_, VK_IMAGE_ASPECT_DEPTH_BIT});
+
+    // GPU 驱动路径: 剔除在场景之前写入间接绘制命令和计数, 上一帧的间接绘制和统计的复制完成之后才能覆盖.
+    // 遮挡剔除时依次是 Early 剔除, Early 场景, Hi-Z 金字塔, Late 剔除, Late 场景
+    auto add_cull_pass = [this](std::string name, GpuCulling::Phase phase)
     {
-        VkImageView attachments[] = {
-            swap_chain_image_views_[i]
-        };
-        VkFramebufferCreateInfo frameBufferCreateInfo{};
-        frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        frameBufferCreateInfo.renderPass = render_pass_;
-        frameBufferCreateInfo.attachmentCount = 1;
-        frameBufferCreateInfo.pAttachments = attachments;
-        frameBufferCreateInfo.width = swap_chain_extent_.width;
-        frameBufferCreateInfo.height = swap_chain_extent_.height;
-        frameBufferCreateInfo.layers = 1;
+        render_graph_.add_pass(std::move(name), PassType::Compute,
+                               [this](RenderGraph::PassBuilder& pass)
+                               {
+                                   pass.write(indirect_draws_, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                              VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+                                   // 计数先由 vkCmdFillBuffer 清零再原子累加, 最后复制出统计
+                                   pass.write(indirect_counts_,
+                                              VK_PIPELINE_STAGE_2_TRANSFER_BIT
+                                              | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                              VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT
+                                              | VK_ACCESS_2_SHADER_STORAGE_READ_BIT
+                                              | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+                               },
+                               [this, phase](VkCommandBuffer commandBuffer, const RenderGraph::PassContext&)
+                               {
+                                   auto cull_scope = gpu_profiler_.scope(
+                                       commandBuffer, phase == GpuCulling::Phase::Late ? "cull late" : "cull");
+                                   gpu_culling_.record_cull(commandBuffer, cull_constants(), phase,
+                                                            current_flight_frame_);
+                               });
+    };
+    auto add_scene_pass = [this](std::string name, bool late)
+    {
+        render_graph_.add_pass(std::move(name), PassType::Graphics,
+                               [this, late](RenderGraph::PassBuilder& pass)
+                               {
+                                   // Late 阶段在 Early 阶段的结果上继续绘制
+                                   if (late)
+                                   {
+                                       pass.color(backbuffer_);
+                                       pass.depth(depth_);
+                                   }
+                                   else
+                                   {
+                                       pass.color(backbuffer_, VkClearColorValue{{0.0f, 0.0f, 0.0f, 1.0f}});
+                                       pass.depth(depth_, VkClearDepthStencilValue{1.0f, 0});
+                                   }
+                                   pass.secondary_command_buffers();
+                                   if (gpu_driven_)
+                                   {
+                                       pass.read(indirect_draws_, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                                                 VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+                                       pass.read(indirect_counts_, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                                                 VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+                                   }
+                               },
+                               [this, late](VkCommandBuffer commandBuffer, const RenderGraph::PassContext&)
+                               {
+                                   auto scene_scope = gpu_profiler_.scope(commandBuffer,
+                                                                          late ? "scene late" : "scene", true);
+                                   const auto commands = late ? late_scene_commands_ : scene_commands_;
+                                   vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(commands.size()),
+                                                        commands.data());
+                               });
+    };
 
-        details::err_check(vkCreateFramebuffer(device_, &frameBufferCreateInfo, nullptr, &swapChainFramebuffers[i]),
-                           "Failed to create framebuffer !");
+    if (gpu_driven_)
+    {
+        indirect_draws_ = render_graph_.import_buffer("indirect draws", gpu_culling_.draw_buffer(),
+                                                      VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
+        indirect_counts_ = render_graph_.import_buffer("indirect counts", gpu_culling_.count_buffer(),
+                                                       VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT
+                                                       | VK_PIPELINE_STAGE_2_TRANSFER_BIT);
+        add_cull_pass("cull", occlusion_culling_ ? GpuCulling::Phase::Early : GpuCulling::Phase::All);
     }
-}
 
-void HelloTriangleApplication::create_command_pool()
-{
-    auto [graphicsFamily, presentFamily] = find_queue_families_index(physical_device_);
+    add_scene_pass("scene", false);
 
-    VkCommandPoolCreateInfo commandPoolCreateInfo{};
-    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    commandPoolCreateInfo.queueFamilyIndex = graphicsFamily.value();
+    if (occlusion_culling_)
+    {
+        // 金字塔只在 gpu_culling_ 内部使用, 它和 Late 剔除之间的屏障由 record_pyramid 录制
+        render_graph_.add_pass("hi-z", PassType::Compute, [this](RenderGraph::PassBuilder& pass)
+                               {
+                                   pass.sample(depth_);
+                                   pass.side_effect();
+                               },
+                               [this](VkCommandBuffer commandBuffer, const RenderGraph::PassContext&)
+                               {
+                                   auto pyramid_scope = gpu_profiler_.scope(commandBuffer, "hi-z");
+                                   gpu_culling_.record_pyramid(commandBuffer);
+                               });
+        add_cull_pass("cull late", GpuCulling::Phase::Late);
+        add_scene_pass("scene late", true);
+    }
 
-    details::err_check(vkCreateCommandPool(device_, &commandPoolCreateInfo, nullptr, &command_pool_),
-                       "Failed to create command pool !");
+    render_graph_.compile(submit_serial_);
+    if (render_graph_.stats().compiles == 1)
+        render_graph_.print_plan();
+
+    // 金字塔的尺寸跟随深度附件; 只做视锥剔除时也需要剔除管线 set 1 的描述符集
+    if (gpu_driven_)
+    {
+        gpu_culling_.resize(occlusion_culling_ ? render_graph_.image_view(depth_) : VK_NULL_HANDLE,
+                            swap_chain_extent_, submit_serial_);
+    }
 }
 
-void HelloTriangleApplication::create_command_buffer()
+void HelloTriangleApplication::create_command_buffer_cache()
 {
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.commandPool = command_pool_;
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+    command_buffer_cache_.init(device_, queue_family_indices_.graphicsFamily.value(), deletion_queue_);
+}
 
-    command_buffers_.resize(MAX_FRAMES_IN_FLIGHT);
-    details::err_check(vkAllocateCommandBuffers(device_, &commandBufferAllocateInfo, command_buffers_.data()),
-                       "Failed to create command buffer command buffers !");
+void HelloTriangleApplication::create_parallel_recorder()
+{
+    if (record_threads_ > 0)
+        parallel_recorder_.init(device_, queue_family_indices_.graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT,
+                                record_threads_);
 }
 
-void HelloTriangleApplication::record_command_buffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+void HelloTriangleApplication::record_command_buffer(VkCommandBuffer commandBuffer, uint32_t imageIndex,
+                                                     std::span<const VkCommandBuffer> scene,
+                                                     std::span<const VkCommandBuffer> late_scene)
 {
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0; // Optional
-    beginInfo.pInheritanceInfo = nullptr; // Optional
+    // 缓存的主命令缓冲每次提交都会重新执行这里的重置和时间戳
+    gpu_profiler_.reset(commandBuffer);
+    auto pass_scope = gpu_profiler_.scope(commandBuffer, "main_pass");
+
+    // 图中的屏障和渲染流程在录制时解析为这一帧的交换链图像
+    render_graph_.bind_image(backbuffer_, swap_chain_images_[imageIndex], swap_chain_image_views_[imageIndex]);
+    scene_commands_ = scene;
+    late_scene_commands_ = late_scene;
+    render_graph_.execute(commandBuffer);
+    scene_commands_ = {};
+    late_scene_commands_ = {};
+}
 
-    details::err_check(vkBeginCommandBuffer(commandBuffer, &beginInfo), "Failed to begin record command buffer!");
+void HelloTriangleApplication::record_scene(VkCommandBuffer commandBuffer)
+{
+    if (gpu_driven_)
+        record_scene_indirect(commandBuffer, occlusion_culling_ ? GpuCulling::Phase::Early : GpuCulling::Phase::All);
+    else
+        record_scene_slice(commandBuffer, 0, scene_draw_count_);
+}
 
+void HelloTriangleApplication::record_scene_slice(VkCommandBuffer commandBuffer, uint32_t begin,
+                                                  uint32_t end) const
+{
+    // 动态状态不会从主命令缓冲继承, 视口和剪裁矩形在这里设置
     VkViewport viewport;
     viewport.x = 0;
     viewport.y = 0;
@@ -1416,21 +1977,14 @@ void HelloTriangleApplication::record_command_buffer(VkCommandBuffer commandBuff
     viewport.maxDepth = 1.0f;
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = render_pass_;
-    renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = swap_chain_extent_;
-
-    VkClearValue clearValue{{{0.0, 0.0, 0.0, 1.0}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearValue;
-
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
     // 绑定图形管线
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_);
+    // 整个命令缓冲只绑定一次 bindless 堆和推送一次纹理下标, 绘制之间只更新物体下标
+    if (bindless_.initialized())
+        bindless_.bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_);
+    const DrawConstants textureConstants{0, texture_handle_.index, sampler_handle_.index};
+    vkCmdPushConstants(commandBuffer, pipeline_layout_, VK_SHADER_STAGE_ALL, offsetof(DrawConstants, texture),
+                       sizeof(DrawConstants) - offsetof(DrawConstants, texture), &textureConstants.texture);
 
     VkRect2D scissor{};
     scissor.offset = {0, 0};
@@ -1441,15 +1995,126 @@ void HelloTriangleApplication::record_command_buffer(VkCommandBuffer commandBuff
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
-    for (auto i = 0; i < 1; ++i)
+    // 材质或者物体数据块变化时才重新绑定 set 0, 其余绘制只更新 push constant
+    uint32_t bound_material = UINT32_MAX;
+    uint32_t bound_block = UINT32_MAX;
+    for (auto i = begin; i < end; ++i)
     {
-        vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+        const uint32_t material = static_cast<uint32_t>(uint64_t{i} * k_material_count / scene_draw_count_);
+        const uint32_t block = i / objects_per_bind_;
+        if (material != bound_material || block != bound_block)
+        {
+            const std::array dynamicOffsets{
+                frame_data_.dynamic_offset(frame_data_refs_.frame),
+                frame_data_.dynamic_offset(frame_data_refs_.materials[material]),
+                frame_data_.dynamic_offset(frame_data_refs_.objects)
+                + static_cast<uint32_t>(block * objects_per_bind_ * sizeof(ObjectData)),
+            };
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1,
+                                    &frame_data_set_, static_cast<uint32_t>(dynamicOffsets.size()),
+                                    dynamicOffsets.data());
+            bound_material = material;
+            bound_block = block;
+        }
+
+        const uint32_t object = i - block * objects_per_bind_;
+        vkCmdPushConstants(commandBuffer, pipeline_layout_, VK_SHADER_STAGE_ALL, offsetof(DrawConstants, object),
+                           sizeof(object), &object);
+        // firstInstance 区分绘制列表中的每一项
+        vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, i);
     }
+}
+
+GpuCulling::Constants HelloTriangleApplication::cull_constants() const
+{
+    // 网格的局部包围半径, 物体的包围圆半径是它乘以 scale
+    float bounding_radius = 0;
+    for (const auto& vertex : vertices)
+    {
+        bounding_radius = std::max(bounding_radius, glm::length(vertex.pos));
+    }
+    const float aspect = static_cast<float>(swap_chain_extent_.width)
+        / static_cast<float>(std::max(swap_chain_extent_.height, 1u));
+
+    GpuCulling::Constants constants;
+    constants.planes = GpuCulling::clip_planes();
+    // 顶点着色器只把物体的形状除以 aspect, 位置已经在裁剪空间中
+    constants.extent_scale = {1.0f / aspect, 1.0f};
+    constants.bounding_radius = bounding_radius;
+    constants.object_base = static_cast<uint32_t>(frame_data_.dynamic_offset(frame_data_refs_.objects)
+        / sizeof(ObjectData));
+    constants.object_count = std::min(scene_draw_count_, gpu_culling_.capacity());
+    constants.bucket_count = k_material_count;
+    constants.index_count = static_cast<uint32_t>(indices.size());
+    return constants;
+}
 
+void HelloTriangleApplication::record_scene_indirect(VkCommandBuffer commandBuffer, GpuCulling::Phase phase)
+{
+    VkViewport viewport;
+    viewport.x = 0;
+    viewport.y = 0;
+    viewport.width = static_cast<float>(swap_chain_extent_.width);
+    viewport.height = static_cast<float>(swap_chain_extent_.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-    vkCmdEndRenderPass(commandBuffer);
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swap_chain_extent_;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    details::err_check(vkEndCommandBuffer(commandBuffer), "failed to record command buffer!");
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect_pipeline_);
+    VkBuffer vertexBuffers[] = {vertex_buffer_};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, index_buffer_, 0, VK_INDEX_TYPE_UINT16);
+    if (bindless_.initialized())
+        bindless_.bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect_pipeline_layout_);
+    gpu_culling_.bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect_pipeline_layout_, 2);
+
+    // 与剔除使用相同的参数, 桶的划分和 draw 缓冲中的区域一致
+    const auto constants = cull_constants();
+    const DrawConstants drawConstants{constants.object_base, texture_handle_.index, sampler_handle_.index};
+    vkCmdPushConstants(commandBuffer, indirect_pipeline_layout_, VK_SHADER_STAGE_ALL, 0, sizeof(drawConstants),
+                       &drawConstants);
+    // 每个材质一个桶: 换材质的 dynamic offset, 然后一次间接绘制这个桶里所有可见的物体
+    for (uint32_t material = 0; material < k_material_count; ++material)
+    {
+        const std::array dynamicOffsets{
+            frame_data_.dynamic_offset(frame_data_refs_.frame),
+            frame_data_.dynamic_offset(frame_data_refs_.materials[material]),
+            frame_data_.dynamic_offset(frame_data_refs_.objects),
+        };
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect_pipeline_layout_, 0, 1,
+                                &frame_data_set_, static_cast<uint32_t>(dynamicOffsets.size()),
+                                dynamicOffsets.data());
+        gpu_culling_.record_draw(commandBuffer, constants, material, phase);
+    }
+}
+
+VkCommandBuffer HelloTriangleApplication::record_parallel(uint32_t imageIndex,
+                                                          const VkCommandBufferInheritanceInfo& inheritance)
+{
+    const auto primary = parallel_recorder_.begin_frame(current_flight_frame_);
+    const auto secondaries = parallel_recorder_.record(inheritance, scene_draw_count_,
+                                                       [this](VkCommandBuffer command_buffer, uint32_t begin,
+                                                              uint32_t end)
+                                                       {
+                                                           record_scene_slice(command_buffer, begin, end);
+                                                       });
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    details::err_check(vkBeginCommandBuffer(primary, &beginInfo), "Failed to begin record command buffer!");
+
+    // 按片段顺序执行, 与单线程录制的结果相同
+    record_command_buffer(primary, imageIndex, secondaries);
+
+    details::err_check(vkEndCommandBuffer(primary), "failed to record command buffer!");
+    return primary;
 }
 
 void HelloTriangleApplication::create_sync_object()
@@ -1457,21 +2122,33 @@ void HelloTriangleApplication::create_sync_object()
     VkSemaphoreCreateInfo semaphoreCreateInfo{};
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceCreateInfo{};
-    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
+    // 交换链只接受二值信号量, 获取图像和呈现仍然使用它们
     image_available_semaphores_.resize(MAX_FRAMES_IN_FLIGHT);
-    fences_in_flight_.resize(MAX_FRAMES_IN_FLIGHT);
-
     for (auto i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
     {
         details::err_check(vkCreateSemaphore(device_, &semaphoreCreateInfo, nullptr, &image_available_semaphores_[i]),
                            "Failed to create semaphore !");
-        details::err_check(vkCreateFence(device_, &fenceCreateInfo, nullptr, &fences_in_flight_[i]),
-                           "Failed to create fence !");
     }
 
+    // 其余的帧同步都在一条时间线上: 第 n 次提交完成时值变为 n
+    VkSemaphoreTypeCreateInfo timelineCreateInfo{};
+    timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineCreateInfo.initialValue = submit_serial_;
+    VkSemaphoreCreateInfo frameTimelineCreateInfo{};
+    frameTimelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    frameTimelineCreateInfo.pNext = &timelineCreateInfo;
+    details::err_check(vkCreateSemaphore(device_, &frameTimelineCreateInfo, nullptr, &frame_timeline_),
+                       "Failed to create timeline semaphore !");
+
+    create_render_finished_semaphores();
+}
+
+void HelloTriangleApplication::create_render_finished_semaphores()
+{
+    VkSemaphoreCreateInfo semaphoreCreateInfo{};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
     render_finished_semaphores_.resize(swap_chain_images_.size());
     // https://docs.vulkan.org/guide/latest/swapchain_semaphore_reuse.html
     for (auto i = 0; i < swap_chain_images_.size(); ++i)
@@ -1481,39 +2158,272 @@ void HelloTriangleApplication::create_sync_object()
     }
 }
 
-void HelloTriangleApplication::cleanup_swap_chain() const
+void HelloTriangleApplication::retire_swap_chain_views()
 {
-    for (const auto swapChainFramebuffer : swapChainFramebuffers)
-    {
-        vkDestroyFramebuffer(device_, swapChainFramebuffer, nullptr);
-    }
-    for (const auto imageView : swap_chain_image_views_)
+    // 最近提交的那一帧可能仍在使用它们, 引用它们的帧缓冲由 render_graph_ 重新编译时退役
+    for (const auto imageView : std::exchange(swap_chain_image_views_, {}))
     {
-        vkDestroyImageView(device_, imageView, nullptr);
+        deletion_queue_.push(submit_serial_, imageView);
     }
-    vkDestroySwapchainKHR(device_, swap_chain_, nullptr);
+}
+
+void HelloTriangleApplication::cleanup_swap_chain()
+{
+    retire_swap_chain_views();
+    retire_swap_chain(std::exchange(swap_chain_, VK_NULL_HANDLE), std::exchange(render_finished_semaphores_, {}));
+    present_fences_.clear();
 }
 
 void HelloTriangleApplication::recreate_swap_chain()
 {
-    vkDeviceWaitIdle(device_);
-    cleanup_swap_chain();
+    // 最小化时帧缓冲大小为 0, 无法创建交换链, 等窗口恢复后再重建
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window_, &width, &height);
+    if (width == 0 || height == 0)
+    {
+        framebuffer_resized_ = true;
+        return;
+    }
+
+    // 不等待设备空闲: 旧的帧缓冲和图像视图按 serial 延迟销毁, 旧交换链在其呈现结束后销毁
+    const VkSwapchainKHR old_swap_chain = swap_chain_;
+    auto old_semaphores = std::exchange(render_finished_semaphores_, {});
+    retire_swap_chain_views();
+
     create_swap_chain();
     create_image_view();
-    create_framebuffers();
+    build_render_graph();
+    create_render_finished_semaphores();
+
+    // 视口尺寸和渲染图都变了
+    ++scene_version_;
+    command_buffer_cache_.invalidate();
+
+    retire_swap_chain(old_swap_chain, std::move(old_semaphores));
+    ++swap_chain_recreations_;
+}
+
+void HelloTriangleApplication::retire_swap_chain(VkSwapchainKHR swap_chain, std::vector<VkSemaphore> semaphores)
+{
+    retired_swap_chains_.push_back({
+        .swap_chain = swap_chain,
+        .semaphores = std::move(semaphores),
+        .present_fences = std::exchange(present_fences_, {}),
+        .serial = submit_serial_ + MAX_FRAMES_IN_FLIGHT,
+    });
+}
+
+void HelloTriangleApplication::collect_retired_swap_chains(bool wait)
+{
+    std::erase_if(retired_swap_chains_, [&](RetiredSwapChain& retired)
+    {
+        if (swapchain_maintenance1_)
+        {
+            if (wait && !retired.present_fences.empty())
+            {
+                vkWaitForFences(device_, retired.present_fences.size(), retired.present_fences.data(), VK_TRUE,
+                                UINT64_MAX);
+            }
+            const bool presented = std::ranges::all_of(retired.present_fences, [&](VkFence fence)
+            {
+                return vkGetFenceStatus(device_, fence) == VK_SUCCESS;
+            });
+            if (!presented)
+                return false;
+        }
+        else if (!wait && completed_serial_ < retired.serial)
+        {
+            return false;
+        }
+
+        vkDestroySwapchainKHR(device_, retired.swap_chain, nullptr);
+        for (const auto semaphore : retired.semaphores)
+        {
+            vkDestroySemaphore(device_, semaphore, nullptr);
+        }
+        free_present_fences_.insert(free_present_fences_.end(), retired.present_fences.begin(),
+                                    retired.present_fences.end());
+        return true;
+    });
+}
+
+VkFence HelloTriangleApplication::acquire_present_fence()
+{
+    // 当前交换链上已经触发的呈现 fence 可以直接复用
+    if (free_present_fences_.empty())
+    {
+        std::erase_if(present_fences_, [&](VkFence fence)
+        {
+            if (vkGetFenceStatus(device_, fence) != VK_SUCCESS)
+                return false;
+            free_present_fences_.push_back(fence);
+            return true;
+        });
+    }
+
+    VkFence fence = VK_NULL_HANDLE;
+    if (!free_present_fences_.empty())
+    {
+        fence = free_present_fences_.back();
+        free_present_fences_.pop_back();
+        vkResetFences(device_, 1, &fence);
+    }
+    else
+    {
+        VkFenceCreateInfo fence_info{};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        details::err_check(vkCreateFence(device_, &fence_info, nullptr, &fence), "Failed to create present fence !");
+    }
+    present_fences_.push_back(fence);
+    return fence;
+}
+
+void HelloTriangleApplication::rebuild_transforms(uint32_t count, uint32_t layers, float aspect)
+{
+    // 物体排成正方形网格, 一个物体时与原来的四边形重合.
+    // 格子不小于 k_min_cell, 物体很多时网格超出窗口的右上方, 超出部分由 GPU 剔除.
+    // 分层时物体按下标连续分给各层, 每层一张同样的网格, 层的根实体携带深度, 第 0 层在最前面; 它的物体放大到
+    // 任意旋转下都盖住自己的格子 (边长 cell * sqrt(2), 宽窗口中 x 方向还要除以 aspect), 后面各层被完全挡住
+    constexpr float k_min_cell = 2.0f / 128;
+    const uint32_t per_layer = (count + layers - 1) / layers;
+    const auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(per_layer))));
+    const float cell = std::max(2.0f / static_cast<float>(columns), k_min_cell);
+    const float cover_scale = cell * 1.5f * std::max(aspect, 1.0f);
+
+    transforms_.clear();
+    transforms_.reserve(layers + count);
+    for (uint32_t layer = 0; layer < layers; ++layer)
+    {
+        const uint32_t root = transforms_.create();
+        transforms_.set_position(root, 0.0f, 0.0f, static_cast<float>(layer + 1) / static_cast<float>(layers + 1));
+    }
+    transform_phases_.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        // 根实体的下标就是层号
+        const uint32_t layer = i / per_layer;
+        const uint32_t slot = i % per_layer;
+        const auto x = static_cast<float>(slot % columns);
+        const auto y = static_cast<float>(slot / columns);
+        const float scale = layers > 1 && layer == 0 ? cover_scale : cell * 0.5f;
+        const uint32_t entity = transforms_.create(layer);
+        transforms_.set_position(entity, -1.0f + cell * (x + 0.5f), -1.0f + cell * (y + 0.5f), 0.0f);
+        transforms_.set_scale(entity, scale, scale);
+        transform_phases_[i] = static_cast<float>(std::fmod(i * 0.37, 2 * std::numbers::pi));
+    }
+    transform_objects_ = count;
+    transform_layers_ = layers;
+    transform_aspect_ = aspect;
+}
+
+void HelloTriangleApplication::update_frame_data()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (animate_ && last_animation_update_ != std::chrono::steady_clock::time_point{})
+        animation_time_ += std::chrono::duration<double>(now - last_animation_update_).count();
+    last_animation_update_ = now;
+    const auto time = static_cast<float>(animation_time_);
+
+    const float aspect = static_cast<float>(swap_chain_extent_.width)
+        / static_cast<float>(std::max(swap_chain_extent_.height, 1u));
+
+    frame_data_.begin();
+    frame_data_refs_.frame = frame_data_.add(FrameUniforms{
+        .time = time,
+        .aspect = aspect,
+    });
+    for (uint32_t material = 0; material < k_material_count; ++material)
+    {
+        const float hue = static_cast<float>(material) / k_material_count;
+        frame_data_refs_.materials[material] = frame_data_.add(MaterialUniforms{
+            .tint = {0.6f + 0.4f * hue, 1.0f - 0.4f * hue, 0.8f + 0.2f * std::sin(time + hue * 6.28f), 1.0f},
+        });
+    }
+
+    // 变换按物体数, 层数和窗口比例建好后只有旋转随时间变化; 角度对 2pi 取余, 保持在 sincos 精确的范围内.
+    // 旋转分块并行写入, 再由 transforms_ 逐层算出世界变换, 直接写进批次, 不经过中间数组
+    const uint32_t count = scene_draw_count_;
+    const uint32_t layers = std::clamp(scene_layers_, 1u, std::max(count, 1u));
+    if (count != transform_objects_ || layers != transform_layers_ || aspect != transform_aspect_)
+        rebuild_transforms(count, layers, aspect);
+    const auto spin = static_cast<float>(std::fmod(animation_time_ * 0.5, 2 * std::numbers::pi));
+    const auto rotation = transforms_.rotation().subspan(layers);
+    task_pool_.run((count + TransformStore::k_chunk_size - 1) / TransformStore::k_chunk_size, [&](uint32_t chunk)
+    {
+        const uint32_t begin = chunk * TransformStore::k_chunk_size;
+        const uint32_t end = std::min(begin + TransformStore::k_chunk_size, count);
+        for (uint32_t i = begin; i < end; ++i)
+            rotation[i] = transform_phases_[i] + spin;
+    });
+    // 根实体在前, 物体是最后一层, 从第 layers 个实体开始
+    transforms_.update(task_pool_, frame_data_.emplace<ObjectData>(count, frame_data_refs_.objects), layers);
+
+    if (!frame_data_.upload(frame_allocator_))
+        throw std::runtime_error("frame data does not fit in the frame ring");
 }
 
 void HelloTriangleApplication::draw_frame()
 {
-    auto current_flight_fence = fences_in_flight_[current_flight_frame_];
-    vkWaitForFences(device_, 1, &current_flight_fence, VK_TRUE, UINT64_MAX);
+    using clock = std::chrono::steady_clock;
+    using enum FrameStats::Timing;
+
+    const auto frame_begin = clock::now();
+    FrameStats::Sample sample{.frame = frame_count_};
+    if (last_frame_begin_ != clock::time_point{})
+        sample[Frame] = std::chrono::duration<float, std::milli>(frame_begin - last_frame_begin_).count();
+    last_frame_begin_ = frame_begin;
+    // 累加从上一个标记到现在的耗时
+    auto mark = frame_begin;
+    auto lap = [&](FrameStats::Timing timing)
+    {
+        const auto now = clock::now();
+        sample[timing] += std::chrono::duration<float, std::milli>(now - mark).count();
+        mark = now;
+    };
 
+    // 等待这个飞行帧上一次的提交完成, 首次使用时值为 0, 立即返回
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &frame_timeline_;
+    waitInfo.pValues = &frame_serials_[current_flight_frame_];
+    details::err_check(vkWaitSemaphores(device_, &waitInfo, UINT64_MAX), "Failed to wait frame timeline !");
+    lap(Wait);
+
+    // 时间线的当前值就是已经完成的最后一帧, 可能比刚才等待的更新
+    details::err_check(vkGetSemaphoreCounterValue(device_, frame_timeline_, &completed_serial_),
+                       "Failed to query frame timeline !");
+    deletion_queue_.collect(completed_serial_);
+
+    // 上一轮提交已完成, GPU 不再读取这一帧上一轮写入的每帧数据
+    frame_allocator_.begin_frame(current_flight_frame_);
+    // 读取这一帧上一轮的 GPU 计时, 查询已经全部可用, 不会等待
+    gpu_profiler_.begin_frame(current_flight_frame_);
+    // 这一帧上一轮的剔除统计同样已经写回, 每次提交只读一次
+    if (gpu_driven_ && std::exchange(culling_collected_serials_[current_flight_frame_],
+                                     frame_serials_[current_flight_frame_]) != frame_serials_[current_flight_frame_])
+        gpu_culling_.collect(current_flight_frame_);
+    // 回收已完成的上传批次占用的暂存空间, 不会阻塞
+    upload_manager_.collect();
+    allocator_.update_budget();
+    collect_retired_swap_chains(false);
+
+    // 最小化或者上一帧错过了重建(窗口大小为 0), 在这里补上
+    if (framebuffer_resized_)
+    {
+        framebuffer_resized_ = false;
+        recreate_swap_chain();
+        if (framebuffer_resized_)
+            return; // 仍然最小化, 跳过这一帧
+    }
 
     VkSemaphore current_available_semaphore = image_available_semaphores_[current_flight_frame_];
     uint32_t image_index = 0;
+    mark = clock::now();
     auto result = vkAcquireNextImageKHR(device_, swap_chain_, UINT64_MAX,
                                         current_available_semaphore, VK_NULL_HANDLE,
                                         &image_index);
+    lap(Acquire);
     if (result == VK_ERROR_OUT_OF_DATE_KHR)
     {
         recreate_swap_chain();
@@ -1530,13 +2440,72 @@ void HelloTriangleApplication::draw_frame()
     }
     // 使用image对应的fence
 
-    auto current_command_buffer = command_buffers_[current_flight_frame_];
     auto current_render_finished_semaphore = render_finished_semaphores_[image_index];
 
     //fmt::print("[{}] image_index: {} flight in {} ", frame_count_, image_index, current_flight_frame_);
 
-    vkResetCommandBuffer(current_command_buffer, 0);
-    record_command_buffer(current_command_buffer, image_index);
+    VkCommandBufferInheritanceInfo inheritance{};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = render_pass_;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = VK_NULL_HANDLE; // 同一个次级命令缓冲用于所有交换链图像
+    // 动态渲染时 renderPass 为空, 从这里继承附件格式
+    VkCommandBufferInheritanceRenderingInfoKHR inheritance_rendering{};
+    inheritance_rendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+    inheritance_rendering.colorAttachmentCount = 1;
+    inheritance_rendering.pColorAttachmentFormats = &surface_format_.format;
+    inheritance_rendering.depthAttachmentFormat = depth_format_;
+    inheritance_rendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    if (dynamic_rendering_)
+        inheritance.pNext = &inheritance_rendering;
+    // 在管线统计查询激活期间执行
+    inheritance.pipelineStatistics = gpu_profiler_.statistics_flags();
+
+    update_frame_data();
+
+    VkCommandBuffer current_command_buffer;
+    // GPU 驱动时场景只有几条命令, 不需要多线程录制
+    if (parallel_recorder_.initialized() && !gpu_driven_)
+    {
+        current_command_buffer = record_parallel(image_index, inheritance);
+    }
+    else
+    {
+        // 内容不变时直接重新提交之前录制好的命令缓冲. 录制进去的 dynamic offset 指向这个飞行帧的环形缓冲区域,
+        // 所以每个飞行帧各缓存一份; 每帧的批次是区域中的第一次分配, 位置通常不变, 只有变化时才重新录制
+        if (std::exchange(scene_frame_data_bases_[current_flight_frame_], frame_data_.base()) != frame_data_.base())
+            ++scene_version_;
+        const auto scene = command_buffer_cache_.secondary(k_scene_commands + current_flight_frame_, scene_version_,
+                                                           inheritance,
+                                                           [this](VkCommandBuffer command_buffer)
+                                                           {
+                                                               record_scene(command_buffer);
+                                                           }, submit_serial_);
+        // 遮挡剔除的 Late 阶段另有一个场景 pass, 绘制 draw 缓冲后一半中的命令
+        VkCommandBuffer late_scene = VK_NULL_HANDLE;
+        if (occlusion_culling_)
+        {
+            late_scene = command_buffer_cache_.secondary(k_late_scene_commands + current_flight_frame_,
+                                                         scene_version_, inheritance,
+                                                         [this](VkCommandBuffer command_buffer)
+                                                         {
+                                                             record_scene_indirect(command_buffer,
+                                                                                   GpuCulling::Phase::Late);
+                                                         }, submit_serial_);
+        }
+        current_command_buffer = command_buffer_cache_.primary(current_flight_frame_, image_index,
+                                                               [&](VkCommandBuffer command_buffer)
+                                                               {
+                                                                   record_command_buffer(
+                                                                       command_buffer, image_index,
+                                                                       std::span(&scene, 1),
+                                                                       late_scene != VK_NULL_HANDLE
+                                                                           ? std::span(&late_scene, 1)
+                                                                           : std::span<VkCommandBuffer>());
+                                                               });
+    }
+
+    lap(Record);
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1546,14 +2515,27 @@ void HelloTriangleApplication::draw_frame()
     submitInfo.pWaitDstStageMask = waitStage;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &current_command_buffer;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &current_render_finished_semaphore;
-
-    // 使用之前先使fence处于未触发状态
-    vkResetFences(device_, 1, &current_flight_fence);
-
-    details::err_check(vkQueueSubmit(graphics_queue_, 1, &submitInfo, current_flight_fence),
+    // 呈现用的二值信号量和帧时间线一起触发, 二值信号量的值被忽略
+    const uint64_t frame_serial = submit_serial_ + 1;
+    const std::array signalSemaphores{current_render_finished_semaphore, frame_timeline_};
+    const std::array<uint64_t, 2> signalValues{0, frame_serial};
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+    submitInfo.pNext = &timelineSubmitInfo;
+
+    // 录制期间写入的每帧数据在提交前统一 flush (一致内存上为空操作)
+    frame_allocator_.flush();
+
+    details::err_check(vkQueueSubmit(graphics_queue_, 1, &submitInfo, VK_NULL_HANDLE),
                        "Failed to submit command buffer event !");
+    frame_serials_[current_flight_frame_] = submit_serial_ = frame_serial;
+    gpu_profiler_.submitted();
+    lap(Submit);
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1563,34 +2545,114 @@ void HelloTriangleApplication::draw_frame()
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &swap_chain_;
     presentInfo.pImageIndices = &image_index;
-    vkQueuePresentKHR(present_queue_, &presentInfo);
+
+    // 呈现 fence 触发后才能确定交换链不再使用这次呈现的信号量, 重建时据此销毁旧交换链
+    VkSwapchainPresentFenceInfoEXT present_fence_info{};
+    VkFence present_fence = VK_NULL_HANDLE;
+    if (swapchain_maintenance1_)
+    {
+        present_fence = acquire_present_fence();
+        present_fence_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+        present_fence_info.swapchainCount = 1;
+        present_fence_info.pFences = &present_fence;
+        presentInfo.pNext = &present_fence_info;
+    }
+
+    // present id 用于测量输入到呈现的延迟, 并在下一帧开始前限制排队的呈现数
+    VkPresentIdKHR present_id_info{};
+    uint64_t present_id = 0;
+    if (present_wait_)
+    {
+        present_id = frame_pacer_.next_present_id();
+        present_id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        present_id_info.swapchainCount = 1;
+        present_id_info.pPresentIds = &present_id;
+        present_id_info.pNext = presentInfo.pNext;
+        presentInfo.pNext = &present_id_info;
+    }
+    result = vkQueuePresentKHR(present_queue_, &presentInfo);
+    lap(Present);
+    frame_pacer_.poll();
 
     ++frame_count_;
-    current_flight_frame_ = (current_flight_frame_ + 1) % MAX_FRAMES_IN_FLIGHT;
+    current_flight_frame_ = (current_flight_frame_ + 1) % frames_in_flight_;
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebuffer_resized_)
+    {
+        framebuffer_resized_ = false;
+        recreate_swap_chain();
+    }
+    else
+    {
+        details::err_check(result, "failed to present swap chain image!");
+    }
+
+    // 重建交换链的耗时也算在 CPU 时间里
+    sample[Cpu] = std::chrono::duration<float, std::milli>(clock::now() - frame_begin).count()
+        - sample[Wait] - sample[Acquire] - sample[Present];
+    frame_stats_.record(sample);
 }
 
 void HelloTriangleApplication::cleanup()
 {
-    vkDestroyBuffer(device_, vertex_buffer_, nullptr);
-    vkFreeMemory(device_, vertex_buffer_memory_, nullptr);
-    vkDestroyBuffer(device_, index_buffer_, nullptr);
-    vkFreeMemory(device_, index_buffer_memory_, nullptr);
+    allocator_.destroy_buffer(vertex_buffer_, vertex_buffer_allocation_);
+    allocator_.destroy_buffer(index_buffer_, index_buffer_allocation_);
+    // 在 bindless_ 中的下标随堆一起销毁, 不需要 remove
+    vkDestroySampler(device_, texture_sampler_, nullptr);
+    vkDestroyImageView(device_, texture_view_, nullptr);
+    vkDestroyImage(device_, texture_image_, nullptr);
+    allocator_.free(texture_allocation_);
     for (auto i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         vkDestroySemaphore(device_, image_available_semaphores_[i], nullptr);
-        vkDestroyFence(device_, fences_in_flight_[i], nullptr);
     }
-    for (auto i = 0; i < swap_chain_images_.size(); i++)
-    {
-        vkDestroySemaphore(device_, render_finished_semaphores_[i], nullptr);
-    }
-
-    vkDestroyCommandPool(device_, command_pool_, nullptr);
+    vkDestroySemaphore(device_, frame_timeline_, nullptr);
 
+    // render finished 信号量随交换链一起退役, 等它的呈现全部结束后销毁
     cleanup_swap_chain();
+    collect_retired_swap_chains(true);
+    for (const auto fence : std::exchange(free_present_fences_, {}))
+    {
+        vkDestroyFence(device_, fence, nullptr);
+    }
     vkDestroyPipeline(device_, graphics_pipeline_, nullptr);
     vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+    vkDestroyPipeline(device_, indirect_pipeline_, nullptr);
+    vkDestroyPipelineLayout(device_, indirect_pipeline_layout_, nullptr);
+    // 描述符集随池一起释放
+    vkDestroyDescriptorPool(device_, frame_data_pool_, nullptr);
+    vkDestroyDescriptorSetLayout(device_, frame_data_layout_, nullptr);
     vkDestroyRenderPass(device_, render_pass_, nullptr);
+    render_graph_.print_stats();
+    render_graph_.destroy();
+    // main_loop 结束时已经 vkDeviceWaitIdle
+    deletion_queue_.flush();
+    bindless_.print_stats();
+    bindless_.destroy();
+    if (gpu_culling_.initialized())
+        gpu_culling_.print_stats();
+    gpu_culling_.destroy();
+    // 退役的次级命令缓冲在上面释放, 之后才能销毁命令池
+    command_buffer_cache_.print_stats();
+    command_buffer_cache_.destroy();
+    parallel_recorder_.destroy();
+    if (transforms_.stats().updates > 0)
+        transforms_.print_stats();
+    task_pool_.destroy();
+
+    pipeline_cache_.print_stats();
+    pipeline_cache_.destroy();
+
+    upload_manager_.print_stats();
+    upload_manager_.destroy();
+    frame_data_.print_stats();
+    frame_allocator_.print_stats();
+    frame_allocator_.destroy();
+    gpu_profiler_.print_stats();
+    gpu_profiler_.destroy();
+    frame_pacer_.print_stats();
+    allocator_.print_stats();
+    allocator_.destroy();
 
     vkDestroySurfaceKHR(vk_instance_, surface_, nullptr);
     vkDestroyDevice(device_, nullptr);
@@ -1602,3 +2664,778 @@ void HelloTriangleApplication::cleanup()
     glfwDestroyWindow(window_);
     glfwTerminate();
 }
+
+void HelloTriangleApplication::init_vulkan()
+{
+    auto init_scope = startup_profiler_.scope("init_vulkan");
+
+    // 着色器文件读取不依赖任何 Vulkan 对象; 逻辑设备创建之后以下几条链互不依赖:
+    //  交换链 -> 图像视图 (主线程, 可能需要 glfwGetFramebufferSize)
+    //  深度格式 + 渲染流程 + 着色器模块 + bindless 堆 + 每帧数据描述符集 + GPU 剔除 -> 图形管线
+    //  上传管理器 (+ bindless 堆) -> 顶点/索引/纹理写入暂存环 -> 一次提交 (UploadManager 内部加锁, 可以并行)
+    //  命令缓冲缓存 (使用 create_allocator 中初始化的 deletion_queue_)
+    using App = HelloTriangleApplication;
+    using enum InitScheduler::Affinity;
+    auto step = [this](void (App::*fn)()) { return [this, fn] { std::invoke(fn, this); }; };
+
+    InitScheduler scheduler(&startup_profiler_);
+    const auto shader_code = scheduler.add("load_shader_code", step(&App::load_shader_code));
+    const auto instance = scheduler.add("create_instance", step(&App::create_instance));
+    // setup_debug_message(); //setup at create_instance
+    const auto surface = scheduler.add("create_surface", step(&App::create_surface), {instance});
+    const auto physical_device = scheduler.add("pick_physical_device", step(&App::pick_physical_device), {surface});
+    const auto device = scheduler.add("create_logical_device", step(&App::create_logical_device), {physical_device});
+    const auto surface_format = scheduler.add("choose_surface_format", step(&App::choose_surface_format), {device});
+    const auto depth_format = scheduler.add("choose_depth_format", step(&App::choose_depth_format), {device});
+    const auto pipeline_cache = scheduler.add("create_pipeline_cache", step(&App::create_pipeline_cache), {device});
+
+    const auto swap_chain = scheduler.add("create_swap_chain", step(&App::create_swap_chain), {surface_format},
+                                          MainThread);
+    const auto image_view = scheduler.add("create_image_view", step(&App::create_image_view), {swap_chain});
+
+    const auto render_pass = scheduler.add("create_render_pass", step(&App::create_render_pass),
+                                           {surface_format, depth_format});
+    const auto shader_modules = scheduler.add("create_shader_modules", step(&App::create_shader_modules),
+                                              {device, shader_code});
+    const auto allocator = scheduler.add("create_allocator", step(&App::create_allocator), {device});
+    // deletion_queue_ 在 create_allocator 中初始化
+    const auto bindless = scheduler.add("create_bindless_heap", step(&App::create_bindless_heap), {allocator});
+    const auto frame_allocator = scheduler.add("create_frame_allocator", step(&App::create_frame_allocator),
+                                               {allocator});
+    const auto frame_data_set = scheduler.add("create_frame_data_set", step(&App::create_frame_data_set),
+                                              {frame_allocator});
+    // 剔除描述符集绑定整个 frame_allocator_ 的 buffer; 之后 gpu_driven_ 才确定, 管线和渲染图都依赖它
+    const auto gpu_culling = scheduler.add("create_gpu_culling", step(&App::create_gpu_culling),
+                                           {frame_allocator, pipeline_cache, shader_code});
+    const auto pipeline = scheduler.add("create_graphics_pipeline", step(&App::create_graphics_pipeline),
+                                        {render_pass, shader_modules, pipeline_cache, bindless, frame_data_set,
+                                         gpu_culling});
+    const auto render_graph = scheduler.add("create_render_graph", step(&App::create_render_graph), {allocator});
+    scheduler.add("build_render_graph", step(&App::build_render_graph),
+                  {image_view, render_graph, gpu_culling, depth_format});
+    const auto upload_manager = scheduler.add("create_upload_manager", step(&App::create_upload_manager),
+                                              {allocator});
+    const auto vertex_buffer = scheduler.add("create_vertex_buffer", step(&App::create_vertex_buffer),
+                                             {upload_manager});
+    const auto index_buffer = scheduler.add("create_index_buffer", step(&App::create_index_buffer),
+                                            {upload_manager});
+    const auto texture = scheduler.add("create_texture", step(&App::create_texture), {upload_manager, bindless});
+    scheduler.add("flush_uploads", step(&App::flush_uploads), {vertex_buffer, index_buffer, texture});
+    scheduler.add("create_gpu_profiler", step(&App::create_gpu_profiler), {device});
+
+    scheduler.add("create_command_buffer_cache", step(&App::create_command_buffer_cache), {allocator});
+    scheduler.add("create_parallel_recorder", step(&App::create_parallel_recorder), {device});
+
+    scheduler.add("create_sync_object", step(&App::create_sync_object), {swap_chain});
+
+    scheduler.add("create_task_pool", step(&App::create_task_pool));
+
+    // 同时推进的链不超过三条左右, 再多的线程没有意义
+    scheduler.run(parallel_init_ ? std::clamp(std::thread::hardware_concurrency(), 1u, 3u) : 0);
+
+    std::cout << std::flush;
+    std::cerr << std::flush;
+}
+
+int HelloTriangleApplication::run_startup_bench(int iterations, bool parallel_init)
+{
+    // 按首次出现的顺序保存每个阶段的样本
+    std::vector<std::pair<std::string, std::vector<double>>> samples;
+    std::vector<double> totals;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        try
+        {
+            HelloTriangleApplication app;
+            app.parallel_init_ = parallel_init;
+            app.startup();
+            vkDeviceWaitIdle(app.device_);
+            app.cleanup();
+
+            for (const auto& phase : app.startup_profiler_.phases())
+            {
+                auto it = std::ranges::find(samples, phase.name, &decltype(samples)::value_type::first);
+                if (it == samples.end())
+                {
+                    it = samples.emplace(samples.end(), phase.name, std::vector<double>{});
+                }
+                it->second.push_back(phase.duration_ms);
+            }
+            totals.push_back(app.startup_profiler_.total_ms());
+        }
+        catch (const std::exception& e)
+        {
+            fmt::println(stderr, "[startup-bench] iteration {} failed: {}", i, e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    samples.emplace_back("total", std::move(totals));
+
+    fmt::println("[startup-bench] {} iterations, {} init", iterations, parallel_init ? "parallel" : "serial");
+    fmt::println("{:<28}{:>12}{:>12}{:>12}", "phase", "min(ms)", "median(ms)", "p95(ms)");
+    for (auto& [name, values] : samples)
+    {
+        const double min = std::ranges::min(values);
+        const double median = StartupProfiler::percentile(values, 50);
+        const double p95 = StartupProfiler::percentile(values, 95);
+        fmt::println("{:<28}{:>12.3f}{:>12.3f}{:>12.3f}", name, min, median, p95);
+    }
+    return EXIT_SUCCESS;
+}
+
+int HelloTriangleApplication::run_resize_bench(int frames)
+{
+    std::vector<double> frame_ms;
+    uint32_t recreations = 0;
+    bool maintenance1 = false;
+    try
+    {
+        HelloTriangleApplication app;
+        app.startup();
+        maintenance1 = app.swapchain_maintenance1_;
+
+        for (int i = 0; i < frames; ++i)
+        {
+            // 宽高在 [WIDTH/2, WIDTH] 之间往返, 几乎每帧都触发一次重建
+            const int step = i % 32 < 16 ? i % 16 : 16 - i % 16;
+            glfwSetWindowSize(app.window_, static_cast<int>(WIDTH / 2 + WIDTH / 32 * step),
+                              static_cast<int>(HEIGHT / 2 + HEIGHT / 32 * step));
+            glfwPollEvents();
+
+            const auto begin = std::chrono::steady_clock::now();
+            app.draw_frame();
+            frame_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin)
+                .count());
+        }
+
+        recreations = app.swap_chain_recreations_;
+        vkDeviceWaitIdle(app.device_);
+        app.cleanup();
+    }
+    catch (const std::exception& e)
+    {
+        fmt::println(stderr, "[resize-bench] failed: {}", e.what());
+        return EXIT_FAILURE;
+    }
+
+    if (frame_ms.empty())
+        return EXIT_SUCCESS;
+
+    const double average = std::ranges::fold_left(frame_ms, 0.0, std::plus{}) / frame_ms.size();
+    const double worst = std::ranges::max(frame_ms);
+    const double p50 = StartupProfiler::percentile(frame_ms, 50);
+    const double p95 = StartupProfiler::percentile(frame_ms, 95);
+    fmt::println("[resize-bench] {} frames, {} swapchain recreations, present fences {}", frame_ms.size(),
+                 recreations, maintenance1 ? "on" : "off");
+    fmt::println("[resize-bench] avg {:.3f}ms, p50 {:.3f}ms, p95 {:.3f}ms, worst {:.3f}ms", average, p50, p95,
+                 worst);
+    return EXIT_SUCCESS;
+}
+
+int HelloTriangleApplication::run_record_bench(int draws)
+{
+    constexpr int k_frames = 300;
+
+    std::vector<uint32_t> thread_counts;
+    const uint32_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t threads = 1; threads < max_threads; threads *= 2)
+    {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::vector<std::pair<uint32_t, ParallelRecorder::Stats>> results;
+    try
+    {
+        HelloTriangleApplication app;
+        app.startup();
+        app.scene_draw_count_ = static_cast<uint32_t>(std::max(draws, 1));
+
+        for (const auto threads : thread_counts)
+        {
+            app.parallel_recorder_.init(app.device_, app.queue_family_indices_.graphicsFamily.value(),
+                                        MAX_FRAMES_IN_FLIGHT, threads);
+            for (int i = 0; i < k_frames; ++i)
+            {
+                glfwPollEvents();
+                app.draw_frame();
+            }
+            // 命令池销毁前它们录制的命令缓冲必须执行完
+            vkDeviceWaitIdle(app.device_);
+            results.emplace_back(threads, app.parallel_recorder_.stats());
+            app.parallel_recorder_.destroy();
+        }
+
+        app.cleanup();
+    }
+    catch (const std::exception& e)
+    {
+        fmt::println(stderr, "[record-bench] failed: {}", e.what());
+        return EXIT_FAILURE;
+    }
+
+    auto per_frame = [](const ParallelRecorder::Stats& stats)
+    {
+        return stats.frames ? stats.record_ms / stats.frames : 0.0;
+    };
+    const double baseline = per_frame(results.front().second);
+
+    fmt::println("[record-bench] {} draws, {} frames per run", draws, k_frames);
+    fmt::println("{:<10}{:>14}{:>14}{:>10}", "threads", "record(ms)", "secondaries", "speedup");
+    for (const auto& [threads, stats] : results)
+    {
+        const double ms = per_frame(stats);
+        const uint64_t secondaries = stats.frames ? stats.secondaries / stats.frames : 0;
+        fmt::println("{:<10}{:>14.3f}{:>14}{:>9.2f}x", threads, ms, secondaries, ms > 0 ? baseline / ms : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
+
+int HelloTriangleApplication::run_render_path_bench(int frames)
+{
+    struct Result
+    {
+        const char* path;
+        double steady_avg_ms;
+        double steady_p95_ms;
+        double resize_avg_ms;
+        double resize_p95_ms;
+        uint32_t recreations;
+        RenderGraph::Stats graph;
+    };
+
+    auto summarize = [](std::vector<double>& samples)
+    {
+        const double average = samples.empty()
+                                   ? 0.0
+                                   : std::ranges::fold_left(samples, 0.0, std::plus{}) / samples.size();
+        return std::pair{average, samples.empty() ? 0.0 : StartupProfiler::percentile(samples, 95)};
+    };
+
+    std::vector<Result> results;
+    for (const bool dynamic_rendering : {true, false})
+    {
+        try
+        {
+            HelloTriangleApplication app;
+            app.set_dynamic_rendering(dynamic_rendering);
+            app.startup();
+            if (dynamic_rendering && !app.dynamic_rendering_)
+            {
+                fmt::println("[render-path-bench] VK_KHR_dynamic_rendering not supported, skipped");
+                vkDeviceWaitIdle(app.device_);
+                app.cleanup();
+                continue;
+            }
+
+            auto timed_frame = [&app](std::vector<double>& samples)
+            {
+                const auto begin = std::chrono::steady_clock::now();
+                app.draw_frame();
+                samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin)
+                    .count());
+            };
+
+            std::vector<double> steady_ms;
+            for (int i = 0; i < frames; ++i)
+            {
+                glfwPollEvents();
+                timed_frame(steady_ms);
+            }
+
+            // 与 resize-bench 相同的尺寸变化, 每次重建交换链渲染流程路径都要为新的图像视图重新创建帧缓冲
+            std::vector<double> resize_ms;
+            const uint32_t recreations = app.swap_chain_recreations_;
+            for (int i = 0; i < frames; ++i)
+            {
+                const int step = i % 32 < 16 ? i % 16 : 16 - i % 16;
+                glfwSetWindowSize(app.window_, static_cast<int>(WIDTH / 2 + WIDTH / 32 * step),
+                                  static_cast<int>(HEIGHT / 2 + HEIGHT / 32 * step));
+                glfwPollEvents();
+                timed_frame(resize_ms);
+            }
+
+            const auto [steady_avg, steady_p95] = summarize(steady_ms);
+            const auto [resize_avg, resize_p95] = summarize(resize_ms);
+            results.push_back({
+                dynamic_rendering ? "dynamic" : "render pass", steady_avg, steady_p95, resize_avg, resize_p95,
+                app.swap_chain_recreations_ - recreations, app.render_graph_.stats()
+            });
+
+            vkDeviceWaitIdle(app.device_);
+            app.cleanup();
+        }
+        catch (const std::exception& e)
+        {
+            fmt::println(stderr, "[render-path-bench] failed: {}", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    fmt::println("[render-path-bench] {} steady frames and {} resize frames per path", frames, frames);
+    fmt::println("{:<14}{:>12}{:>12}{:>12}{:>12}{:>14}{:>14}{:>14}", "path", "steady(ms)", "p95", "resize(ms)",
+                 "p95", "recreations", "render passes", "framebuffers");
+    for (const auto& result : results)
+    {
+        fmt::println("{:<14}{:>12.3f}{:>12.3f}{:>12.3f}{:>12.3f}{:>14}{:>14}{:>14}", result.path,
+                     result.steady_avg_ms, result.steady_p95_ms, result.resize_avg_ms, result.resize_p95_ms,
+                     result.recreations, result.graph.render_pass_objects, result.graph.framebuffer_objects);
+    }
+    return EXIT_SUCCESS;
+}
+
+int HelloTriangleApplication::run_gpu_driven_bench(int frames)
+{
+    struct Result
+    {
+        uint32_t objects;
+        bool gpu_driven;
+        double record_ms;
+        double cpu_ms;
+        double cpu_p95_ms;
+    };
+
+    constexpr std::array<uint32_t, 5> k_object_counts{1000, 4000, 16000, 32000, 64000};
+    std::vector<Result> results;
+    for (const bool gpu_driven : {false, true})
+    {
+        try
+        {
+            HelloTriangleApplication app;
+            app.set_gpu_driven(gpu_driven);
+            app.startup();
+            if (gpu_driven && !app.gpu_driven_)
+            {
+                fmt::println("[gpu-driven-bench] GPU driven path unavailable, skipped");
+                vkDeviceWaitIdle(app.device_);
+                app.cleanup();
+                continue;
+            }
+
+            for (const auto objects : k_object_counts)
+            {
+                app.scene_draw_count_ = objects;
+                for (int i = 0; i < frames; ++i)
+                {
+                    // 模拟每帧都在变化的绘制列表: 缓存的命令缓冲全部失效, 每帧都要重新录制场景
+                    ++app.scene_version_;
+                    glfwPollEvents();
+                    app.draw_frame();
+                }
+
+                auto samples = app.frame_stats_.snapshot();
+                if (samples.size() > static_cast<size_t>(frames))
+                    samples.erase(samples.begin(), samples.end() - frames);
+                std::vector<double> record_ms, cpu_ms;
+                for (const auto& sample : samples)
+                {
+                    record_ms.push_back(sample[FrameStats::Timing::Record]);
+                    cpu_ms.push_back(sample[FrameStats::Timing::Cpu]);
+                }
+                const auto average = [](const std::vector<double>& values)
+                {
+                    return values.empty() ? 0.0 : std::ranges::fold_left(values, 0.0, std::plus{}) / values.size();
+                };
+                results.push_back({
+                    objects, gpu_driven, average(record_ms), average(cpu_ms),
+                    cpu_ms.empty() ? 0.0 : StartupProfiler::percentile(cpu_ms, 95)
+                });
+            }
+
+            vkDeviceWaitIdle(app.device_);
+            app.cleanup();
+        }
+        catch (const std::exception& e)
+        {
+            fmt::println(stderr, "[gpu-driven-bench] failed: {}", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    fmt::println("[gpu-driven-bench] {} frames per object count, scene re-recorded every frame", frames);
+    fmt::println("{:<10}{:<12}{:>12}{:>12}{:>12}{:>10}", "objects", "path", "record(ms)", "cpu(ms)", "p95",
+                 "draws");
+    for (const auto& result : results)
+    {
+        // 逐个绘制时每个物体一条 vkCmdDraw, GPU 驱动时每个材质一条 vkCmdDrawIndexedIndirectCount
+        fmt::println("{:<10}{:<12}{:>12.3f}{:>12.3f}{:>12.3f}{:>10}", result.objects,
+                     result.gpu_driven ? "gpu driven" : "per draw", result.record_ms, result.cpu_ms,
+                     result.cpu_p95_ms, result.gpu_driven ? k_material_count : result.objects);
+    }
+    return EXIT_SUCCESS;
+}
+
+int HelloTriangleApplication::run_occlusion_bench(int frames)
+{
+    struct Result
+    {
+        uint32_t objects;
+        bool occlusion;
+        double drawn;
+        double frustum_culled;
+        double occlusion_culled;
+        double gpu_ms; // 剔除, 金字塔和场景 pass 的 GPU 耗时之和
+        uint64_t vertex_invocations;
+        uint64_t fragment_invocations;
+    };
+
+    // 8 层叠放, 只有最前面一层可见
+    constexpr uint32_t k_layers = 8;
+    constexpr std::array<uint32_t, 3> k_object_counts{8000, 32000, 64000};
+    std::vector<Result> results;
+    for (const bool occlusion : {false, true})
+    {
+        try
+        {
+            HelloTriangleApplication app;
+            app.set_occlusion_culling(occlusion);
+            app.set_scene_layers(k_layers);
+            app.startup();
+            if (!app.gpu_driven_)
+            {
+                fmt::println("[occlusion-bench] GPU driven path unavailable");
+                vkDeviceWaitIdle(app.device_);
+                app.cleanup();
+                return EXIT_FAILURE;
+            }
+
+            for (const auto objects : k_object_counts)
+            {
+                app.scene_draw_count_ = objects;
+                ++app.scene_version_;
+                const auto before = app.gpu_culling_.stats();
+                for (int i = 0; i < frames; ++i)
+                {
+                    glfwPollEvents();
+                    app.draw_frame();
+                }
+                const auto after = app.gpu_culling_.stats();
+
+                Result result{objects, occlusion};
+                if (const auto counted = static_cast<double>(after.frames - before.frames); counted > 0)
+                {
+                    result.drawn = (after.drawn_early + after.drawn_late - before.drawn_early - before.drawn_late)
+                        / counted;
+                    result.frustum_culled = (after.frustum_culled - before.frustum_culled) / counted;
+                    result.occlusion_culled = (after.occlusion_culled - before.occlusion_culled) / counted;
+                }
+                for (const auto& timing : app.gpu_profiler_.timings())
+                {
+                    if (timing.name == "main_pass")
+                        continue;
+                    result.gpu_ms += timing.avg_ms;
+                    if (timing.statistics)
+                    {
+                        result.vertex_invocations += timing.statistics->vertex_invocations;
+                        result.fragment_invocations += timing.statistics->fragment_invocations;
+                    }
+                }
+                results.push_back(result);
+            }
+
+            vkDeviceWaitIdle(app.device_);
+            app.cleanup();
+        }
+        catch (const std::exception& e)
+        {
+            fmt::println(stderr, "[occlusion-bench] failed: {}", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    fmt::println("[occlusion-bench] {} frames per object count, {} layers, per frame averages", frames, k_layers);
+    fmt::println("{:<10}{:<11}{:>10}{:>10}{:>10}{:>10}{:>12}{:>14}", "objects", "culling", "drawn", "occluded",
+                 "frustum", "gpu(ms)", "vs inv", "fs inv");
+    for (const auto& result : results)
+    {
+        // 管线统计是最后一帧的两个场景 pass 之和, 不支持时为 0
+        fmt::println("{:<10}{:<11}{:>10.0f}{:>10.0f}{:>10.0f}{:>10.3f}{:>12}{:>14}", result.objects,
+                     result.occlusion ? "occlusion" : "frustum", result.drawn, result.occlusion_culled,
+                     result.frustum_culled, result.gpu_ms, result.vertex_invocations,
+                     result.fragment_invocations);
+    }
+    return EXIT_SUCCESS;
+}
+
+int HelloTriangleApplication::run_bvh_bench(int objects)
+{
+    constexpr int k_queries = 200;
+    constexpr int k_refits = 20;
+    // 增量 refit 每次移动 1 / k_moved_stride 的物体
+    constexpr uint32_t k_moved_stride = 100;
+
+    struct Result
+    {
+        uint32_t objects;
+        std::string method;
+        double cull_ms;
+        double visible;
+    };
+
+    // 与 update_frame_data 相同的单层网格, 包围盒与 cull_constants 的包围圆一致; 物体绕格子中心小幅摆动
+    float bounding_radius = 0;
+    for (const auto& vertex : vertices)
+    {
+        bounding_radius = std::max(bounding_radius, glm::length(vertex.pos));
+    }
+    const float aspect = static_cast<float>(WIDTH) / static_cast<float>(HEIGHT);
+    constexpr float k_min_cell = 2.0f / 128;
+    auto place = [&](uint32_t columns, float cell, uint32_t object, float time) -> SceneBvh::Aabb
+    {
+        const float sway = cell * 0.25f * std::sin(time + static_cast<float>(object) * 0.37f);
+        const float x = -1.0f + cell * (static_cast<float>(object % columns) + 0.5f) + sway;
+        const float y = -1.0f + cell * (static_cast<float>(object / columns) + 0.5f);
+        const float extent_y = cell * 0.5f * bounding_radius;
+        const float extent_x = extent_y / aspect;
+        return {x - extent_x, y - extent_y, x + extent_x, y + extent_y};
+    };
+
+    std::vector<SceneBvh::Simd> simd_levels;
+    for (const auto simd : {SceneBvh::Simd::Scalar, SceneBvh::Simd::Sse, SceneBvh::Simd::Avx2})
+    {
+        if (simd <= best_simd_level())
+            simd_levels.push_back(simd);
+    }
+    const uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+    TaskPool pool;
+    pool.init(threads);
+
+    const auto base = static_cast<uint32_t>(std::max(objects, 1));
+    std::vector<Result> results;
+    for (const uint32_t count : {base, base * 4, base * 10})
+    {
+        const auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        const float cell = std::max(2.0f / static_cast<float>(columns), k_min_cell);
+        std::vector<SceneBvh::Aabb> bounds(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            bounds[i] = place(columns, cell, i, 0.0f);
+        }
+
+        SceneBvh bvh;
+        bvh.build(bounds);
+        const float built_cost = bvh.sah_cost();
+
+        // 所有物体都移动时整体 refit, 然后每次只移动 1 / k_moved_stride 的物体做增量 refit
+        for (int i = 0; i < k_refits; ++i)
+        {
+            for (uint32_t object = 0; object < count; ++object)
+            {
+                bounds[object] = place(columns, cell, object, static_cast<float>(i + 1) * 0.1f);
+            }
+            bvh.refit(bounds);
+        }
+        const auto full = bvh.stats();
+        std::vector<uint32_t> moved;
+        for (int i = 0; i < k_refits; ++i)
+        {
+            moved.clear();
+            const float time = static_cast<float>(k_refits + i + 1) * 0.1f;
+            for (auto object = static_cast<uint32_t>(i) % k_moved_stride; object < count; object += k_moved_stride)
+            {
+                bounds[object] = place(columns, cell, object, time);
+                moved.push_back(object);
+            }
+            bvh.refit(bounds, moved);
+        }
+        const auto incremental = bvh.stats();
+        fmt::println("[bvh-bench] {} objects: {} nodes, {} leaves, depth {}; build {:.2f} ms, full refit {:.3f} ms, "
+                     "refit of {} moved {:.3f} ms, sah cost {:.2f} -> {:.2f}",
+                     count, full.nodes, full.leaves, full.max_depth, full.build_ms, full.refit_ms / k_refits,
+                     moved.size(), (incremental.refit_ms - full.refit_ms) / k_refits, built_cost, bvh.sah_cost());
+
+        // 视锥沿网格的对角线来回平移, 每种方法使用同样的序列
+        const float span = std::max(static_cast<float>(columns) * cell - 2.0f, 0.0f);
+        auto planes_at = [&](int query)
+        {
+            const float pan = span * 0.5f * (1.0f - std::cos(static_cast<float>(query) * 6.2831853f / k_queries));
+            auto planes = GpuCulling::clip_planes();
+            for (auto& plane : planes)
+            {
+                plane[3] -= (plane[0] + plane[1]) * pan;
+            }
+            return planes;
+        };
+
+        std::vector<uint32_t> visible;
+        visible.reserve(count);
+        uint64_t expected = 0;
+        auto measure = [&](std::string method, auto&& cull)
+        {
+            uint64_t total = 0;
+            double ms = 0;
+            for (int query = 0; query < k_queries; ++query)
+            {
+                const auto planes = planes_at(query);
+                visible.clear();
+                const auto begin = std::chrono::steady_clock::now();
+                cull(planes);
+                ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+                total += visible.size();
+            }
+            if (results.empty() || results.back().objects != count)
+                expected = total;
+            else if (total != expected)
+                throw std::runtime_error(fmt::format("{} found {} visible objects, expected {}", method, total,
+                                                     expected));
+            results.push_back({count, std::move(method), ms / k_queries,
+                               static_cast<double>(total) / k_queries});
+        };
+
+        try
+        {
+            measure("linear", [&](const SceneBvh::Planes& planes)
+            {
+                SceneBvh::cull_linear(bounds, planes, visible);
+            });
+            for (const auto simd : simd_levels)
+            {
+                bvh.set_simd(simd);
+                measure(fmt::format("bvh {}", magic_enum::enum_name(simd)), [&](const SceneBvh::Planes& planes)
+                {
+                    bvh.cull(planes, visible);
+                });
+            }
+            measure(fmt::format("bvh {} x{}", magic_enum::enum_name(bvh.simd()), threads),
+                    [&](const SceneBvh::Planes& planes)
+                    {
+                        bvh.cull(planes, pool, visible);
+                    });
+        }
+        catch (const std::exception& e)
+        {
+            fmt::println(stderr, "[bvh-bench] failed: {}", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    fmt::println("[bvh-bench] {} queries per method, frustum panning across the grid", k_queries);
+    fmt::println("{:<10}{:<16}{:>12}{:>14}{:>10}{:>10}", "objects", "method", "cull(ms)", "objects/ms", "visible",
+                 "speedup");
+    double baseline = 0;
+    for (const auto& result : results)
+    {
+        if (result.method == "linear")
+            baseline = result.cull_ms;
+        fmt::println("{:<10}{:<16}{:>12.4f}{:>14.0f}{:>10.0f}{:>9.2f}x", result.objects, result.method,
+                     result.cull_ms, result.cull_ms > 0 ? result.objects / result.cull_ms : 0.0, result.visible,
+                     result.cull_ms > 0 ? baseline / result.cull_ms : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
+
+int HelloTriangleApplication::run_transform_bench(int entities)
+{
+    constexpr int k_updates = 50;
+    constexpr uint32_t k_roots = 8;
+    constexpr double k_frame_budget_ms = 1000.0 / 60.0;
+
+    struct Result
+    {
+        SimdLevel simd;
+        uint32_t threads;
+        double mean_ms;
+        double min_ms;
+    };
+
+    // 与 rebuild_transforms 相同的两层结构: 根携带深度并且自身也旋转, 孩子排成网格, 初相对 2pi 取余
+    const auto count = std::max(static_cast<uint32_t>(std::max(entities, 0)), k_roots + 1);
+    const uint32_t children = count - k_roots;
+    const auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(children))));
+    const float cell = 2.0f / static_cast<float>(columns);
+    TransformStore store;
+    store.reserve(count);
+    for (uint32_t root = 0; root < k_roots; ++root)
+    {
+        store.create();
+        store.set_position(root, 0.0f, 0.0f, static_cast<float>(root + 1) / static_cast<float>(k_roots + 1));
+        store.set_rotation(root, static_cast<float>(root) * 0.1f);
+    }
+    std::vector<float> phases(children);
+    for (uint32_t i = 0; i < children; ++i)
+    {
+        const uint32_t entity = store.create(static_cast<uint32_t>(uint64_t{i} * k_roots / children));
+        store.set_position(entity, -1.0f + cell * (static_cast<float>(i % columns) + 0.5f),
+                           -1.0f + cell * (static_cast<float>(i / columns) + 0.5f), 0.0f);
+        store.set_scale(entity, cell * 0.5f, cell * 0.25f);
+        phases[i] = static_cast<float>(std::fmod(i * 0.37, 2 * std::numbers::pi));
+    }
+
+    std::vector<SimdLevel> simd_levels;
+    for (const auto simd : {SimdLevel::Scalar, SimdLevel::Sse, SimdLevel::Avx2})
+    {
+        if (simd <= best_simd_level())
+            simd_levels.push_back(simd);
+    }
+    const uint32_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> thread_counts;
+    for (uint32_t threads = 1; threads < max_threads; threads *= 2)
+    {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    // 应用中 out 是 frame_data_ 的批次, 这里是普通内存; 每种配置跑同样的旋转序列, 最后一次的结果必须逐位一致
+    std::vector<ObjectData> out(children);
+    std::vector<ObjectData> expected;
+    std::vector<Result> results;
+    TaskPool pool;
+    try
+    {
+        for (const auto threads : thread_counts)
+        {
+            pool.destroy();
+            pool.init(threads);
+            for (const auto simd : simd_levels)
+            {
+                store.set_simd(simd);
+                const auto rotation = store.rotation().subspan(k_roots);
+                double total_ms = 0;
+                double min_ms = std::numeric_limits<double>::max();
+                // 第 0 次预热, 不计时
+                for (int update = 0; update <= k_updates; ++update)
+                {
+                    const auto spin = static_cast<float>(std::fmod(update * 0.05, 2 * std::numbers::pi));
+                    for (uint32_t i = 0; i < children; ++i)
+                    {
+                        rotation[i] = phases[i] + spin;
+                    }
+                    store.update(pool, out, k_roots);
+                    if (update > 0)
+                    {
+                        total_ms += store.stats().last_update_ms;
+                        min_ms = std::min(min_ms, store.stats().last_update_ms);
+                    }
+                }
+                if (expected.empty())
+                    expected = out;
+                else if (std::memcmp(out.data(), expected.data(), out.size() * sizeof(ObjectData)) != 0)
+                    throw std::runtime_error(fmt::format("{} x{} differs from the first configuration",
+                                                         magic_enum::enum_name(simd), threads));
+                results.push_back({simd, threads, total_ms / k_updates, min_ms});
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fmt::println(stderr, "[transform-bench] failed: {}", e.what());
+        return EXIT_FAILURE;
+    }
+
+    fmt::println("[transform-bench] {} entities ({} roots, {} levels), {} updates per configuration, "
+                 "{} bytes written per entity, frame budget {:.2f} ms", count, k_roots, store.level_count(),
+                 k_updates, sizeof(ObjectData), k_frame_budget_ms);
+    fmt::println("{:<8}{:>8}{:>12}{:>12}{:>14}{:>10}{:>10}", "simd", "threads", "mean(ms)", "min(ms)",
+                 "entities/ms", "budget", "speedup");
+    const double baseline = results.front().mean_ms;
+    for (const auto& result : results)
+    {
+        fmt::println("{:<8}{:>8}{:>12.3f}{:>12.3f}{:>14.0f}{:>9.1f}%{:>9.2f}x", magic_enum::enum_name(result.simd),
+                     result.threads, result.mean_ms, result.min_ms,
+                     result.mean_ms > 0 ? count / result.mean_ms : 0.0, result.mean_ms / k_frame_budget_ms * 100,
+                     result.mean_ms > 0 ? baseline / result.mean_ms : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
@@ -20,8 +20,10 @@
 #include <format>
 //#include <print>
 #include <chrono>
+#include <filesystem>
 #include <map>
 #include <ranges>
+#include <span>
 #include <range/v3/all.hpp>
 #include <unordered_set>
 #include <fmt/printf.h>
@@ -30,6 +32,25 @@
 #include <glm/glm.hpp>
 
 #include "HelloTriangleApplication.h"
+#include "BindlessHeap.h"
+#include "CommandBufferCache.h"
+#include "DeletionQueue.h"
+#include "FrameAllocator.h"
+#include "FrameDataBatch.h"
+#include "FramePacer.h"
+#include "FrameStats.h"
+#include "GpuAllocator.h"
+#include "GpuCulling.h"
+#include "GpuProfiler.h"
+#include "ParallelRecorder.h"
+#include "PipelineCache.h"
+#include "RedrawScheduler.h"
+#include "RenderGraph.h"
+#include "SceneBvh.h"
+#include "StartupProfiler.h"
+#include "TaskPool.h"
+#include "TransformStore.h"
+#include "UploadManager.h"
 
 
 constexpr uint32_t WIDTH = 800;
@@ -41,6 +62,24 @@ constexpr std::array<const char*, 1> k_vulkan_validation_layers = {
 const std::vector k_device_extensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 };
+// 可选扩展, 设备支持时才启用
+const std::vector k_optional_device_extensions = {
+    VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME,
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    // 需要下面两个实例扩展和 swapchainMaintenance1 特性
+    VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME,
+    // 两者的特性都可用时才启用, 用于测量和限制呈现延迟
+    VK_KHR_PRESENT_ID_EXTENSION_NAME,
+    VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+    // render graph 用 vkCmdPipelineBarrier2 批量录制屏障
+    VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+    // 直接渲染到图像视图, 不需要渲染流程和帧缓冲 (1.3 核心); 依赖的 create_renderpass2 / depth_stencil_resolve 在 1.2 核心中
+    VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+};
+const std::vector k_optional_instance_extensions = {
+    VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME,
+    VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME,
+};
 #ifdef NODEBUG
 constexpr bool k_enable_validation_layers = false;
 #else
@@ -87,6 +126,20 @@ namespace vk_pred
     {
         return queue_family_properties.queueFlags & VK_QUEUE_GRAPHICS_BIT;
     }
+
+    // 只有传输能力的队列族, 通常对应独立的 DMA 引擎
+    inline bool is_vk_queue_transfer_only(int index, const VkQueueFamilyProperties& queue_family_properties)
+    {
+        constexpr VkQueueFlags mask = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+        return (queue_family_properties.queueFlags & mask) == VK_QUEUE_TRANSFER_BIT;
+    }
+
+    // 支持传输但不支持图形的队列族(包括异步计算族)
+    inline bool is_vk_queue_transfer_non_graphics(int index, const VkQueueFamilyProperties& queue_family_properties)
+    {
+        return (queue_family_properties.queueFlags & VK_QUEUE_TRANSFER_BIT)
+            && !(queue_family_properties.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+    }
 }
 
 namespace details
@@ -112,6 +165,8 @@ namespace details
 
     std::string get_project_dir();
 
+    void err_check(VkResult result, std::string_view message);
+
 
     std::vector<char> read_file(const std::string& filePath);
 }
@@ -174,20 +229,126 @@ const std::vector<uint16_t> indices = {
     0, 1, 2, 2, 3, 0
 };
 
+// 以下结构与 shader/sample_triangle.vert 中的 std140 布局一致
+// set 0 binding 0: 每帧数据, 整帧一个 dynamic offset
+struct FrameUniforms
+{
+    float time;
+    float aspect; // 宽 / 高
+    float padding[2];
+};
+
+// set 0 binding 1: 材质参数, 换材质时只换 dynamic offset
+struct MaterialUniforms
+{
+    glm::vec4 tint;
+};
+
+// set 0 binding 2: 每个物体的世界变换, 一次绑定最多 objects_per_bind_ 个, 由 TransformStore 直接写进批次.
+// 大小是 32 字节, std140 的数组步长和 GpuCulling 的 std430 布局都与它一致
+using ObjectData = TransformStore::GpuTransform;
+
+// 每次绘制的 push constant: 物体在当前绑定的 ObjectData 数组中的下标 (GPU 驱动路径是这一帧的 object_base),
+// 以及片段着色器采样的纹理和采样器在 bindless 堆中的下标, 这两项整个命令缓冲不变
+struct DrawConstants
+{
+    uint32_t object;
+    uint32_t texture;
+    uint32_t sampler;
+};
+
+constexpr uint32_t k_material_count = 4;
+// shader 中 ObjectData 数组的长度 (64KiB)
+constexpr uint32_t k_max_objects_per_bind = 2048;
+// GPU 驱动路径一次最多剔除和绘制的物体数
+constexpr uint32_t k_max_gpu_objects = 65536;
+
 constexpr int MAX_FRAMES_IN_FLIGHT = 3;
 
 class HelloTriangleApplication
 {
 public:
+    // 运行时切换呈现模式, 下一帧重建交换链; 不支持时退回 MAILBOX / FIFO
+    void set_present_mode(VkPresentModeKHR present_mode)
+    {
+        requested_present_mode_ = present_mode;
+        if (swap_chain_ != VK_NULL_HANDLE)
+            framebuffer_resized_ = true;
+        redraw_.invalidate();
+    }
+
+    // 0 表示不限制帧率
+    void set_frame_cap(double fps) { frame_pacer_.set_frame_cap(fps); }
+
+    // true (默认) 时场景没有变化就阻塞等待事件, false 时每轮都重绘
+    void set_event_driven(bool event_driven) { redraw_.set_event_driven(event_driven); }
+
+    // 在 run 之前调用; false 时即使设备支持也不启用 VK_KHR_dynamic_rendering, 使用渲染流程
+    void set_dynamic_rendering(bool dynamic_rendering) { prefer_dynamic_rendering_ = dynamic_rendering; }
+
+    // 在 run 之前调用; false 时即使设备支持也逐个物体录制绘制, 不使用 GPU 剔除和间接绘制
+    void set_gpu_driven(bool gpu_driven) { prefer_gpu_driven_ = gpu_driven; }
+
+    // 在 run 之前调用; false 时 GPU 驱动路径只做视锥剔除, 不做两阶段的 Hi-Z 遮挡剔除
+    void set_occlusion_culling(bool occlusion_culling) { prefer_occlusion_culling_ = occlusion_culling; }
+
+    // 物体分成 layers 层前后叠放, 最前面一层放大到盖住后面各层; 1 (默认) 时所有物体在同一深度
+    void set_scene_layers(uint32_t layers) { scene_layers_ = std::max(layers, 1u); }
+
+    // 大于 0 时逐个绘制的场景每帧用 threads 个线程 (包括主线程) 录制, 不再使用命令缓冲缓存; 0 (默认) 时不启用
+    void set_record_threads(uint32_t threads) { record_threads_ = threads; }
+
     void run()
     {
-        init_window();
-        init_vulkan();
+        startup();
         main_loop();
         cleanup();
     }
 
+    // 反复执行 init/cleanup, 输出每个初始化阶段的 min/median/p95
+    static int run_startup_bench(int iterations, bool parallel_init = true);
+
+    // 每帧改变窗口大小, 统计交换链反复重建期间的帧耗时(重点是最差帧)
+    static int run_resize_bench(int frames);
+
+    // 场景放大到 draws 个绘制, 分别用 1, 2, 4 ... 个线程录制, 输出每帧录制耗时和加速比
+    static int run_record_bench(int draws);
+
+    // 分别用动态渲染和渲染流程绘制 frames 帧, 再改变窗口大小 frames 帧, 比较帧耗时和创建的渲染流程/帧缓冲数
+    static int run_render_path_bench(int frames);
+
+    // 物体数逐级增加, 分别用逐个绘制和 GPU 剔除 + 间接绘制各跑 frames 帧 (每帧都重新录制), 比较 CPU 耗时
+    static int run_gpu_driven_bench(int frames);
+
+    // 多层叠放的密集场景, 分别只做视锥剔除和加上遮挡剔除各跑 frames 帧, 比较绘制的物体数和管线统计
+    static int run_occlusion_bench(int frames);
+
+    // 不创建窗口: 网格场景放大到 objects, 4 倍和 10 倍个物体, 比较逐个测试和 BVH (各指令集, 单线程和多线程)
+    // 的 CPU 视锥剔除吞吐 (物体数/ms), 以及 BVH 的构建和 refit 耗时
+    static int run_bvh_bench(int objects);
+
+    // 不创建窗口: 两层的场景 (8 个根, 其余是它们的孩子) 共 entities 个实体, 分别用各指令集和 1, 2, 4 ... 个线程
+    // 更新世界变换, 输出每次更新的耗时和占 60Hz 帧预算的比例
+    static int run_transform_bench(int entities);
+
 private:
+    void startup()
+    {
+        startup_profiler_.begin_session();
+        {
+            auto phase = startup_profiler_.scope("init_window");
+            init_window();
+        }
+        init_vulkan();
+        {
+            auto phase = startup_profiler_.scope("first_frame");
+            draw_frame();
+        }
+
+        startup_profiler_.export_chrome_trace(std::filesystem::current_path() / "startup_trace.json");
+        fmt::println("{}", startup_profiler_.summary());
+    }
+
     static bool check_validation_layer_support(std::span<const char* const> layers);
 
     static bool check_device_extensions_support(VkPhysicalDevice device,
@@ -195,6 +356,11 @@ private:
 
     void create_logical_device();
 
+    bool is_device_extension_enabled(std::string_view extension) const
+    {
+        return enabled_device_extensions_.contains(extension);
+    }
+
     struct SwapChainSupportDetails
     {
         VkSurfaceCapabilitiesKHR capabilities;
@@ -219,12 +385,14 @@ private:
     {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        // 没有专用族时回退到 graphicsFamily
+        std::optional<uint32_t> transferFamily;
+        // 不单独选计算族: GPU 剔除和 Hi-Z 的计算 pass 夹在同一帧的两个场景 pass 之间 (后期剔除读这一帧的深度),
+        // 放到异步计算队列上每帧要多两次跨族的所有权转移和信号量交接, 所以都录制在图形队列上
     };
 
     QueueFamilyIndices find_queue_families_index(VkPhysicalDevice device);
 
-    uint32_t find_memory_type(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-
     int rate_device_suitability(VkPhysicalDevice device);
 
     void pick_physical_device();
@@ -247,6 +415,7 @@ private:
         const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
         void* pUserData);
 
+    // 包含设备支持的 k_optional_instance_extensions
     static std::vector<const char*> get_required_extensions();
 
 
@@ -254,9 +423,15 @@ private:
 
     void create_instance();
 
+    void choose_surface_format();
+
+    // 支持作为深度附件并且可以采样的格式 (遮挡剔除从它构建 Hi-Z 金字塔)
+    void choose_depth_format();
+
     static VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 
-    static VkPresentModeKHR choose_swap_present_mode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+    static VkPresentModeKHR choose_swap_present_mode(const std::vector<VkPresentModeKHR>& availablePresentModes,
+                                                     VkPresentModeKHR preferred);
 
     VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities);
 
@@ -274,20 +449,92 @@ private:
         {
             fmt::println("[glfw]error {}, {}", error_code, description);
         });
+        glfwSetKeyCallback(window_, [](GLFWwindow* window, int key, int scancode, int action, int mods)
+        {
+            const auto app = static_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+            if (action != GLFW_PRESS)
+                return;
+            app->redraw_.invalidate();
+            // F1 - F4 切换呈现模式, F5 循环切换帧率上限, F6 暂停/继续动画, F12 导出帧耗时
+            switch (key)
+            {
+            case GLFW_KEY_F1:
+                app->set_present_mode(VK_PRESENT_MODE_FIFO_KHR);
+                break;
+            case GLFW_KEY_F2:
+                app->set_present_mode(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+                break;
+            case GLFW_KEY_F3:
+                app->set_present_mode(VK_PRESENT_MODE_MAILBOX_KHR);
+                break;
+            case GLFW_KEY_F4:
+                app->set_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR);
+                break;
+            case GLFW_KEY_F5:
+                {
+                    constexpr std::array caps{0.0, 30.0, 60.0, 120.0, 144.0};
+                    const auto it = std::ranges::find(caps, app->frame_pacer_.frame_cap());
+                    const auto next = it == caps.end() || it + 1 == caps.end() ? caps.begin() : it + 1;
+                    app->set_frame_cap(*next);
+                    fmt::println("[frame pacer] frame cap {}", *next);
+                    break;
+                }
+            case GLFW_KEY_F6:
+                app->animate_ = !app->animate_;
+                break;
+            case GLFW_KEY_F12:
+                app->dump_frame_stats_ = true;
+                break;
+            default:
+                break;
+            }
+        });
         glfwSetFramebufferSizeCallback(window_, [](GLFWwindow* window, int width, int height)
         {
             const auto app = static_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
             app->framebuffer_resized_ = true;
+            app->redraw_.invalidate();
+        });
+        // 窗口被遮挡后重新露出等情况, 内容需要重绘
+        glfwSetWindowRefreshCallback(window_, [](GLFWwindow* window)
+        {
+            const auto app = static_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+            app->redraw_.invalidate();
         });
     };
 
     void create_vertex_buffer();
     void create_index_buffer();
 
-    void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer,
-                       VkDeviceMemory& buffer_memory);
+    void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, const GpuAllocator::MemoryUsage& memory_usage,
+                       VkBuffer& buffer, GpuAllocation& allocation);
 
-    void copy_buffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size);
+    void create_pipeline_cache();
+
+    void create_allocator();
+
+    void create_upload_manager();
+
+    void create_frame_allocator();
+
+    void create_task_pool();
+
+    void create_gpu_profiler();
+
+    // 设备支持 descriptor indexing 时创建, 管线布局的 set 1
+    void create_bindless_heap();
+
+    // 管线布局的 set 0: 指向 frame_allocator_ 的三个 dynamic uniform buffer
+    void create_frame_data_set();
+
+    // 设备支持 drawIndirectCount 并且剔除着色器存在时创建, 之后 gpu_driven_ 为 true
+    void create_gpu_culling();
+
+    // bindless 堆存在时上传一张棋盘格纹理, 和采样器一起登记进堆, 片段着色器按 DrawConstants 中的下标采样
+    void create_texture();
+
+    // 顶点, 索引和纹理数据合并成一个批次提交
+    void flush_uploads();
 
     void create_surface()
     {
@@ -302,63 +549,107 @@ private:
     void create_image_view();
 
 
+    void load_shader_code();
+
+    void create_shader_modules();
+
     void create_graphics_pipeline();
 
     VkShaderModule create_shader_module(std::span<char> code);
 
+    // 只用于创建管线和次级命令缓冲的继承信息, 每帧实际使用的渲染流程由 render_graph_ 创建, 两者兼容;
+    // 动态渲染时不创建, 管线和继承信息只依赖附件格式
     void create_render_pass();
 
-    void create_framebuffers();
+    void create_render_graph();
 
-    void create_command_pool();
+    // 交换链 (重新) 创建后重新声明并编译帧渲染图
+    void build_render_graph();
 
-    void create_command_buffer();
+    void create_command_buffer_cache();
 
-    void record_command_buffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void create_parallel_recorder();
+
+    // 主命令缓冲: 执行帧渲染图, 场景 pass 执行 scene 中的次级命令缓冲,
+    // 遮挡剔除时 Late 阶段的场景 pass 执行 late_scene 中的
+    void record_command_buffer(VkCommandBuffer commandBuffer, uint32_t imageIndex,
+                               std::span<const VkCommandBuffer> scene,
+                               std::span<const VkCommandBuffer> late_scene = {});
+
+    // 场景的次级命令缓冲, 只依赖 scene_version_ 覆盖的状态; 遮挡剔除时是 Early 阶段
+    void record_scene(VkCommandBuffer commandBuffer);
+
+    // 录制场景绘制列表中的 [begin, end), 可以在任意线程上调用
+    void record_scene_slice(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) const;
+
+    // GPU 驱动路径的场景: 每个材质一次间接绘制, 命令数与物体数无关; phase 选择 draw 缓冲中的区域
+    void record_scene_indirect(VkCommandBuffer commandBuffer, GpuCulling::Phase phase);
+
+    // 这一帧剔除和间接绘制共用的参数, 录制时从 frame_data_ 和交换链尺寸得出
+    GpuCulling::Constants cull_constants() const;
+
+    // 每帧多线程重新录制场景, 不经过 command_buffer_cache_
+    VkCommandBuffer record_parallel(uint32_t imageIndex, const VkCommandBufferInheritanceInfo& inheritance);
 
     void create_sync_object();
 
-    void cleanup_swap_chain() const;
+    // 图像视图交给 deletion_queue_, 在最后一次使用它们的帧完成后销毁
+    void retire_swap_chain_views();
+
+    void cleanup_swap_chain();
+
+    void create_render_finished_semaphores();
+
+    // 旧交换链及其 render finished 信号量在呈现结束后才能销毁:
+    // 有 VK_EXT_swapchain_maintenance1 时等待它的所有呈现 fence, 否则等待之后 MAX_FRAMES_IN_FLIGHT 帧完成
+    void retire_swap_chain(VkSwapchainKHR swap_chain, std::vector<VkSemaphore> semaphores);
+
+    void collect_retired_swap_chains(bool wait);
+
+    VkFence acquire_present_fence();
 
     void recreate_swap_chain();
 
-    void init_vulkan()
-    {
-        create_instance();
-        // setup_debug_message(); //setup at create_instance
-        create_surface();
-        pick_physical_device();
-        create_logical_device();
-        create_swap_chain();
-        create_image_view();
-        create_render_pass();
-        create_graphics_pipeline();
-        create_framebuffers();
-        create_command_pool();
-        create_vertex_buffer();
-        create_command_buffer();
-        create_sync_object();
-        recreate_swap_chain();
-
-        std::cout << std::flush;
-        std::cerr << std::flush;
-    }
+    // 按依赖关系并行执行各初始化步骤, 见 InitScheduler
+    void init_vulkan();
+
+    // 打包这一帧的每帧数据, 材质和物体动画数据, 一次上传到 frame_allocator_
+    void update_frame_data();
+
+    // 按物体数, 层数和窗口比例重建 transforms_ 的层级: 每层一个根, 物体是它的孩子
+    void rebuild_transforms(uint32_t count, uint32_t layers, float aspect);
 
     void draw_frame();
 
     void main_loop()
     {
-        auto tp = std::chrono::steady_clock::now();
         while (!glfwWindowShouldClose(window_))
         {
+            // 场景没有变化时阻塞等待事件, 最小化时不 acquire/submit
+            redraw_.set_animating(animate_);
+            if (!redraw_.wait(window_))
+                continue;
+            // 跨越空闲期的帧间隔不是卡顿
+            if (redraw_.resumed_from_idle())
+                last_frame_begin_ = {};
+            // 帧率上限和呈现排队上限都在采样输入之前等待, 等待的时间不会计入延迟
+            frame_pacer_.wait_for_frame();
             glfwPollEvents();
+            frame_pacer_.input_sampled();
             draw_frame();
-            auto last_tp = std::exchange(tp, std::chrono::steady_clock::now());
-            auto cost_ms = std::chrono::duration<double>(tp - last_tp).count() * 1000;
+            redraw_.frame_drawn();
 
-            //fmt::println("frame cost: {: .4f}ms, fps: {}", cost_ms, static_cast<uint64_t>(1000 / cost_ms));
+            // F12 随时导出最近的帧耗时
+            if (std::exchange(dump_frame_stats_, false))
+            {
+                frame_stats_.write_csv(std::filesystem::current_path() / "frame_stats.csv");
+            }
         }
         vkDeviceWaitIdle(device_);
+
+        frame_stats_.print_report();
+        frame_stats_.write_csv(std::filesystem::current_path() / "frame_stats.csv");
+        redraw_.print_stats("HelloTriangleApplication");
     }
 
     void cleanup();
@@ -367,34 +658,170 @@ private:
     vk::Instance vk_instance_ = nullptr;
     VkDebugUtilsMessengerEXT debug_messenger_ = nullptr;
     VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties physical_device_properties_{};
     VkDevice device_ = nullptr;
+    std::unordered_set<std::string_view> enabled_instance_extensions_;
+    std::unordered_set<std::string_view> enabled_device_extensions_;
+    bool swapchain_maintenance1_ = false;
+    // VK_KHR_present_id 和 VK_KHR_present_wait 都已启用
+    bool present_wait_ = false;
+    // VK_KHR_synchronization2 已启用
+    bool synchronization2_ = false;
+    bool prefer_dynamic_rendering_ = true;
+    // VK_KHR_dynamic_rendering 已启用, 此时 render_pass_ 为空
+    bool dynamic_rendering_ = false;
+    // bindless 需要的 descriptor indexing 特性 (1.2 核心) 都已启用
+    bool descriptor_indexing_ = false;
+    // multiDrawIndirect, drawIndirectFirstInstance 和 drawIndirectCount (1.2 核心) 都已启用
+    bool draw_indirect_count_ = false;
+    bool prefer_gpu_driven_ = true;
+    // gpu_culling_ 已创建, 场景由剔除生成的间接绘制命令绘制
+    bool gpu_driven_ = false;
+    bool prefer_occlusion_culling_ = true;
+    // gpu_driven_ 并且每帧做两阶段的遮挡剔除
+    bool occlusion_culling_ = false;
+    // pipelineStatisticsQuery 和 inheritedQueries 都已启用
+    bool pipeline_statistics_ = false;
+    QueueFamilyIndices queue_family_indices_;
+    PipelineCache pipeline_cache_;
+    GpuAllocator allocator_;
+    UploadManager upload_manager_;
+    // 每帧更新的数据, 按 current_flight_frame_ 分区
+    FrameAllocator frame_allocator_;
+    FrameDataBatch frame_data_;
+
+    // 这一帧 frame_data_ 中各部分的位置, 录制时换算成 dynamic offset
+    struct FrameDataRefs
+    {
+        FrameDataBatch::Ref frame;
+        std::array<FrameDataBatch::Ref, k_material_count> materials;
+        FrameDataBatch::Ref objects;
+    };
+
+    FrameDataRefs frame_data_refs_;
+    VkDescriptorSetLayout frame_data_layout_{};
+    VkDescriptorPool frame_data_pool_{};
+    VkDescriptorSet frame_data_set_{};
+    // 受 maxUniformBufferRange 限制, 物体更多时每 objects_per_bind_ 个重新绑定一次
+    uint32_t objects_per_bind_ = k_max_objects_per_bind;
+    // 每个飞行帧缓存的场景次级命令缓冲录制时的 frame_data_.base(), 变化后需要重新录制
+    std::array<VkDeviceSize, MAX_FRAMES_IN_FLIGHT> scene_frame_data_bases_{};
+    GpuProfiler gpu_profiler_;
+    BindlessHeap bindless_;
+    GpuCulling gpu_culling_;
+    DeletionQueue deletion_queue_;
+    // 每次提交一帧加一, 同时也是 frame_timeline_ 在这次提交完成后的值;
+    // frame_serials_ 记录每个飞行帧最近一次提交的 serial
+    uint64_t submit_serial_ = 0;
+    uint64_t completed_serial_ = 0;
+    std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frame_serials_{};
+    // 每个飞行帧已经读过剔除统计的提交 serial; 上一轮跳过提交 (最小化或交换链过期) 时不重复累加
+    std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> culling_collected_serials_{};
+    StartupProfiler startup_profiler_;
+    bool parallel_init_ = true;
     vk::SurfaceKHR surface_{};
     VkQueue graphics_queue_ = nullptr;
     VkQueue present_queue_{};
+    // 与 graphics_queue_ 属于同一族时就是同一个 VkQueue
+    VkQueue transfer_queue_{};
     VkSwapchainKHR swap_chain_{};
     std::vector<VkImage> swap_chain_images_;
+    VkSurfaceFormatKHR surface_format_{};
     VkFormat swap_chain_image_format_{};
+    VkFormat depth_format_ = VK_FORMAT_D32_SFLOAT;
     VkExtent2D swap_chain_extent_{};
     std::vector<VkImageView> swap_chain_image_views_;
+    std::vector<char> vert_spv_;
+    std::vector<char> frag_spv_;
+    // 没有 bindless 堆时使用的片段着色器, 不采样纹理
+    std::vector<char> untextured_frag_spv_;
+    VkShaderModule vert_shader_module_{};
+    VkShaderModule frag_shader_module_{};
+    // GPU 驱动路径的剔除和顶点着色器, 没有编译时为空, 不启用该路径
+    std::vector<char> cull_spv_;
+    std::vector<char> hiz_spv_;
+    std::vector<char> indirect_vert_spv_;
     VkPipelineLayout pipeline_layout_{};
     VkRenderPass render_pass_{};
     VkPipeline graphics_pipeline_{};
-    std::vector<VkFramebuffer> swapChainFramebuffers;
-    VkCommandPool command_pool_{};
+    // set 0, 1 同 pipeline_layout_ (没有 bindless 堆时 set 1 是空布局), set 2 是 gpu_culling_ 的物体数据
+    VkPipelineLayout indirect_pipeline_layout_{};
+    VkPipeline indirect_pipeline_{};
+    RenderGraph render_graph_;
+    RenderGraph::ImageHandle backbuffer_;
+    // 每帧清除的临时深度附件, 遮挡剔除时在两个场景 pass 之间被采样
+    RenderGraph::ImageHandle depth_;
+    RenderGraph::BufferHandle indirect_draws_;
+    RenderGraph::BufferHandle indirect_counts_;
+    // 录制主命令缓冲期间, 场景 pass 要执行的次级命令缓冲
+    std::span<const VkCommandBuffer> scene_commands_;
+    std::span<const VkCommandBuffer> late_scene_commands_;
+    CommandBufferCache command_buffer_cache_;
+    // command_buffer_cache_ 中各部分次级命令缓冲的 id
+    static constexpr uint32_t k_scene_commands = 0;
+    static constexpr uint32_t k_late_scene_commands = k_scene_commands + MAX_FRAMES_IN_FLIGHT;
+    // 管线, 顶点数据或视口变化时加一, 场景的次级命令缓冲随之重新录制
+    uint64_t scene_version_ = 1;
+    uint32_t scene_draw_count_ = 1;
+    uint32_t scene_layers_ = 1;
+    // 初始化后每帧使用多线程录制, 由 record_threads_ 启用
+    ParallelRecorder parallel_recorder_;
+    uint32_t record_threads_ = 0;
 
-    std::vector<VkCommandBuffer> command_buffers_;
     std::vector<VkSemaphore> image_available_semaphores_;
     std::vector<VkSemaphore> render_finished_semaphores_;
-    std::vector<VkFence> fences_in_flight_;
-    std::map<uint32_t, uint32_t> image_available_semaphores_map_;
-    std::map<uint32_t, uint32_t> available_semaphores_image_map_;
+    // 帧完成的时间线信号量, CPU 用 vkWaitSemaphores 等待, 其他队列也可以在提交时等待某个 serial
+    VkSemaphore frame_timeline_{};
     bool framebuffer_resized_ = false;
+
+    struct RetiredSwapChain
+    {
+        VkSwapchainKHR swap_chain;
+        std::vector<VkSemaphore> semaphores;
+        std::vector<VkFence> present_fences;
+        uint64_t serial; // 没有呈现 fence 时使用
+    };
+
+    std::vector<RetiredSwapChain> retired_swap_chains_;
+    // 当前交换链上尚未回收的呈现 fence
+    std::vector<VkFence> present_fences_;
+    std::vector<VkFence> free_present_fences_;
+    uint32_t swap_chain_recreations_ = 0;
     uint32_t current_flight_frame_ = 0;
     uint32_t frame_count_ = 0;
+    FrameStats frame_stats_;
+    FramePacer frame_pacer_;
+    RedrawScheduler redraw_;
+    VkPresentModeKHR requested_present_mode_ = VK_PRESENT_MODE_MAILBOX_KHR;
+    VkPresentModeKHR present_mode_ = VK_PRESENT_MODE_FIFO_KHR;
+    // 由呈现模式决定, 不超过 MAX_FRAMES_IN_FLIGHT
+    uint32_t frames_in_flight_ = MAX_FRAMES_IN_FLIGHT;
+    std::chrono::steady_clock::time_point last_frame_begin_{};
+    bool dump_frame_stats_ = false;
+    bool animate_ = true;
+    // 动画时间, 暂停期间不前进
+    double animation_time_ = 0;
+    std::chrono::steady_clock::time_point last_animation_update_{};
+    // 场景的变换, 每帧在 task_pool_ 上更新, 结果直接写进 frame_data_
+    TaskPool task_pool_;
+    TransformStore transforms_;
+    // 每个物体旋转的初相, 已对 2pi 取余
+    std::vector<float> transform_phases_;
+    // transforms_ 按这些参数建立, 变化时重建
+    uint32_t transform_objects_ = 0;
+    uint32_t transform_layers_ = 0;
+    float transform_aspect_ = 0;
     VkBuffer vertex_buffer_{};
-    VkDeviceMemory vertex_buffer_memory_{};
+    GpuAllocation vertex_buffer_allocation_;
     VkBuffer index_buffer_{};
-    VkDeviceMemory index_buffer_memory_{};
+    GpuAllocation index_buffer_allocation_;
+    // create_texture 上传的纹理和它的采样器, 以及两者在 bindless_ 中的下标
+    VkImage texture_image_{};
+    GpuAllocation texture_allocation_;
+    VkImageView texture_view_{};
+    VkSampler texture_sampler_{};
+    BindlessHeap::Handle texture_handle_;
+    BindlessHeap::Handle sampler_handle_;
 };
 
 
@@ -0,0 +1,124 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "InitScheduler.h"
+
+#include "StartupProfiler.h"
+
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+InitScheduler::TaskId InitScheduler::add(std::string name, std::function<void()> fn,
+                                         std::initializer_list<TaskId> dependencies, Affinity affinity)
+{
+    const auto id = static_cast<TaskId>(tasks_.size());
+    for (const auto dependency : dependencies)
+    {
+        if (dependency >= id)
+            throw std::logic_error("init task dependency must be added before its dependents");
+        tasks_[dependency].dependents.push_back(id);
+    }
+    tasks_.push_back(Task{
+        .name = std::move(name),
+        .fn = std::move(fn),
+        .affinity = affinity,
+        .pending = static_cast<uint32_t>(dependencies.size()),
+        .dependents = {},
+    });
+    return id;
+}
+
+void InitScheduler::run(uint32_t worker_count)
+{
+    {
+        std::lock_guard lock(mutex_);
+        remaining_ = tasks_.size();
+        serial_ = worker_count == 0;
+        error_ = nullptr;
+        for (TaskId id = 0; id < tasks_.size(); ++id)
+        {
+            if (tasks_[id].pending == 0)
+                push_ready(id);
+        }
+    }
+
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(worker_count);
+        for (uint32_t i = 0; i < worker_count; ++i)
+        {
+            workers.emplace_back([this] { worker_loop(false); });
+        }
+        worker_loop(true);
+    } // 等待所有工作线程退出
+
+    if (error_)
+        std::rethrow_exception(error_);
+}
+
+void InitScheduler::worker_loop(bool main_thread)
+{
+    // 串行模式下调用线程负责所有任务
+    const bool take_main = main_thread;
+    const bool take_any = !main_thread || serial_;
+
+    while (true)
+    {
+        TaskId id;
+        {
+            std::unique_lock lock(mutex_);
+            cv_.wait(lock, [&]
+            {
+                return remaining_ == 0 || error_
+                    || (take_main && !ready_main_.empty())
+                    || (take_any && !ready_any_.empty());
+            });
+            if (remaining_ == 0 || error_)
+                return;
+
+            auto& queue = take_main && !ready_main_.empty() ? ready_main_ : ready_any_;
+            id = queue.front();
+            queue.pop_front();
+        }
+        execute(id);
+    }
+}
+
+void InitScheduler::execute(TaskId id)
+{
+    auto& task = tasks_[id];
+    try
+    {
+        std::optional<StartupProfiler::Scope> scope;
+        if (profiler_)
+            scope.emplace(*profiler_, task.name);
+        task.fn();
+    }
+    catch (...)
+    {
+        std::lock_guard lock(mutex_);
+        if (!error_)
+            error_ = std::current_exception();
+        cv_.notify_all();
+        return;
+    }
+
+    std::lock_guard lock(mutex_);
+    --remaining_;
+    for (const auto dependent : task.dependents)
+    {
+        if (--tasks_[dependent].pending == 0)
+            push_ready(dependent);
+    }
+    cv_.notify_all();
+}
+
+void InitScheduler::push_ready(TaskId id)
+{
+    if (tasks_[id].affinity == Affinity::MainThread)
+        ready_main_.push_back(id);
+    else
+        ready_any_.push_back(id);
+}
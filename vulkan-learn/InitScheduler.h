@@ -0,0 +1,78 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_INITSCHEDULER_H
+#define VULKAN_LEARN_INITSCHEDULER_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class StartupProfiler;
+
+/**
+ * @brief 按依赖关系调度的初始化任务图
+ *
+ * 任务在所有依赖完成后立即进入就绪队列, 由工作线程取走执行. 标记为 MainThread 的任务只会在调用
+ * run() 的线程上执行(例如需要调用 glfwGetFramebufferSize 的交换链创建). worker_count 为 0 时
+ * 退化为在调用线程上按拓扑顺序串行执行, 方便和并行版本做对比.
+ *
+ * 任意任务抛出异常后不再调度新任务, 等待正在执行的任务结束后在 run() 中重新抛出第一个异常.
+ */
+class InitScheduler
+{
+public:
+    using TaskId = uint32_t;
+
+    enum class Affinity
+    {
+        Any,
+        MainThread,
+    };
+
+    explicit InitScheduler(StartupProfiler* profiler = nullptr) : profiler_(profiler)
+    {
+    }
+
+    TaskId add(std::string name, std::function<void()> fn, std::initializer_list<TaskId> dependencies = {},
+               Affinity affinity = Affinity::Any);
+
+    void run(uint32_t worker_count);
+
+private:
+    struct Task
+    {
+        std::string name;
+        std::function<void()> fn;
+        Affinity affinity;
+        uint32_t pending;
+        std::vector<TaskId> dependents;
+    };
+
+    void worker_loop(bool main_thread);
+
+    void execute(TaskId id);
+
+    // 调用方需持有 mutex_
+    void push_ready(TaskId id);
+
+    StartupProfiler* profiler_;
+    std::vector<Task> tasks_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<TaskId> ready_any_;
+    std::deque<TaskId> ready_main_;
+    size_t remaining_ = 0;
+    bool serial_ = false;
+    std::exception_ptr error_;
+};
+
+
+#endif //VULKAN_LEARN_INITSCHEDULER_H
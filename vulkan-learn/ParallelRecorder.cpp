@@ -0,0 +1,132 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "ParallelRecorder.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    // 片段太小时线程切换的开销超过录制本身
+    constexpr uint32_t k_min_draws_per_slice = 64;
+}
+
+void ParallelRecorder::init(VkDevice device, uint32_t queue_family, uint32_t frame_count, uint32_t thread_count)
+{
+    device_ = device;
+    slices_.resize(std::max(thread_count, 1u));
+    primaries_.resize(frame_count);
+    stats_ = {};
+
+    for (auto& slice : slices_)
+    {
+        slice.pools.resize(frame_count);
+        slice.secondaries.resize(frame_count);
+        for (uint32_t frame = 0; frame < frame_count; ++frame)
+        {
+            VkCommandPoolCreateInfo pool_info{};
+            pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            // 每帧整池重置, 不需要 RESET_COMMAND_BUFFER
+            pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pool_info.queueFamilyIndex = queue_family;
+            details::err_check(vkCreateCommandPool(device_, &pool_info, nullptr, &slice.pools[frame]),
+                               "failed to create recording command pool!");
+
+            VkCommandBufferAllocateInfo allocate_info{};
+            allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocate_info.commandPool = slice.pools[frame];
+            allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocate_info.commandBufferCount = 1;
+            details::err_check(vkAllocateCommandBuffers(device_, &allocate_info, &slice.secondaries[frame]),
+                               "failed to allocate secondary command buffer!");
+        }
+    }
+
+    // 主命令缓冲只在调用线程上录制, 放在第 0 片的命令池里; 它在 record 返回之后才开始录制,
+    // 不会与第 0 片 (可能在工作线程上) 同时使用这个命令池
+    for (uint32_t frame = 0; frame < frame_count; ++frame)
+    {
+        VkCommandBufferAllocateInfo allocate_info{};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandPool = slices_[0].pools[frame];
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocate_info.commandBufferCount = 1;
+        details::err_check(vkAllocateCommandBuffers(device_, &allocate_info, &primaries_[frame]),
+                           "failed to allocate primary command buffer!");
+    }
+
+    pool_.init(static_cast<uint32_t>(slices_.size()));
+}
+
+void ParallelRecorder::destroy()
+{
+    if (!initialized())
+        return;
+
+    pool_.destroy();
+    for (const auto& slice : slices_)
+    {
+        for (const auto pool : slice.pools)
+        {
+            vkDestroyCommandPool(device_, pool, nullptr);
+        }
+    }
+    slices_.clear();
+    primaries_.clear();
+    device_ = VK_NULL_HANDLE;
+}
+
+VkCommandBuffer ParallelRecorder::begin_frame(uint32_t frame)
+{
+    frame_ = frame;
+    // 工作线程此时都在等待新任务, 不会同时访问这些命令池
+    for (const auto& slice : slices_)
+    {
+        vkResetCommandPool(device_, slice.pools[frame], 0);
+    }
+    return primaries_[frame];
+}
+
+std::span<const VkCommandBuffer> ParallelRecorder::record(const VkCommandBufferInheritanceInfo& inheritance,
+                                                          uint32_t draw_count, const SliceRecorder& slice_recorder)
+{
+    const auto begin = std::chrono::steady_clock::now();
+
+    inheritance_ = &inheritance;
+    slice_recorder_ = &slice_recorder;
+    draw_count_ = draw_count;
+    slice_count_ = std::clamp((draw_count + k_min_draws_per_slice - 1) / k_min_draws_per_slice, 1u,
+                              thread_count());
+    recorded_.assign(slice_count_, VK_NULL_HANDLE);
+    // 第一个异常在所有片段停下后重新抛出
+    pool_.run(slice_count_, [this](uint32_t slice) { record_slice(slice); });
+
+    ++stats_.frames;
+    stats_.secondaries += slice_count_;
+    stats_.record_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    return recorded_;
+}
+
+void ParallelRecorder::record_slice(uint32_t index)
+{
+    const VkCommandBuffer command_buffer = slices_[index].secondaries[frame_];
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT
+        | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = inheritance_;
+    details::err_check(vkBeginCommandBuffer(command_buffer, &begin_info),
+                       "failed to begin secondary command buffer!");
+
+    const auto begin = static_cast<uint32_t>(static_cast<uint64_t>(draw_count_) * index / slice_count_);
+    const auto end = static_cast<uint32_t>(static_cast<uint64_t>(draw_count_) * (index + 1) / slice_count_);
+    (*slice_recorder_)(command_buffer, begin, end);
+
+    details::err_check(vkEndCommandBuffer(command_buffer), "failed to record secondary command buffer!");
+    recorded_[index] = command_buffer;
+}
@@ -0,0 +1,91 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_PARALLELRECORDER_H
+#define VULKAN_LEARN_PARALLELRECORDER_H
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "TaskPool.h"
+
+/**
+ * @brief 多线程录制次级命令缓冲
+ *
+ * 绘制列表按线程数切成连续的片段, 每片作为一个任务交给 TaskPool (调用线程也参与录制), 每片一个次级命令缓冲,
+ * 按片段顺序返回, 主命令缓冲依次执行它们, 结果与单线程录制一致.
+ *
+ * 命令池不能被多个线程同时使用, 每个片段为每个飞行帧持有一个 TRANSIENT 命令池, 一帧内一个片段只在一个线程上
+ * 录制. begin_frame 时整池 vkResetCommandPool, 不逐个重置命令缓冲; 命令缓冲分配一次后一直复用.
+ * 调用前该帧上一次的提交必须已经完成.
+ */
+class ParallelRecorder
+{
+public:
+    // 录制 [begin, end) 范围内的绘制, 不需要调用 begin/end
+    using SliceRecorder = std::function<void(VkCommandBuffer, uint32_t begin, uint32_t end)>;
+
+    struct Stats
+    {
+        uint32_t frames = 0;
+        uint64_t secondaries = 0;
+        double record_ms = 0; // record 的墙钟时间
+    };
+
+    ParallelRecorder() = default;
+    ParallelRecorder(const ParallelRecorder&) = delete;
+    ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+    // thread_count 包括调用线程
+    void init(VkDevice device, uint32_t queue_family, uint32_t frame_count, uint32_t thread_count);
+
+    // 停止工作线程并销毁命令池, 调用前所有录制的命令缓冲都已执行完
+    void destroy();
+
+    // 重置 frame 的全部命令池, 返回这一帧的主命令缓冲(尚未 begin)
+    VkCommandBuffer begin_frame(uint32_t frame);
+
+    // 在 begin_frame 之后调用一次, 按片段顺序返回录制好的次级命令缓冲
+    std::span<const VkCommandBuffer> record(const VkCommandBufferInheritanceInfo& inheritance, uint32_t draw_count,
+                                            const SliceRecorder& slice_recorder);
+
+    uint32_t thread_count() const { return static_cast<uint32_t>(slices_.size()); }
+
+    bool initialized() const { return device_ != VK_NULL_HANDLE; }
+
+    Stats stats() const { return stats_; }
+
+private:
+    struct SliceState
+    {
+        // 每个飞行帧一个命令池和其中的次级命令缓冲
+        std::vector<VkCommandPool> pools;
+        std::vector<VkCommandBuffer> secondaries;
+    };
+
+    // 录制第 index 片, 在 pool_ 的任意一个线程上执行
+    void record_slice(uint32_t index);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    // 片段数不超过线程数
+    std::vector<SliceState> slices_;
+    std::vector<VkCommandBuffer> primaries_; // 从第 0 片的命令池分配, 只在调用线程上录制
+    uint32_t frame_ = 0;
+    TaskPool pool_;
+
+    // 当前任务, 在 pool_.run 之前由调用线程写好
+    const VkCommandBufferInheritanceInfo* inheritance_ = nullptr;
+    const SliceRecorder* slice_recorder_ = nullptr;
+    uint32_t draw_count_ = 0;
+    uint32_t slice_count_ = 0;
+    std::vector<VkCommandBuffer> recorded_;
+
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_PARALLELRECORDER_H
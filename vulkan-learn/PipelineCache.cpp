@@ -0,0 +1,291 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "PipelineCache.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <cstring>
+#include <fstream>
+
+void PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties& properties, std::filesystem::path path,
+                         bool creation_feedback)
+{
+    device_ = device;
+    properties_ = properties;
+    path_ = std::move(path);
+    creation_feedback_ = creation_feedback;
+
+    initial_data_ = load_validated();
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = initial_data_.size();
+    create_info.pInitialData = initial_data_.empty() ? nullptr : initial_data_.data();
+
+    // 部分驱动遇到无法识别的数据会直接报错而不是忽略, 此时退回空缓存
+    if (vkCreatePipelineCache(device_, &create_info, nullptr, &cache_) != VK_SUCCESS)
+    {
+        fmt::println("[pipeline cache] driver rejected {}, start cold", path_.string());
+        initial_data_.clear();
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+        details::err_check(vkCreatePipelineCache(device_, &create_info, nullptr, &cache_),
+                           "failed to create pipeline cache!");
+    }
+    warm_ = !initial_data_.empty();
+
+    fmt::println("[pipeline cache] {} start, {} bytes loaded from {}", warm_ ? "warm" : "cold",
+                 initial_data_.size(), path_.string());
+}
+
+void PipelineCache::destroy()
+{
+    if (cache_ == VK_NULL_HANDLE)
+        return;
+
+    save();
+
+    std::lock_guard lock(mutex_);
+    for (const auto thread_cache : thread_caches_ | std::views::values)
+    {
+        vkDestroyPipelineCache(device_, thread_cache, nullptr);
+    }
+    thread_caches_.clear();
+    vkDestroyPipelineCache(device_, cache_, nullptr);
+    cache_ = VK_NULL_HANDLE;
+    initial_data_.clear();
+}
+
+void PipelineCache::save()
+{
+    std::vector<char> data;
+    FileHeader header{};
+    {
+        std::lock_guard lock(mutex_);
+        if (!thread_caches_.empty())
+        {
+            std::vector<VkPipelineCache> src_caches;
+            src_caches.reserve(thread_caches_.size());
+            for (const auto thread_cache : thread_caches_ | std::views::values)
+            {
+                src_caches.push_back(thread_cache);
+            }
+            details::err_check(vkMergePipelineCaches(device_, cache_, static_cast<uint32_t>(src_caches.size()),
+                                                     src_caches.data()),
+                               "failed to merge pipeline caches!");
+        }
+
+        size_t data_size = 0;
+        details::err_check(vkGetPipelineCacheData(device_, cache_, &data_size, nullptr),
+                           "failed to get pipeline cache data size!");
+        data.resize(data_size);
+        details::err_check(vkGetPipelineCacheData(device_, cache_, &data_size, data.data()),
+                           "failed to get pipeline cache data!");
+        data.resize(data_size);
+
+        header.avg_miss_ms = average_miss_ms();
+    }
+
+    header.magic = k_magic;
+    header.version = k_version;
+    header.vendor_id = properties_.vendorID;
+    header.device_id = properties_.deviceID;
+    header.driver_version = properties_.driverVersion;
+    std::memcpy(header.uuid, properties_.pipelineCacheUUID, VK_UUID_SIZE);
+    header.data_size = data.size();
+    header.data_hash = hash(data.data(), data.size());
+
+    // 先写临时文件再 rename, 避免进程中途退出留下半截文件
+    auto tmp_path = path_;
+    tmp_path += ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file)
+        {
+            fmt::println("[pipeline cache] failed to write {}", tmp_path.string());
+            return;
+        }
+    }
+
+    std::error_code error_code;
+    std::filesystem::rename(tmp_path, path_, error_code);
+    if (error_code)
+    {
+        fmt::println("[pipeline cache] failed to replace {}: {}", path_.string(), error_code.message());
+        std::filesystem::remove(tmp_path, error_code);
+        return;
+    }
+    fmt::println("[pipeline cache] saved {} bytes to {}", data.size(), path_.string());
+}
+
+VkPipelineCache PipelineCache::thread_cache()
+{
+    std::lock_guard lock(mutex_);
+    auto [it, inserted] = thread_caches_.try_emplace(std::this_thread::get_id(), VK_NULL_HANDLE);
+    if (inserted)
+    {
+        // 子缓存同样以磁盘数据为初始内容, 否则工作线程上永远无法命中
+        VkPipelineCacheCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        create_info.initialDataSize = initial_data_.size();
+        create_info.pInitialData = initial_data_.empty() ? nullptr : initial_data_.data();
+        details::err_check(vkCreatePipelineCache(device_, &create_info, nullptr, &it->second),
+                           "failed to create thread pipeline cache!");
+    }
+    return it->second;
+}
+
+template <typename CreateInfo, typename CreateFn>
+VkResult PipelineCache::create_pipelines(uint32_t count, const CreateInfo* create_infos, VkPipeline* pipelines,
+                                         CreateFn create_fn)
+{
+    const VkPipelineCache cache = thread_cache();
+
+    std::vector<CreateInfo> infos(create_infos, create_infos + count);
+    std::vector<VkPipelineCreationFeedback> feedbacks(count);
+    std::vector<VkPipelineCreationFeedbackCreateInfo> feedback_infos(count);
+    if (creation_feedback_)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            feedback_infos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO;
+            feedback_infos[i].pNext = infos[i].pNext;
+            feedback_infos[i].pPipelineCreationFeedback = &feedbacks[i];
+            infos[i].pNext = &feedback_infos[i];
+        }
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    const VkResult result = create_fn(device_, cache, count, infos.data(), nullptr, pipelines);
+    const auto cost_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    if (result == VK_SUCCESS)
+    {
+        std::lock_guard lock(mutex_);
+        for (const auto& feedback : feedbacks)
+        {
+            record(feedback, cost_ms / count);
+        }
+    }
+    return result;
+}
+
+void PipelineCache::record(const VkPipelineCreationFeedback& feedback, double ms)
+{
+    bool hit = warm_;
+    if (creation_feedback_ && (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT))
+    {
+        hit = feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
+    }
+
+    if (hit)
+    {
+        ++stats_.hits;
+        stats_.hit_ms += ms;
+    }
+    else
+    {
+        ++stats_.misses;
+        stats_.miss_ms += ms;
+    }
+}
+
+VkResult PipelineCache::create_graphics_pipelines(uint32_t count, const VkGraphicsPipelineCreateInfo* create_infos,
+                                                  VkPipeline* pipelines)
+{
+    return create_pipelines(count, create_infos, pipelines, vkCreateGraphicsPipelines);
+}
+
+VkResult PipelineCache::create_compute_pipelines(uint32_t count, const VkComputePipelineCreateInfo* create_infos,
+                                                 VkPipeline* pipelines)
+{
+    return create_pipelines(count, create_infos, pipelines, vkCreateComputePipelines);
+}
+
+PipelineCache::Stats PipelineCache::stats() const
+{
+    std::lock_guard lock(mutex_);
+    Stats stats = stats_;
+    stats.estimated = !creation_feedback_;
+    stats.saved_ms = std::max(0.0, stats.hits * average_miss_ms() - stats.hit_ms);
+    return stats;
+}
+
+void PipelineCache::print_stats() const
+{
+    const auto [hits, misses, hit_ms, miss_ms, saved_ms, estimated] = stats();
+    fmt::println("[pipeline cache] {}: hit {} ({:.3f}ms), miss {} ({:.3f}ms), saved ~{:.3f}ms{}",
+                 warm_ ? "warm" : "cold", hits, hit_ms, misses, miss_ms, saved_ms,
+                 estimated ? " (estimated, no creation feedback)" : "");
+}
+
+double PipelineCache::average_miss_ms() const
+{
+    // 本次有冷编译就用本次的平均值, 否则沿用文件里记录的历史值
+    return stats_.misses > 0 ? stats_.miss_ms / stats_.misses : avg_miss_ms_;
+}
+
+std::vector<char> PipelineCache::load_validated()
+{
+    std::error_code error_code;
+    const auto file_size = std::filesystem::file_size(path_, error_code);
+    if (error_code)
+        return {};
+
+    auto reject = [this](std::string_view reason)
+    {
+        fmt::println("[pipeline cache] discard {}: {}", path_.string(), reason);
+        return std::vector<char>{};
+    };
+
+    std::ifstream file(path_, std::ios::in | std::ios::binary);
+    FileHeader header{};
+    if (file_size < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return reject("truncated header");
+    if (header.magic != k_magic || header.version != k_version)
+        return reject("unknown file format");
+    if (header.vendor_id != properties_.vendorID || header.device_id != properties_.deviceID)
+        return reject("different device");
+    if (header.driver_version != properties_.driverVersion)
+        return reject("driver version changed");
+    if (std::memcmp(header.uuid, properties_.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        return reject("pipelineCacheUUID changed");
+    if (header.data_size != file_size - sizeof(header))
+        return reject("size mismatch");
+
+    std::vector<char> data(header.data_size);
+    if (!file.read(data.data(), static_cast<std::streamsize>(data.size())))
+        return reject("truncated data");
+    if (hash(data.data(), data.size()) != header.data_hash)
+        return reject("checksum mismatch");
+
+    // 驱动自己的头部也再校验一遍, 防止文件头和数据来自不同设备
+    VkPipelineCacheHeaderVersionOne vk_header{};
+    if (data.size() < sizeof(vk_header))
+        return reject("missing vulkan cache header");
+    std::memcpy(&vk_header, data.data(), sizeof(vk_header));
+    if (vk_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        || vk_header.vendorID != properties_.vendorID
+        || vk_header.deviceID != properties_.deviceID
+        || std::memcmp(vk_header.pipelineCacheUUID, properties_.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        return reject("vulkan cache header mismatch");
+
+    avg_miss_ms_ = header.avg_miss_ms;
+    return data;
+}
+
+uint64_t PipelineCache::hash(const char* data, size_t size)
+{
+    // FNV-1a
+    uint64_t value = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        value ^= static_cast<uint8_t>(data[i]);
+        value *= 1099511628211ull;
+    }
+    return value;
+}
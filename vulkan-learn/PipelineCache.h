@@ -0,0 +1,115 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_PIPELINECACHE_H
+#define VULKAN_LEARN_PIPELINECACHE_H
+
+#include <vulkan/vulkan.h>
+
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 持久化的 VkPipelineCache
+ *
+ * 启动时从磁盘加载缓存数据, 并用设备的 vendorID / deviceID / driverVersion / pipelineCacheUUID 校验文件头,
+ * 不匹配的数据直接丢弃(冷启动). 每个线程使用独立的子缓存以避免竞争, 保存时合并到主缓存, 再以
+ * "写临时文件 + rename" 的方式原子地写回磁盘.
+ *
+ * 命中/未命中依赖 VK_EXT_pipeline_creation_feedback (Vulkan 1.3 核心), 不可用时只统计耗时.
+ */
+class PipelineCache
+{
+public:
+    struct Stats
+    {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        double hit_ms = 0;
+        double miss_ms = 0;
+        double saved_ms = 0; // 按历史平均编译耗时估算的节省时间
+        bool estimated = false; // 没有 creation feedback 时按缓存冷/热推断命中
+    };
+
+    PipelineCache() = default;
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    void init(VkDevice device, const VkPhysicalDeviceProperties& properties, std::filesystem::path path,
+              bool creation_feedback = false);
+
+    // 合并所有线程缓存后写回磁盘并销毁
+    void destroy();
+
+    // 合并线程缓存并原子写回磁盘, 可在运行期间调用
+    void save();
+
+    VkPipelineCache handle() const { return cache_; }
+
+    // 当前线程的子缓存, 首次调用时创建
+    VkPipelineCache thread_cache();
+
+    bool is_warm() const { return warm_; }
+
+    VkResult create_graphics_pipelines(uint32_t count, const VkGraphicsPipelineCreateInfo* create_infos,
+                                       VkPipeline* pipelines);
+
+    VkResult create_compute_pipelines(uint32_t count, const VkComputePipelineCreateInfo* create_infos,
+                                      VkPipeline* pipelines);
+
+    Stats stats() const;
+
+    void print_stats() const;
+
+private:
+    double average_miss_ms() const;
+
+    // 文件头, 紧跟其后的是 vkGetPipelineCacheData 的原始数据
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint32_t driver_version;
+        uint8_t uuid[VK_UUID_SIZE];
+        uint32_t reserved; // 显式占住对齐空洞, 整个结构体按字节写盘不会带出未初始化的填充
+        uint64_t data_size;
+        uint64_t data_hash;
+        double avg_miss_ms; // 历次冷编译的平均耗时, 用于估算 saved_ms
+    };
+    static_assert(sizeof(FileHeader) == 64, "FileHeader must not contain implicit padding");
+
+    static constexpr uint32_t k_magic = 0x43505856; // "VXPC"
+    static constexpr uint32_t k_version = 1;
+
+    std::vector<char> load_validated();
+
+    template <typename CreateInfo, typename CreateFn>
+    VkResult create_pipelines(uint32_t count, const CreateInfo* create_infos, VkPipeline* pipelines,
+                              CreateFn create_fn);
+
+    void record(const VkPipelineCreationFeedback& feedback, double ms);
+
+    static uint64_t hash(const char* data, size_t size);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties_{};
+    std::filesystem::path path_;
+    VkPipelineCache cache_ = VK_NULL_HANDLE;
+    bool creation_feedback_ = false;
+    bool warm_ = false;
+    double avg_miss_ms_ = 0;
+    std::vector<char> initial_data_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::thread::id, VkPipelineCache> thread_caches_;
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_PIPELINECACHE_H
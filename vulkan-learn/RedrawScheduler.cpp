@@ -0,0 +1,140 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "RedrawScheduler.h"
+
+#include "HelloTriangleApplication.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
+namespace
+{
+    double seconds(RedrawScheduler::clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    // 进程所有线程的 CPU 时间(用户态 + 内核态)
+    double process_cpu_seconds()
+    {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+            return 0;
+        auto to_100ns = [](const FILETIME& time)
+        {
+            return static_cast<uint64_t>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+        };
+        return static_cast<double>(to_100ns(kernel) + to_100ns(user)) * 1e-7;
+#else
+        timespec time{};
+        if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+            return 0;
+        return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec) * 1e-9;
+#endif
+    }
+}
+
+RedrawScheduler::RedrawScheduler()
+    : start_(clock::now()), cpu_start_s_(process_cpu_seconds())
+{
+    usage_time_ = start_;
+    usage_cpu_s_ = cpu_start_s_;
+}
+
+void RedrawScheduler::invalidate(uint32_t frames)
+{
+    pending_frames_ = std::max(pending_frames_, frames);
+}
+
+bool RedrawScheduler::wait(GLFWwindow* window)
+{
+    resumed_from_idle_ = false;
+    const auto begin = clock::now();
+    sample_usage(begin);
+
+    // 最小化时交换链图像大小为 0, 不 acquire 也不提交, 只等窗口恢复或关闭
+    if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0)
+    {
+        glfwWaitEventsTimeout(k_iconified_timeout_s);
+        stats_.wait_s += seconds(clock::now() - begin);
+        ++stats_.iconified_waits;
+        resumed_from_idle_ = true;
+        if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0)
+            return false;
+        // 恢复后窗口内容需要重新绘制
+        invalidate();
+        return true;
+    }
+
+    if (!event_driven_ || animating_ || pending_frames_ > 0)
+    {
+        glfwPollEvents();
+        return true;
+    }
+
+    if (idle_timeout_s_ > 0)
+        glfwWaitEventsTimeout(idle_timeout_s_);
+    else
+        glfwWaitEvents();
+    const double waited = seconds(clock::now() - begin);
+    stats_.wait_s += waited;
+    ++stats_.idle_waits;
+    resumed_from_idle_ = true;
+
+    if (idle_timeout_s_ > 0 && waited >= idle_timeout_s_)
+    {
+        // 超时说明这段时间没有事件, 只需要一帧
+        invalidate(1);
+    }
+    else if (invalidate_on_events_)
+    {
+        invalidate();
+    }
+    return pending_frames_ > 0;
+}
+
+void RedrawScheduler::frame_drawn()
+{
+    ++stats_.frames_drawn;
+    if (pending_frames_ > 0)
+        --pending_frames_;
+}
+
+void RedrawScheduler::sample_usage(clock::time_point now)
+{
+    if (now - usage_time_ < k_usage_interval)
+        return;
+    const double cpu = process_cpu_seconds();
+    stats_.recent_cpu_usage = (cpu - usage_cpu_s_) / seconds(now - usage_time_);
+    usage_time_ = now;
+    usage_cpu_s_ = cpu;
+}
+
+RedrawScheduler::Stats RedrawScheduler::stats() const
+{
+    Stats stats = stats_;
+    stats.wall_s = seconds(clock::now() - start_);
+    stats.cpu_s = process_cpu_seconds() - cpu_start_s_;
+    stats.cpu_usage = stats.wall_s > 0 ? stats.cpu_s / stats.wall_s : 0;
+    return stats;
+}
+
+void RedrawScheduler::print_stats(const char* name) const
+{
+    const auto stats = this->stats();
+    fmt::println("[redraw] {}: {} mode, {} frames drawn in {:.1f}s, {} idle waits, {} iconified waits, "
+                 "{:.1f}s ({:.0f}%) blocked in event wait",
+                 name, event_driven_ ? "event-driven" : "continuous", stats.frames_drawn, stats.wall_s,
+                 stats.idle_waits, stats.iconified_waits, stats.wait_s,
+                 stats.wall_s > 0 ? stats.wait_s / stats.wall_s * 100 : 0);
+    fmt::println("[redraw] {}: cpu {:.2f}s, average {:.1f}% of one core, last {:.1f}%",
+                 name, stats.cpu_s, stats.cpu_usage * 100, stats.recent_cpu_usage * 100);
+}
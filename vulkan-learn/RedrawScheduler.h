@@ -0,0 +1,96 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_REDRAWSCHEDULER_H
+#define VULKAN_LEARN_REDRAWSCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+
+struct GLFWwindow;
+
+/**
+ * @brief 事件驱动的重绘调度
+ *
+ * 主循环每轮先调用 wait: 有待绘制的帧或者正在播放动画时只 poll 事件并立即返回 true; 否则阻塞在
+ * glfwWaitEventsTimeout 中, 直到有事件或者超过 idle_timeout. 窗口最小化时永远返回 false, 调用方不会
+ * acquire/submit. 输入, 窗口大小变化等由调用方在回调里 invalidate; 也可以让任何唤醒等待的事件都视为失效
+ * (ImGui 的额外平台窗口有自己的回调, 无法逐个接入).
+ *
+ * 每次失效会连续重绘 k_invalidate_frames 帧, 让依赖上一帧布局的 UI 稳定下来.
+ * stats 统计绘制/空闲的轮数和进程的 CPU 占用, 用来衡量空闲时的开销.
+ */
+class RedrawScheduler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t k_invalidate_frames = 3;
+    static constexpr double k_iconified_timeout_s = 0.25;
+
+    struct Stats
+    {
+        uint64_t frames_drawn = 0;
+        uint64_t idle_waits = 0; // 没有失效, 阻塞等待事件的次数
+        uint64_t iconified_waits = 0;
+        double wait_s = 0; // 阻塞在等待事件中的总时间
+        double wall_s = 0;
+        double cpu_s = 0; // 进程 CPU 时间, 包含所有线程
+        double cpu_usage = 0; // cpu_s / wall_s, 单个核心占满为 1
+        double recent_cpu_usage = 0; // 最近约 k_usage_interval 内的 CPU 占用
+    };
+
+    static constexpr auto k_usage_interval = std::chrono::seconds(1);
+
+    RedrawScheduler();
+    RedrawScheduler(const RedrawScheduler&) = delete;
+    RedrawScheduler& operator=(const RedrawScheduler&) = delete;
+
+    // false 时每轮都重绘(原来的行为), 最小化时仍然跳过
+    void set_event_driven(bool event_driven) { event_driven_ = event_driven; }
+
+    bool event_driven() const { return event_driven_; }
+
+    // 空闲超过该时间也重绘一帧, 0 表示只由失效触发
+    void set_idle_timeout(double seconds) { idle_timeout_s_ = seconds; }
+
+    // 任何唤醒等待的事件都视为失效
+    void set_invalidate_on_events(bool invalidate) { invalidate_on_events_ = invalidate; }
+
+    void invalidate(uint32_t frames = k_invalidate_frames);
+
+    // 动画期间每轮都重绘
+    void set_animating(bool animating) { animating_ = animating; }
+
+    // 处理窗口事件, 返回这一轮是否需要绘制
+    bool wait(GLFWwindow* window);
+
+    // 上一次 wait 是否因为空闲或最小化而阻塞过, 调用方据此忽略跨越空闲期的帧间隔
+    bool resumed_from_idle() const { return resumed_from_idle_; }
+
+    void frame_drawn();
+
+    Stats stats() const;
+
+    void print_stats(const char* name) const;
+
+private:
+    void sample_usage(clock::time_point now);
+
+    bool event_driven_ = true;
+    bool invalidate_on_events_ = false;
+    bool animating_ = false;
+    double idle_timeout_s_ = 0;
+    uint32_t pending_frames_ = k_invalidate_frames;
+    bool resumed_from_idle_ = false;
+
+    Stats stats_;
+    clock::time_point start_;
+    double cpu_start_s_ = 0;
+    clock::time_point usage_time_;
+    double usage_cpu_s_ = 0;
+};
+
+
+#endif //VULKAN_LEARN_REDRAWSCHEDULER_H
@@ -0,0 +1,1294 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "RenderGraph.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <ranges>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    // 临时图像只由 GPU 访问
+    constexpr GpuAllocator::MemoryUsage k_transient_usage{
+        .preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        .avoid = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    };
+
+    // 这里用到的 2 版本阶段和访问标志都和旧版本同值, 退回 vkCmdPipelineBarrier 时直接截断
+    VkPipelineStageFlags legacy_stages(VkPipelineStageFlags2 stages)
+    {
+        return static_cast<VkPipelineStageFlags>(stages);
+    }
+
+    VkAccessFlags legacy_access(VkAccessFlags2 access)
+    {
+        return static_cast<VkAccessFlags>(access);
+    }
+
+    bool has_stencil(VkFormat format)
+    {
+        return format == VK_FORMAT_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT
+            || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+    }
+
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    std::string_view layout_name(VkImageLayout layout)
+    {
+        switch (layout)
+        {
+        case VK_IMAGE_LAYOUT_UNDEFINED:
+            return "undefined";
+        case VK_IMAGE_LAYOUT_GENERAL:
+            return "general";
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            return "color_attachment";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            return "depth_attachment";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+            return "depth_read_only";
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            return "shader_read_only";
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            return "transfer_src";
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            return "transfer_dst";
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+            return "present_src";
+        default:
+            return "other";
+        }
+    }
+
+    std::string_view load_op_name(VkAttachmentLoadOp load_op)
+    {
+        switch (load_op)
+        {
+        case VK_ATTACHMENT_LOAD_OP_LOAD:
+            return "load";
+        case VK_ATTACHMENT_LOAD_OP_CLEAR:
+            return "clear";
+        default:
+            return "dont_care";
+        }
+    }
+}
+
+VkImage RenderGraph::PassContext::image(ImageHandle handle) const
+{
+    return graph->images_[handle.index].image;
+}
+
+VkImageView RenderGraph::PassContext::view(ImageHandle handle) const
+{
+    return graph->images_[handle.index].view;
+}
+
+VkBuffer RenderGraph::PassContext::buffer(BufferHandle handle) const
+{
+    return graph->buffers_[handle.index].buffer;
+}
+
+void RenderGraph::PassBuilder::color(ImageHandle image, std::optional<VkClearColorValue> clear)
+{
+    graph_->add_image_use(pass_, image.index, ImageUsage::Color,
+                          clear ? std::optional(VkClearValue{.color = *clear}) : std::nullopt);
+}
+
+void RenderGraph::PassBuilder::depth(ImageHandle image, std::optional<VkClearDepthStencilValue> clear)
+{
+    graph_->add_image_use(pass_, image.index, ImageUsage::Depth,
+                          clear ? std::optional(VkClearValue{.depthStencil = *clear}) : std::nullopt);
+}
+
+void RenderGraph::PassBuilder::depth_read(ImageHandle image)
+{
+    graph_->add_image_use(pass_, image.index, ImageUsage::DepthRead);
+}
+
+void RenderGraph::PassBuilder::sample(ImageHandle image)
+{
+    graph_->add_image_use(pass_, image.index, ImageUsage::Sampled);
+}
+
+void RenderGraph::PassBuilder::read_storage(ImageHandle image)
+{
+    graph_->add_image_use(pass_, image.index, ImageUsage::StorageRead);
+}
+
+void RenderGraph::PassBuilder::write_storage(ImageHandle image)
+{
+    graph_->add_image_use(pass_, image.index, ImageUsage::StorageWrite);
+}
+
+void RenderGraph::PassBuilder::copy_src(ImageHandle image)
+{
+    graph_->add_image_use(pass_, image.index, ImageUsage::TransferSrc);
+}
+
+void RenderGraph::PassBuilder::copy_dst(ImageHandle image)
+{
+    graph_->add_image_use(pass_, image.index, ImageUsage::TransferDst);
+}
+
+void RenderGraph::PassBuilder::read(BufferHandle buffer, VkPipelineStageFlags2 stage, VkAccessFlags2 access)
+{
+    if (buffer.index >= graph_->buffers_.size())
+        throw std::runtime_error("render graph: invalid buffer handle");
+    graph_->passes_[pass_].buffers.push_back({buffer.index, stage, access, false});
+}
+
+void RenderGraph::PassBuilder::write(BufferHandle buffer, VkPipelineStageFlags2 stage, VkAccessFlags2 access)
+{
+    if (buffer.index >= graph_->buffers_.size())
+        throw std::runtime_error("render graph: invalid buffer handle");
+    graph_->passes_[pass_].buffers.push_back({buffer.index, stage, access, true});
+}
+
+void RenderGraph::PassBuilder::side_effect()
+{
+    graph_->passes_[pass_].side_effect = true;
+}
+
+void RenderGraph::PassBuilder::secondary_command_buffers()
+{
+    graph_->passes_[pass_].secondary = true;
+}
+
+void RenderGraph::init(VkDevice device, GpuAllocator& allocator, DeletionQueue& deletion_queue,
+                       bool synchronization2, bool dynamic_rendering)
+{
+    device_ = device;
+    allocator_ = &allocator;
+    deletion_queue_ = &deletion_queue;
+    cmd_pipeline_barrier2_ = synchronization2
+                                 ? reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(
+                                     vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR"))
+                                 : nullptr;
+    if (dynamic_rendering)
+    {
+        cmd_begin_rendering_ = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+        cmd_end_rendering_ = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+    }
+    else
+    {
+        cmd_begin_rendering_ = nullptr;
+        cmd_end_rendering_ = nullptr;
+    }
+    fmt::println("[render graph] barriers via {}, {}",
+                 cmd_pipeline_barrier2_ ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier",
+                 cmd_begin_rendering_ ? "dynamic rendering" : "render pass objects");
+}
+
+void RenderGraph::destroy()
+{
+    // serial 0 的对象在删除队列下一次 collect / flush 时销毁
+    reset(0);
+    device_ = VK_NULL_HANDLE;
+    allocator_ = nullptr;
+    deletion_queue_ = nullptr;
+}
+
+void RenderGraph::reset(uint64_t retire_serial)
+{
+    release(retire_serial);
+    images_.clear();
+    buffers_.clear();
+    passes_.clear();
+}
+
+RenderGraph::ImageHandle RenderGraph::import_image(std::string name, const ImportedImage& imported)
+{
+    compiled_ = false;
+    images_.push_back({.name = std::move(name), .desc = imported.desc, .imported = true, .external = imported});
+    return {static_cast<uint32_t>(images_.size() - 1)};
+}
+
+RenderGraph::ImageHandle RenderGraph::create_image(std::string name, const ImageDesc& desc)
+{
+    compiled_ = false;
+    images_.push_back({.name = std::move(name), .desc = desc});
+    return {static_cast<uint32_t>(images_.size() - 1)};
+}
+
+RenderGraph::BufferHandle RenderGraph::import_buffer(std::string name, VkBuffer buffer,
+                                                     VkPipelineStageFlags2 initial_stage,
+                                                     VkAccessFlags2 initial_access)
+{
+    compiled_ = false;
+    buffers_.push_back({std::move(name), buffer, initial_stage, initial_access});
+    return {static_cast<uint32_t>(buffers_.size() - 1)};
+}
+
+void RenderGraph::add_pass(std::string name, PassType type, const std::function<void(PassBuilder&)>& setup,
+                           Execute execute)
+{
+    compiled_ = false;
+    passes_.push_back({.name = std::move(name), .type = type, .execute = std::move(execute)});
+    PassBuilder builder(*this, static_cast<uint32_t>(passes_.size() - 1));
+    setup(builder);
+}
+
+void RenderGraph::add_image_use(uint32_t pass, uint32_t image, ImageUsage usage, std::optional<VkClearValue> clear)
+{
+    if (image >= images_.size())
+        throw std::runtime_error(fmt::format("render graph: invalid image handle in pass {}", passes_[pass].name));
+    if (is_attachment(usage) && passes_[pass].type != PassType::Graphics)
+        throw std::runtime_error(fmt::format("render graph: attachment used in non-graphics pass {}",
+                                             passes_[pass].name));
+
+    passes_[pass].images.push_back({image, usage, clear});
+    auto& flags = images_[image].usage;
+    switch (usage)
+    {
+    case ImageUsage::Color:
+        flags |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        break;
+    case ImageUsage::Depth:
+    case ImageUsage::DepthRead:
+        flags |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        break;
+    case ImageUsage::Sampled:
+        flags |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        break;
+    case ImageUsage::StorageRead:
+    case ImageUsage::StorageWrite:
+        flags |= VK_IMAGE_USAGE_STORAGE_BIT;
+        break;
+    case ImageUsage::TransferSrc:
+        flags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        break;
+    case ImageUsage::TransferDst:
+        flags |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        break;
+    }
+}
+
+RenderGraph::Access RenderGraph::image_access(ImageUsage usage, PassType type)
+{
+    const VkPipelineStageFlags2 shader_stages = type == PassType::Compute
+                                                    ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+                                                    : VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT
+                                                    | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    constexpr VkPipelineStageFlags2 depth_stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT
+        | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    switch (usage)
+    {
+    case ImageUsage::Color:
+        return {
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true
+        };
+    case ImageUsage::Depth:
+        return {
+            depth_stages,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true
+        };
+    case ImageUsage::DepthRead:
+        return {
+            depth_stages, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false
+        };
+    case ImageUsage::Sampled:
+        return {shader_stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+    case ImageUsage::StorageRead:
+        return {shader_stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false};
+    case ImageUsage::StorageWrite:
+        return {
+            shader_stages, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+            true
+        };
+    case ImageUsage::TransferSrc:
+        return {
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            false
+        };
+    case ImageUsage::TransferDst:
+        return {
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            true
+        };
+    }
+    return {};
+}
+
+void RenderGraph::compile(uint64_t retire_serial)
+{
+    release(retire_serial);
+    const auto previous = stats_;
+    stats_ = {};
+    stats_.compiles = previous.compiles + 1;
+    stats_.render_pass_objects = previous.render_pass_objects;
+    stats_.framebuffer_objects = previous.framebuffer_objects;
+    stats_.passes = static_cast<uint32_t>(passes_.size());
+
+    cull();
+    build_groups();
+    allocate_transients();
+    build_barriers();
+    create_render_passes();
+    compiled_ = true;
+}
+
+void RenderGraph::cull()
+{
+    // 从后往前: 写入的资源被之后保留的 pass 读取, 或者是导入资源, 这个 pass 才需要保留
+    std::vector<bool> needed(images_.size(), false);
+    for (auto& pass : passes_ | std::views::reverse)
+    {
+        bool live = pass.side_effect;
+        for (const auto& use : pass.images)
+        {
+            if (is_write(use.usage) && (images_[use.image].imported || needed[use.image]))
+                live = true;
+        }
+        // buffer 都是导入的, 写入总是可见的输出
+        live |= std::ranges::any_of(pass.buffers, &BufferUse::write);
+
+        pass.culled = !live;
+        if (!live)
+        {
+            ++stats_.culled_passes;
+            continue;
+        }
+        // 清除的附件不依赖更早的内容; 不清除的附件可能加载之前的内容, 视为读取
+        for (const auto& use : pass.images)
+        {
+            if (use.clear)
+                needed[use.image] = false;
+        }
+        for (const auto& use : pass.images)
+        {
+            if (!use.clear && (!is_write(use.usage) || is_attachment(use.usage)))
+                needed[use.image] = true;
+        }
+    }
+}
+
+bool RenderGraph::can_merge(const Group& group, const Pass& pass) const
+{
+    if (group.type != PassType::Graphics || pass.type != PassType::Graphics || group.secondary != pass.secondary)
+        return false;
+
+    // 附件必须完全相同, 并且不能再清除
+    auto attachments = pass.images | std::views::filter([](const ImageUse& use) { return is_attachment(use.usage); });
+    if (std::ranges::distance(attachments) != static_cast<std::ptrdiff_t>(group.attachments.size()))
+        return false;
+    size_t index = 0;
+    for (const auto& use : attachments)
+    {
+        const auto& attachment = group.attachments[index++];
+        if (use.clear || use.image != attachment.image || use.usage != attachment.usage)
+            return false;
+    }
+
+    // 组内不能插入屏障: 非附件资源只能和组内的 pass 一起读, 且布局相同
+    for (const auto group_pass : group.passes)
+    {
+        const auto& other = passes_[group_pass];
+        for (const auto& use : pass.images)
+        {
+            if (is_attachment(use.usage))
+                continue;
+            for (const auto& other_use : other.images)
+            {
+                if (other_use.image != use.image)
+                    continue;
+                if (is_attachment(other_use.usage) || is_write(other_use.usage) || is_write(use.usage)
+                    || image_access(other_use.usage, other.type).layout != image_access(use.usage, pass.type).layout)
+                    return false;
+            }
+        }
+        for (const auto& use : pass.buffers)
+        {
+            for (const auto& other_use : other.buffers)
+            {
+                if (other_use.buffer == use.buffer && (other_use.write || use.write))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+void RenderGraph::build_groups()
+{
+    groups_.clear();
+    for (uint32_t index = 0; index < passes_.size(); ++index)
+    {
+        auto& pass = passes_[index];
+        if (pass.culled)
+            continue;
+
+        if (!groups_.empty() && can_merge(groups_.back(), pass))
+        {
+            groups_.back().passes.push_back(index);
+            pass.group = static_cast<uint32_t>(groups_.size() - 1);
+            ++stats_.merged_passes;
+            continue;
+        }
+
+        Group group;
+        group.passes = {index};
+        group.type = pass.type;
+        group.secondary = pass.secondary;
+        if (pass.type == PassType::Graphics)
+        {
+            for (const auto& use : pass.images)
+            {
+                if (!is_attachment(use.usage))
+                    continue;
+                const auto& extent = images_[use.image].desc.extent;
+                if (group.attachments.empty())
+                    group.extent = extent;
+                else if (extent.width != group.extent.width || extent.height != group.extent.height)
+                    throw std::runtime_error(fmt::format("render graph: attachment sizes differ in pass {}",
+                                                         pass.name));
+                group.attachments.push_back({
+                    .image = use.image, .usage = use.usage, .clear = use.clear.value_or(VkClearValue{})
+                });
+            }
+            if (group.attachments.empty())
+                throw std::runtime_error(fmt::format("render graph: graphics pass {} has no attachments", pass.name));
+            ++stats_.render_passes;
+        }
+        pass.group = static_cast<uint32_t>(groups_.size());
+        groups_.push_back(std::move(group));
+    }
+
+    for (uint32_t group = 0; group < groups_.size(); ++group)
+    {
+        for (const auto index : groups_[group].passes)
+        {
+            for (const auto& use : passes_[index].images)
+            {
+                auto& image = images_[use.image];
+                image.first_group = std::min(image.first_group, group);
+                image.last_group = std::max(image.last_group, group);
+            }
+        }
+    }
+}
+
+void RenderGraph::allocate_transients()
+{
+    struct Placement
+    {
+        uint32_t image;
+        VkMemoryRequirements requirements;
+    };
+
+    const auto lifetimes_overlap = [this](uint32_t a, uint32_t b)
+    {
+        return images_[a].first_group <= images_[b].last_group && images_[b].first_group <= images_[a].last_group;
+    };
+
+    // memoryTypeBits 相同的图像才能放进同一块内存
+    std::map<uint32_t, std::vector<Placement>> buckets;
+    for (uint32_t index = 0; index < images_.size(); ++index)
+    {
+        auto& image = images_[index];
+        if (image.imported || image.first_group > image.last_group)
+            continue;
+
+        VkImageCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        createInfo.imageType = VK_IMAGE_TYPE_2D;
+        createInfo.format = image.desc.format;
+        createInfo.extent = {image.desc.extent.width, image.desc.extent.height, 1};
+        createInfo.mipLevels = 1;
+        createInfo.arrayLayers = 1;
+        createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        createInfo.usage = image.usage;
+        createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        details::err_check(vkCreateImage(device_, &createInfo, nullptr, &image.image),
+                           "Failed to create render graph image !");
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(device_, image.image, &requirements);
+        image.size = requirements.size;
+        buckets[requirements.memoryTypeBits].push_back({index, requirements});
+        ++stats_.transient_images;
+        stats_.transient_bytes += requirements.size;
+    }
+
+    for (auto& [memory_type_bits, placements] : buckets)
+    {
+        // 从大到小放置, 每个图像放在和所有生命周期重叠的图像都不相交的最低偏移
+        std::ranges::sort(placements, std::greater{}, [](const Placement& placement)
+        {
+            return placement.requirements.size;
+        });
+        const auto heap = static_cast<uint32_t>(heaps_.size());
+        VkDeviceSize heap_size = 0;
+        VkDeviceSize alignment = 1;
+        std::vector<uint32_t> placed;
+        for (const auto& [index, requirements] : placements)
+        {
+            auto& image = images_[index];
+            VkDeviceSize offset = 0;
+            for (bool moved = true; moved;)
+            {
+                moved = false;
+                for (const auto other : placed)
+                {
+                    const auto& placed_image = images_[other];
+                    if (lifetimes_overlap(index, other) && offset < placed_image.offset + placed_image.size
+                        && placed_image.offset < offset + requirements.size)
+                    {
+                        offset = align_up(placed_image.offset + placed_image.size, requirements.alignment);
+                        moved = true;
+                    }
+                }
+            }
+            image.heap = heap;
+            image.offset = offset;
+            heap_size = std::max(heap_size, offset + requirements.size);
+            alignment = std::max(alignment, requirements.alignment);
+            placed.push_back(index);
+        }
+
+        // 内存相交的图像生命周期一定不重叠, 较早的是较晚的之前的占用者
+        for (const auto a : placed)
+        {
+            for (const auto b : placed)
+            {
+                const auto& first = images_[a];
+                auto& second = images_[b];
+                if (first.last_group < second.first_group && first.offset < second.offset + second.size
+                    && second.offset < first.offset + first.size)
+                    second.aliases.push_back(a);
+            }
+        }
+
+        const VkMemoryRequirements requirements{heap_size, alignment, memory_type_bits};
+        auto allocation = allocator_->allocate(requirements, k_transient_usage, false);
+        if (!allocation)
+            throw std::runtime_error("render graph: failed to allocate transient memory");
+        for (const auto index : placed)
+        {
+            auto& image = images_[index];
+            details::err_check(vkBindImageMemory(device_, image.image, allocation.memory,
+                                                 allocation.offset + image.offset),
+                               "Failed to bind render graph image memory !");
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = image.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = image.desc.format;
+            viewInfo.subresourceRange = {image.desc.aspect, 0, 1, 0, 1};
+            details::err_check(vkCreateImageView(device_, &viewInfo, nullptr, &image.view),
+                               "Failed to create render graph image view !");
+        }
+        heaps_.push_back(allocation);
+        stats_.transient_memory += heap_size;
+    }
+}
+
+void RenderGraph::build_barriers()
+{
+    std::vector<State> image_states(images_.size());
+    for (size_t index = 0; index < images_.size(); ++index)
+    {
+        const auto& image = images_[index];
+        if (!image.imported)
+            continue;
+        image_states[index].layout = image.external.initial_layout;
+        image_states[index].write_stage = image.external.initial_stage;
+        image_states[index].defined = image.external.preserve;
+    }
+    std::vector<State> buffer_states(buffers_.size());
+    for (size_t index = 0; index < buffers_.size(); ++index)
+    {
+        buffer_states[index].write_stage = buffers_[index].initial_stage;
+        buffer_states[index].write_access = buffers_[index].initial_access;
+    }
+
+    // 组内对同一个资源的访问合并为一次
+    std::vector<std::map<uint32_t, Access>> group_image_accesses(groups_.size());
+    std::vector<std::map<uint32_t, Access>> group_buffer_accesses(groups_.size());
+    for (uint32_t group_index = 0; group_index < groups_.size(); ++group_index)
+    {
+        auto& image_accesses = group_image_accesses[group_index];
+        auto& buffer_accesses = group_buffer_accesses[group_index];
+        for (const auto index : groups_[group_index].passes)
+        {
+            const auto& pass = passes_[index];
+            for (const auto& use : pass.images)
+            {
+                const auto access = image_access(use.usage, pass.type);
+                auto [it, inserted] = image_accesses.try_emplace(use.image, access);
+                if (inserted)
+                    continue;
+                it->second.stage |= access.stage;
+                it->second.access |= access.access;
+                it->second.write |= access.write;
+                if (it->second.layout != access.layout)
+                    it->second.layout = VK_IMAGE_LAYOUT_GENERAL;
+            }
+            for (const auto& use : pass.buffers)
+            {
+                auto [it, inserted] = buffer_accesses.try_emplace(use.buffer,
+                                                                  Access{use.stage, use.access, {}, use.write});
+                if (inserted)
+                    continue;
+                it->second.stage |= use.stage;
+                it->second.access |= use.access;
+                it->second.write |= use.write;
+            }
+        }
+    }
+
+    // 瞬态图像每帧都从未定义的内容开始, 但所有飞行帧共用同一块内存: 这一帧的第一次使用必须等上一帧对它以及
+    // 与它共用内存的图像的最后一次写入和读取完成. 按一帧的访问顺序求出每个图像结束时的状态, 作为开始时的来源
+    std::vector<State> final_states(images_.size());
+    for (const auto& accesses : group_image_accesses)
+    {
+        for (const auto& [index, access] : accesses)
+        {
+            auto& state = final_states[index];
+            if (!access.write && state.layout == access.layout)
+            {
+                state.read_stages |= access.stage;
+                continue;
+            }
+            state.layout = access.layout;
+            state.write_stage = access.stage;
+            state.write_access = access.write ? access.access : VK_ACCESS_2_NONE;
+            state.read_stages = access.write ? VK_PIPELINE_STAGE_2_NONE : access.stage;
+        }
+    }
+    const auto wrap_around = [&](uint32_t index, uint32_t previous)
+    {
+        image_states[index].write_stage |= final_states[previous].write_stage;
+        image_states[index].write_access |= final_states[previous].write_access;
+        image_states[index].read_stages |= final_states[previous].read_stages;
+    };
+    for (uint32_t index = 0; index < images_.size(); ++index)
+    {
+        if (images_[index].imported)
+            continue;
+        wrap_around(index, index);
+        for (const auto alias : images_[index].aliases)
+        {
+            wrap_around(index, alias);
+            wrap_around(alias, index);
+        }
+    }
+
+    // 之后连续的只读访问 (布局相同, 中间没有写入), 一次屏障就让写入对它们全部可见
+    const auto later_reads = [&](const std::vector<std::map<uint32_t, Access>>& accesses, uint32_t resource,
+                                 uint32_t group_index, VkImageLayout layout)
+    {
+        Access reads;
+        for (auto next = group_index + 1; next < groups_.size(); ++next)
+        {
+            const auto it = accesses[next].find(resource);
+            if (it == accesses[next].end())
+                continue;
+            if (it->second.write || it->second.layout != layout)
+                break;
+            reads.stage |= it->second.stage;
+            reads.access |= it->second.access;
+        }
+        return reads;
+    };
+
+    for (uint32_t group_index = 0; group_index < groups_.size(); ++group_index)
+    {
+        auto& group = groups_[group_index];
+
+        // 之前有内容且没有清除时加载, 之后还会被使用 (或者是导入资源) 时保存
+        for (auto& attachment : group.attachments)
+        {
+            const auto& image = images_[attachment.image];
+            const auto& pass = passes_[group.passes.front()];
+            const bool clear = std::ranges::any_of(pass.images, [&](const ImageUse& use)
+            {
+                return use.image == attachment.image && use.clear;
+            });
+            attachment.load_op = clear
+                                     ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                     : image_states[attachment.image].defined
+                                     ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                     : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment.store_op = image.imported || image.last_group > group_index
+                                      ? VK_ATTACHMENT_STORE_OP_STORE
+                                      : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        }
+
+        for (const auto& [index, access] : group_image_accesses[group_index])
+        {
+            auto& state = image_states[index];
+            const auto& image = images_[index];
+
+            VkPipelineStageFlags2 src_stage = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 src_access = VK_ACCESS_2_NONE;
+            // 复用内存的第一次使用要等之前的占用者用完
+            if (group_index == image.first_group)
+            {
+                for (const auto alias : image.aliases)
+                {
+                    src_stage |= image_states[alias].write_stage | image_states[alias].read_stages;
+                    src_access |= image_states[alias].write_access;
+                }
+            }
+
+            const bool layout_change = state.layout != access.layout;
+            if (!access.write && !layout_change)
+            {
+                // 读后读: 最后一次写入已经对这些阶段可见时不需要屏障
+                if ((access.stage & ~state.visible_stages) != 0 && (state.write_stage | src_stage) != 0)
+                {
+                    const auto reads = later_reads(group_image_accesses, index, group_index, access.layout);
+                    group.barriers.images.push_back({
+                        index, state.write_stage | src_stage, state.write_access | src_access,
+                        access.stage | reads.stage, access.access | reads.access, state.layout, access.layout
+                    });
+                    state.visible_stages |= reads.stage;
+                }
+                state.visible_stages |= access.stage;
+                state.read_stages |= access.stage;
+                continue;
+            }
+
+            // 内容不需要保留时从 UNDEFINED 转换: 没有内容, 或者附件不加载
+            const bool discard = !state.defined || std::ranges::any_of(group.attachments, [&](const Attachment& a)
+            {
+                return a.image == index && a.load_op != VK_ATTACHMENT_LOAD_OP_LOAD;
+            });
+            src_stage |= state.write_stage | state.read_stages;
+            src_access |= state.write_access;
+            // 只为读取做的布局转换同时覆盖之后的只读访问
+            const auto reads = access.write
+                                   ? Access{}
+                                   : later_reads(group_image_accesses, index, group_index, access.layout);
+            if (layout_change || src_stage != 0 || src_access != 0)
+            {
+                group.barriers.images.push_back({
+                    index, src_stage, src_access, access.stage | reads.stage, access.access | reads.access,
+                    discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout, access.layout
+                });
+            }
+            state.layout = access.layout;
+            state.write_stage = access.stage;
+            if (access.write)
+            {
+                state.write_access = access.access;
+                state.visible_stages = VK_PIPELINE_STAGE_2_NONE;
+                state.read_stages = VK_PIPELINE_STAGE_2_NONE;
+                state.defined = true;
+            }
+            else
+            {
+                // 只有布局转换, 转换之后对这次以及之后的只读访问可见
+                state.write_access = VK_ACCESS_2_NONE;
+                state.visible_stages = access.stage | reads.stage;
+                state.read_stages = access.stage;
+            }
+        }
+
+        for (const auto& [index, access] : group_buffer_accesses[group_index])
+        {
+            auto& state = buffer_states[index];
+            if (!access.write)
+            {
+                if ((access.stage & ~state.visible_stages) != 0 && state.write_access != 0)
+                {
+                    const auto reads = later_reads(group_buffer_accesses, index, group_index,
+                                                   VK_IMAGE_LAYOUT_UNDEFINED);
+                    group.barriers.buffers.push_back({
+                        index, state.write_stage, state.write_access, access.stage | reads.stage,
+                        access.access | reads.access
+                    });
+                    state.visible_stages |= reads.stage;
+                }
+                state.visible_stages |= access.stage;
+                state.read_stages |= access.stage;
+                continue;
+            }
+            const auto src_stage = state.write_stage | state.read_stages;
+            if (src_stage != 0)
+            {
+                group.barriers.buffers.push_back({
+                    index, src_stage, state.write_access, access.stage, access.access
+                });
+            }
+            state.write_stage = access.stage;
+            state.write_access = access.access;
+            state.visible_stages = VK_PIPELINE_STAGE_2_NONE;
+            state.read_stages = VK_PIPELINE_STAGE_2_NONE;
+        }
+
+        stats_.image_barriers += static_cast<uint32_t>(group.barriers.images.size());
+        stats_.buffer_barriers += static_cast<uint32_t>(group.barriers.buffers.size());
+        stats_.barrier_batches += group.barriers.empty() ? 0 : 1;
+    }
+
+    // 导入图像转换到图外需要的布局, 并让最后一次写入可用
+    final_barriers_ = {};
+    for (uint32_t index = 0; index < images_.size(); ++index)
+    {
+        const auto& image = images_[index];
+        const auto& state = image_states[index];
+        if (!image.imported)
+            continue;
+        const auto final_layout = image.external.final_layout != VK_IMAGE_LAYOUT_UNDEFINED
+                                      ? image.external.final_layout
+                                      : state.layout;
+        if (final_layout == state.layout && state.write_access == 0)
+            continue;
+        final_barriers_.images.push_back({
+            index, state.write_stage | state.read_stages, state.write_access, VK_PIPELINE_STAGE_2_NONE,
+            VK_ACCESS_2_NONE, state.layout, final_layout
+        });
+    }
+    stats_.image_barriers += static_cast<uint32_t>(final_barriers_.images.size());
+    stats_.barrier_batches += final_barriers_.empty() ? 0 : 1;
+}
+
+void RenderGraph::create_render_passes()
+{
+    // 动态渲染在录制时直接给出附件
+    if (dynamic_rendering())
+        return;
+
+    for (auto& group : groups_)
+    {
+        if (group.type != PassType::Graphics)
+            continue;
+
+        // 布局转换全部由图的屏障完成, 渲染流程内外布局不变, 也不需要子流程依赖
+        std::vector<VkAttachmentDescription> descriptions;
+        std::vector<VkAttachmentReference> color_references;
+        std::optional<VkAttachmentReference> depth_reference;
+        for (const auto& attachment : group.attachments)
+        {
+            const auto& image = images_[attachment.image];
+            const auto layout = image_access(attachment.usage, PassType::Graphics).layout;
+
+            VkAttachmentDescription description{};
+            description.format = image.desc.format;
+            description.samples = VK_SAMPLE_COUNT_1_BIT;
+            description.loadOp = attachment.load_op;
+            description.storeOp = attachment.store_op;
+            description.stencilLoadOp = has_stencil(image.desc.format)
+                                            ? attachment.load_op
+                                            : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            description.stencilStoreOp = has_stencil(image.desc.format)
+                                             ? attachment.store_op
+                                             : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            description.initialLayout = layout;
+            description.finalLayout = layout;
+
+            const VkAttachmentReference reference{static_cast<uint32_t>(descriptions.size()), layout};
+            if (attachment.usage == ImageUsage::Color)
+                color_references.push_back(reference);
+            else
+                depth_reference = reference;
+            descriptions.push_back(description);
+        }
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = static_cast<uint32_t>(color_references.size());
+        subpass.pColorAttachments = color_references.data();
+        subpass.pDepthStencilAttachment = depth_reference ? &*depth_reference : nullptr;
+
+        VkRenderPassCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        createInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+        createInfo.pAttachments = descriptions.data();
+        createInfo.subpassCount = 1;
+        createInfo.pSubpasses = &subpass;
+        details::err_check(vkCreateRenderPass(device_, &createInfo, nullptr, &group.render_pass),
+                           "Failed to create render graph render pass !");
+        ++stats_.render_pass_objects;
+    }
+}
+
+void RenderGraph::release(uint64_t retire_serial)
+{
+    // 最近提交的命令缓冲可能仍在使用这些对象
+    for (auto& group : groups_)
+    {
+        for (const auto framebuffer : group.framebuffers | std::views::values)
+            deletion_queue_->push(retire_serial, framebuffer);
+        if (group.render_pass != VK_NULL_HANDLE)
+            deletion_queue_->push(retire_serial, group.render_pass);
+    }
+    groups_.clear();
+    final_barriers_ = {};
+
+    for (auto& image : images_)
+    {
+        if (!image.imported)
+        {
+            if (image.view != VK_NULL_HANDLE)
+                deletion_queue_->push(retire_serial, image.view);
+            if (image.image != VK_NULL_HANDLE)
+            {
+                deletion_queue_->push(retire_serial, [device = device_, handle = image.image]
+                {
+                    vkDestroyImage(device, handle, nullptr);
+                });
+            }
+            image.image = VK_NULL_HANDLE;
+            image.view = VK_NULL_HANDLE;
+        }
+        image.first_group = UINT32_MAX;
+        image.last_group = 0;
+        image.heap = UINT32_MAX;
+        image.aliases.clear();
+    }
+    // 图像先于它们共用的内存销毁
+    for (const auto& heap : std::exchange(heaps_, {}))
+        deletion_queue_->push(retire_serial, heap);
+
+    for (auto& pass : passes_)
+    {
+        pass.culled = false;
+        pass.group = UINT32_MAX;
+    }
+    compiled_ = false;
+}
+
+void RenderGraph::bind_image(ImageHandle handle, VkImage image, VkImageView view)
+{
+    auto& resource = images_.at(handle.index);
+    if (!resource.imported)
+        throw std::runtime_error(fmt::format("render graph: {} is not an imported image", resource.name));
+    resource.image = image;
+    resource.view = view;
+}
+
+void RenderGraph::bind_buffer(BufferHandle handle, VkBuffer buffer)
+{
+    buffers_.at(handle.index).buffer = buffer;
+}
+
+VkFramebuffer RenderGraph::framebuffer(Group& group)
+{
+    std::vector<VkImageView> views;
+    views.reserve(group.attachments.size());
+    for (const auto& attachment : group.attachments)
+    {
+        const auto& image = images_[attachment.image];
+        if (image.view == VK_NULL_HANDLE)
+            throw std::runtime_error(fmt::format("render graph: image {} is not bound", image.name));
+        views.push_back(image.view);
+    }
+    if (const auto it = group.framebuffers.find(views); it != group.framebuffers.end())
+        return it->second;
+
+    VkFramebufferCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    createInfo.renderPass = group.render_pass;
+    createInfo.attachmentCount = static_cast<uint32_t>(views.size());
+    createInfo.pAttachments = views.data();
+    createInfo.width = group.extent.width;
+    createInfo.height = group.extent.height;
+    createInfo.layers = 1;
+
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    details::err_check(vkCreateFramebuffer(device_, &createInfo, nullptr, &framebuffer),
+                       "Failed to create render graph framebuffer !");
+    group.framebuffers.emplace(std::move(views), framebuffer);
+    ++stats_.framebuffer_objects;
+    return framebuffer;
+}
+
+void RenderGraph::begin_rendering(VkCommandBuffer command_buffer, const Group& group) const
+{
+    std::vector<VkRenderingAttachmentInfoKHR> colors;
+    std::optional<VkRenderingAttachmentInfoKHR> depth;
+    bool stencil = false;
+    for (const auto& attachment : group.attachments)
+    {
+        const auto& image = images_[attachment.image];
+        if (image.view == VK_NULL_HANDLE)
+            throw std::runtime_error(fmt::format("render graph: image {} is not bound", image.name));
+
+        VkRenderingAttachmentInfoKHR info{};
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        info.imageView = image.view;
+        info.imageLayout = image_access(attachment.usage, PassType::Graphics).layout;
+        info.resolveMode = VK_RESOLVE_MODE_NONE;
+        info.loadOp = attachment.load_op;
+        info.storeOp = attachment.store_op;
+        info.clearValue = attachment.clear;
+        if (attachment.usage == ImageUsage::Color)
+        {
+            colors.push_back(info);
+        }
+        else
+        {
+            depth = info;
+            stencil = has_stencil(image.desc.format);
+        }
+    }
+
+    VkRenderingInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    // 合并的 pass 全部来自次级命令缓冲时, 内容由它们提供
+    renderingInfo.flags = group.secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+    renderingInfo.renderArea.offset = {0, 0};
+    renderingInfo.renderArea.extent = group.extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colors.size());
+    renderingInfo.pColorAttachments = colors.data();
+    renderingInfo.pDepthAttachment = depth ? &*depth : nullptr;
+    renderingInfo.pStencilAttachment = stencil ? &*depth : nullptr;
+    cmd_begin_rendering_(command_buffer, &renderingInfo);
+}
+
+void RenderGraph::record_barriers(VkCommandBuffer command_buffer, const BarrierBatch& batch) const
+{
+    if (batch.empty())
+        return;
+
+    if (cmd_pipeline_barrier2_)
+    {
+        std::vector<VkImageMemoryBarrier2> image_barriers;
+        image_barriers.reserve(batch.images.size());
+        for (const auto& barrier : batch.images)
+        {
+            const auto& image = images_[barrier.image];
+            VkImageMemoryBarrier2 imageBarrier{};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            imageBarrier.srcStageMask = barrier.src_stage;
+            imageBarrier.srcAccessMask = barrier.src_access;
+            imageBarrier.dstStageMask = barrier.dst_stage;
+            imageBarrier.dstAccessMask = barrier.dst_access;
+            imageBarrier.oldLayout = barrier.old_layout;
+            imageBarrier.newLayout = barrier.new_layout;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = image.image;
+            imageBarrier.subresourceRange = {
+                image.desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS
+            };
+            image_barriers.push_back(imageBarrier);
+        }
+        std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+        buffer_barriers.reserve(batch.buffers.size());
+        for (const auto& barrier : batch.buffers)
+        {
+            VkBufferMemoryBarrier2 bufferBarrier{};
+            bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+            bufferBarrier.srcStageMask = barrier.src_stage;
+            bufferBarrier.srcAccessMask = barrier.src_access;
+            bufferBarrier.dstStageMask = barrier.dst_stage;
+            bufferBarrier.dstAccessMask = barrier.dst_access;
+            bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.buffer = buffers_[barrier.buffer].buffer;
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = VK_WHOLE_SIZE;
+            buffer_barriers.push_back(bufferBarrier);
+        }
+
+        VkDependencyInfo dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size());
+        dependencyInfo.pImageMemoryBarriers = image_barriers.data();
+        dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size());
+        dependencyInfo.pBufferMemoryBarriers = buffer_barriers.data();
+        cmd_pipeline_barrier2_(command_buffer, &dependencyInfo);
+        return;
+    }
+
+    // 旧接口一次调用只有一对阶段掩码, 合并所有屏障的阶段
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    std::vector<VkImageMemoryBarrier> image_barriers;
+    image_barriers.reserve(batch.images.size());
+    for (const auto& barrier : batch.images)
+    {
+        const auto& image = images_[barrier.image];
+        src_stages |= legacy_stages(barrier.src_stage);
+        dst_stages |= legacy_stages(barrier.dst_stage);
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask = legacy_access(barrier.src_access);
+        imageBarrier.dstAccessMask = legacy_access(barrier.dst_access);
+        imageBarrier.oldLayout = barrier.old_layout;
+        imageBarrier.newLayout = barrier.new_layout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = image.image;
+        imageBarrier.subresourceRange = {
+            image.desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS
+        };
+        image_barriers.push_back(imageBarrier);
+    }
+    std::vector<VkBufferMemoryBarrier> buffer_barriers;
+    buffer_barriers.reserve(batch.buffers.size());
+    for (const auto& barrier : batch.buffers)
+    {
+        src_stages |= legacy_stages(barrier.src_stage);
+        dst_stages |= legacy_stages(barrier.dst_stage);
+        VkBufferMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = legacy_access(barrier.src_access);
+        bufferBarrier.dstAccessMask = legacy_access(barrier.dst_access);
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = buffers_[barrier.buffer].buffer;
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+        buffer_barriers.push_back(bufferBarrier);
+    }
+    // NONE 在旧接口中对应 TOP_OF_PIPE / BOTTOM_OF_PIPE
+    vkCmdPipelineBarrier(command_buffer,
+                         src_stages != 0 ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         dst_stages != 0 ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr,
+                         static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                         static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+}
+
+void RenderGraph::execute(VkCommandBuffer command_buffer)
+{
+    if (!compiled_)
+        throw std::runtime_error("render graph: execute before compile");
+
+    for (auto& group : groups_)
+    {
+        record_barriers(command_buffer, group.barriers);
+
+        PassContext context{.graph = this};
+        if (group.type != PassType::Graphics)
+        {
+            for (const auto index : group.passes)
+                passes_[index].execute(command_buffer, context);
+            continue;
+        }
+
+        context.extent = group.extent;
+        if (dynamic_rendering())
+        {
+            begin_rendering(command_buffer, group);
+            for (const auto index : group.passes)
+                passes_[index].execute(command_buffer, context);
+            cmd_end_rendering_(command_buffer);
+            continue;
+        }
+
+        context.render_pass = group.render_pass;
+        context.framebuffer = framebuffer(group);
+
+        std::vector<VkClearValue> clear_values;
+        clear_values.reserve(group.attachments.size());
+        for (const auto& attachment : group.attachments)
+            clear_values.push_back(attachment.clear);
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = group.render_pass;
+        renderPassInfo.framebuffer = context.framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = group.extent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clear_values.size());
+        renderPassInfo.pClearValues = clear_values.data();
+
+        // 合并的 pass 依次在同一个子流程中录制
+        vkCmdBeginRenderPass(command_buffer, &renderPassInfo,
+                             group.secondary
+                                 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                 : VK_SUBPASS_CONTENTS_INLINE);
+        for (const auto index : group.passes)
+            passes_[index].execute(command_buffer, context);
+        vkCmdEndRenderPass(command_buffer);
+    }
+
+    record_barriers(command_buffer, final_barriers_);
+}
+
+VkRenderPass RenderGraph::render_pass(std::string_view pass) const
+{
+    const auto it = std::ranges::find(passes_, pass, &Pass::name);
+    if (!compiled_ || it == passes_.end() || it->culled || it->type != PassType::Graphics)
+        return VK_NULL_HANDLE;
+    return groups_[it->group].render_pass;
+}
+
+RenderGraph::Stats RenderGraph::stats() const
+{
+    return stats_;
+}
+
+void RenderGraph::print_stats() const
+{
+    fmt::println("[render graph] {} compiles, {} passes ({} culled, {} merged) in {} render passes, "
+                 "{} barrier batches ({} image, {} buffer barriers)",
+                 stats_.compiles, stats_.passes, stats_.culled_passes, stats_.merged_passes, stats_.render_passes,
+                 stats_.barrier_batches, stats_.image_barriers, stats_.buffer_barriers);
+    fmt::println("[render graph] {} transient images, {:.1f} MiB of memory for {:.1f} MiB of images",
+                 stats_.transient_images, static_cast<double>(stats_.transient_memory) / (1 << 20),
+                 static_cast<double>(stats_.transient_bytes) / (1 << 20));
+    fmt::println("[render graph] {}: {} render pass and {} framebuffer objects created",
+                 dynamic_rendering() ? "dynamic rendering" : "render pass objects", stats_.render_pass_objects,
+                 stats_.framebuffer_objects);
+}
+
+void RenderGraph::print_plan() const
+{
+    for (const auto& pass : passes_)
+    {
+        if (pass.culled)
+            fmt::println("[render graph] culled {}", pass.name);
+    }
+    const auto print_batch = [this](const BarrierBatch& batch)
+    {
+        for (const auto& barrier : batch.images)
+        {
+            fmt::println("[render graph]     barrier {} {} -> {}", images_[barrier.image].name,
+                         layout_name(barrier.old_layout), layout_name(barrier.new_layout));
+        }
+        for (const auto& barrier : batch.buffers)
+            fmt::println("[render graph]     barrier {}", buffers_[barrier.buffer].name);
+    };
+    for (size_t index = 0; index < groups_.size(); ++index)
+    {
+        const auto& group = groups_[index];
+        std::string names;
+        for (const auto pass : group.passes)
+            names += (names.empty() ? "" : " + ") + passes_[pass].name;
+        fmt::println("[render graph] {}: {}", index, names);
+        print_batch(group.barriers);
+        for (const auto& attachment : group.attachments)
+        {
+            fmt::println("[render graph]     {} load {} store {}", images_[attachment.image].name,
+                         load_op_name(attachment.load_op),
+                         attachment.store_op == VK_ATTACHMENT_STORE_OP_STORE ? "store" : "dont_care");
+        }
+    }
+    fmt::println("[render graph] final");
+    print_batch(final_barriers_);
+    for (const auto& image : images_)
+    {
+        if (image.heap == UINT32_MAX)
+            continue;
+        std::string aliases;
+        for (const auto alias : image.aliases)
+            aliases += " " + images_[alias].name;
+        fmt::println("[render graph] {} heap {} offset {} size {}{}{}", image.name, image.heap, image.offset,
+                     image.size, aliases.empty() ? "" : " reuses", aliases);
+    }
+}
@@ -0,0 +1,408 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_RENDERGRAPH_H
+#define VULKAN_LEARN_RENDERGRAPH_H
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DeletionQueue.h"
+#include "GpuAllocator.h"
+
+/**
+ * @brief 帧渲染图
+ *
+ * 每个 pass 在 setup 中声明读写哪些图像和 buffer, compile 据此:
+ *  - 剔除输出没有被使用的 pass (写入导入资源或者标记了 side_effect 的 pass 总是保留)
+ *  - 把相邻的, 附件相同并且彼此之间不需要屏障的图形 pass 合并进同一个渲染流程实例
+ *  - 按资源的上一次访问计算屏障: 读后读且布局相同时不需要屏障, 每组 pass 之前的屏障合并为一次
+ *    vkCmdPipelineBarrier2 (没有 synchronization2 时退回 vkCmdPipelineBarrier)
+ *  - 按附件之前是否有内容, 之后是否还会被使用选择 loadOp / storeOp, 内容不需要时从 UNDEFINED 转换布局
+ *  - 生命周期不重叠的临时图像共用同一块内存 (aliasing), 复用内存的第一次使用会等待之前占用者的最后一次访问
+ *  - 临时图像只有一份, 所有飞行帧共用: 每帧的第一次使用等待上一帧对同一块内存的最后一次访问
+ *
+ * 图的结构只在 compile 时分析, 之后每帧只需要 bind 导入资源的实际句柄再 execute.
+ * 重新声明 (reset) 或重新编译时, 旧的渲染流程, 帧缓冲和临时图像按 retire_serial 交给删除队列.
+ *
+ * 启用 VK_KHR_dynamic_rendering 时每组图形 pass 用 vkCmdBeginRenderingKHR 直接渲染到附件的图像视图,
+ * 不创建渲染流程和帧缓冲, 交换链重建时也就没有需要重建的对象; 否则退回渲染流程 + 按视图缓存的帧缓冲.
+ */
+class RenderGraph
+{
+public:
+    struct ImageHandle
+    {
+        uint32_t index = UINT32_MAX;
+
+        explicit operator bool() const { return index != UINT32_MAX; }
+    };
+
+    struct BufferHandle
+    {
+        uint32_t index = UINT32_MAX;
+
+        explicit operator bool() const { return index != UINT32_MAX; }
+    };
+
+    enum class PassType
+    {
+        Graphics,
+        Compute,
+        Transfer,
+    };
+
+    struct ImageDesc
+    {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{};
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    };
+
+    // 导入图像在图外的状态
+    struct ImportedImage
+    {
+        ImageDesc desc;
+        // 执行前的布局, 以及图中第一次访问需要等待的阶段 (例如 acquire 信号量的等待阶段)
+        VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 initial_stage = VK_PIPELINE_STAGE_2_NONE;
+        // 执行后转换到的布局
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // 执行前的内容是否需要保留, false 时第一次使用可以丢弃旧内容
+        bool preserve = false;
+    };
+
+    struct PassContext
+    {
+        // 图形 pass 所在的渲染流程, 用于次级命令缓冲的继承信息; 动态渲染时为空
+        VkRenderPass render_pass = VK_NULL_HANDLE;
+        uint32_t subpass = 0;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkExtent2D extent{};
+        const RenderGraph* graph = nullptr;
+
+        VkImage image(ImageHandle handle) const;
+        VkImageView view(ImageHandle handle) const;
+        VkBuffer buffer(BufferHandle handle) const;
+    };
+
+    using Execute = std::function<void(VkCommandBuffer, const PassContext&)>;
+
+    class PassBuilder
+    {
+    public:
+        // 颜色附件, clear 为空时保留之前的内容 (如果有)
+        void color(ImageHandle image, std::optional<VkClearColorValue> clear = {});
+
+        void depth(ImageHandle image, std::optional<VkClearDepthStencilValue> clear = {});
+
+        // 只读深度附件
+        void depth_read(ImageHandle image);
+
+        void sample(ImageHandle image);
+
+        void read_storage(ImageHandle image);
+
+        void write_storage(ImageHandle image);
+
+        void copy_src(ImageHandle image);
+
+        void copy_dst(ImageHandle image);
+
+        void read(BufferHandle buffer, VkPipelineStageFlags2 stage, VkAccessFlags2 access);
+
+        void write(BufferHandle buffer, VkPipelineStageFlags2 stage, VkAccessFlags2 access);
+
+        // 即使输出没有被使用也不剔除
+        void side_effect();
+
+        // 渲染流程的内容全部来自次级命令缓冲
+        void secondary_command_buffers();
+
+    private:
+        friend class RenderGraph;
+
+        PassBuilder(RenderGraph& graph, uint32_t pass) : graph_(&graph), pass_(pass) {}
+
+        RenderGraph* graph_;
+        uint32_t pass_;
+    };
+
+    struct Stats
+    {
+        uint32_t passes = 0;
+        uint32_t culled_passes = 0;
+        uint32_t render_passes = 0; // 合并之后的渲染流程实例数
+        uint32_t merged_passes = 0;
+        uint32_t barrier_batches = 0;
+        uint32_t image_barriers = 0;
+        uint32_t buffer_barriers = 0;
+        uint32_t transient_images = 0;
+        VkDeviceSize transient_bytes = 0; // 不复用内存时需要的总量
+        VkDeviceSize transient_memory = 0; // 实际分配的总量
+        uint32_t compiles = 0;
+        // 以下两项跨编译累计
+        uint64_t render_pass_objects = 0;
+        uint64_t framebuffer_objects = 0;
+    };
+
+    RenderGraph() = default;
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // synchronization2 / dynamic_rendering: 设备是否启用了 VK_KHR_synchronization2 / VK_KHR_dynamic_rendering
+    void init(VkDevice device, GpuAllocator& allocator, DeletionQueue& deletion_queue, bool synchronization2,
+              bool dynamic_rendering);
+
+    bool dynamic_rendering() const { return cmd_begin_rendering_ != nullptr; }
+
+    // 所有对象都已不再使用
+    void destroy();
+
+    // 清除所有声明和编译结果
+    void reset(uint64_t retire_serial);
+
+    ImageHandle import_image(std::string name, const ImportedImage& imported);
+
+    // 由图创建并分配内存, 只在图内部使用
+    ImageHandle create_image(std::string name, const ImageDesc& desc);
+
+    BufferHandle import_buffer(std::string name, VkBuffer buffer,
+                               VkPipelineStageFlags2 initial_stage = VK_PIPELINE_STAGE_2_NONE,
+                               VkAccessFlags2 initial_access = VK_ACCESS_2_NONE);
+
+    void add_pass(std::string name, PassType type, const std::function<void(PassBuilder&)>& setup, Execute execute);
+
+    void compile(uint64_t retire_serial);
+
+    bool compiled() const { return compiled_; }
+
+    // 每帧执行前绑定导入图像的实际句柄, 例如这一帧 acquire 到的交换链图像
+    void bind_image(ImageHandle handle, VkImage image, VkImageView view);
+
+    void bind_buffer(BufferHandle handle, VkBuffer buffer);
+
+    // 编译之后图像的视图, 临时图像的视图在下一次 reset 或 compile 之前有效; 导入图像是最近一次 bind 的视图
+    VkImageView image_view(ImageHandle handle) const { return images_[handle.index].view; }
+
+    // 录制所有未被剔除的 pass 以及它们之间的屏障
+    void execute(VkCommandBuffer command_buffer);
+
+    // pass 被合并后所在渲染流程, 未编译, 不是图形 pass 或者使用动态渲染时为空
+    VkRenderPass render_pass(std::string_view pass) const;
+
+    Stats stats() const;
+
+    void print_stats() const;
+
+    // 输出编译结果: 每组 pass 的屏障, 附件的 load/store 以及临时图像的内存复用
+    void print_plan() const;
+
+private:
+    enum class ImageUsage
+    {
+        Color,
+        Depth,
+        DepthRead,
+        Sampled,
+        StorageRead,
+        StorageWrite,
+        TransferSrc,
+        TransferDst,
+    };
+
+    struct ImageUse
+    {
+        uint32_t image;
+        ImageUsage usage;
+        std::optional<VkClearValue> clear;
+    };
+
+    struct BufferUse
+    {
+        uint32_t buffer;
+        VkPipelineStageFlags2 stage;
+        VkAccessFlags2 access;
+        bool write;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        PassType type;
+        std::vector<ImageUse> images;
+        std::vector<BufferUse> buffers;
+        bool side_effect = false;
+        bool secondary = false;
+        Execute execute;
+        bool culled = false;
+        uint32_t group = UINT32_MAX;
+    };
+
+    struct ImageResource
+    {
+        std::string name;
+        ImageDesc desc;
+        bool imported = false;
+        ImportedImage external;
+        VkImageUsageFlags usage = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        // 使用它的第一个和最后一个组, 没有被使用时 first > last
+        uint32_t first_group = UINT32_MAX;
+        uint32_t last_group = 0;
+        // 临时图像在复用内存中的位置
+        uint32_t heap = UINT32_MAX;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        // 同一块内存中之前的占用者, 第一次使用前需要等待它们
+        std::vector<uint32_t> aliases;
+    };
+
+    struct BufferResource
+    {
+        std::string name;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkPipelineStageFlags2 initial_stage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 initial_access = VK_ACCESS_2_NONE;
+    };
+
+    struct ImageBarrier
+    {
+        uint32_t image;
+        VkPipelineStageFlags2 src_stage;
+        VkAccessFlags2 src_access;
+        VkPipelineStageFlags2 dst_stage;
+        VkAccessFlags2 dst_access;
+        VkImageLayout old_layout;
+        VkImageLayout new_layout;
+    };
+
+    struct BufferBarrier
+    {
+        uint32_t buffer;
+        VkPipelineStageFlags2 src_stage;
+        VkAccessFlags2 src_access;
+        VkPipelineStageFlags2 dst_stage;
+        VkAccessFlags2 dst_access;
+    };
+
+    struct BarrierBatch
+    {
+        std::vector<ImageBarrier> images;
+        std::vector<BufferBarrier> buffers;
+
+        bool empty() const { return images.empty() && buffers.empty(); }
+    };
+
+    struct Attachment
+    {
+        uint32_t image;
+        ImageUsage usage;
+        VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        VkAttachmentStoreOp store_op = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        VkClearValue clear{};
+    };
+
+    // 合并后的一组 pass, 非图形 pass 每个单独成组
+    struct Group
+    {
+        std::vector<uint32_t> passes;
+        PassType type = PassType::Graphics;
+        bool secondary = false;
+        BarrierBatch barriers;
+        std::vector<Attachment> attachments;
+        VkExtent2D extent{};
+        VkRenderPass render_pass = VK_NULL_HANDLE;
+        std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+    };
+
+    // 资源在某个组中的合并访问
+    struct Access
+    {
+        VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 access = VK_ACCESS_2_NONE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool write = false;
+    };
+
+    // 编译时模拟的资源状态
+    struct State
+    {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // 最后一次写入 (或布局转换) 的阶段和访问
+        VkPipelineStageFlags2 write_stage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+        // 最后一次写入已经对这些阶段可见
+        VkPipelineStageFlags2 visible_stages = VK_PIPELINE_STAGE_2_NONE;
+        // 最后一次写入之后读取过的阶段, 下一次写入需要等待它们
+        VkPipelineStageFlags2 read_stages = VK_PIPELINE_STAGE_2_NONE;
+        // 是否已经有需要保留的内容
+        bool defined = false;
+    };
+
+    static Access image_access(ImageUsage usage, PassType type);
+
+    static bool is_attachment(ImageUsage usage)
+    {
+        return usage == ImageUsage::Color || usage == ImageUsage::Depth || usage == ImageUsage::DepthRead;
+    }
+
+    static bool is_write(ImageUsage usage)
+    {
+        return usage == ImageUsage::Color || usage == ImageUsage::Depth || usage == ImageUsage::StorageWrite
+            || usage == ImageUsage::TransferDst;
+    }
+
+    void add_image_use(uint32_t pass, uint32_t image, ImageUsage usage, std::optional<VkClearValue> clear = {});
+
+    void cull();
+
+    void build_groups();
+
+    // pass 能否并入 group: 附件完全相同, 不清除附件, 并且和组内已有的 pass 之间不需要屏障
+    bool can_merge(const Group& group, const Pass& pass) const;
+
+    void allocate_transients();
+
+    void build_barriers();
+
+    void create_render_passes();
+
+    // 把编译结果交给删除队列
+    void release(uint64_t retire_serial);
+
+    VkFramebuffer framebuffer(Group& group);
+
+    void begin_rendering(VkCommandBuffer command_buffer, const Group& group) const;
+
+    void record_barriers(VkCommandBuffer command_buffer, const BarrierBatch& batch) const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    GpuAllocator* allocator_ = nullptr;
+    DeletionQueue* deletion_queue_ = nullptr;
+    PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2_ = nullptr;
+    PFN_vkCmdBeginRenderingKHR cmd_begin_rendering_ = nullptr;
+    PFN_vkCmdEndRenderingKHR cmd_end_rendering_ = nullptr;
+
+    std::vector<ImageResource> images_;
+    std::vector<BufferResource> buffers_;
+    std::vector<Pass> passes_;
+
+    bool compiled_ = false;
+    std::vector<Group> groups_;
+    // 执行结束后导入图像转换到最终布局
+    BarrierBatch final_barriers_;
+    std::vector<GpuAllocation> heaps_;
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_RENDERGRAPH_H
@@ -0,0 +1,622 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "SceneBvh.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+struct SceneBvh::Frustum
+{
+    // 每个数组是四个平面的同一个分量
+    alignas(16) std::array<float, 4> nx;
+    alignas(16) std::array<float, 4> ny;
+    alignas(16) std::array<float, 4> d;
+    alignas(16) std::array<float, 4> abs_nx;
+    alignas(16) std::array<float, 4> abs_ny;
+    Simd simd = Simd::Scalar;
+};
+
+namespace
+{
+    using Aabb = SceneBvh::Aabb;
+
+    constexpr uint32_t k_nil = UINT32_MAX;
+    // SAH 代价: 多测试一层节点记 k_traversal_cost, 叶子中的物体成批测试, 每个物体折算为 k_object_cost
+    constexpr float k_traversal_cost = 1.0f;
+    constexpr float k_object_cost = 0.25f;
+    // SoA 数组末尾的补齐, 不小于最宽的 SIMD 宽度
+    constexpr uint32_t k_simd_padding = 8;
+    // 并行剔除时每个线程平均分到的子树数, 多切几棵以平衡负载
+    constexpr uint32_t k_tasks_per_thread = 4;
+
+    static_assert(sizeof(SceneBvh::Node) == 32);
+    static_assert(SceneBvh::k_max_leaf_size <= k_simd_padding);
+
+    enum class Overlap
+    {
+        Outside,
+        Partial,
+        Inside,
+    };
+
+    Aabb empty_bounds()
+    {
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        return {inf, inf, -inf, -inf};
+    }
+
+    Aabb merge(const Aabb& a, const Aabb& b)
+    {
+        return {std::min(a.min_x, b.min_x), std::min(a.min_y, b.min_y),
+                std::max(a.max_x, b.max_x), std::max(a.max_y, b.max_y)};
+    }
+
+    // 二维的 SAH 用半周长: 与矩形相交的随机直线的概率与周长成正比
+    float half_perimeter(const Aabb& bounds)
+    {
+        return std::max(bounds.max_x - bounds.min_x, 0.0f) + std::max(bounds.max_y - bounds.min_y, 0.0f);
+    }
+
+    // 标量版本同时定义了 SSE 版本的运算顺序 (见 SimdLevel)
+    Overlap classify_scalar(const SceneBvh::Frustum& frustum, const Aabb& bounds)
+    {
+        const float cx = (bounds.min_x + bounds.max_x) * 0.5f;
+        const float cy = (bounds.min_y + bounds.max_y) * 0.5f;
+        const float ex = (bounds.max_x - bounds.min_x) * 0.5f;
+        const float ey = (bounds.max_y - bounds.min_y) * 0.5f;
+        bool inside = true;
+        for (uint32_t p = 0; p < 4; ++p)
+        {
+            const float distance = frustum.nx[p] * cx + frustum.ny[p] * cy + frustum.d[p];
+            const float radius = frustum.abs_nx[p] * ex + frustum.abs_ny[p] * ey;
+            if (distance < -radius)
+                return Overlap::Outside;
+            inside &= distance >= radius;
+        }
+        return inside ? Overlap::Inside : Overlap::Partial;
+    }
+
+    uint32_t test_objects_scalar(const SceneBvh::Frustum& frustum, const float* cx, const float* cy,
+                                 const float* ex, const float* ey, uint32_t count)
+    {
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            bool visible = true;
+            for (uint32_t p = 0; p < 4; ++p)
+            {
+                const float distance = frustum.nx[p] * cx[i] + frustum.ny[p] * cy[i] + frustum.d[p];
+                const float radius = frustum.abs_nx[p] * ex[i] + frustum.abs_ny[p] * ey[i];
+                visible &= distance + radius >= 0.0f;
+            }
+            mask |= static_cast<uint32_t>(visible) << i;
+        }
+        return mask;
+    }
+
+#ifdef VULKAN_LEARN_SSE
+    // 一个包围盒对四个平面
+    Overlap classify_sse(const SceneBvh::Frustum& frustum, const Aabb& bounds)
+    {
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 min = _mm_setr_ps(bounds.min_x, bounds.min_y, 0.0f, 0.0f);
+        const __m128 max = _mm_setr_ps(bounds.max_x, bounds.max_y, 0.0f, 0.0f);
+        const __m128 center = _mm_mul_ps(_mm_add_ps(min, max), half);
+        const __m128 extent = _mm_mul_ps(_mm_sub_ps(max, min), half);
+        const __m128 cx = _mm_shuffle_ps(center, center, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 cy = _mm_shuffle_ps(center, center, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m128 ex = _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 ey = _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(1, 1, 1, 1));
+
+        const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(frustum.nx.data()), cx),
+                                                      _mm_mul_ps(_mm_load_ps(frustum.ny.data()), cy)),
+                                           _mm_load_ps(frustum.d.data()));
+        const __m128 radius = _mm_add_ps(_mm_mul_ps(_mm_load_ps(frustum.abs_nx.data()), ex),
+                                         _mm_mul_ps(_mm_load_ps(frustum.abs_ny.data()), ey));
+        if (_mm_movemask_ps(_mm_cmplt_ps(distance, _mm_sub_ps(_mm_setzero_ps(), radius))) != 0)
+            return Overlap::Outside;
+        return _mm_movemask_ps(_mm_cmpge_ps(distance, radius)) == 0xF ? Overlap::Inside : Overlap::Partial;
+    }
+
+    // 一次 4 个物体对四个平面
+    uint32_t test_objects_sse(const SceneBvh::Frustum& frustum, const float* cx, const float* cy,
+                              const float* ex, const float* ey, uint32_t count)
+    {
+        uint32_t mask = 0;
+        for (uint32_t base = 0; base < count; base += 4)
+        {
+            const __m128 x = _mm_loadu_ps(cx + base);
+            const __m128 y = _mm_loadu_ps(cy + base);
+            const __m128 w = _mm_loadu_ps(ex + base);
+            const __m128 h = _mm_loadu_ps(ey + base);
+            __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (uint32_t p = 0; p < 4; ++p)
+            {
+                const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.nx[p]), x),
+                                                              _mm_mul_ps(_mm_set1_ps(frustum.ny[p]), y)),
+                                                   _mm_set1_ps(frustum.d[p]));
+                const __m128 radius = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.abs_nx[p]), w),
+                                                 _mm_mul_ps(_mm_set1_ps(frustum.abs_ny[p]), h));
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+            }
+            mask |= static_cast<uint32_t>(_mm_movemask_ps(visible)) << base;
+        }
+        // 补齐部分读到的是下一个叶子或末尾的填充, 丢掉
+        return mask & ((1u << count) - 1);
+    }
+#endif
+
+#ifdef VULKAN_LEARN_AVX2
+    // 一次 8 个物体对四个平面, 叶子不超过 8 个物体, 一次就够
+    VULKAN_LEARN_TARGET_AVX2
+    uint32_t test_objects_avx2(const SceneBvh::Frustum& frustum, const float* cx, const float* cy,
+                               const float* ex, const float* ey, uint32_t count)
+    {
+        const __m256 x = _mm256_loadu_ps(cx);
+        const __m256 y = _mm256_loadu_ps(cy);
+        const __m256 w = _mm256_loadu_ps(ex);
+        const __m256 h = _mm256_loadu_ps(ey);
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (uint32_t p = 0; p < 4; ++p)
+        {
+            const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frustum.nx[p]), x),
+                                                                _mm256_mul_ps(_mm256_set1_ps(frustum.ny[p]), y)),
+                                                  _mm256_set1_ps(frustum.d[p]));
+            const __m256 radius = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frustum.abs_nx[p]), w),
+                                                _mm256_mul_ps(_mm256_set1_ps(frustum.abs_ny[p]), h));
+            visible = _mm256_and_ps(visible,
+                                    _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        return static_cast<uint32_t>(_mm256_movemask_ps(visible)) & ((1u << count) - 1);
+    }
+#endif
+
+    Overlap classify(const SceneBvh::Frustum& frustum, const Aabb& bounds)
+    {
+#ifdef VULKAN_LEARN_SSE
+        if (frustum.simd != SceneBvh::Simd::Scalar)
+            return classify_sse(frustum, bounds);
+#endif
+        return classify_scalar(frustum, bounds);
+    }
+}
+
+SceneBvh::SceneBvh()
+    : simd_(best_simd_level())
+{
+}
+
+void SceneBvh::set_simd(Simd simd)
+{
+    simd_ = std::min(simd, best_simd_level());
+}
+
+SceneBvh::Frustum SceneBvh::make_frustum(const Planes& planes, Simd simd)
+{
+    Frustum frustum;
+    for (uint32_t p = 0; p < 4; ++p)
+    {
+        frustum.nx[p] = planes[p][0];
+        frustum.ny[p] = planes[p][1];
+        frustum.d[p] = planes[p][3];
+        frustum.abs_nx[p] = std::abs(planes[p][0]);
+        frustum.abs_ny[p] = std::abs(planes[p][1]);
+    }
+    frustum.simd = simd;
+    return frustum;
+}
+
+void SceneBvh::build(std::span<const Aabb> bounds)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    const auto count = static_cast<uint32_t>(bounds.size());
+
+    nodes_.clear();
+    order_.resize(count);
+    std::iota(order_.begin(), order_.end(), 0u);
+    stats_ = {};
+    stats_.objects = count;
+
+    std::vector<float> centroid_x(count);
+    std::vector<float> centroid_y(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        centroid_x[i] = (bounds[i].min_x + bounds[i].max_x) * 0.5f;
+        centroid_y[i] = (bounds[i].min_y + bounds[i].max_y) * 0.5f;
+    }
+
+    // 深度优先先序: 先弹出左半, 它的整棵子树建完后才轮到右半, 所以左孩子总是紧跟父节点
+    struct Range
+    {
+        uint32_t begin;
+        uint32_t end;
+        uint32_t parent;
+        uint32_t depth;
+        bool right;
+    };
+    struct Bin
+    {
+        Aabb bounds = empty_bounds();
+        uint32_t count = 0;
+    };
+    std::vector<Range> stack;
+    if (count > 0)
+    {
+        nodes_.reserve(2 * static_cast<size_t>(count) - 1);
+        stack.push_back({0, count, k_nil, 0, false});
+    }
+    while (!stack.empty())
+    {
+        const Range range = stack.back();
+        stack.pop_back();
+        const auto index = static_cast<uint32_t>(nodes_.size());
+        if (range.right)
+            nodes_[range.parent].right = index;
+
+        Aabb node_bounds = empty_bounds();
+        Aabb centroid_bounds = empty_bounds();
+        for (uint32_t i = range.begin; i < range.end; ++i)
+        {
+            const uint32_t object = order_[i];
+            node_bounds = merge(node_bounds, bounds[object]);
+            centroid_bounds = merge(centroid_bounds,
+                                    {centroid_x[object], centroid_y[object], centroid_x[object], centroid_y[object]});
+        }
+        const uint32_t node_count = range.end - range.begin;
+        nodes_.push_back({
+            .bounds = node_bounds,
+            .first = range.begin,
+            .count = node_count,
+            .right = 0,
+            .parent = range.parent,
+        });
+        stats_.max_depth = std::max(stats_.max_depth, range.depth);
+
+        // 沿质心分布较长的轴分箱, 在箱的边界中找 SAH 代价最小的划分
+        const bool axis_y = centroid_bounds.max_y - centroid_bounds.min_y
+            > centroid_bounds.max_x - centroid_bounds.min_x;
+        const float* centroids = axis_y ? centroid_y.data() : centroid_x.data();
+        const float low = axis_y ? centroid_bounds.min_y : centroid_bounds.min_x;
+        const float extent = (axis_y ? centroid_bounds.max_y : centroid_bounds.max_x) - low;
+        uint32_t mid = range.begin;
+        bool split = false;
+        if (node_count > 1 && extent > 0)
+        {
+            const float scale = static_cast<float>(k_bin_count) / extent;
+            auto bin_of = [&](uint32_t object)
+            {
+                return std::min(static_cast<uint32_t>((centroids[object] - low) * scale), k_bin_count - 1);
+            };
+            std::array<Bin, k_bin_count> bins{};
+            for (uint32_t i = range.begin; i < range.end; ++i)
+            {
+                auto& bin = bins[bin_of(order_[i])];
+                bin.bounds = merge(bin.bounds, bounds[order_[i]]);
+                ++bin.count;
+            }
+
+            // right_cost[b]: 箱 [b, k_bin_count) 的半周长乘物体数
+            std::array<float, k_bin_count> right_cost{};
+            Aabb accumulated = empty_bounds();
+            uint32_t accumulated_count = 0;
+            for (uint32_t b = k_bin_count - 1; b > 0; --b)
+            {
+                accumulated = merge(accumulated, bins[b].bounds);
+                accumulated_count += bins[b].count;
+                right_cost[b] = half_perimeter(accumulated) * static_cast<float>(accumulated_count);
+            }
+            float best_cost = std::numeric_limits<float>::infinity();
+            uint32_t best_split = 0;
+            accumulated = empty_bounds();
+            accumulated_count = 0;
+            for (uint32_t b = 1; b < k_bin_count; ++b)
+            {
+                accumulated = merge(accumulated, bins[b - 1].bounds);
+                accumulated_count += bins[b - 1].count;
+                if (accumulated_count == 0 || accumulated_count == node_count)
+                    continue;
+                const float cost = half_perimeter(accumulated) * static_cast<float>(accumulated_count)
+                    + right_cost[b];
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_split = b;
+                }
+            }
+
+            // 最小和最大的质心分别落在第一个和最后一个箱, 一定找得到划分
+            const float area = half_perimeter(node_bounds);
+            const float split_cost = k_traversal_cost + k_object_cost * best_cost / std::max(area, 1e-20f);
+            const float leaf_cost = k_object_cost * static_cast<float>(node_count);
+            if (best_split != 0 && (node_count > k_max_leaf_size || split_cost < leaf_cost))
+            {
+                mid = static_cast<uint32_t>(std::partition(order_.begin() + range.begin, order_.begin() + range.end,
+                                                           [&](uint32_t object)
+                                                           {
+                                                               return bin_of(object) < best_split;
+                                                           })
+                    - order_.begin());
+                split = true;
+            }
+        }
+        if (!split && node_count > k_max_leaf_size)
+        {
+            // 质心全部重合, 分箱无从划分, 按中位数切开以满足叶子的容量
+            mid = range.begin + node_count / 2;
+            std::nth_element(order_.begin() + range.begin, order_.begin() + mid, order_.begin() + range.end,
+                             [&](uint32_t a, uint32_t b) { return centroids[a] < centroids[b]; });
+            split = true;
+        }
+        if (!split)
+        {
+            ++stats_.leaves;
+            continue;
+        }
+        stack.push_back({mid, range.end, index, range.depth + 1, true});
+        stack.push_back({range.begin, mid, index, range.depth + 1, false});
+    }
+    stats_.nodes = static_cast<uint32_t>(nodes_.size());
+
+    const size_t padded = static_cast<size_t>(count) + k_simd_padding;
+    center_x_.assign(padded, 0.0f);
+    center_y_.assign(padded, 0.0f);
+    extent_x_.assign(padded, 0.0f);
+    extent_y_.assign(padded, 0.0f);
+    slot_of_.resize(count);
+    leaf_of_.resize(count);
+    for (uint32_t index = 0; index < nodes_.size(); ++index)
+    {
+        const Node& node = nodes_[index];
+        if (node.right != 0)
+            continue;
+        for (uint32_t slot = node.first; slot < node.first + node.count; ++slot)
+        {
+            slot_of_[order_[slot]] = slot;
+            leaf_of_[order_[slot]] = index;
+            write_object(slot, bounds[order_[slot]]);
+        }
+    }
+    dirty_.assign(nodes_.size(), 0);
+
+    stats_.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void SceneBvh::write_object(uint32_t slot, const Aabb& bounds)
+{
+    center_x_[slot] = (bounds.min_x + bounds.max_x) * 0.5f;
+    center_y_[slot] = (bounds.min_y + bounds.max_y) * 0.5f;
+    extent_x_[slot] = (bounds.max_x - bounds.min_x) * 0.5f;
+    extent_y_[slot] = (bounds.max_y - bounds.min_y) * 0.5f;
+}
+
+void SceneBvh::refit_node(uint32_t index)
+{
+    Node& node = nodes_[index];
+    if (node.right != 0)
+    {
+        node.bounds = merge(nodes_[index + 1].bounds, nodes_[node.right].bounds);
+        return;
+    }
+    Aabb bounds = empty_bounds();
+    for (uint32_t slot = node.first; slot < node.first + node.count; ++slot)
+    {
+        bounds = merge(bounds, {center_x_[slot] - extent_x_[slot], center_y_[slot] - extent_y_[slot],
+                                center_x_[slot] + extent_x_[slot], center_y_[slot] + extent_y_[slot]});
+    }
+    node.bounds = bounds;
+}
+
+void SceneBvh::refit(std::span<const Aabb> bounds)
+{
+    if (bounds.size() != order_.size())
+        throw std::runtime_error("SceneBvh::refit: object count changed, build again instead");
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (uint32_t slot = 0; slot < order_.size(); ++slot)
+    {
+        write_object(slot, bounds[order_[slot]]);
+    }
+    // 孩子的下标总比父节点大, 倒序遍历即自底向上
+    for (auto index = static_cast<uint32_t>(nodes_.size()); index-- > 0;)
+    {
+        refit_node(index);
+    }
+
+    ++stats_.refits;
+    stats_.refit_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void SceneBvh::refit(std::span<const Aabb> bounds, std::span<const uint32_t> moved)
+{
+    if (bounds.size() != order_.size())
+        throw std::runtime_error("SceneBvh::refit: object count changed, build again instead");
+    const auto begin = std::chrono::steady_clock::now();
+
+    // 标记叶子到根的路径, 遇到已经标记的节点说明上面的路径也已标记
+    uint32_t last_dirty = 0;
+    for (const uint32_t object : moved)
+    {
+        write_object(slot_of_[object], bounds[object]);
+        last_dirty = std::max(last_dirty, leaf_of_[object]);
+        for (uint32_t index = leaf_of_[object]; index != k_nil && !dirty_[index]; index = nodes_[index].parent)
+        {
+            dirty_[index] = 1;
+        }
+    }
+    if (!moved.empty())
+    {
+        for (uint32_t index = last_dirty + 1; index-- > 0;)
+        {
+            if (!dirty_[index])
+                continue;
+            refit_node(index);
+            dirty_[index] = 0;
+        }
+    }
+
+    ++stats_.refits;
+    stats_.refit_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+uint32_t SceneBvh::test_objects(const Frustum& frustum, uint32_t first, uint32_t count) const
+{
+    const float* cx = center_x_.data() + first;
+    const float* cy = center_y_.data() + first;
+    const float* ex = extent_x_.data() + first;
+    const float* ey = extent_y_.data() + first;
+    switch (frustum.simd)
+    {
+#ifdef VULKAN_LEARN_AVX2
+    case Simd::Avx2:
+        return test_objects_avx2(frustum, cx, cy, ex, ey, count);
+#endif
+#ifdef VULKAN_LEARN_SSE
+    case Simd::Sse:
+        return test_objects_sse(frustum, cx, cy, ex, ey, count);
+#endif
+    default:
+        return test_objects_scalar(frustum, cx, cy, ex, ey, count);
+    }
+}
+
+void SceneBvh::cull_subtree(const Frustum& frustum, uint32_t root, std::vector<uint32_t>& visible) const
+{
+    // 左孩子直接继续, 右孩子入栈, 栈深不超过树高
+    std::vector<uint32_t> stack;
+    stack.reserve(stats_.max_depth + 1);
+    uint32_t index = root;
+    while (true)
+    {
+        const Node& node = nodes_[index];
+        const Overlap overlap = classify(frustum, node.bounds);
+        if (overlap == Overlap::Inside)
+        {
+            visible.insert(visible.end(), order_.begin() + node.first, order_.begin() + node.first + node.count);
+        }
+        else if (overlap == Overlap::Partial)
+        {
+            if (node.right != 0)
+            {
+                stack.push_back(node.right);
+                ++index;
+                continue;
+            }
+            for (uint32_t mask = test_objects(frustum, node.first, node.count); mask != 0; mask &= mask - 1)
+            {
+                visible.push_back(order_[node.first + std::countr_zero(mask)]);
+            }
+        }
+
+        if (stack.empty())
+            break;
+        index = stack.back();
+        stack.pop_back();
+    }
+}
+
+uint32_t SceneBvh::cull(const Planes& planes, std::vector<uint32_t>& visible) const
+{
+    if (nodes_.empty())
+        return 0;
+    const size_t before = visible.size();
+    cull_subtree(make_frustum(planes, simd_), 0, visible);
+    return static_cast<uint32_t>(visible.size() - before);
+}
+
+uint32_t SceneBvh::cull(const Planes& planes, TaskPool& pool, std::vector<uint32_t>& visible)
+{
+    if (nodes_.empty())
+        return 0;
+    if (pool.thread_count() <= 1)
+        return cull(planes, visible);
+
+    // 逐层把内部节点换成它的两个孩子, 保持先序, 直到子树数够分; 上层节点不单独测试,
+    // 孩子的包围盒被父节点包含, 结果与从根开始遍历相同
+    const uint32_t target = pool.thread_count() * k_tasks_per_thread;
+    task_roots_.assign(1, 0);
+    std::vector<uint32_t> next;
+    while (task_roots_.size() < target)
+    {
+        next.clear();
+        for (const uint32_t root : task_roots_)
+        {
+            if (nodes_[root].right == 0)
+            {
+                next.push_back(root);
+                continue;
+            }
+            next.push_back(root + 1);
+            next.push_back(nodes_[root].right);
+        }
+        if (next.size() == task_roots_.size())
+            break;
+        task_roots_.swap(next);
+    }
+
+    const auto frustum = make_frustum(planes, simd_);
+    task_visible_.resize(task_roots_.size());
+    pool.run(static_cast<uint32_t>(task_roots_.size()), [&](uint32_t task)
+    {
+        task_visible_[task].clear();
+        cull_subtree(frustum, task_roots_[task], task_visible_[task]);
+    });
+
+    const size_t before = visible.size();
+    for (uint32_t task = 0; task < task_roots_.size(); ++task)
+    {
+        visible.insert(visible.end(), task_visible_[task].begin(), task_visible_[task].end());
+    }
+    return static_cast<uint32_t>(visible.size() - before);
+}
+
+uint32_t SceneBvh::cull_linear(std::span<const Aabb> bounds, const Planes& planes, std::vector<uint32_t>& visible)
+{
+    const auto frustum = make_frustum(planes, Simd::Scalar);
+    const size_t before = visible.size();
+    for (uint32_t object = 0; object < bounds.size(); ++object)
+    {
+        const Aabb& box = bounds[object];
+        const float cx = (box.min_x + box.max_x) * 0.5f;
+        const float cy = (box.min_y + box.max_y) * 0.5f;
+        const float ex = (box.max_x - box.min_x) * 0.5f;
+        const float ey = (box.max_y - box.min_y) * 0.5f;
+        if (test_objects_scalar(frustum, &cx, &cy, &ex, &ey, 1) != 0)
+            visible.push_back(object);
+    }
+    return static_cast<uint32_t>(visible.size() - before);
+}
+
+float SceneBvh::sah_cost() const
+{
+    if (nodes_.empty())
+        return 0;
+    const float root_area = half_perimeter(nodes_[0].bounds);
+    if (root_area <= 0)
+        return k_object_cost * static_cast<float>(nodes_[0].count);
+
+    // 节点被访问的概率按它与根的半周长之比估计
+    float cost = 0;
+    for (const Node& node : nodes_)
+    {
+        const float probability = half_perimeter(node.bounds) / root_area;
+        cost += probability * (node.right != 0 ? k_traversal_cost : k_object_cost * static_cast<float>(node.count));
+    }
+    return cost;
+}
+
+void SceneBvh::print_stats() const
+{
+    fmt::println("[bvh] {} objects, {} nodes, {} leaves, depth {}, sah cost {:.2f}, {}; build {:.3f} ms, "
+                 "{} refits averaging {:.3f} ms",
+                 stats_.objects, stats_.nodes, stats_.leaves, stats_.max_depth, sah_cost(),
+                 magic_enum::enum_name(simd_), stats_.build_ms, stats_.refits,
+                 stats_.refits ? stats_.refit_ms / static_cast<double>(stats_.refits) : 0.0);
+}
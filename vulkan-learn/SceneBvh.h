@@ -0,0 +1,151 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_SCENEBVH_H
+#define VULKAN_LEARN_SCENEBVH_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Simd.h"
+#include "TaskPool.h"
+
+/**
+ * @brief CPU 端的场景层次包围盒 (BVH), 用于大场景的视锥剔除
+ *
+ * 场景是裁剪空间中的二维物体, 包围盒是 xy 平面上的轴对齐矩形. 节点按深度优先的先序存放在一个连续数组中,
+ * 左孩子紧跟在父节点之后, 只记录右孩子的下标; 每个节点 32 字节, 一条缓存行两个节点.
+ * 物体下标按树的顺序重排, 每棵子树的物体在 order() 中是连续的一段, 整棵子树都在视锥内时直接整段输出.
+ * 叶子中物体的包围盒另外按 SoA (中心 x / y, 半宽 x / y 各一个数组) 存放, 供 SIMD 成批测试.
+ *
+ * build 用分箱的 SAH (二维下以半周长代替表面积) 划分; 物体移动后 refit 自底向上更新包围盒, 树的结构不变,
+ * 移动幅度大时 sah_cost() 会变差, 由调用方决定何时重新 build.
+ *
+ * 视锥测试与 shader/cull.comp 相同: 平面 (nx, ny, 0, d), 中心到平面的距离小于包围盒在法线上的投影半径时剔除.
+ * 节点用 SSE 一次测试四个平面; 叶子中的物体在支持 AVX2 的 CPU 上一次测试 8 个, 否则 SSE 一次 4 个.
+ */
+class SceneBvh
+{
+public:
+    // 叶子最多容纳的物体数, 正好一次 AVX2 测试
+    static constexpr uint32_t k_max_leaf_size = 8;
+    static constexpr uint32_t k_bin_count = 16;
+
+    struct Aabb
+    {
+        float min_x = 0;
+        float min_y = 0;
+        float max_x = 0;
+        float max_y = 0;
+    };
+
+    // 与 GpuCulling::Constants::planes 相同, 只使用 x, y, w 三项
+    using Planes = std::array<std::array<float, 4>, 4>;
+
+    using Simd = SimdLevel;
+
+    // 剔除时使用的平面形式 (四个平面按分量转置), 定义在 SceneBvh.cpp
+    struct Frustum;
+
+    struct alignas(32) Node
+    {
+        Aabb bounds;
+        // 子树的物体在 order() 中的范围
+        uint32_t first = 0;
+        uint32_t count = 0;
+        // 0 表示叶子 (根节点不会是右孩子); 左孩子是下一个节点
+        uint32_t right = 0;
+        // 根节点为 UINT32_MAX
+        uint32_t parent = 0;
+    };
+
+    struct Stats
+    {
+        uint32_t objects = 0;
+        uint32_t nodes = 0;
+        uint32_t leaves = 0;
+        uint32_t max_depth = 0;
+        double build_ms = 0;
+        uint64_t refits = 0;
+        double refit_ms = 0; // 所有 refit 的耗时之和
+    };
+
+    SceneBvh();
+    SceneBvh(const SceneBvh&) = delete;
+    SceneBvh& operator=(const SceneBvh&) = delete;
+
+    // bounds 按物体下标排列, 之后的 refit 和剔除结果都使用同样的下标
+    void build(std::span<const Aabb> bounds);
+
+    // 所有物体都可能移动: 整体刷新叶子数据, 再自底向上重算每个节点
+    void refit(std::span<const Aabb> bounds);
+
+    // 只有 moved 中的物体移动: 只重算它们所在的叶子和祖先; bounds 仍是全部物体的包围盒
+    void refit(std::span<const Aabb> bounds, std::span<const uint32_t> moved);
+
+    // 把可见物体的下标追加到 visible, 按 order() 的顺序; 返回追加的个数
+    uint32_t cull(const Planes& planes, std::vector<uint32_t>& visible) const;
+
+    // 同上, 树的上层切成若干子树分给 pool 的线程遍历, 结果按子树顺序拼接, 与单线程的结果完全相同
+    uint32_t cull(const Planes& planes, TaskPool& pool, std::vector<uint32_t>& visible);
+
+    // 不经过 BVH 逐个测试所有物体, 作为对照
+    static uint32_t cull_linear(std::span<const Aabb> bounds, const Planes& planes, std::vector<uint32_t>& visible);
+
+    // 见 SimdLevel
+    void set_simd(Simd simd);
+
+    Simd simd() const { return simd_; }
+
+    // 以节点测试为单位的 SAH 代价 (各节点按与根的半周长之比加权), 用于比较 refit 前后树的质量
+    float sah_cost() const;
+
+    std::span<const Node> nodes() const { return nodes_; }
+
+    std::span<const uint32_t> order() const { return order_; }
+
+    bool empty() const { return nodes_.empty(); }
+
+    Stats stats() const { return stats_; }
+
+    void print_stats() const;
+
+private:
+    static Frustum make_frustum(const Planes& planes, Simd simd);
+
+    // 遍历 root 为根的子树
+    void cull_subtree(const Frustum& frustum, uint32_t root, std::vector<uint32_t>& visible) const;
+
+    // 叶子中 [first, first + count) 的物体里可见的那些, 按位返回
+    uint32_t test_objects(const Frustum& frustum, uint32_t first, uint32_t count) const;
+
+    // 从叶子的 SoA 数据或两个孩子重算节点的包围盒
+    void refit_node(uint32_t index);
+
+    void write_object(uint32_t slot, const Aabb& bounds);
+
+    std::vector<Node> nodes_;
+    // 树中的第 slot 个物体 -> 物体下标
+    std::vector<uint32_t> order_;
+    // 物体下标 -> 树中的位置和所在的叶子
+    std::vector<uint32_t> slot_of_;
+    std::vector<uint32_t> leaf_of_;
+    // 按 order_ 排列的物体包围盒, 末尾补齐一个 SIMD 宽度, 成批读取时不会越界
+    std::vector<float> center_x_;
+    std::vector<float> center_y_;
+    std::vector<float> extent_x_;
+    std::vector<float> extent_y_;
+    // 增量 refit 中需要重算的节点
+    std::vector<uint8_t> dirty_;
+    // 并行剔除时每棵子树的根和输出
+    std::vector<uint32_t> task_roots_;
+    std::vector<std::vector<uint32_t>> task_visible_;
+    Simd simd_ = Simd::Scalar;
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_SCENEBVH_H
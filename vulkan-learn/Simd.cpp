@@ -0,0 +1,22 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "Simd.h"
+
+SimdLevel best_simd_level()
+{
+    static const SimdLevel best = []
+    {
+#ifdef VULKAN_LEARN_AVX2
+        if (__builtin_cpu_supports("avx2"))
+            return SimdLevel::Avx2;
+#endif
+#ifdef VULKAN_LEARN_SSE
+        return SimdLevel::Sse;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }();
+    return best;
+}
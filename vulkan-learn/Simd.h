@@ -0,0 +1,40 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_SIMD_H
+#define VULKAN_LEARN_SIMD_H
+
+#include <cstdint>
+
+// x86-64 一定有 SSE2; AVX2 版本的函数用函数级的 target 属性编译, 工程不需要加 -mavx2, 运行时按 CPU 选择.
+// MSVC 下只用 SSE
+#if defined(__x86_64__) || defined(_M_X64)
+#define VULKAN_LEARN_SSE 1
+#include <immintrin.h>
+#endif
+
+#if defined(VULKAN_LEARN_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define VULKAN_LEARN_AVX2 1
+#define VULKAN_LEARN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/**
+ * @brief 手写 SIMD 路径的指令集级别, 可以强制使用较低的级别做对比
+ *
+ * 带 SIMD 路径的模块 (SceneBvh, TransformStore) 遵守同一约定:
+ *  - 默认使用 best_simd_level(); set_simd 只能降级, 超过 best_simd_level() 时取 best_simd_level()
+ *  - 各级别的实现运算顺序相同并且都不用 FMA, 结果逐位一致, 切换级别只影响速度
+ */
+enum class SimdLevel : uint32_t
+{
+    Scalar,
+    Sse,
+    Avx2,
+};
+
+// 当前 CPU 支持并且编译进来的最高级别
+SimdLevel best_simd_level();
+
+
+#endif //VULKAN_LEARN_SIMD_H
@@ -0,0 +1,109 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "StartupProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include <fmt/format.h>
+
+void StartupProfiler::begin_session()
+{
+    std::lock_guard lock(mutex_);
+    origin_ = clock::now();
+    phases_.clear();
+    thread_indices_.clear();
+}
+
+void StartupProfiler::record(std::string_view name, clock::time_point begin, clock::time_point end)
+{
+    std::lock_guard lock(mutex_);
+    phases_.push_back(Phase{
+        .name = std::string(name),
+        .thread = thread_index(std::this_thread::get_id()),
+        .start_ms = std::chrono::duration<double, std::milli>(begin - origin_).count(),
+        .duration_ms = std::chrono::duration<double, std::milli>(end - begin).count(),
+    });
+}
+
+std::vector<StartupProfiler::Phase> StartupProfiler::phases() const
+{
+    std::lock_guard lock(mutex_);
+    auto phases = phases_;
+    std::ranges::stable_sort(phases, {}, &Phase::start_ms);
+    return phases;
+}
+
+double StartupProfiler::total_ms() const
+{
+    std::lock_guard lock(mutex_);
+    double total = 0;
+    for (const auto& phase : phases_)
+    {
+        total = std::max(total, phase.start_ms + phase.duration_ms);
+    }
+    return total;
+}
+
+void StartupProfiler::export_chrome_trace(const std::filesystem::path& path) const
+{
+    auto escape = [](std::string_view text)
+    {
+        std::string result;
+        for (const char c : text)
+        {
+            if (c == '"' || c == '\\')
+                result.push_back('\\');
+            result.push_back(c);
+        }
+        return result;
+    };
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file)
+    {
+        fmt::println("[startup] failed to write {}", path.string());
+        return;
+    }
+
+    // Chrome trace 的 ts/dur 单位是微秒, "X" 为完整事件
+    file << R"({"displayTimeUnit":"ms","traceEvents":[)";
+    bool first = true;
+    for (const auto& [name, thread, start_ms, duration_ms] : phases())
+    {
+        file << (first ? "\n" : ",\n");
+        file << fmt::format(R"({{"name":"{}","cat":"startup","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                            escape(name), thread, start_ms * 1000.0, duration_ms * 1000.0);
+        first = false;
+    }
+    file << "\n]}\n";
+}
+
+std::string StartupProfiler::summary() const
+{
+    std::string line = fmt::format("startup {:.2f}ms:", total_ms());
+    for (const auto& phase : phases())
+    {
+        line += fmt::format(" {} {:.2f}ms,", phase.name, phase.duration_ms);
+    }
+    line.pop_back();
+    return line;
+}
+
+double StartupProfiler::percentile(std::vector<double>& samples, double p)
+{
+    if (samples.empty())
+        return 0;
+    std::ranges::sort(samples);
+    const auto rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+    return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+}
+
+uint32_t StartupProfiler::thread_index(std::thread::id id)
+{
+    const auto [it, inserted] = thread_indices_.try_emplace(id, static_cast<uint32_t>(thread_indices_.size()));
+    return it->second;
+}
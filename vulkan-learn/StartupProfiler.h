@@ -0,0 +1,87 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_STARTUPPROFILER_H
+#define VULKAN_LEARN_STARTUPPROFILER_H
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 启动阶段计时
+ *
+ * 用 scope() 包住每个初始化步骤, 结束后可以导出 Chrome trace / Perfetto 可直接打开的 JSON,
+ * 或者打印一行汇总. 记录是线程安全的, 并行初始化时每个工作线程会显示为独立的轨道.
+ */
+class StartupProfiler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct Phase
+    {
+        std::string name;
+        uint32_t thread;
+        double start_ms;
+        double duration_ms;
+    };
+
+    class Scope
+    {
+    public:
+        Scope(StartupProfiler& profiler, std::string_view name)
+            : profiler_(&profiler), name_(name), begin_(clock::now())
+        {
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope()
+        {
+            profiler_->record(name_, begin_, clock::now());
+        }
+
+    private:
+        StartupProfiler* profiler_;
+        std::string_view name_;
+        clock::time_point begin_;
+    };
+
+    // 清空记录并以当前时刻为时间原点
+    void begin_session();
+
+    [[nodiscard]] Scope scope(std::string_view name) { return {*this, name}; }
+
+    void record(std::string_view name, clock::time_point begin, clock::time_point end);
+
+    std::vector<Phase> phases() const;
+
+    // 会话开始到最后一个阶段结束的耗时
+    double total_ms() const;
+
+    void export_chrome_trace(const std::filesystem::path& path) const;
+
+    std::string summary() const;
+
+    // 最近秩法求百分位, samples 会被排序
+    static double percentile(std::vector<double>& samples, double p);
+
+private:
+    uint32_t thread_index(std::thread::id id);
+
+    mutable std::mutex mutex_;
+    clock::time_point origin_ = clock::now();
+    std::vector<Phase> phases_;
+    std::unordered_map<std::thread::id, uint32_t> thread_indices_;
+};
+
+
+#endif //VULKAN_LEARN_STARTUPPROFILER_H
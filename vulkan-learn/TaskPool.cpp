@@ -0,0 +1,120 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "TaskPool.h"
+
+#include <algorithm>
+
+TaskPool::~TaskPool()
+{
+    destroy();
+}
+
+void TaskPool::init(uint32_t thread_count)
+{
+    destroy();
+    thread_count_ = std::max(thread_count, 1u);
+    // generation_ 跨 destroy / init 保留, 新线程从当前值开始等待, 不会把上一轮的最后一个任务当成新任务
+    uint64_t generation;
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = false;
+        generation = generation_;
+    }
+    workers_.reserve(thread_count_ - 1);
+    for (uint32_t i = 1; i < thread_count_; ++i)
+    {
+        workers_.emplace_back([this, generation] { worker_loop(generation); });
+    }
+}
+
+void TaskPool::destroy()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    start_cv_.notify_all();
+    workers_.clear(); // join
+    thread_count_ = 0;
+}
+
+void TaskPool::run(uint32_t task_count, const Task& task)
+{
+    if (task_count == 0)
+        return;
+    if (workers_.empty() || task_count == 1)
+    {
+        for (uint32_t i = 0; i < task_count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    task_ = &task;
+    task_count_ = task_count;
+    next_task_.store(0, std::memory_order_relaxed);
+    {
+        std::lock_guard lock(mutex_);
+        running_ = static_cast<uint32_t>(workers_.size());
+        error_ = nullptr;
+        ++generation_;
+    }
+    start_cv_.notify_all();
+
+    drain();
+
+    std::exception_ptr error;
+    {
+        std::unique_lock lock(mutex_);
+        done_cv_.wait(lock, [this] { return running_ == 0; });
+        error = error_;
+    }
+    task_ = nullptr;
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void TaskPool::worker_loop(uint64_t seen)
+{
+    while (true)
+    {
+        {
+            std::unique_lock lock(mutex_);
+            start_cv_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_)
+                return;
+            seen = generation_;
+        }
+
+        drain();
+
+        std::lock_guard lock(mutex_);
+        if (--running_ == 0)
+            done_cv_.notify_one();
+    }
+}
+
+void TaskPool::drain()
+{
+    while (true)
+    {
+        const uint32_t index = next_task_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= task_count_)
+            return;
+        try
+        {
+            (*task_)(index);
+        }
+        catch (...)
+        {
+            std::lock_guard lock(mutex_);
+            if (!error_)
+                error_ = std::current_exception();
+            // 剩下的任务不再领取
+            next_task_.store(task_count_, std::memory_order_relaxed);
+        }
+    }
+}
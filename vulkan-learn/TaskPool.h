@@ -0,0 +1,74 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_TASKPOOL_H
+#define VULKAN_LEARN_TASKPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 常驻工作线程上的 parallel-for
+ *
+ * run 把 [0, task_count) 的任务交给调用线程和工作线程, 每个线程用原子计数依次领取下一个任务, 全部完成后返回.
+ * 任务之间没有顺序保证, 需要有序的结果时按任务下标写入各自的输出. 工作线程在 init 时创建,
+ * 两次 run 之间在条件变量上等待, 不会每次调用都创建线程.
+ * 未初始化或只有一个线程时 run 在调用线程上依次执行所有任务.
+ */
+class TaskPool
+{
+public:
+    using Task = std::function<void(uint32_t task)>;
+
+    TaskPool() = default;
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    ~TaskPool();
+
+    // thread_count 包括调用线程
+    void init(uint32_t thread_count);
+
+    void destroy();
+
+    bool initialized() const { return thread_count_ != 0; }
+
+    uint32_t thread_count() const { return std::max(thread_count_, 1u); }
+
+    // 同一时间只能有一个调用方; 任务抛出的第一个异常在所有线程停下后重新抛出, 之后的任务不再领取
+    void run(uint32_t task_count, const Task& task);
+
+private:
+    // seen: 创建线程时的 generation_, 之前的任务与这个线程无关
+    void worker_loop(uint64_t seen);
+
+    // 领取并执行任务, 直到没有剩余
+    void drain();
+
+    uint32_t thread_count_ = 0;
+
+    // 当前任务, 在 generation_ 变化前由调用线程写好
+    const Task* task_ = nullptr;
+    uint32_t task_count_ = 0;
+    std::atomic<uint32_t> next_task_ = 0;
+
+    std::vector<std::jthread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_ = 0;
+    uint32_t running_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+};
+
+
+#endif //VULKAN_LEARN_TASKPOOL_H
@@ -0,0 +1,229 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity) : capacity_(capacity)
+{
+    for (auto& heads : free_heads_)
+    {
+        heads.fill(k_nil);
+    }
+    if (capacity_ == 0)
+        return;
+
+    const uint32_t node = new_node();
+    nodes_[node].offset = 0;
+    nodes_[node].size = capacity_;
+    insert_free(node);
+}
+
+std::optional<TlsfAllocator::Allocation> TlsfAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+    size = std::max<uint64_t>(size, 1);
+    alignment = std::max<uint64_t>(alignment, 1);
+    assert(std::has_single_bit(alignment));
+
+    // 按最坏情况的对齐填充查找, 找到的块一定放得下
+    const auto index = mapping_search(size + alignment - 1);
+    if (!index || size > capacity_)
+        return std::nullopt;
+
+    uint32_t node = find_free(*index);
+    if (node == k_nil)
+        return std::nullopt;
+    remove_free(node);
+
+    const uint64_t offset = nodes_[node].offset;
+    const uint64_t padding = (offset + alignment - 1) / alignment * alignment - offset;
+    if (padding > 0)
+    {
+        // 对齐产生的前部空隙作为独立的空闲块留下
+        const uint32_t tail = split(node, padding);
+        insert_free(node);
+        node = tail;
+    }
+
+    if (nodes_[node].size - size >= k_min_block_size)
+    {
+        insert_free(split(node, size));
+    }
+
+    Node& allocated = nodes_[node];
+    allocated.free = false;
+    used_ += allocated.size;
+    ++allocation_count_;
+    return Allocation{allocated.offset, allocated.size, node};
+}
+
+void TlsfAllocator::free(uint32_t handle)
+{
+    assert(handle < nodes_.size() && !nodes_[handle].free);
+
+    used_ -= nodes_[handle].size;
+    --allocation_count_;
+    nodes_[handle].free = true;
+
+    if (const uint32_t next = nodes_[handle].next_phys; next != k_nil && nodes_[next].free)
+    {
+        remove_free(next);
+        merge_next(handle);
+    }
+    if (const uint32_t prev = nodes_[handle].prev_phys; prev != k_nil && nodes_[prev].free)
+    {
+        remove_free(prev);
+        merge_next(prev);
+        handle = prev;
+    }
+    insert_free(handle);
+}
+
+TlsfAllocator::Stats TlsfAllocator::stats() const
+{
+    Stats stats;
+    stats.capacity = capacity_;
+    stats.used = used_;
+    stats.free = capacity_ - used_;
+    stats.allocation_count = allocation_count_;
+    if (capacity_ == 0)
+        return stats;
+
+    // 第 0 个节点始终位于偏移 0, 不会被合并进前驱
+    for (uint32_t node = 0; node != k_nil; node = nodes_[node].next_phys)
+    {
+        if (nodes_[node].free)
+        {
+            ++stats.free_block_count;
+            stats.largest_free = std::max(stats.largest_free, nodes_[node].size);
+        }
+    }
+    return stats;
+}
+
+TlsfAllocator::Index TlsfAllocator::mapping_insert(uint64_t size)
+{
+    if (size < k_sl_count)
+        return {0, static_cast<uint32_t>(size)};
+
+    const auto fl = static_cast<uint32_t>(std::bit_width(size) - 1);
+    const auto sl = static_cast<uint32_t>(size >> (fl - k_sl_log2)) & (k_sl_count - 1);
+    return {fl - k_sl_log2 + 1, sl};
+}
+
+std::optional<TlsfAllocator::Index> TlsfAllocator::mapping_search(uint64_t size)
+{
+    if (size >= k_sl_count)
+    {
+        const uint64_t round = (uint64_t{1} << (std::bit_width(size) - 1 - k_sl_log2)) - 1;
+        if (size > UINT64_MAX - round)
+            return std::nullopt;
+        size += round;
+    }
+    return mapping_insert(size);
+}
+
+uint32_t TlsfAllocator::find_free(Index index) const
+{
+    auto [fl, sl] = index;
+    uint32_t sl_map = sl_bitmap_[fl] & (~0u << sl);
+    if (sl_map == 0)
+    {
+        const uint64_t fl_map = fl + 1 < k_fl_count ? fl_bitmap_ & (~uint64_t{0} << (fl + 1)) : 0;
+        if (fl_map == 0)
+            return k_nil;
+        fl = static_cast<uint32_t>(std::countr_zero(fl_map));
+        sl_map = sl_bitmap_[fl];
+    }
+    sl = static_cast<uint32_t>(std::countr_zero(sl_map));
+    return free_heads_[fl][sl];
+}
+
+uint32_t TlsfAllocator::new_node()
+{
+    if (!unused_nodes_.empty())
+    {
+        const uint32_t node = unused_nodes_.back();
+        unused_nodes_.pop_back();
+        nodes_[node] = Node{};
+        return node;
+    }
+    nodes_.emplace_back();
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+void TlsfAllocator::insert_free(uint32_t node)
+{
+    const auto [fl, sl] = mapping_insert(nodes_[node].size);
+    const uint32_t head = free_heads_[fl][sl];
+
+    nodes_[node].free = true;
+    nodes_[node].prev_free = k_nil;
+    nodes_[node].next_free = head;
+    if (head != k_nil)
+        nodes_[head].prev_free = node;
+
+    free_heads_[fl][sl] = node;
+    fl_bitmap_ |= uint64_t{1} << fl;
+    sl_bitmap_[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::remove_free(uint32_t node)
+{
+    const auto [fl, sl] = mapping_insert(nodes_[node].size);
+    const uint32_t prev = nodes_[node].prev_free;
+    const uint32_t next = nodes_[node].next_free;
+
+    if (prev != k_nil)
+        nodes_[prev].next_free = next;
+    if (next != k_nil)
+        nodes_[next].prev_free = prev;
+
+    if (free_heads_[fl][sl] == node)
+    {
+        free_heads_[fl][sl] = next;
+        if (next == k_nil)
+        {
+            sl_bitmap_[fl] &= ~(1u << sl);
+            if (sl_bitmap_[fl] == 0)
+                fl_bitmap_ &= ~(uint64_t{1} << fl);
+        }
+    }
+    nodes_[node].prev_free = k_nil;
+    nodes_[node].next_free = k_nil;
+}
+
+uint32_t TlsfAllocator::split(uint32_t node, uint64_t size)
+{
+    const uint32_t tail = new_node();
+    Node& head = nodes_[node];
+    Node& rest = nodes_[tail];
+
+    rest.offset = head.offset + size;
+    rest.size = head.size - size;
+    rest.prev_phys = node;
+    rest.next_phys = head.next_phys;
+    rest.free = true;
+    if (head.next_phys != k_nil)
+        nodes_[head.next_phys].prev_phys = tail;
+
+    head.next_phys = tail;
+    head.size = size;
+    return tail;
+}
+
+void TlsfAllocator::merge_next(uint32_t node)
+{
+    const uint32_t next = nodes_[node].next_phys;
+    nodes_[node].size += nodes_[next].size;
+    nodes_[node].next_phys = nodes_[next].next_phys;
+    if (nodes_[node].next_phys != k_nil)
+        nodes_[nodes_[node].next_phys].prev_phys = node;
+
+    nodes_[next] = Node{};
+    unused_nodes_.push_back(next);
+}
@@ -0,0 +1,109 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_TLSFALLOCATOR_H
+#define VULKAN_LEARN_TLSFALLOCATOR_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief 基于偏移量的 TLSF (Two-Level Segregated Fit) 子分配器
+ *
+ * 只管理 [0, capacity) 区间内的偏移, 不接触实际内存, 因此可以用来切分 VkDeviceMemory.
+ * 空闲块按 (一级: 2 的幂, 二级: 每个幂区间再等分 k_sl_count 份) 分桶, 用位图在 O(1) 内找到
+ * 足够大的空闲块; 释放时与物理上相邻的空闲块合并.
+ *
+ * 块的元数据保存在 nodes_ 中, 分配返回的 handle 即节点下标.
+ */
+class TlsfAllocator
+{
+public:
+    struct Allocation
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t handle;
+    };
+
+    struct Stats
+    {
+        uint64_t capacity = 0;
+        uint64_t used = 0;
+        uint64_t free = 0;
+        uint64_t largest_free = 0;
+        uint32_t allocation_count = 0;
+        uint32_t free_block_count = 0;
+    };
+
+    TlsfAllocator() = default;
+    explicit TlsfAllocator(uint64_t capacity);
+
+    std::optional<Allocation> allocate(uint64_t size, uint64_t alignment);
+
+    void free(uint32_t handle);
+
+    bool empty() const { return allocation_count_ == 0; }
+
+    uint64_t capacity() const { return capacity_; }
+
+    Stats stats() const;
+
+private:
+    static constexpr uint32_t k_sl_log2 = 4;
+    static constexpr uint32_t k_sl_count = 1u << k_sl_log2;
+    static constexpr uint32_t k_fl_count = 64;
+    static constexpr uint32_t k_nil = UINT32_MAX;
+    // 比这个还小的尾部不再单独拆成空闲块
+    static constexpr uint64_t k_min_block_size = 16;
+
+    struct Node
+    {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint32_t prev_phys = k_nil;
+        uint32_t next_phys = k_nil;
+        uint32_t prev_free = k_nil;
+        uint32_t next_free = k_nil;
+        bool free = false;
+    };
+
+    struct Index
+    {
+        uint32_t fl;
+        uint32_t sl;
+    };
+
+    static Index mapping_insert(uint64_t size);
+
+    // 向上取整到下一个二级区间, 保证该桶中的任何块都不小于 size
+    static std::optional<Index> mapping_search(uint64_t size);
+
+    uint32_t find_free(Index index) const;
+
+    uint32_t new_node();
+
+    void insert_free(uint32_t node);
+
+    void remove_free(uint32_t node);
+
+    // 把 node 从 size 处切开, 返回切下的后半部分(空闲, 未插入空闲表)
+    uint32_t split(uint32_t node, uint64_t size);
+
+    void merge_next(uint32_t node);
+
+    uint64_t capacity_ = 0;
+    uint64_t used_ = 0;
+    uint32_t allocation_count_ = 0;
+    uint64_t fl_bitmap_ = 0;
+    std::array<uint32_t, k_fl_count> sl_bitmap_{};
+    std::array<std::array<uint32_t, k_sl_count>, k_fl_count> free_heads_{};
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> unused_nodes_;
+};
+
+
+#endif //VULKAN_LEARN_TLSFALLOCATOR_H
@@ -0,0 +1,593 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "TransformStore.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    using GpuTransform = TransformStore::GpuTransform;
+
+    static_assert(sizeof(GpuTransform) == 8 * sizeof(float));
+    static_assert(TransformStore::k_chunk_size % 8 == 0);
+
+    // 一次 update_range 用到的数组
+    struct Streams
+    {
+        const float* position_x;
+        const float* position_y;
+        const float* depth;
+        const float* rotation;
+        const float* scale_x;
+        const float* scale_y;
+        const uint32_t* parent; // 根一层为空
+        // 父实体的世界变换从这里读, 这一层的结果写回同样的数组; keep_world 为 false 时不写
+        float* world_m00;
+        float* world_m10;
+        float* world_m01;
+        float* world_m11;
+        float* world_x;
+        float* world_y;
+        float* world_depth;
+        bool keep_world;
+        // 实体 first_out + k 写进 out[k], k < out_count
+        GpuTransform* out;
+        uint32_t first_out;
+        uint32_t out_count;
+    };
+
+    // sincos 使用 Cephes 的 sinf / cosf: 按 pi / 4 的整数倍 (取偶数) 归约, 三段常数减去以保留精度,
+    // 再在 [-pi / 4, pi / 4] 上用多项式, 按象限交换 sin / cos 并决定符号
+    constexpr float k_four_over_pi = 1.27323954473516f;
+    constexpr float k_dp1 = 0.78515625f;
+    constexpr float k_dp2 = 2.4187564849853515625e-4f;
+    constexpr float k_dp3 = 3.77489497744594108e-8f;
+    constexpr float k_sin_p0 = -1.9515295891e-4f;
+    constexpr float k_sin_p1 = 8.3321608736e-3f;
+    constexpr float k_sin_p2 = -1.6666654611e-1f;
+    constexpr float k_cos_p0 = 2.443315711809948e-5f;
+    constexpr float k_cos_p1 = -1.388731625493765e-3f;
+    constexpr float k_cos_p2 = 4.166664568298827e-2f;
+
+    void sincos_scalar(float x, float& sin_value, float& cos_value)
+    {
+        const float ax = std::abs(x);
+        int j = static_cast<int>(ax * k_four_over_pi);
+        j = (j + 1) & ~1;
+        const float y = static_cast<float>(j);
+        const float r = ((ax - y * k_dp1) - y * k_dp2) - y * k_dp3;
+        const float z = r * r;
+        float cos_poly = k_cos_p0 * z;
+        cos_poly += k_cos_p1;
+        cos_poly *= z;
+        cos_poly += k_cos_p2;
+        cos_poly *= z;
+        cos_poly *= z;
+        cos_poly -= z * 0.5f;
+        cos_poly += 1.0f;
+        float sin_poly = k_sin_p0 * z;
+        sin_poly += k_sin_p1;
+        sin_poly *= z;
+        sin_poly += k_sin_p2;
+        sin_poly *= z;
+        sin_poly *= r;
+        sin_poly += r;
+
+        const bool swap = (j & 2) != 0;
+        sin_value = swap ? cos_poly : sin_poly;
+        cos_value = swap ? sin_poly : cos_poly;
+        if (((j & 4) != 0) != std::signbit(x))
+            sin_value = -sin_value;
+        if (((j - 2) & 4) == 0)
+            cos_value = -cos_value;
+    }
+
+    void update_scalar(const Streams& streams, uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            float s;
+            float c;
+            sincos_scalar(streams.rotation[i], s, c);
+            const float l00 = c * streams.scale_x[i];
+            const float l10 = s * streams.scale_x[i];
+            const float l01 = -(s * streams.scale_y[i]);
+            const float l11 = c * streams.scale_y[i];
+            const float x = streams.position_x[i];
+            const float y = streams.position_y[i];
+            const float depth = streams.depth[i];
+
+            float w00 = l00;
+            float w10 = l10;
+            float w01 = l01;
+            float w11 = l11;
+            float wx = x;
+            float wy = y;
+            float wdepth = depth;
+            if (streams.parent)
+            {
+                const uint32_t p = streams.parent[i];
+                const float p00 = streams.world_m00[p];
+                const float p10 = streams.world_m10[p];
+                const float p01 = streams.world_m01[p];
+                const float p11 = streams.world_m11[p];
+                w00 = p00 * l00 + p01 * l10;
+                w10 = p10 * l00 + p11 * l10;
+                w01 = p00 * l01 + p01 * l11;
+                w11 = p10 * l01 + p11 * l11;
+                wx = (p00 * x + p01 * y) + streams.world_x[p];
+                wy = (p10 * x + p11 * y) + streams.world_y[p];
+                wdepth = streams.world_depth[p] + depth;
+            }
+
+            if (streams.keep_world)
+            {
+                streams.world_m00[i] = w00;
+                streams.world_m10[i] = w10;
+                streams.world_m01[i] = w01;
+                streams.world_m11[i] = w11;
+                streams.world_x[i] = wx;
+                streams.world_y[i] = wy;
+                streams.world_depth[i] = wdepth;
+            }
+            if (i - streams.first_out < streams.out_count)
+                streams.out[i - streams.first_out] = {{w00, w10, w01, w11}, {wx, wy}, wdepth, 0.0f};
+        }
+    }
+
+    // 转置好的 width 条记录写进 out, 只有一部分落在输出范围内时逐条复制
+    void write_records(const Streams& streams, uint32_t begin, uint32_t width, const float* records)
+    {
+        for (uint32_t k = 0; k < width; ++k)
+        {
+            if (begin + k - streams.first_out < streams.out_count)
+                std::memcpy(&streams.out[begin + k - streams.first_out], records + 8 * k, sizeof(GpuTransform));
+        }
+    }
+
+#ifdef VULKAN_LEARN_SSE
+    void sincos_sse(__m128 x, __m128& sin_value, __m128& cos_value)
+    {
+        const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(INT32_MIN));
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i two = _mm_set1_epi32(2);
+        const __m128i four = _mm_set1_epi32(4);
+
+        __m128 sign_sin = _mm_and_ps(x, sign_mask);
+        const __m128 ax = _mm_andnot_ps(sign_mask, x);
+        __m128i j = _mm_cvttps_epi32(_mm_mul_ps(ax, _mm_set1_ps(k_four_over_pi)));
+        j = _mm_andnot_si128(one, _mm_add_epi32(j, one));
+        const __m128 y = _mm_cvtepi32_ps(j);
+        sign_sin = _mm_xor_ps(sign_sin, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, four), 29)));
+        const __m128 sign_cos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, two), four), 29));
+        // 为真时 sin 取 sin 多项式, cos 取 cos 多项式
+        const __m128 keep = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, two), _mm_setzero_si128()));
+
+        __m128 r = _mm_sub_ps(ax, _mm_mul_ps(y, _mm_set1_ps(k_dp1)));
+        r = _mm_sub_ps(r, _mm_mul_ps(y, _mm_set1_ps(k_dp2)));
+        r = _mm_sub_ps(r, _mm_mul_ps(y, _mm_set1_ps(k_dp3)));
+        const __m128 z = _mm_mul_ps(r, r);
+
+        __m128 cos_poly = _mm_mul_ps(_mm_set1_ps(k_cos_p0), z);
+        cos_poly = _mm_add_ps(cos_poly, _mm_set1_ps(k_cos_p1));
+        cos_poly = _mm_mul_ps(cos_poly, z);
+        cos_poly = _mm_add_ps(cos_poly, _mm_set1_ps(k_cos_p2));
+        cos_poly = _mm_mul_ps(cos_poly, z);
+        cos_poly = _mm_mul_ps(cos_poly, z);
+        cos_poly = _mm_sub_ps(cos_poly, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+        cos_poly = _mm_add_ps(cos_poly, _mm_set1_ps(1.0f));
+        __m128 sin_poly = _mm_mul_ps(_mm_set1_ps(k_sin_p0), z);
+        sin_poly = _mm_add_ps(sin_poly, _mm_set1_ps(k_sin_p1));
+        sin_poly = _mm_mul_ps(sin_poly, z);
+        sin_poly = _mm_add_ps(sin_poly, _mm_set1_ps(k_sin_p2));
+        sin_poly = _mm_mul_ps(sin_poly, z);
+        sin_poly = _mm_mul_ps(sin_poly, r);
+        sin_poly = _mm_add_ps(sin_poly, r);
+
+        sin_value = _mm_or_ps(_mm_and_ps(keep, sin_poly), _mm_andnot_ps(keep, cos_poly));
+        cos_value = _mm_or_ps(_mm_and_ps(keep, cos_poly), _mm_andnot_ps(keep, sin_poly));
+        sin_value = _mm_xor_ps(sin_value, sign_sin);
+        cos_value = _mm_xor_ps(cos_value, sign_cos);
+    }
+
+    __m128 gather_sse(const float* values, const uint32_t* index)
+    {
+        return _mm_setr_ps(values[index[0]], values[index[1]], values[index[2]], values[index[3]]);
+    }
+
+    void update_sse(const Streams& streams, uint32_t begin, uint32_t end)
+    {
+        const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(INT32_MIN));
+        uint32_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 s;
+            __m128 c;
+            sincos_sse(_mm_loadu_ps(streams.rotation + i), s, c);
+            const __m128 scale_x = _mm_loadu_ps(streams.scale_x + i);
+            const __m128 scale_y = _mm_loadu_ps(streams.scale_y + i);
+            const __m128 l00 = _mm_mul_ps(c, scale_x);
+            const __m128 l10 = _mm_mul_ps(s, scale_x);
+            const __m128 l01 = _mm_xor_ps(_mm_mul_ps(s, scale_y), sign_mask);
+            const __m128 l11 = _mm_mul_ps(c, scale_y);
+            const __m128 x = _mm_loadu_ps(streams.position_x + i);
+            const __m128 y = _mm_loadu_ps(streams.position_y + i);
+            const __m128 depth = _mm_loadu_ps(streams.depth + i);
+
+            __m128 w00 = l00;
+            __m128 w10 = l10;
+            __m128 w01 = l01;
+            __m128 w11 = l11;
+            __m128 wx = x;
+            __m128 wy = y;
+            __m128 wdepth = depth;
+            if (streams.parent)
+            {
+                const uint32_t* p = streams.parent + i;
+                const __m128 p00 = gather_sse(streams.world_m00, p);
+                const __m128 p10 = gather_sse(streams.world_m10, p);
+                const __m128 p01 = gather_sse(streams.world_m01, p);
+                const __m128 p11 = gather_sse(streams.world_m11, p);
+                w00 = _mm_add_ps(_mm_mul_ps(p00, l00), _mm_mul_ps(p01, l10));
+                w10 = _mm_add_ps(_mm_mul_ps(p10, l00), _mm_mul_ps(p11, l10));
+                w01 = _mm_add_ps(_mm_mul_ps(p00, l01), _mm_mul_ps(p01, l11));
+                w11 = _mm_add_ps(_mm_mul_ps(p10, l01), _mm_mul_ps(p11, l11));
+                wx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p00, x), _mm_mul_ps(p01, y)), gather_sse(streams.world_x, p));
+                wy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p10, x), _mm_mul_ps(p11, y)), gather_sse(streams.world_y, p));
+                wdepth = _mm_add_ps(gather_sse(streams.world_depth, p), depth);
+            }
+
+            if (streams.keep_world)
+            {
+                _mm_storeu_ps(streams.world_m00 + i, w00);
+                _mm_storeu_ps(streams.world_m10 + i, w10);
+                _mm_storeu_ps(streams.world_m01 + i, w01);
+                _mm_storeu_ps(streams.world_m11 + i, w11);
+                _mm_storeu_ps(streams.world_x + i, wx);
+                _mm_storeu_ps(streams.world_y + i, wy);
+                _mm_storeu_ps(streams.world_depth + i, wdepth);
+            }
+
+            // 4 x 8 的 SoA 转置成 4 条记录: 前半是矩阵, 后半是平移, 深度和填充
+            __m128 tail = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(w00, w10, w01, w11);
+            _MM_TRANSPOSE4_PS(wx, wy, wdepth, tail);
+            if (i - streams.first_out < streams.out_count && i + 3 - streams.first_out < streams.out_count)
+            {
+                auto* out = reinterpret_cast<float*>(streams.out + (i - streams.first_out));
+                _mm_storeu_ps(out, w00);
+                _mm_storeu_ps(out + 4, wx);
+                _mm_storeu_ps(out + 8, w10);
+                _mm_storeu_ps(out + 12, wy);
+                _mm_storeu_ps(out + 16, w01);
+                _mm_storeu_ps(out + 20, wdepth);
+                _mm_storeu_ps(out + 24, w11);
+                _mm_storeu_ps(out + 28, tail);
+            }
+            else
+            {
+                alignas(16) float records[4 * 8];
+                _mm_store_ps(records, w00);
+                _mm_store_ps(records + 4, wx);
+                _mm_store_ps(records + 8, w10);
+                _mm_store_ps(records + 12, wy);
+                _mm_store_ps(records + 16, w01);
+                _mm_store_ps(records + 20, wdepth);
+                _mm_store_ps(records + 24, w11);
+                _mm_store_ps(records + 28, tail);
+                write_records(streams, i, 4, records);
+            }
+        }
+        update_scalar(streams, i, end);
+    }
+#endif
+
+#ifdef VULKAN_LEARN_AVX2
+    VULKAN_LEARN_TARGET_AVX2
+    void sincos_avx2(__m256 x, __m256& sin_value, __m256& cos_value)
+    {
+        const __m256 sign_mask = _mm256_castsi256_ps(_mm256_set1_epi32(INT32_MIN));
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i two = _mm256_set1_epi32(2);
+        const __m256i four = _mm256_set1_epi32(4);
+
+        __m256 sign_sin = _mm256_and_ps(x, sign_mask);
+        const __m256 ax = _mm256_andnot_ps(sign_mask, x);
+        __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(ax, _mm256_set1_ps(k_four_over_pi)));
+        j = _mm256_andnot_si256(one, _mm256_add_epi32(j, one));
+        const __m256 y = _mm256_cvtepi32_ps(j);
+        sign_sin = _mm256_xor_ps(sign_sin, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, four), 29)));
+        const __m256 sign_cos = _mm256_castsi256_ps(
+            _mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, two), four), 29));
+        const __m256 keep = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, two),
+                                                                   _mm256_setzero_si256()));
+
+        __m256 r = _mm256_sub_ps(ax, _mm256_mul_ps(y, _mm256_set1_ps(k_dp1)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(y, _mm256_set1_ps(k_dp2)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(y, _mm256_set1_ps(k_dp3)));
+        const __m256 z = _mm256_mul_ps(r, r);
+
+        __m256 cos_poly = _mm256_mul_ps(_mm256_set1_ps(k_cos_p0), z);
+        cos_poly = _mm256_add_ps(cos_poly, _mm256_set1_ps(k_cos_p1));
+        cos_poly = _mm256_mul_ps(cos_poly, z);
+        cos_poly = _mm256_add_ps(cos_poly, _mm256_set1_ps(k_cos_p2));
+        cos_poly = _mm256_mul_ps(cos_poly, z);
+        cos_poly = _mm256_mul_ps(cos_poly, z);
+        cos_poly = _mm256_sub_ps(cos_poly, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+        cos_poly = _mm256_add_ps(cos_poly, _mm256_set1_ps(1.0f));
+        __m256 sin_poly = _mm256_mul_ps(_mm256_set1_ps(k_sin_p0), z);
+        sin_poly = _mm256_add_ps(sin_poly, _mm256_set1_ps(k_sin_p1));
+        sin_poly = _mm256_mul_ps(sin_poly, z);
+        sin_poly = _mm256_add_ps(sin_poly, _mm256_set1_ps(k_sin_p2));
+        sin_poly = _mm256_mul_ps(sin_poly, z);
+        sin_poly = _mm256_mul_ps(sin_poly, r);
+        sin_poly = _mm256_add_ps(sin_poly, r);
+
+        sin_value = _mm256_xor_ps(_mm256_blendv_ps(cos_poly, sin_poly, keep), sign_sin);
+        cos_value = _mm256_xor_ps(_mm256_blendv_ps(sin_poly, cos_poly, keep), sign_cos);
+    }
+
+    VULKAN_LEARN_TARGET_AVX2
+    void update_avx2(const Streams& streams, uint32_t begin, uint32_t end)
+    {
+        const __m256 sign_mask = _mm256_castsi256_ps(_mm256_set1_epi32(INT32_MIN));
+        uint32_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256 s;
+            __m256 c;
+            sincos_avx2(_mm256_loadu_ps(streams.rotation + i), s, c);
+            const __m256 scale_x = _mm256_loadu_ps(streams.scale_x + i);
+            const __m256 scale_y = _mm256_loadu_ps(streams.scale_y + i);
+            const __m256 l00 = _mm256_mul_ps(c, scale_x);
+            const __m256 l10 = _mm256_mul_ps(s, scale_x);
+            const __m256 l01 = _mm256_xor_ps(_mm256_mul_ps(s, scale_y), sign_mask);
+            const __m256 l11 = _mm256_mul_ps(c, scale_y);
+            const __m256 x = _mm256_loadu_ps(streams.position_x + i);
+            const __m256 y = _mm256_loadu_ps(streams.position_y + i);
+            const __m256 depth = _mm256_loadu_ps(streams.depth + i);
+
+            __m256 w00 = l00;
+            __m256 w10 = l10;
+            __m256 w01 = l01;
+            __m256 w11 = l11;
+            __m256 wx = x;
+            __m256 wy = y;
+            __m256 wdepth = depth;
+            if (streams.parent)
+            {
+                const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(streams.parent + i));
+                const __m256 p00 = _mm256_i32gather_ps(streams.world_m00, p, 4);
+                const __m256 p10 = _mm256_i32gather_ps(streams.world_m10, p, 4);
+                const __m256 p01 = _mm256_i32gather_ps(streams.world_m01, p, 4);
+                const __m256 p11 = _mm256_i32gather_ps(streams.world_m11, p, 4);
+                w00 = _mm256_add_ps(_mm256_mul_ps(p00, l00), _mm256_mul_ps(p01, l10));
+                w10 = _mm256_add_ps(_mm256_mul_ps(p10, l00), _mm256_mul_ps(p11, l10));
+                w01 = _mm256_add_ps(_mm256_mul_ps(p00, l01), _mm256_mul_ps(p01, l11));
+                w11 = _mm256_add_ps(_mm256_mul_ps(p10, l01), _mm256_mul_ps(p11, l11));
+                wx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p00, x), _mm256_mul_ps(p01, y)),
+                                   _mm256_i32gather_ps(streams.world_x, p, 4));
+                wy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p10, x), _mm256_mul_ps(p11, y)),
+                                   _mm256_i32gather_ps(streams.world_y, p, 4));
+                wdepth = _mm256_add_ps(_mm256_i32gather_ps(streams.world_depth, p, 4), depth);
+            }
+
+            if (streams.keep_world)
+            {
+                _mm256_storeu_ps(streams.world_m00 + i, w00);
+                _mm256_storeu_ps(streams.world_m10 + i, w10);
+                _mm256_storeu_ps(streams.world_m01 + i, w01);
+                _mm256_storeu_ps(streams.world_m11 + i, w11);
+                _mm256_storeu_ps(streams.world_x + i, wx);
+                _mm256_storeu_ps(streams.world_y + i, wy);
+                _mm256_storeu_ps(streams.world_depth + i, wdepth);
+            }
+
+            // 8 x 8 转置: 第 k 行是第 k 个实体的整条记录
+            const __m256 t0 = _mm256_unpacklo_ps(w00, w10);
+            const __m256 t1 = _mm256_unpackhi_ps(w00, w10);
+            const __m256 t2 = _mm256_unpacklo_ps(w01, w11);
+            const __m256 t3 = _mm256_unpackhi_ps(w01, w11);
+            const __m256 t4 = _mm256_unpacklo_ps(wx, wy);
+            const __m256 t5 = _mm256_unpackhi_ps(wx, wy);
+            const __m256 t6 = _mm256_unpacklo_ps(wdepth, _mm256_setzero_ps());
+            const __m256 t7 = _mm256_unpackhi_ps(wdepth, _mm256_setzero_ps());
+            const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+            const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+            const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+            const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+            const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+            const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+            const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+            const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+            const std::array rows{
+                _mm256_permute2f128_ps(s0, s4, 0x20), _mm256_permute2f128_ps(s1, s5, 0x20),
+                _mm256_permute2f128_ps(s2, s6, 0x20), _mm256_permute2f128_ps(s3, s7, 0x20),
+                _mm256_permute2f128_ps(s0, s4, 0x31), _mm256_permute2f128_ps(s1, s5, 0x31),
+                _mm256_permute2f128_ps(s2, s6, 0x31), _mm256_permute2f128_ps(s3, s7, 0x31),
+            };
+            if (i - streams.first_out < streams.out_count && i + 7 - streams.first_out < streams.out_count)
+            {
+                auto* out = reinterpret_cast<float*>(streams.out + (i - streams.first_out));
+                for (uint32_t k = 0; k < 8; ++k)
+                {
+                    _mm256_storeu_ps(out + 8 * k, rows[k]);
+                }
+            }
+            else
+            {
+                alignas(32) float records[8 * 8];
+                for (uint32_t k = 0; k < 8; ++k)
+                {
+                    _mm256_store_ps(records + 8 * k, rows[k]);
+                }
+                write_records(streams, i, 8, records);
+            }
+        }
+        update_scalar(streams, i, end);
+    }
+#endif
+}
+
+TransformStore::TransformStore()
+    : simd_(best_simd_level())
+{
+}
+
+void TransformStore::reserve(uint32_t count)
+{
+    for (auto* values : {&position_x_, &position_y_, &depth_, &rotation_, &scale_x_, &scale_y_, &world_m00_,
+                         &world_m10_, &world_m01_, &world_m11_, &world_x_, &world_y_, &world_depth_})
+    {
+        values->reserve(count);
+    }
+    parent_.reserve(count);
+}
+
+void TransformStore::clear()
+{
+    for (auto* values : {&position_x_, &position_y_, &depth_, &rotation_, &scale_x_, &scale_y_, &world_m00_,
+                         &world_m10_, &world_m01_, &world_m11_, &world_x_, &world_y_, &world_depth_})
+    {
+        values->clear();
+    }
+    parent_.clear();
+    level_begin_.clear();
+}
+
+uint32_t TransformStore::create(uint32_t parent)
+{
+    const uint32_t entity = size();
+    uint32_t level = 0;
+    if (parent != k_no_parent)
+    {
+        if (parent >= entity)
+            throw std::runtime_error("TransformStore::create: parent does not exist");
+        level = static_cast<uint32_t>(std::upper_bound(level_begin_.begin(), level_begin_.end(), parent)
+            - level_begin_.begin());
+    }
+    if (level + 1 < level_count())
+        throw std::runtime_error("TransformStore::create: entities must be created level by level");
+    if (level == level_count())
+        level_begin_.push_back(entity);
+
+    position_x_.push_back(0.0f);
+    position_y_.push_back(0.0f);
+    depth_.push_back(0.0f);
+    rotation_.push_back(0.0f);
+    scale_x_.push_back(1.0f);
+    scale_y_.push_back(1.0f);
+    parent_.push_back(parent);
+    for (auto* values : {&world_m00_, &world_m10_, &world_m01_, &world_m11_, &world_x_, &world_y_, &world_depth_})
+    {
+        values->push_back(0.0f);
+    }
+    return entity;
+}
+
+void TransformStore::set_position(uint32_t entity, float x, float y, float depth)
+{
+    position_x_[entity] = x;
+    position_y_[entity] = y;
+    depth_[entity] = depth;
+}
+
+void TransformStore::set_rotation(uint32_t entity, float rotation)
+{
+    rotation_[entity] = rotation;
+}
+
+void TransformStore::set_scale(uint32_t entity, float x, float y)
+{
+    scale_x_[entity] = x;
+    scale_y_[entity] = y;
+}
+
+void TransformStore::set_simd(SimdLevel simd)
+{
+    simd_ = std::min(simd, best_simd_level());
+}
+
+void TransformStore::update(TaskPool& pool, std::span<GpuTransform> out, uint32_t first)
+{
+    if (out.size() > size() || first > size() - out.size())
+        throw std::runtime_error("TransformStore::update: output range exceeds the entities");
+    const auto begin = std::chrono::steady_clock::now();
+
+    // 同一层的实体互不依赖, 层与层之间由 TaskPool::run 的返回隔开
+    for (uint32_t level = 0; level < level_count(); ++level)
+    {
+        const uint32_t level_begin = level_begin_[level];
+        const uint32_t level_end = level + 1 < level_count() ? level_begin_[level + 1] : size();
+        const uint32_t chunks = (level_end - level_begin + k_chunk_size - 1) / k_chunk_size;
+        pool.run(chunks, [&](uint32_t chunk)
+        {
+            const uint32_t chunk_begin = level_begin + chunk * k_chunk_size;
+            update_range(chunk_begin, std::min(chunk_begin + k_chunk_size, level_end), level, out, first);
+        });
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    ++stats_.updates;
+    stats_.update_ms += ms;
+    stats_.last_update_ms = ms;
+    stats_.entities = size();
+    stats_.levels = level_count();
+}
+
+void TransformStore::update_range(uint32_t begin, uint32_t end, uint32_t level, std::span<GpuTransform> out,
+                                  uint32_t first)
+{
+    const Streams streams{
+        .position_x = position_x_.data(),
+        .position_y = position_y_.data(),
+        .depth = depth_.data(),
+        .rotation = rotation_.data(),
+        .scale_x = scale_x_.data(),
+        .scale_y = scale_y_.data(),
+        .parent = level > 0 ? parent_.data() : nullptr,
+        .world_m00 = world_m00_.data(),
+        .world_m10 = world_m10_.data(),
+        .world_m01 = world_m01_.data(),
+        .world_m11 = world_m11_.data(),
+        .world_x = world_x_.data(),
+        .world_y = world_y_.data(),
+        .world_depth = world_depth_.data(),
+        .keep_world = level + 1 < level_count(),
+        .out = out.data(),
+        .first_out = first,
+        .out_count = static_cast<uint32_t>(out.size()),
+    };
+    switch (simd_)
+    {
+#ifdef VULKAN_LEARN_AVX2
+    case SimdLevel::Avx2:
+        update_avx2(streams, begin, end);
+        break;
+#endif
+#ifdef VULKAN_LEARN_SSE
+    case SimdLevel::Sse:
+        update_sse(streams, begin, end);
+        break;
+#endif
+    default:
+        update_scalar(streams, begin, end);
+        break;
+    }
+}
+
+void TransformStore::print_stats() const
+{
+    fmt::println("[transform store] {} entities in {} levels, {}; {} updates averaging {:.3f} ms, last {:.3f} ms",
+                 stats_.entities, stats_.levels, magic_enum::enum_name(simd_), stats_.updates,
+                 stats_.updates ? stats_.update_ms / static_cast<double>(stats_.updates) : 0.0,
+                 stats_.last_update_ms);
+}
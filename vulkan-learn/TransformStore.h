@@ -0,0 +1,122 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_TRANSFORMSTORE_H
+#define VULKAN_LEARN_TRANSFORMSTORE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Simd.h"
+#include "TaskPool.h"
+
+/**
+ * @brief 数据导向的场景变换存储: 局部和世界变换按结构体数组 (SoA) 存放, 逐层用 SIMD 并行更新
+ *
+ * 每个实体有局部的位置 (x, y, 深度), 旋转角和两个方向的缩放, 以及父实体; 世界矩阵是二维仿射变换
+ * (2x2 线性部分和平移), 深度沿层级相加. 实体必须按层级顺序创建 (先建所有根, 再建它们的孩子, 以此类推),
+ * 每一层在数组中是连续的一段, 更新时一层做完再做下一层, 同一层内切成 k_chunk_size 的块分给 TaskPool 的线程.
+ *
+ * 块内一次处理 4 个 (SSE) 或 8 个 (AVX2) 实体: 向量化的 sincos, 与父实体的世界矩阵相乘 (父实体的数据用 gather 读取),
+ * 再转置成 GpuTransform 直接写进调用方给出的缓冲, 通常是这一帧 FrameDataBatch::emplace 返回的映射内存.
+ * 三个版本的结果逐位一致 (见 SimdLevel). 最后一层没有孩子, 它的世界变换只写进 GPU 缓冲.
+ */
+class TransformStore
+{
+public:
+    static constexpr uint32_t k_no_parent = UINT32_MAX;
+    // 并行更新时每个任务处理的实体数, 是 SIMD 宽度的倍数
+    static constexpr uint32_t k_chunk_size = 8192;
+
+    // 写进每帧 GPU 缓冲的一条记录, std140 的数组步长和 std430 的布局都是 32 字节
+    struct GpuTransform
+    {
+        glm::vec4 matrix; // 世界矩阵的线性部分, 按列存放: (m00, m10, m01, m11)
+        glm::vec2 offset; // 世界平移
+        float depth; // 裁剪空间深度, 越小越靠前
+        float padding;
+    };
+
+    struct Stats
+    {
+        uint32_t entities = 0;
+        uint32_t levels = 0;
+        uint64_t updates = 0;
+        double update_ms = 0; // 所有 update 的耗时之和
+        double last_update_ms = 0;
+    };
+
+    TransformStore();
+    TransformStore(const TransformStore&) = delete;
+    TransformStore& operator=(const TransformStore&) = delete;
+
+    void reserve(uint32_t count);
+
+    void clear();
+
+    // 新实体的局部变换为单位变换; parent 必须已经存在, 并且新实体的层级不低于之前创建的所有实体
+    uint32_t create(uint32_t parent = k_no_parent);
+
+    uint32_t size() const { return static_cast<uint32_t>(parent_.size()); }
+
+    uint32_t level_count() const { return static_cast<uint32_t>(level_begin_.size()); }
+
+    void set_position(uint32_t entity, float x, float y, float depth);
+
+    // 弧度; 向量化 sincos 的区间归约只在 |rotation| 不超过几千时精确, 随时间累加的角度应先对 2pi 取余
+    void set_rotation(uint32_t entity, float rotation);
+
+    void set_scale(uint32_t entity, float x, float y);
+
+    // 局部变换的 SoA 数组, 按实体下标排列, 批量修改时直接写
+    std::span<float> position_x() { return position_x_; }
+    std::span<float> position_y() { return position_y_; }
+    std::span<float> depth() { return depth_; }
+    std::span<float> rotation() { return rotation_; }
+    std::span<float> scale_x() { return scale_x_; }
+    std::span<float> scale_y() { return scale_y_; }
+
+    // 计算所有实体的世界变换, 其中 [first, first + out.size()) 的实体同时写进 out
+    void update(TaskPool& pool, std::span<GpuTransform> out, uint32_t first = 0);
+
+    // 见 SimdLevel
+    void set_simd(SimdLevel simd);
+
+    SimdLevel simd() const { return simd_; }
+
+    Stats stats() const { return stats_; }
+
+    void print_stats() const;
+
+private:
+    // 更新 [begin, end), 这些实体属于同一层
+    void update_range(uint32_t begin, uint32_t end, uint32_t level, std::span<GpuTransform> out, uint32_t first);
+
+    // 局部变换
+    std::vector<float> position_x_;
+    std::vector<float> position_y_;
+    std::vector<float> depth_;
+    std::vector<float> rotation_;
+    std::vector<float> scale_x_;
+    std::vector<float> scale_y_;
+    std::vector<uint32_t> parent_;
+    // 世界变换, 供下一层读取
+    std::vector<float> world_m00_;
+    std::vector<float> world_m10_;
+    std::vector<float> world_m01_;
+    std::vector<float> world_m11_;
+    std::vector<float> world_x_;
+    std::vector<float> world_y_;
+    std::vector<float> world_depth_;
+    // 每一层的第一个实体
+    std::vector<uint32_t> level_begin_;
+    SimdLevel simd_ = SimdLevel::Scalar;
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_TRANSFORMSTORE_H
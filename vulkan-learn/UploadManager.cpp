@@ -0,0 +1,446 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#include "UploadManager.h"
+
+#include "HelloTriangleApplication.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // 同时满足 vkCmdCopyBufferToImage 对 bufferOffset 的要求: 4 的倍数 (传输队列) 和纹素大小的倍数
+    constexpr VkDeviceSize k_copy_alignment = 16;
+    // 暂存内存不占用 ReBAR 的 DEVICE_LOCAL | HOST_VISIBLE 堆, 那部分留给每帧更新的数据
+    constexpr GpuAllocator::MemoryUsage k_staging_usage{
+        .required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        .avoid = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    };
+}
+
+void UploadManager::init(VkDevice device, GpuAllocator& allocator, QueueInfo transfer, QueueInfo graphics,
+                         VkDeviceSize ring_size)
+{
+    device_ = device;
+    allocator_ = &allocator;
+    transfer_ = transfer;
+    graphics_ = graphics;
+    ring_size_ = ring_size;
+
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = transfer_.family;
+    details::err_check(vkCreateCommandPool(device_, &pool_info, nullptr, &command_pool_),
+                       "failed to create upload command pool!");
+    if (transfers_ownership())
+    {
+        pool_info.queueFamilyIndex = graphics_.family;
+        details::err_check(vkCreateCommandPool(device_, &pool_info, nullptr, &acquire_command_pool_),
+                           "failed to create upload acquire command pool!");
+    }
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = ring_size_;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    ring_allocation_ = allocator_->create_buffer(buffer_info, ring_buffer_, k_staging_usage);
+    if (!ring_allocation_ || !ring_allocation_.mapped)
+    {
+        throw std::runtime_error("failed to create upload staging ring!");
+    }
+}
+
+void UploadManager::destroy()
+{
+    std::lock_guard lock(mutex_);
+    flush_locked();
+    while (!in_flight_.empty())
+    {
+        wait_oldest_locked();
+    }
+    for (const auto& batch : free_batches_)
+    {
+        vkDestroyFence(device_, batch.fence, nullptr);
+        vkDestroySemaphore(device_, batch.semaphore, nullptr);
+    }
+    free_batches_.clear();
+    vkDestroyCommandPool(device_, command_pool_, nullptr);
+    vkDestroyCommandPool(device_, acquire_command_pool_, nullptr);
+    command_pool_ = VK_NULL_HANDLE;
+    acquire_command_pool_ = VK_NULL_HANDLE;
+    allocator_->destroy_buffer(ring_buffer_, ring_allocation_);
+}
+
+void UploadManager::upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size)
+{
+    if (size == 0)
+        return;
+
+    std::lock_guard lock(mutex_);
+    const auto [src, src_offset] = stage_locked(data, size);
+    pending_.push_back({src, dst, {src_offset, dst_offset, size}});
+}
+
+void UploadManager::upload_image(VkImage dst, VkExtent2D extent, const void* data, VkDeviceSize size)
+{
+    if (size == 0)
+        return;
+
+    std::lock_guard lock(mutex_);
+    const auto [src, src_offset] = stage_locked(data, size);
+    VkBufferImageCopy region{};
+    region.bufferOffset = src_offset;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {extent.width, extent.height, 1};
+    pending_images_.push_back({src, dst, region});
+    ++stats_.images;
+}
+
+UploadManager::Ticket UploadManager::flush()
+{
+    std::lock_guard lock(mutex_);
+    return flush_locked();
+}
+
+bool UploadManager::is_complete(Ticket ticket)
+{
+    std::lock_guard lock(mutex_);
+    collect_locked();
+    return ticket.serial <= completed_serial_;
+}
+
+void UploadManager::wait(Ticket ticket)
+{
+    std::lock_guard lock(mutex_);
+    if (ticket.serial >= next_serial_)
+        flush_locked();
+    while (completed_serial_ < ticket.serial && !in_flight_.empty())
+    {
+        wait_oldest_locked();
+    }
+}
+
+void UploadManager::collect()
+{
+    std::lock_guard lock(mutex_);
+    collect_locked();
+}
+
+UploadManager::Stats UploadManager::stats() const
+{
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+void UploadManager::print_stats() const
+{
+    const auto stats = this->stats();
+    fmt::println("[upload] {} copies ({} images) in {} batches, {:.2f}MiB, ring stalls {}, oversized {}, "
+                 "ownership transfers {}",
+                 stats.copies, stats.images, stats.batches, stats.bytes_uploaded / (1024.0 * 1024.0), stats.stalls,
+                 stats.oversized, stats.ownership_transfers);
+}
+
+bool UploadManager::try_reserve(VkDeviceSize size, uint64_t& virtual_offset)
+{
+    // 环为空时从头开始, 保证任何不超过 ring_size_ 的请求都能放下
+    if (head_ == tail_ && in_flight_.empty())
+        head_ = tail_ = 0;
+
+    uint64_t offset = (head_ + k_copy_alignment - 1) / k_copy_alignment * k_copy_alignment;
+    // 不跨越环的末尾, 放不下就从下一圈的开头开始
+    if (const uint64_t wrapped = offset % ring_size_; wrapped + size > ring_size_)
+        offset += ring_size_ - wrapped;
+    if (offset + size - tail_ > ring_size_)
+        return false;
+
+    head_ = offset + size;
+    virtual_offset = offset;
+    return true;
+}
+
+std::pair<VkBuffer, VkDeviceSize> UploadManager::stage_locked(const void* data, VkDeviceSize size)
+{
+    ++stats_.copies;
+    stats_.bytes_uploaded += size;
+
+    if (size > ring_size_)
+    {
+        // 环放不下, 单独建一个暂存 buffer 跟随这个批次一起回收
+        VkBufferCreateInfo buffer_info{};
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = size;
+        buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkBuffer staging = VK_NULL_HANDLE;
+        GpuAllocation allocation = allocator_->create_buffer(buffer_info, staging, k_staging_usage);
+        if (!allocation)
+        {
+            throw std::runtime_error("failed to create temporary staging buffer!");
+        }
+        std::memcpy(allocation.mapped, data, size);
+        pending_temporaries_.emplace_back(staging, allocation);
+        ++stats_.oversized;
+        return {staging, 0};
+    }
+
+    uint64_t offset = 0;
+    while (!try_reserve(size, offset))
+    {
+        collect_locked();
+        if (try_reserve(size, offset))
+            break;
+        // 环已经被待提交的拷贝占满, 先提交它们才有批次可以等
+        if (in_flight_.empty())
+            flush_locked();
+        ++stats_.stalls;
+        wait_oldest_locked();
+    }
+
+    const VkDeviceSize ring_offset = offset % ring_size_;
+    std::memcpy(static_cast<char*>(ring_allocation_.mapped) + ring_offset, data, size);
+    return {ring_buffer_, ring_offset};
+}
+
+UploadManager::Ticket UploadManager::flush_locked()
+{
+    if (pending_.empty() && pending_images_.empty())
+        return {next_serial_ - 1};
+
+    Batch batch = acquire_batch();
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    details::err_check(vkBeginCommandBuffer(batch.command_buffer, &begin_info),
+                       "failed to begin upload command buffer!");
+
+    // 源和目标相同的连续拷贝合并成一次 vkCmdCopyBuffer
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < pending_.size(); ++i)
+    {
+        regions.push_back(pending_[i].region);
+        const bool last = i + 1 == pending_.size()
+            || pending_[i + 1].src != pending_[i].src || pending_[i + 1].dst != pending_[i].dst;
+        if (last)
+        {
+            vkCmdCopyBuffer(batch.command_buffer, pending_[i].src, pending_[i].dst,
+                            static_cast<uint32_t>(regions.size()), regions.data());
+            regions.clear();
+        }
+    }
+
+    // 图像整体从 UNDEFINED 转换到 TRANSFER_DST 再拷贝, 之后的转换到 SHADER_READ_ONLY_OPTIMAL 随下面的屏障一起录制
+    std::vector<VkImageMemoryBarrier> image_barriers;
+    for (const auto& copy : pending_images_)
+    {
+        VkImageMemoryBarrier& barrier = image_barriers.emplace_back();
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = copy.dst;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    }
+    if (!image_barriers.empty())
+    {
+        vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(image_barriers.size()),
+                             image_barriers.data());
+    }
+    for (const auto& copy : pending_images_)
+    {
+        vkCmdCopyBufferToImage(batch.command_buffer, copy.src, copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                               &copy.region);
+    }
+    for (auto& barrier : image_barriers)
+    {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    if (!transfers_ownership())
+    {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        for (auto& image_barrier : image_barriers)
+        {
+            image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            image_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        }
+        vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr,
+                             static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+        details::err_check(vkEndCommandBuffer(batch.command_buffer), "failed to end upload command buffer!");
+
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &batch.command_buffer;
+        details::err_check(vkQueueSubmit(transfer_.queue, 1, &submit_info, batch.fence),
+                           "failed to submit upload batch!");
+    }
+    else
+    {
+        // 每个目标 buffer 和图像做一次队列族所有权转移, release 和 acquire 的参数 (包括图像的布局转换) 必须一致
+        std::vector<VkBufferMemoryBarrier> barriers;
+        for (const auto& copy : pending_)
+        {
+            if (std::ranges::any_of(barriers, [&](const auto& barrier) { return barrier.buffer == copy.dst; }))
+                continue;
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = transfer_.family;
+            barrier.dstQueueFamilyIndex = graphics_.family;
+            barrier.buffer = copy.dst;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            barriers.push_back(barrier);
+        }
+        for (auto& barrier : image_barriers)
+        {
+            barrier.srcQueueFamilyIndex = transfer_.family;
+            barrier.dstQueueFamilyIndex = graphics_.family;
+        }
+        stats_.ownership_transfers += static_cast<uint32_t>(barriers.size() + image_barriers.size());
+
+        auto set_access = [&](VkAccessFlags src_access, VkAccessFlags dst_access)
+        {
+            for (auto& barrier : barriers)
+            {
+                barrier.srcAccessMask = src_access;
+                barrier.dstAccessMask = dst_access;
+            }
+            for (auto& barrier : image_barriers)
+            {
+                barrier.srcAccessMask = src_access;
+                barrier.dstAccessMask = dst_access;
+            }
+        };
+        set_access(VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+        vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                             static_cast<uint32_t>(barriers.size()), barriers.data(),
+                             static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+        details::err_check(vkEndCommandBuffer(batch.command_buffer), "failed to end upload command buffer!");
+
+        VkSubmitInfo release_info{};
+        release_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        release_info.commandBufferCount = 1;
+        release_info.pCommandBuffers = &batch.command_buffer;
+        release_info.signalSemaphoreCount = 1;
+        release_info.pSignalSemaphores = &batch.semaphore;
+        details::err_check(vkQueueSubmit(transfer_.queue, 1, &release_info, VK_NULL_HANDLE),
+                           "failed to submit upload batch!");
+
+        details::err_check(vkBeginCommandBuffer(batch.acquire_command_buffer, &begin_info),
+                           "failed to begin upload acquire command buffer!");
+        set_access(0, VK_ACCESS_MEMORY_READ_BIT);
+        vkCmdPipelineBarrier(batch.acquire_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                             static_cast<uint32_t>(barriers.size()), barriers.data(),
+                             static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+        details::err_check(vkEndCommandBuffer(batch.acquire_command_buffer),
+                           "failed to end upload acquire command buffer!");
+
+        const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquire_info{};
+        acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquire_info.waitSemaphoreCount = 1;
+        acquire_info.pWaitSemaphores = &batch.semaphore;
+        acquire_info.pWaitDstStageMask = &wait_stage;
+        acquire_info.commandBufferCount = 1;
+        acquire_info.pCommandBuffers = &batch.acquire_command_buffer;
+        details::err_check(vkQueueSubmit(graphics_.queue, 1, &acquire_info, batch.fence),
+                           "failed to submit upload acquire batch!");
+    }
+
+    batch.serial = next_serial_++;
+    batch.ring_end = head_;
+    batch.temporaries = std::move(pending_temporaries_);
+    pending_temporaries_.clear();
+    pending_.clear();
+    pending_images_.clear();
+    ++stats_.batches;
+
+    const Ticket ticket{batch.serial};
+    in_flight_.push_back(std::move(batch));
+    return ticket;
+}
+
+void UploadManager::collect_locked()
+{
+    // 同一队列上的提交按顺序完成, 只需要检查最老的批次
+    while (!in_flight_.empty() && vkGetFenceStatus(device_, in_flight_.front().fence) == VK_SUCCESS)
+    {
+        retire(in_flight_.front());
+        in_flight_.pop_front();
+    }
+}
+
+void UploadManager::wait_oldest_locked()
+{
+    details::err_check(vkWaitForFences(device_, 1, &in_flight_.front().fence, VK_TRUE, UINT64_MAX),
+                       "failed to wait for upload batch!");
+    collect_locked();
+}
+
+UploadManager::Batch UploadManager::acquire_batch()
+{
+    if (!free_batches_.empty())
+    {
+        Batch batch = std::move(free_batches_.back());
+        free_batches_.pop_back();
+        vkResetFences(device_, 1, &batch.fence);
+        return batch;
+    }
+
+    Batch batch;
+    VkCommandBufferAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = command_pool_;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    details::err_check(vkAllocateCommandBuffers(device_, &alloc_info, &batch.command_buffer),
+                       "failed to allocate upload command buffer!");
+
+    VkFenceCreateInfo fence_info{};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    details::err_check(vkCreateFence(device_, &fence_info, nullptr, &batch.fence), "failed to create upload fence!");
+
+    if (transfers_ownership())
+    {
+        alloc_info.commandPool = acquire_command_pool_;
+        details::err_check(vkAllocateCommandBuffers(device_, &alloc_info, &batch.acquire_command_buffer),
+                           "failed to allocate upload acquire command buffer!");
+
+        // fence 挂在等待该信号量的 acquire 提交上, fence 触发后信号量可以安全复用
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        details::err_check(vkCreateSemaphore(device_, &semaphore_info, nullptr, &batch.semaphore),
+                           "failed to create upload semaphore!");
+    }
+    return batch;
+}
+
+void UploadManager::retire(Batch& batch)
+{
+    completed_serial_ = batch.serial;
+    tail_ = batch.ring_end;
+    for (auto& [buffer, allocation] : batch.temporaries)
+    {
+        allocator_->destroy_buffer(buffer, allocation);
+    }
+    batch.temporaries.clear();
+    free_batches_.push_back(std::move(batch));
+}
@@ -0,0 +1,161 @@
+﻿//
+// Created by zhang on 2026/10/18.
+//
+
+#ifndef VULKAN_LEARN_UPLOADMANAGER_H
+#define VULKAN_LEARN_UPLOADMANAGER_H
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "GpuAllocator.h"
+
+/**
+ * @brief 基于持久映射暂存环形缓冲的异步上传
+ *
+ * upload_buffer / upload_image 把数据写进暂存环并记下一次拷贝, flush 把攒下的所有拷贝录制进一个命令缓冲一次提交,
+ * 返回的 Ticket 对应这次提交的 fence, 调用方用 is_complete / wait 查询, 不再需要 vkQueueWaitIdle.
+ *
+ * 环上的空间按单调递增的虚拟偏移分配, 每个批次记录自己用到的末尾位置, fence 触发后整段回收.
+ * 只有环被占满时 upload_buffer 才会等待最老的批次; 超过整个环大小的数据改用临时暂存 buffer.
+ *
+ * 拷贝提交到传输队列. 传输队列和图形队列属于同一族时, 批次末尾带一个 TRANSFER -> ALL_COMMANDS 的内存屏障,
+ * 之后提交的绘制可以直接使用目标 buffer. 属于不同族(独立 DMA 引擎)时, 传输命令缓冲对每个目标 buffer 和图像做
+ * release, 并 signal 一个信号量; 随后在图形队列上提交一个只含 acquire 屏障的命令缓冲等待该信号量,
+ * 批次的 fence 挂在 acquire 提交上. 这样拷贝与正在进行的渲染重叠, 之后的绘制按提交顺序排在 acquire 之后.
+ *
+ * flush 会向图形队列提交, 需要与绘制提交在同一线程(或者由调用方保证队列的外部同步).
+ */
+class UploadManager
+{
+public:
+    struct Ticket
+    {
+        uint64_t serial = 0;
+    };
+
+    struct Stats
+    {
+        uint64_t bytes_uploaded = 0;
+        uint32_t copies = 0;
+        uint32_t batches = 0;
+        uint32_t stalls = 0; // 环满时等待 GPU 的次数
+        uint32_t oversized = 0; // 使用临时暂存 buffer 的次数
+        uint32_t images = 0; // upload_image 的次数, 也计入 copies
+        uint32_t ownership_transfers = 0; // 跨队列族 release/acquire 的 buffer 数
+    };
+
+    struct QueueInfo
+    {
+        VkQueue queue = VK_NULL_HANDLE;
+        uint32_t family = 0;
+    };
+
+    UploadManager() = default;
+    UploadManager(const UploadManager&) = delete;
+    UploadManager& operator=(const UploadManager&) = delete;
+
+    // transfer 与 graphics 可以是同一个队列
+    void init(VkDevice device, GpuAllocator& allocator, QueueInfo transfer, QueueInfo graphics,
+              VkDeviceSize ring_size = 16ull << 20);
+
+    // 等待所有批次完成后释放资源
+    void destroy();
+
+    // 拷贝到暂存环并排队, 真正的提交发生在 flush
+    void upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+
+    // 整个图像一次上传: 单个 mip 和层的颜色图像, data 按行紧密排列, 纹素不超过 16 字节.
+    // 旧内容丢弃, 批次完成后图像处于 SHADER_READ_ONLY_OPTIMAL; 图像需要 TRANSFER_DST 用途
+    void upload_image(VkImage dst, VkExtent2D extent, const void* data, VkDeviceSize size);
+
+    // 提交目前攒下的拷贝, 没有待提交的拷贝时返回最近一次提交的 Ticket
+    Ticket flush();
+
+    bool is_complete(Ticket ticket);
+
+    void wait(Ticket ticket);
+
+    // 回收已完成批次占用的环空间, 每帧调用一次即可
+    void collect();
+
+    Stats stats() const;
+
+    void print_stats() const;
+
+private:
+    struct Copy
+    {
+        VkBuffer src;
+        VkBuffer dst;
+        VkBufferCopy region;
+    };
+
+    struct ImageCopy
+    {
+        VkBuffer src;
+        VkImage dst;
+        VkBufferImageCopy region;
+    };
+
+    struct Batch
+    {
+        uint64_t serial = 0;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        // 仅在跨队列族时使用: 图形队列上的 acquire 命令缓冲, 以及 release -> acquire 的信号量
+        VkCommandBuffer acquire_command_buffer = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t ring_end = 0;
+        // 超过环大小时的临时暂存 buffer, 批次完成后释放
+        std::vector<std::pair<VkBuffer, GpuAllocation>> temporaries;
+    };
+
+    // 以下函数都要求已经持有 mutex_
+    bool try_reserve(VkDeviceSize size, uint64_t& virtual_offset);
+
+    // 把 data 写进暂存环, 放不下时写进跟随批次回收的临时暂存 buffer; 返回拷贝的源 buffer 和偏移
+    std::pair<VkBuffer, VkDeviceSize> stage_locked(const void* data, VkDeviceSize size);
+
+    Ticket flush_locked();
+
+    void collect_locked();
+
+    void wait_oldest_locked();
+
+    Batch acquire_batch();
+
+    bool transfers_ownership() const { return transfer_.family != graphics_.family; }
+
+    void retire(Batch& batch);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    GpuAllocator* allocator_ = nullptr;
+    QueueInfo transfer_;
+    QueueInfo graphics_;
+    VkCommandPool command_pool_ = VK_NULL_HANDLE;
+    VkCommandPool acquire_command_pool_ = VK_NULL_HANDLE;
+
+    VkBuffer ring_buffer_ = VK_NULL_HANDLE;
+    GpuAllocation ring_allocation_;
+    VkDeviceSize ring_size_ = 0;
+    // 虚拟偏移, 对 ring_size_ 取模得到实际位置; [tail_, head_) 为正在使用的区间
+    uint64_t head_ = 0;
+    uint64_t tail_ = 0;
+
+    mutable std::mutex mutex_;
+    std::vector<Copy> pending_;
+    std::vector<ImageCopy> pending_images_;
+    std::vector<std::pair<VkBuffer, GpuAllocation>> pending_temporaries_;
+    std::deque<Batch> in_flight_;
+    std::vector<Batch> free_batches_;
+    uint64_t next_serial_ = 1;
+    uint64_t completed_serial_ = 0;
+    Stats stats_;
+};
+
+
+#endif //VULKAN_LEARN_UPLOADMANAGER_H
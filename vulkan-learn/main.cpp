@@ -37,11 +37,15 @@
 #include "imgui_impl_vulkan.h"
 #include <stdio.h>          // printf, fprintf
 #include <stdlib.h>         // abort
+#include <limits.h>         // INT_MAX
 #define GLFW_INCLUDE_NONE
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
 #include "backends/imgui_impl_vulkan.h"
+#include "HelloTriangleApplication.h"
+#include "PipelineCache.h"
+#include "RedrawScheduler.h"
 
 // Volk headers
 #ifdef IMGUI_IMPL_VULKAN_USE_VOLK
@@ -70,6 +74,7 @@ static VkDevice                 g_Device = VK_NULL_HANDLE;
 static uint32_t                 g_QueueFamily = (uint32_t)-1;
 static VkQueue                  g_Queue = VK_NULL_HANDLE;
 static VkPipelineCache          g_PipelineCache = VK_NULL_HANDLE;
+static PipelineCache            g_PipelineCacheStore;
 static VkDescriptorPool         g_DescriptorPool = VK_NULL_HANDLE;
 
 static ImGui_ImplVulkanH_Window g_MainWindowData;
@@ -209,6 +214,14 @@ static void SetupVulkan(ImVector<const char*> instance_extensions)
         vkGetDeviceQueue(g_Device, g_QueueFamily, 0, &g_Queue);
     }
 
+    // Create Pipeline Cache (loaded from disk, validated against the device and saved back on shutdown)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+        g_PipelineCacheStore.init(g_Device, properties, "imgui_pipeline_cache.bin");
+        g_PipelineCache = g_PipelineCacheStore.handle();
+    }
+
     // Create Descriptor Pool
     // If you wish to load e.g. additional textures you may need to alter pools sizes and maxSets.
     {
@@ -265,6 +278,8 @@ static void SetupVulkanWindow(ImGui_ImplVulkanH_Window* wd, VkSurfaceKHR surface
 static void CleanupVulkan()
 {
     vkDestroyDescriptorPool(g_Device, g_DescriptorPool, g_Allocator);
+    g_PipelineCacheStore.destroy();
+    g_PipelineCache = VK_NULL_HANDLE;
 
 #ifdef APP_USE_VULKAN_DEBUG_REPORT
     // Remove the debug report callback
@@ -369,9 +384,147 @@ static void FramePresent(ImGui_ImplVulkanH_Window* wd)
     wd->SemaphoreIndex = (wd->SemaphoreIndex + 1) % wd->SemaphoreCount; // Now we can use the next set of semaphores
 }
 
+// Optional [N] after a bench flag: fallback when it is absent, 0 (after printing an error) when it is not a positive
+// integer, so the benches never run with an empty sample set
+static int bench_count(int argc, char** argv, int i, int fallback)
+{
+    if (i + 1 >= argc || strncmp(argv[i + 1], "--", 2) == 0)
+        return fallback;
+    char* end = nullptr;
+    const long value = strtol(argv[i + 1], &end, 10);
+    if (*end != '\0' || value < 1 || value > INT_MAX)
+    {
+        fprintf(stderr, "%s expects a positive count, got \"%s\"\n", argv[i], argv[i + 1]);
+        return 0;
+    }
+    return static_cast<int>(value);
+}
+
 // Main code
-int main(int, char**)
+int main(int argc, char** argv)
 {
+    // --startup-bench [N]: run HelloTriangleApplication init/cleanup N times and report per-phase timings
+    // --serial-init: run the init steps one after another instead of on the dependency scheduler
+    // --resize-bench [N]: resize the HelloTriangleApplication window every frame for N frames and report frame times
+    // --record-bench [N]: record N draws per frame on 1, 2, 4 ... threads and report recording time per frame
+    // --render-path-bench [N]: draw N steady and N resizing frames with dynamic rendering and with render pass objects
+    // --gpu-driven-bench [N]: draw N frames per object count with per-object draws and with GPU-culled indirect draws
+    // --occlusion-bench [N]: draw N frames per object count of a layered scene with and without occlusion culling
+    // --bvh-bench [N]: frustum cull N, 4N and 10N objects on the CPU, linearly and through the BVH, in objects/ms
+    // --transform-bench [N]: update N transforms per SIMD level on 1, 2, 4 ... threads against a 60 Hz frame budget
+    // --triangle: run HelloTriangleApplication instead of the ImGui example
+    //   --present-mode fifo|fifo-relaxed|mailbox|immediate, --fps-cap N: initial frame pacing settings
+    //   --render-pass: use render pass and framebuffer objects even if VK_KHR_dynamic_rendering is available
+    //   --per-draw: record one draw per object even if GPU culling and drawIndirectCount are available
+    //   --no-occlusion: GPU culling tests the frustum only, without the two-phase Hi-Z occlusion pass
+    //   --layers N: stack the objects in N depth layers, the front layer covering the ones behind it
+    //   --record-threads N: record the per-draw scene on N threads every frame (use with --per-draw)
+    // --continuous: redraw every frame instead of only when input, animation or a resize invalidated the window
+    bool serial_init = false;
+    bool triangle = false;
+    bool continuous = false;
+    bool render_pass = false;
+    bool per_draw = false;
+    bool no_occlusion = false;
+    uint32_t layers = 1;
+    uint32_t record_threads = 0;
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    double fps_cap = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        serial_init |= strcmp(argv[i], "--serial-init") == 0;
+        triangle |= strcmp(argv[i], "--triangle") == 0;
+        continuous |= strcmp(argv[i], "--continuous") == 0;
+        render_pass |= strcmp(argv[i], "--render-pass") == 0;
+        per_draw |= strcmp(argv[i], "--per-draw") == 0;
+        no_occlusion |= strcmp(argv[i], "--no-occlusion") == 0;
+        if (strcmp(argv[i], "--layers") == 0 && i + 1 < argc)
+            layers = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+        if (strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc)
+            record_threads = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 0));
+        if (strcmp(argv[i], "--fps-cap") == 0 && i + 1 < argc)
+            fps_cap = atof(argv[i + 1]);
+        if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc)
+        {
+            const char* mode = argv[i + 1];
+            if (strcmp(mode, "fifo") == 0)
+                present_mode = VK_PRESENT_MODE_FIFO_KHR;
+            else if (strcmp(mode, "fifo-relaxed") == 0)
+                present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            else if (strcmp(mode, "immediate") == 0)
+                present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            else
+                present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+        }
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--startup-bench") == 0)
+        {
+            const int iterations = bench_count(argc, argv, i, 10);
+            return iterations > 0
+                       ? HelloTriangleApplication::run_startup_bench(iterations, !serial_init)
+                       : EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--resize-bench") == 0)
+        {
+            const int frames = bench_count(argc, argv, i, 600);
+            return frames > 0 ? HelloTriangleApplication::run_resize_bench(frames) : EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--record-bench") == 0)
+        {
+            const int draws = bench_count(argc, argv, i, 10000);
+            return draws > 0 ? HelloTriangleApplication::run_record_bench(draws) : EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--render-path-bench") == 0)
+        {
+            const int frames = bench_count(argc, argv, i, 600);
+            return frames > 0 ? HelloTriangleApplication::run_render_path_bench(frames) : EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--gpu-driven-bench") == 0)
+        {
+            const int frames = bench_count(argc, argv, i, 300);
+            return frames > 0 ? HelloTriangleApplication::run_gpu_driven_bench(frames) : EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--occlusion-bench") == 0)
+        {
+            const int frames = bench_count(argc, argv, i, 300);
+            return frames > 0 ? HelloTriangleApplication::run_occlusion_bench(frames) : EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--bvh-bench") == 0)
+        {
+            const int objects = bench_count(argc, argv, i, 100000);
+            return objects > 0 ? HelloTriangleApplication::run_bvh_bench(objects) : EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--transform-bench") == 0)
+        {
+            const int entities = bench_count(argc, argv, i, 1000000);
+            return entities > 0 ? HelloTriangleApplication::run_transform_bench(entities) : EXIT_FAILURE;
+        }
+    }
+    if (triangle)
+    {
+        try
+        {
+            HelloTriangleApplication app;
+            app.set_present_mode(present_mode);
+            app.set_frame_cap(fps_cap);
+            app.set_event_driven(!continuous);
+            app.set_dynamic_rendering(!render_pass);
+            app.set_gpu_driven(!per_draw);
+            app.set_occlusion_culling(!no_occlusion);
+            app.set_scene_layers(layers);
+            app.set_record_threads(record_threads);
+            app.run();
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "%s\n", e.what());
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
         return 1;
@@ -476,6 +629,13 @@ int main(int, char**)
     bool show_another_window = false;
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
+    // Redraw only when something changed: platform windows install their own callbacks, so any event that wakes
+    // the wait counts as input. The idle timeout keeps the text cursor blinking and the framerate readout fresh.
+    RedrawScheduler redraw;
+    redraw.set_event_driven(!continuous);
+    redraw.set_invalidate_on_events(true);
+    redraw.set_idle_timeout(0.5);
+
     // Main loop
     while (!glfwWindowShouldClose(window))
     {
@@ -484,7 +644,9 @@ int main(int, char**)
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application, or clear/overwrite your copy of the mouse data.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application, or clear/overwrite your copy of the keyboard data.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-        glfwPollEvents();
+        // Blocks while nothing is dirty and returns false while the main window is minimized.
+        if (!redraw.wait(window))
+            continue;
 
         // Resize swap chain?
         int fb_width, fb_height;
@@ -495,11 +657,7 @@ int main(int, char**)
             ImGui_ImplVulkanH_CreateOrResizeWindow(g_Instance, g_PhysicalDevice, g_Device, wd, g_QueueFamily, g_Allocator, fb_width, fb_height, g_MinImageCount, 0);
             g_MainWindowData.FrameIndex = 0;
             g_SwapChainRebuild = false;
-        }
-        if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0)
-        {
-            ImGui_ImplGlfw_Sleep(10);
-            continue;
+            redraw.invalidate();
         }
 
         // Start the Dear ImGui frame
@@ -531,6 +689,14 @@ int main(int, char**)
             ImGui::Text("counter = %d", counter);
 
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+            const RedrawScheduler::Stats redraw_stats = redraw.stats();
+            ImGui::Text("CPU %.1f%% (average %.1f%%), %llu frames drawn, %.0f%% idle",
+                        redraw_stats.recent_cpu_usage * 100.0, redraw_stats.cpu_usage * 100.0,
+                        (unsigned long long)redraw_stats.frames_drawn,
+                        redraw_stats.wall_s > 0.0 ? redraw_stats.wait_s / redraw_stats.wall_s * 100.0 : 0.0);
+            bool event_driven = redraw.event_driven();
+            if (ImGui::Checkbox("Redraw only on events", &event_driven))
+                redraw.set_event_driven(event_driven);
             ImGui::End();
         }
 
@@ -544,6 +710,9 @@ int main(int, char**)
             ImGui::End();
         }
 
+        // Keep drawing while a widget is being dragged or edited, even if no new events arrive
+        redraw.set_animating(ImGui::IsAnyItemActive() || io.WantTextInput);
+
         // Rendering
         ImGui::Render();
         ImDrawData* main_draw_data = ImGui::GetDrawData();
@@ -565,7 +734,9 @@ int main(int, char**)
         // Present Main Platform Window
         if (!main_is_minimized)
             FramePresent(wd);
+        redraw.frame_drawn();
     }
+    redraw.print_stats("imgui");
 
     // Cleanup
     err = vkDeviceWaitIdle(g_Device);
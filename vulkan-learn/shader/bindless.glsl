@@ -0,0 +1,14 @@
+// BindlessHeap 的着色器端声明, #include 之后用 push constant 中的下标索引各数组.
+// set 0 是每帧数据 (见 sample_triangle.vert). 管线布局的 push constant 范围是全部阶段的 128 字节,
+// 着色器自己声明 layout(push_constant) 块.
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (set = 1, binding = 0) uniform texture2D bindless_textures[];
+// 不带格式的读取需要 shaderStorageImageReadWithoutFormat, 否则按实际格式另外声明一个别名数组
+layout (set = 1, binding = 1) uniform image2D bindless_storage_images[];
+layout (set = 1, binding = 2) buffer BindlessBuffer { uint words[]; } bindless_buffers[];
+layout (set = 1, binding = 3) uniform sampler bindless_samplers[];
+
+// 下标在一次绘制内不统一时 (例如来自实例数据) 需要 nonuniformEXT
+#define bindless_sampler2D(texture_index, sampler_index) \
+    sampler2D(bindless_textures[nonuniformEXT(texture_index)], bindless_samplers[nonuniformEXT(sampler_index)])
@@ -1,7 +1,21 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
 
 layout (location = 0) out vec4 outColor;
 layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec2 fragUV;
+
+// 与 HelloTriangleApplication.h 中的 DrawConstants 一致: offset 0 是顶点着色器的物体下标,
+// 之后是 create_texture 登记进 bindless 堆的纹理和采样器下标
+layout(push_constant) uniform DrawConstants {
+    uint object;
+    uint texture_index;
+    uint sampler_index;
+} draw;
+
 void main() {
-    outColor = vec4(fragColor, 1);
-}
\ No newline at end of file
+    vec3 texel = texture(bindless_sampler2D(draw.texture_index, draw.sampler_index), fragUV).rgb;
+    outColor = vec4(fragColor * texel, 1);
+}
@@ -4,23 +4,47 @@ layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUV;
 
+// 与 HelloTriangleApplication.h 中的 FrameUniforms / MaterialUniforms / ObjectData / DrawConstants 一致,
+// set 0 的三个 uniform buffer 都通过 dynamic offset 指向这一帧在环形缓冲中的数据
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    float time;
+    float aspect;
+} frame;
 
-//vec2 positions[3] = vec2[](
-//    vec2(0.0, -0.5),
-//    vec2(0.5, 0.5),
-//    vec2(-0.5, 0.5)
-//);
-//vec3 colors[3] = vec3[](
-//    vec3(1.0,0.0,0.0),
-//    vec3(0.0,1.0,0.0),
-//    vec3(0.0,0.0,1.0)
-//);
+layout(set = 0, binding = 1) uniform MaterialUniforms {
+    vec4 tint;
+} material;
 
-void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
+// 与 TransformStore::GpuTransform 一致, 正好 32 字节, std140 的数组步长不需要额外取整
+struct ObjectData {
+    vec4 matrix;
+    vec2 offset;
+    float depth;
+    float padding;
+};
+
+// 数组长度为 k_max_objects_per_bind, 实际绑定的范围可能更小, 下标不会超过它
+layout(set = 0, binding = 2) uniform Objects {
+    ObjectData objects[2048];
+};
 
-    //gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    //fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+// 纹理和采样器下标只由片段着色器使用
+layout(push_constant) uniform DrawConstants {
+    uint object;
+    uint texture_index;
+    uint sampler_index;
+} draw;
+
+void main() {
+    ObjectData data = objects[draw.object];
+    // 世界矩阵由 CPU 的 TransformStore 算好, 按列存放
+    vec2 position = mat2(data.matrix.xy, data.matrix.zw) * inPosition;
+    // 保持物体在非正方形窗口中的比例
+    position.x /= frame.aspect;
+    gl_Position = vec4(position + data.offset, data.depth, 1.0);
+    fragColor = inColor * material.tint.rgb;
+    // 网格是边长 1 的正方形, 局部坐标平移后就是纹理坐标
+    fragUV = inPosition + 0.5;
+}
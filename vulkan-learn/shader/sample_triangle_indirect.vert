@@ -0,0 +1,44 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUV;
+
+// GPU 驱动路径: 与 sample_triangle.vert 相同的变换, 物体数据从 GpuCulling 的 storage buffer 读取,
+// 下标来自剔除生成的绘制命令的 firstInstance. set 1 是片段着色器使用的 bindless 堆
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    float time;
+    float aspect;
+} frame;
+
+layout(set = 0, binding = 1) uniform MaterialUniforms {
+    vec4 tint;
+} material;
+
+struct ObjectData {
+    vec4 matrix;
+    vec2 offset;
+    float depth;
+    float padding;
+};
+
+layout(set = 2, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+layout(push_constant) uniform DrawConstants {
+    uint object_base;
+    uint texture_index;
+    uint sampler_index;
+} draw;
+
+void main() {
+    ObjectData data = objects[draw.object_base + gl_InstanceIndex];
+    vec2 position = mat2(data.matrix.xy, data.matrix.zw) * inPosition;
+    position.x /= frame.aspect;
+    gl_Position = vec4(position + data.offset, data.depth, 1.0);
+    fragColor = inColor * material.tint.rgb;
+    fragUV = inPosition + 0.5;
+}
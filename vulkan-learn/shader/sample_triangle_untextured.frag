@@ -0,0 +1,8 @@
+#version 450
+
+// 设备不支持 descriptor indexing (没有 bindless 堆) 时代替 sample_triangle.frag, 只使用顶点颜色
+layout (location = 0) out vec4 outColor;
+layout (location = 0) in vec3 fragColor;
+void main() {
+    outColor = vec4(fragColor, 1);
+}